@@ -2,38 +2,32 @@
 #include <sstream>
 #include <algorithm>
 #include <cstring>
+#include <stdexcept>
 
-HttpRequest::HttpRequest() : complete_(false) {}
+HttpRequest::HttpRequest() : contentLength_(0) {}
 
-bool HttpRequest::parse(const std::vector<char>& rawData) {
-    if (rawData.empty()) {
-        return false;
-    }
-    
-    // Find header/body separator - support both \r\n\r\n and \n\n
-    size_t headerEnd = std::string::npos;
-    size_t headerSize = 0;
-    
-    // Convert to string for header parsing only
-    std::string rawStr(rawData.begin(), rawData.end());
-    
-    // Try \r\n\r\n first
-    headerEnd = rawStr.find("\r\n\r\n");
-    if (headerEnd != std::string::npos) {
-        headerSize = headerEnd + 4;
-    } else {
-        // Try \n\n
-        headerEnd = rawStr.find("\n\n");
-        if (headerEnd != std::string::npos) {
-            headerSize = headerEnd + 2;
-        } else {
-            // Headers not complete yet
-            return false;
+size_t HttpRequest::findHeaderEnd(const char* data, size_t size) {
+    // The first line break followed by an empty line, either style
+    for (const char* p = static_cast<const char*>(std::memchr(data, '\n', size)); p != nullptr;
+         p = static_cast<const char*>(std::memchr(p + 1, '\n', data + size - p - 1))) {
+        size_t next = p + 1 - data;
+        if (next < size && data[next] == '\n') {
+            return next + 1;
+        }
+        if (next + 1 < size && data[next] == '\r' && data[next + 1] == '\n') {
+            return next + 2;
         }
     }
+    return 0;
+}
+
+bool HttpRequest::parse(const char* data, size_t headerSize) {
+    if (headerSize == 0) {
+        return false;
+    }
     
-    // Extract header section
-    std::string headerSection = rawStr.substr(0, headerEnd);
+    // Header parsing works on a copy of the header block only
+    std::string headerSection(data, headerSize);
     
     // Parse request line
     std::istringstream headerStream(headerSection);
@@ -55,25 +49,17 @@ bool HttpRequest::parse(const std::vector<char>& rawData) {
     // Parse headers
     parseHeaders(headerSection);
     
-    // Extract body (binary-safe)
-    if (headerSize < rawData.size()) {
-        body_.assign(rawData.begin() + headerSize, rawData.end());
-    }
-    
-    // Check if request is complete based on Content-Length
+    // No Content-Length means no body (GET/HEAD)
     std::string contentLengthStr = getHeader("content-length");
     if (!contentLengthStr.empty()) {
-        size_t contentLength = std::stoull(contentLengthStr);
-        if (body_.size() >= contentLength) {
-            // Trim body to exact content length
-            body_.resize(contentLength);
-            complete_ = true;
-        } else {
-            complete_ = false;
+        if (contentLengthStr.find_first_not_of("0123456789") != std::string::npos) {
+            return false;
+        }
+        try {
+            contentLength_ = std::stoull(contentLengthStr);
+        } catch (const std::exception&) {
+            return false;
         }
-    } else {
-        // No body expected (GET/HEAD) or body is complete
-        complete_ = true;
     }
     
     return true;
@@ -121,6 +107,14 @@ std::string HttpRequest::getHeader(const std::string& name) const {
     return "";
 }
 
+bool HttpRequest::wantsKeepAlive() const {
+    std::string connection = toLowerCase(getHeader("connection"));
+    if (version_ == "HTTP/1.0") {
+        return connection.find("keep-alive") != std::string::npos;
+    }
+    return connection.find("close") == std::string::npos;
+}
+
 std::string HttpRequest::toLowerCase(const std::string& str) const {
     std::string result = str;
     std::transform(result.begin(), result.end(), result.begin(), ::tolower);
@@ -3,26 +3,32 @@
 
 #include <string>
 #include <map>
-#include <vector>
+#include <cstddef>
 
 class HttpRequest {
 public:
     HttpRequest();
-    bool parse(const std::vector<char>& rawData);
+    // Parses the request line and headers in data[0, headerSize). The body
+    // is not copied; the server streams it to the handler as it arrives.
+    bool parse(const char* data, size_t headerSize);
+    // Length of the header block including the empty line (\r\n\r\n or
+    // \n\n) that ends it, or 0 if it is not complete yet
+    static size_t findHeaderEnd(const char* data, size_t size);
     
     std::string getMethod() const { return method_; }
     std::string getPath() const { return path_; }
     std::string getHeader(const std::string& name) const;
-    const std::vector<char>& getBody() const { return body_; }
-    bool isComplete() const { return complete_; }
+    size_t getContentLength() const { return contentLength_; }
+    // HTTP/1.1 keeps the connection open unless "Connection: close";
+    // HTTP/1.0 only with "Connection: keep-alive"
+    bool wantsKeepAlive() const;
     
 private:
     std::string method_;
     std::string path_;
     std::string version_;
     std::map<std::string, std::string> headers_;
-    std::vector<char> body_;
-    bool complete_;
+    size_t contentLength_;
     
     void parseHeaders(const std::string& headerSection);
     std::string toLowerCase(const std::string& str) const;
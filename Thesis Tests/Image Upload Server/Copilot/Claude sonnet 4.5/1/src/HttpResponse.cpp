@@ -22,7 +22,7 @@ void HttpResponse::setBody(const std::string& body) {
     body_.assign(body.begin(), body.end());
 }
 
-std::vector<char> HttpResponse::build() const {
+std::vector<char> HttpResponse::build(bool keepAlive) const {
     std::ostringstream responseStream;
     
     // Status line
@@ -37,7 +37,7 @@ std::vector<char> HttpResponse::build() const {
     responseStream << "Content-Length: " << body_.size() << "\r\n";
     
     // Connection header
-    responseStream << "Connection: close\r\n";
+    responseStream << "Connection: " << (keepAlive ? "keep-alive" : "close") << "\r\n";
     
     // Empty line separating headers from body
     responseStream << "\r\n";
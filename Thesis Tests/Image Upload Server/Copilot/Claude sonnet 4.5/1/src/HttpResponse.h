@@ -14,7 +14,8 @@ public:
     void setBody(const std::vector<char>& body);
     void setBody(const std::string& body);
     
-    std::vector<char> build() const;
+    // keepAlive announces whether the connection stays open for another request
+    std::vector<char> build(bool keepAlive = false) const;
     
     // Helper methods for common status codes
     static HttpResponse ok(const std::vector<char>& body, const std::string& contentType = "text/html");
@@ -0,0 +1,161 @@
+#include "MultipartParser.h"
+#include <algorithm>
+
+MultipartParser::MultipartParser(const std::string& boundary, PartBegin onPartBegin, PartData onPartData,
+                                 PartEnd onPartEnd)
+    : state_(State::Preamble), delimiter_("\n--" + boundary), headerBytes_(0),
+      onPartBegin_(onPartBegin), onPartData_(onPartData), onPartEnd_(onPartEnd) {
+    // The first boundary may open the body, so start as if after a line break
+    pending_ = "\n";
+}
+
+bool MultipartParser::feed(const char* data, size_t size) {
+    if (state_ == State::Error) {
+        return false;
+    }
+    if (state_ == State::Done) {
+        return true;  // epilogue, ignored
+    }
+    
+    pending_.append(data, size);
+    size_t pos = 0;
+    bool progress = true;
+    while (progress) {
+        switch (state_) {
+            case State::Preamble:
+                progress = parsePreamble(pos);
+                break;
+            case State::AfterBoundary:
+                progress = parseAfterBoundary(pos);
+                break;
+            case State::Headers:
+                progress = parseHeaders(pos);
+                break;
+            case State::Body:
+                progress = parseBody(pos);
+                break;
+            default:
+                progress = false;
+        }
+    }
+    
+    if (state_ == State::Done) {
+        pending_.clear();
+    } else {
+        pending_.erase(0, pos);
+    }
+    return state_ != State::Error;
+}
+
+bool MultipartParser::fail(const std::string& message) {
+    error_ = message;
+    state_ = State::Error;
+    return false;
+}
+
+bool MultipartParser::parsePreamble(size_t& pos) {
+    size_t found = pending_.find(delimiter_, pos);
+    if (found == std::string::npos) {
+        // Keep what could be the start of a boundary split across chunks
+        pos = std::max(pos, pending_.size() - std::min(pending_.size(), delimiter_.size() - 1));
+        return false;
+    }
+    pos = found + delimiter_.size();
+    state_ = State::AfterBoundary;
+    return true;
+}
+
+bool MultipartParser::parseAfterBoundary(size_t& pos) {
+    if (pending_.size() - pos < 2) {
+        return false;
+    }
+    if (pending_.compare(pos, 2, "--") == 0) {
+        pos += 2;
+        state_ = State::Done;
+        return false;
+    }
+    
+    // Skip transport padding up to the line break
+    size_t lineEnd = pending_.find('\n', pos);
+    if (lineEnd == std::string::npos) {
+        if (pending_.size() - pos > MAX_HEADER_SIZE) {
+            return fail("Malformed multipart boundary line");
+        }
+        return false;
+    }
+    pos = lineEnd + 1;
+    headers_.clear();
+    headerBytes_ = 0;
+    state_ = State::Headers;
+    return true;
+}
+
+bool MultipartParser::parseHeaders(size_t& pos) {
+    size_t lineEnd = pending_.find('\n', pos);
+    if (lineEnd == std::string::npos) {
+        if (headerBytes_ + pending_.size() - pos > MAX_HEADER_SIZE) {
+            return fail("Multipart part headers too large");
+        }
+        return false;
+    }
+    
+    std::string line = pending_.substr(pos, lineEnd - pos);
+    headerBytes_ += lineEnd + 1 - pos;
+    pos = lineEnd + 1;
+    if (headerBytes_ > MAX_HEADER_SIZE) {
+        return fail("Multipart part headers too large");
+    }
+    
+    // Remove \r if present
+    if (!line.empty() && line.back() == '\r') {
+        line.pop_back();
+    }
+    
+    // An empty line ends the headers
+    if (line.empty()) {
+        state_ = State::Body;
+        if (!onPartBegin_(headers_)) {
+            return fail("Multipart part rejected");
+        }
+        return true;
+    }
+    
+    size_t colonPos = line.find(':');
+    if (colonPos != std::string::npos) {
+        std::string name = line.substr(0, colonPos);
+        std::string value = line.substr(colonPos + 1);
+        std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+        value.erase(0, value.find_first_not_of(" \t"));
+        value.erase(value.find_last_not_of(" \t") + 1);
+        headers_[name] = value;
+    }
+    return true;
+}
+
+bool MultipartParser::parseBody(size_t& pos) {
+    size_t found = pending_.find(delimiter_, pos);
+    if (found == std::string::npos) {
+        // Everything but a possible partial delimiter (and the CR before it) is part data
+        size_t keep = std::min(pending_.size() - pos, delimiter_.size());
+        size_t end = pending_.size() - keep;
+        if (end > pos && !onPartData_(pending_.data() + pos, end - pos)) {
+            return fail("Multipart part rejected");
+        }
+        pos = end;
+        return false;
+    }
+    
+    size_t end = found;
+    if (end > pos && pending_[end - 1] == '\r') {
+        --end;
+    }
+    if (end > pos && !onPartData_(pending_.data() + pos, end - pos)) {
+        return fail("Multipart part rejected");
+    }
+    if (!onPartEnd_()) {
+        return fail("Multipart part rejected");
+    }
+    pos = found + delimiter_.size();
+    state_ = State::AfterBoundary;
+    return true;
+}
@@ -0,0 +1,58 @@
+#ifndef MULTIPART_PARSER_H
+#define MULTIPART_PARSER_H
+
+#include <string>
+#include <map>
+#include <functional>
+#include <cstddef>
+
+// Incremental multipart/form-data parser. The body is fed in chunks as
+// they arrive from the socket; part headers are collected, but part bodies
+// are handed to onPartData as they are found and never buffered, so memory
+// stays constant whatever the upload size. Lines may end in CRLF or LF.
+class MultipartParser {
+public:
+    // Header names are lowercase. A callback returning false stops the parser.
+    using PartBegin = std::function<bool(const std::map<std::string, std::string>& headers)>;
+    using PartData = std::function<bool(const char* data, size_t size)>;
+    using PartEnd = std::function<bool()>;
+    
+    MultipartParser(const std::string& boundary, PartBegin onPartBegin, PartData onPartData, PartEnd onPartEnd);
+    
+    // False once the input is malformed or a callback refused it
+    bool feed(const char* data, size_t size);
+    
+    bool isDone() const { return state_ == State::Done; }
+    std::string getError() const { return error_; }
+    
+    // Part headers larger than this are rejected
+    static const size_t MAX_HEADER_SIZE = 16 * 1024;
+    
+private:
+    enum class State {
+        Preamble,       // before the first boundary
+        AfterBoundary,  // "--" closes the body, a line break starts a part
+        Headers,
+        Body,
+        Done,
+        Error
+    };
+    
+    State state_;
+    std::string delimiter_;   // "\n--" + boundary; a CR before it belongs to it too
+    std::string pending_;     // bytes not yet consumed, bounded by one chunk plus a delimiter
+    std::map<std::string, std::string> headers_;
+    size_t headerBytes_;
+    std::string error_;
+    PartBegin onPartBegin_;
+    PartData onPartData_;
+    PartEnd onPartEnd_;
+    
+    bool fail(const std::string& message);
+    bool parsePreamble(size_t& pos);
+    bool parseAfterBoundary(size_t& pos);
+    bool parseHeaders(size_t& pos);
+    bool parseBody(size_t& pos);
+};
+
+#endif // MULTIPART_PARSER_H
@@ -1,24 +1,43 @@
 #include "Server.h"
-#include "HttpRequest.h"
-#include "HttpResponse.h"
 #include "FileHandler.h"
-#include "UploadHandler.h"
 #include <sys/socket.h>
+#include <sys/epoll.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <csignal>
 #include <cstring>
+#include <cerrno>
 #include <iostream>
 #include <vector>
+#include <algorithm>
 
-Server::Server(int port) : port_(port), serverSocket_(-1) {
+// Socket reads use chunks of this size; a request's memory does not depend on its body
+static const size_t READ_CHUNK_SIZE = 64 * 1024;
+// Requests whose headers do not end within this many bytes are rejected
+static const size_t MAX_HEADER_SIZE = 64 * 1024;
+// Events handled per epoll_wait() call
+static const int MAX_EVENTS = 256;
+// A connection's turn ends after this many bytes moved or requests started;
+// the rest waits until every other ready connection has had its turn
+static const size_t TURN_BYTES = 256 * 1024;
+static const int TURN_REQUESTS = 16;
+// Connections without any progress for this long are closed, idle keep-alive ones included
+static const std::chrono::seconds CONNECTION_TIMEOUT(5);
+
+Server::Server(int port) : port_(port), serverSocket_(-1), epollFd_(-1), readBuffer_(READ_CHUNK_SIZE) {
     // Ignore SIGPIPE to prevent server crashes when client disconnects
     std::signal(SIGPIPE, SIG_IGN);
 }
 
 Server::~Server() {
+    for (auto& entry : connections_) {
+        close(entry.first);
+    }
+    if (epollFd_ >= 0) {
+        close(epollFd_);
+    }
     if (serverSocket_ >= 0) {
         close(serverSocket_);
     }
@@ -26,7 +45,7 @@ Server::~Server() {
 
 void Server::setupSocket() {
     // Create socket
-    serverSocket_ = socket(AF_INET, SOCK_STREAM, 0);
+    serverSocket_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
     if (serverSocket_ < 0) {
         throw std::runtime_error("Failed to create socket");
     }
@@ -51,201 +70,329 @@ void Server::setupSocket() {
     }
     
     // Listen for connections
-    if (listen(serverSocket_, 10) < 0) {
+    if (listen(serverSocket_, SOMAXCONN) < 0) {
         close(serverSocket_);
         throw std::runtime_error("Failed to listen on socket");
     }
     
+    // The listening socket is level-triggered: connections not accepted in
+    // one pass are reported again
+    epollFd_ = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event event;
+    std::memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = serverSocket_;
+    if (epollFd_ < 0 || epoll_ctl(epollFd_, EPOLL_CTL_ADD, serverSocket_, &event) < 0) {
+        throw std::runtime_error("Failed to set up epoll");
+    }
+    
     std::cout << "Server listening on port " << port_ << std::endl;
 }
 
 void Server::run() {
     setupSocket();
     
+    std::vector<struct epoll_event> events(MAX_EVENTS);
+    auto lastSweep = std::chrono::steady_clock::now();
     while (true) {
-        // Accept client connection
-        struct sockaddr_in clientAddr;
-        socklen_t clientAddrLen = sizeof(clientAddr);
+        // Connections with work left over must not wait for an event that will not come
+        int ready = epoll_wait(epollFd_, events.data(), MAX_EVENTS, readyQueue_.empty() ? 1000 : 0);
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error("epoll_wait failed");
+        }
+        
+        for (int i = 0; i < ready; ++i) {
+            int fd = events[i].data.fd;
+            if (fd == serverSocket_) {
+                acceptConnections();
+                continue;
+            }
+            auto it = connections_.find(fd);
+            if (it == connections_.end()) {
+                continue;
+            }
+            Connection& conn = *it->second;
+            uint32_t flags = events[i].events;
+            if (flags & EPOLLERR) {
+                closeConnection(fd);
+                continue;
+            }
+            // A hang-up is read like data: recv() then reports the end of the stream
+            if (flags & (EPOLLIN | EPOLLRDHUP | EPOLLHUP)) {
+                conn.readable = true;
+            }
+            if (flags & EPOLLOUT) {
+                conn.writable = true;
+            }
+            if (!service(conn)) {
+                closeConnection(fd);
+            }
+        }
         
-        int clientSock = accept(serverSocket_, (struct sockaddr*)&clientAddr, &clientAddrLen);
+        // Then the next turn of the connections that used up their last one
+        std::vector<int> turns;
+        turns.swap(readyQueue_);
+        for (int fd : turns) {
+            auto it = connections_.find(fd);
+            if (it == connections_.end()) {
+                continue;
+            }
+            it->second->queued = false;
+            if (!service(*it->second)) {
+                closeConnection(fd);
+            }
+        }
+        
+        auto now = std::chrono::steady_clock::now();
+        if (now - lastSweep >= std::chrono::seconds(1)) {
+            closeIdleConnections();
+            lastSweep = now;
+        }
+    }
+}
+
+void Server::acceptConnections() {
+    while (true) {
+        int clientSock = accept4(serverSocket_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
         if (clientSock < 0) {
-            std::cerr << "Failed to accept connection" << std::endl;
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                std::cerr << "Failed to accept connection" << std::endl;
+            }
+            return;
+        }
+        
+        // Registered once for both directions; the flags in Connection
+        // remember what the edges reported
+        struct epoll_event event;
+        std::memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        event.data.fd = clientSock;
+        if (epoll_ctl(epollFd_, EPOLL_CTL_ADD, clientSock, &event) < 0) {
+            std::cerr << "Failed to watch connection" << std::endl;
+            close(clientSock);
             continue;
         }
         
+        std::unique_ptr<Connection> conn(new Connection());
+        conn->sock = clientSock;
+        conn->lastActive = std::chrono::steady_clock::now();
+        connections_[clientSock] = std::move(conn);
         std::cout << "Client connected from " << getClientIP(clientSock) << std::endl;
+    }
+}
+
+bool Server::service(Connection& conn) {
+    size_t bytes = 0;
+    int requests = 0;
+    while (true) {
+        // Edge-triggered: nothing reports this connection again, so requeue it
+        if (bytes >= TURN_BYTES || requests >= TURN_REQUESTS) {
+            if (!conn.queued) {
+                conn.queued = true;
+                readyQueue_.push_back(conn.sock);
+            }
+            return true;
+        }
+        
+        if (conn.state == Connection::State::Writing) {
+            size_t sentBefore = conn.outputSent;
+            if (!flush(conn, TURN_BYTES - bytes)) {
+                return false;
+            }
+            bytes += conn.outputSent - sentBefore;
+            if (conn.outputSent < conn.output.size()) {
+                if (conn.writable) {
+                    continue;  // turn used up
+                }
+                return true;  // wait for EPOLLOUT
+            }
+            if (!conn.keepAlive) {
+                return false;
+            }
+            conn.output.clear();
+            conn.outputSent = 0;
+            conn.state = Connection::State::ReadingHeaders;
+            continue;
+        }
         
-        // Handle client request
-        try {
-            handleClient(clientSock);
-        } catch (const std::exception& e) {
-            std::cerr << "Error handling client: " << e.what() << std::endl;
+        // Use what is buffered first: pipelined requests are already here
+        if (conn.state == Connection::State::ReadingHeaders) {
+            size_t headerSize = HttpRequest::findHeaderEnd(conn.input.data(), conn.input.size());
+            if (headerSize > 0) {
+                startRequest(conn, headerSize);
+                ++requests;
+                continue;
+            }
+            if (conn.input.size() > MAX_HEADER_SIZE) {
+                respond(conn, HttpResponse::badRequest("Request headers too large"), false);
+                continue;
+            }
+        } else if (!conn.input.empty()) {
+            size_t size = std::min(conn.input.size(), conn.bodyRemaining);
+            std::string rest = conn.input.substr(size);
+            consumeBody(conn, conn.input.data(), size);
+            conn.input.swap(rest);
+            continue;
         }
         
-        close(clientSock);
-        std::cout << "Client disconnected" << std::endl;
+        // More input needed
+        if (!conn.readable) {
+            return true;
+        }
+        // A body is read straight from the socket into its consumer, never
+        // past its end, so the next request stays in the socket
+        size_t wanted = readBuffer_.size();
+        if (conn.state == Connection::State::ReadingBody) {
+            wanted = std::min(wanted, conn.bodyRemaining);
+        }
+        ssize_t bytesRead = recv(conn.sock, readBuffer_.data(), wanted, 0);
+        if (bytesRead < 0 && errno == EINTR) {
+            continue;
+        }
+        if (bytesRead < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            conn.readable = false;
+            return true;
+        }
+        if (bytesRead <= 0) {
+            // Closing between requests is how keep-alive connections end
+            if (conn.state != Connection::State::ReadingHeaders || !conn.input.empty()) {
+                std::cerr << "Incomplete request received" << std::endl;
+            }
+            return false;
+        }
+        conn.lastActive = std::chrono::steady_clock::now();
+        bytes += bytesRead;
+        if (conn.state == Connection::State::ReadingBody) {
+            consumeBody(conn, readBuffer_.data(), bytesRead);
+        } else {
+            conn.input.append(readBuffer_.data(), bytesRead);
+        }
     }
 }
 
-void Server::handleClient(int clientSock) {
-    // Read request
-    std::vector<char> rawRequest = readRequest(clientSock);
-    if (rawRequest.empty()) {
-        std::cerr << "Empty request received" << std::endl;
-        return;
-    }
-    
+void Server::startRequest(Connection& conn, size_t headerSize) {
     // Parse HTTP request
-    HttpRequest request;
-    if (!request.parse(rawRequest)) {
+    conn.request = HttpRequest();
+    bool parsed = conn.request.parse(conn.input.data(), headerSize);
+    conn.input.erase(0, headerSize);
+    if (!parsed) {
         std::cerr << "Failed to parse request" << std::endl;
-        HttpResponse response = HttpResponse::badRequest("Invalid HTTP request");
-        sendResponse(clientSock, response.build());
+        respond(conn, HttpResponse::badRequest("Invalid HTTP request"), false);
         return;
     }
-    
-    // Check if request is complete
-    if (!request.isComplete()) {
-        std::cerr << "Incomplete request received" << std::endl;
-        HttpResponse response = HttpResponse::badRequest("Incomplete request");
-        sendResponse(clientSock, response.build());
+    // Without a length the end of a chunked body cannot be found, nor the next request
+    if (!conn.request.getHeader("transfer-encoding").empty()) {
+        respond(conn, HttpResponse::badRequest("Chunked request bodies are not supported"), false);
         return;
     }
     
-    std::cout << "Request: " << request.getMethod() << " " << request.getPath() << std::endl;
-    
-    // Route request
-    HttpResponse response;
+    std::cout << "Request: " << conn.request.getMethod() << " " << conn.request.getPath() << std::endl;
     
-    if (request.getMethod() == "GET") {
-        // Serve static files
-        FileHandler fileHandler;
-        response = fileHandler.handle(request.getPath());
-    } else if (request.getMethod() == "POST") {
-        // Handle file upload
-        std::string contentType = request.getHeader("content-type");
+    conn.keepAlive = conn.request.wantsKeepAlive();
+    conn.bodyRemaining = conn.request.getContentLength();
+    conn.upload.reset();
+    conn.uploadResult.clear();
+    if (conn.request.getMethod() == "POST") {
+        // Handle file upload, writing the file while it is received
+        std::string contentType = conn.request.getHeader("content-type");
         if (contentType.find("multipart/form-data") != std::string::npos) {
-            UploadHandler uploadHandler;
-            std::string result = uploadHandler.handle(request.getBody(), contentType);
-            
-            // Parse result to determine status code
-            if (result.find("200 OK") == 0) {
-                response = HttpResponse::ok(result, "text/plain");
-            } else if (result.find("400") == 0) {
-                response = HttpResponse::badRequest(result);
-            } else {
-                response = HttpResponse::internalError(result);
-            }
+            conn.upload.reset(new UploadHandler());
+            conn.uploadResult = conn.upload->begin(contentType);
         } else {
-            response = HttpResponse::badRequest("Expected multipart/form-data");
+            conn.uploadResult = "400 Bad Request: Expected multipart/form-data";
         }
-    } else {
-        response = HttpResponse::badRequest("Method not supported");
     }
     
-    // Send response
-    sendResponse(clientSock, response.build());
+    conn.state = Connection::State::ReadingBody;
+    if (conn.bodyRemaining == 0) {
+        respond(conn, route(conn), conn.keepAlive);
+    }
+}
+
+void Server::consumeBody(Connection& conn, const char* data, size_t size) {
+    // Bodies of other requests are read and dropped so the connection stays usable
+    if (conn.upload && conn.uploadResult.empty()) {
+        conn.upload->feed(data, size);
+    }
+    conn.bodyRemaining -= size;
+    if (conn.bodyRemaining == 0) {
+        respond(conn, route(conn), conn.keepAlive);
+    }
 }
 
-std::vector<char> Server::readRequest(int clientSock) {
-    std::vector<char> buffer;
-    char chunk[4096];
+HttpResponse Server::route(Connection& conn) {
+    const HttpRequest& request = conn.request;
     
-    // Set socket to non-blocking mode temporarily
-    int flags = fcntl(clientSock, F_GETFL, 0);
-    fcntl(clientSock, F_SETFL, flags | O_NONBLOCK);
+    if (request.getMethod() == "GET") {
+        // Serve static files
+        FileHandler fileHandler;
+        return fileHandler.handle(request.getPath());
+    }
+    if (request.getMethod() != "POST") {
+        return HttpResponse::badRequest("Method not supported");
+    }
     
-    // Read data in chunks with timeout
-    fd_set readSet;
-    struct timeval timeout;
-    bool headersComplete = false;
-    size_t contentLength = 0;
-    size_t headerSize = 0;
+    std::string result = conn.uploadResult.empty() ? conn.upload->finish() : conn.uploadResult;
     
-    while (true) {
-        FD_ZERO(&readSet);
-        FD_SET(clientSock, &readSet);
-        timeout.tv_sec = 5;  // 5 second timeout
-        timeout.tv_usec = 0;
-        
-        int selectResult = select(clientSock + 1, &readSet, nullptr, nullptr, &timeout);
-        if (selectResult <= 0) {
-            break;  // Timeout or error
-        }
-        
-        ssize_t bytesRead = recv(clientSock, chunk, sizeof(chunk), 0);
-        if (bytesRead <= 0) {
-            break;  // Connection closed or error
+    // Parse result to determine status code
+    if (result.find("200 OK") == 0) {
+        return HttpResponse::ok(result, "text/plain");
+    } else if (result.find("400") == 0) {
+        return HttpResponse::badRequest(result);
+    }
+    return HttpResponse::internalError(result);
+}
+
+void Server::respond(Connection& conn, const HttpResponse& response, bool keepAlive) {
+    conn.upload.reset();
+    conn.keepAlive = keepAlive;
+    conn.output = response.build(keepAlive);
+    conn.outputSent = 0;
+    conn.state = Connection::State::Writing;
+}
+
+bool Server::flush(Connection& conn, size_t limit) {
+    size_t end = conn.outputSent + std::min(limit, conn.output.size() - conn.outputSent);
+    while (conn.outputSent < end && conn.writable) {
+        ssize_t sent = send(conn.sock, conn.output.data() + conn.outputSent,
+                            end - conn.outputSent, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) {
+            continue;
         }
-        
-        buffer.insert(buffer.end(), chunk, chunk + bytesRead);
-        
-        // Check if headers are complete
-        if (!headersComplete) {
-            std::string bufferStr(buffer.begin(), buffer.end());
-            size_t headerEnd = bufferStr.find("\r\n\r\n");
-            if (headerEnd == std::string::npos) {
-                headerEnd = bufferStr.find("\n\n");
-                if (headerEnd != std::string::npos) {
-                    headerSize = headerEnd + 2;
-                    headersComplete = true;
-                }
-            } else {
-                headerSize = headerEnd + 4;
-                headersComplete = true;
-            }
-            
-            if (headersComplete) {
-                // Extract Content-Length
-                std::string headers = bufferStr.substr(0, headerSize);
-                size_t clPos = headers.find("Content-Length:");
-                if (clPos == std::string::npos) {
-                    clPos = headers.find("content-length:");
-                }
-                
-                if (clPos != std::string::npos) {
-                    size_t lineEnd = headers.find("\n", clPos);
-                    std::string clLine = headers.substr(clPos, lineEnd - clPos);
-                    size_t colonPos = clLine.find(':');
-                    if (colonPos != std::string::npos) {
-                        std::string clValue = clLine.substr(colonPos + 1);
-                        // Trim whitespace
-                        clValue.erase(0, clValue.find_first_not_of(" \t\r\n"));
-                        clValue.erase(clValue.find_last_not_of(" \t\r\n") + 1);
-                        contentLength = std::stoull(clValue);
-                    }
-                } else {
-                    // No Content-Length, request is complete
-                    break;
-                }
-            }
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            conn.writable = false;
+            break;
         }
-        
-        // Check if we have received all data
-        if (headersComplete) {
-            size_t bodySize = buffer.size() - headerSize;
-            if (bodySize >= contentLength) {
-                break;  // Request complete
-            }
+        if (sent < 0) {
+            std::cerr << "Failed to send response" << std::endl;
+            return false;
         }
+        conn.outputSent += sent;
+        conn.lastActive = std::chrono::steady_clock::now();
     }
-    
-    // Restore blocking mode
-    fcntl(clientSock, F_SETFL, flags);
-    
-    return buffer;
+    return true;
 }
 
-void Server::sendResponse(int clientSock, const std::vector<char>& response) {
-    size_t totalSent = 0;
-    while (totalSent < response.size()) {
-        ssize_t sent = send(clientSock, response.data() + totalSent, 
-                           response.size() - totalSent, MSG_NOSIGNAL);
-        if (sent < 0) {
-            std::cerr << "Failed to send response" << std::endl;
-            break;
+void Server::closeConnection(int clientSock) {
+    // Closing the socket also removes it from the epoll set
+    close(clientSock);
+    connections_.erase(clientSock);
+    std::cout << "Client disconnected" << std::endl;
+}
+
+void Server::closeIdleConnections() {
+    auto now = std::chrono::steady_clock::now();
+    std::vector<int> idle;
+    for (const auto& entry : connections_) {
+        if (now - entry.second->lastActive >= CONNECTION_TIMEOUT) {
+            idle.push_back(entry.first);
         }
-        totalSent += sent;
+    }
+    for (int clientSock : idle) {
+        closeConnection(clientSock);
     }
 }
 
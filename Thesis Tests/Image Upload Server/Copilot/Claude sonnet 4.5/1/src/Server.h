@@ -4,7 +4,18 @@
 #include <string>
 #include <map>
 #include <vector>
+#include <memory>
+#include <chrono>
+#include <unordered_map>
+#include "HttpRequest.h"
+#include "HttpResponse.h"
+#include "UploadHandler.h"
 
+// Single-threaded reactor. Every socket is non-blocking and watched by one
+// epoll instance, client sockets edge-triggered. Each connection is a small
+// state machine, so a slow client only holds its own state. Connections stay
+// open between requests (HTTP/1.1 keep-alive), and pipelined requests are
+// answered in order.
 class Server {
 public:
     Server(int port);
@@ -13,13 +24,49 @@ public:
     void run();
     
 private:
+    struct Connection {
+        enum class State {
+            ReadingHeaders,  // buffering up to the empty line
+            ReadingBody,     // passing Content-Length bytes to the handler
+            Writing          // sending the response
+        };
+        
+        int sock;
+        State state = State::ReadingHeaders;
+        // Edge-triggered: set by an event, cleared when recv()/send() would block
+        bool readable = true;
+        bool writable = true;
+        bool queued = false;     // in readyQueue_: stopped with work left, not for lack of data
+        std::string input;       // received, not yet consumed; may hold pipelined requests
+        HttpRequest request;
+        size_t bodyRemaining = 0;
+        std::unique_ptr<UploadHandler> upload;
+        std::string uploadResult;  // error decided before the body was read
+        bool keepAlive = false;
+        std::vector<char> output;
+        size_t outputSent = 0;
+        std::chrono::steady_clock::time_point lastActive;
+    };
+    
     int port_;
     int serverSocket_;
+    int epollFd_;
+    std::unordered_map<int, std::unique_ptr<Connection>> connections_;
+    std::vector<char> readBuffer_;  // shared; only the event loop thread reads
+    std::vector<int> readyQueue_;   // connections whose turn ended before they would block
     
     void setupSocket();
-    void handleClient(int clientSock);
-    std::vector<char> readRequest(int clientSock);
-    void sendResponse(int clientSock, const std::vector<char>& response);
+    void acceptConnections();
+    // Runs conn's state machine until it would block or its turn is used up;
+    // false once it should be closed
+    bool service(Connection& conn);
+    void startRequest(Connection& conn, size_t headerSize);
+    void consumeBody(Connection& conn, const char* data, size_t size);
+    HttpResponse route(Connection& conn);
+    void respond(Connection& conn, const HttpResponse& response, bool keepAlive);
+    bool flush(Connection& conn, size_t limit);  // sends up to limit bytes; false on a send error
+    void closeConnection(int clientSock);
+    void closeIdleConnections();
     std::string getClientIP(int clientSock);
 };
 
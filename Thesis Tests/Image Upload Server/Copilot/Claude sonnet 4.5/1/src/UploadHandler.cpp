@@ -1,11 +1,22 @@
 #include "UploadHandler.h"
-#include <fstream>
 #include <chrono>
 #include <sstream>
 #include <algorithm>
 #include <cstring>
+#include <cstdio>
+#include <cerrno>
+#include <cstdlib>
+#include <unistd.h>
+#include <sys/stat.h>
 
-std::string UploadHandler::handle(const std::vector<char>& body, const std::string& contentType) {
+UploadHandler::UploadHandler(const std::string& uploadDir)
+    : uploadDir_(uploadDir), tempFd_(-1), fileSize_(0), inFilePart_(false), fileDone_(false) {}
+
+UploadHandler::~UploadHandler() {
+    removeTempFile();
+}
+
+std::string UploadHandler::begin(const std::string& contentType) {
     // Extract boundary from Content-Type header
     std::string boundaryPrefix = "boundary=";
     size_t boundaryPos = contentType.find(boundaryPrefix);
@@ -13,92 +24,153 @@ std::string UploadHandler::handle(const std::vector<char>& body, const std::stri
         return "400 Bad Request: No boundary in Content-Type";
     }
     
-    std::string boundary = "--" + contentType.substr(boundaryPos + boundaryPrefix.length());
-    
-    // Convert body to string for parsing (we'll extract binary data separately)
-    std::string data(body.begin(), body.end());
-    
-    // Find the file field
-    size_t fileFieldPos = data.find("Content-Disposition:");
-    if (fileFieldPos == std::string::npos) {
-        return "400 Bad Request: No Content-Disposition found";
+    std::string boundary = contentType.substr(boundaryPos + boundaryPrefix.length());
+    boundary = boundary.substr(0, boundary.find(';'));
+    if (boundary.size() >= 2 && boundary.front() == '"' && boundary.back() == '"') {
+        boundary = boundary.substr(1, boundary.size() - 2);
+    }
+    if (boundary.empty()) {
+        return "400 Bad Request: No boundary in Content-Type";
     }
     
-    // Extract Content-Disposition line
-    size_t dispEnd = data.find("\n", fileFieldPos);
-    if (dispEnd == std::string::npos) {
-        return "400 Bad Request: Invalid Content-Disposition";
+    parser_.reset(new MultipartParser(
+        boundary,
+        [this](const std::map<std::string, std::string>& headers) { return onPartBegin(headers); },
+        [this](const char* data, size_t size) { return onPartData(data, size); },
+        [this]() { return onPartEnd(); }));
+    return "";
+}
+
+bool UploadHandler::feed(const char* data, size_t size) {
+    if (!parser_ || !result_.empty()) {
+        return false;
+    }
+    if (!parser_->feed(data, size)) {
+        // A refusing callback has already set the result
+        if (result_.empty()) {
+            result_ = "400 Bad Request: " + parser_->getError();
+        }
+        removeTempFile();
+        return false;
+    }
+    return true;
+}
+
+std::string UploadHandler::finish() {
+    if (!parser_) {
+        return "400 Bad Request: Expected multipart/form-data";
     }
+    if (!result_.empty()) {
+        return result_;
+    }
+    if (!parser_->isDone()) {
+        return "400 Bad Request: Incomplete multipart body";
+    }
+    if (!fileDone_) {
+        return "400 Bad Request: Expected field name 'file'";
+    }
+    if (fileSize_ == 0) {
+        return "400 Bad Request: Empty file data";
+    }
+    
+    // Generate unique filename with timestamp
+    std::string timestamp = generateTimestamp();
+    std::string savedFilename = timestamp + "_" + filename_;
+    std::string filepath = uploadDir_ + "/" + savedFilename;
     
-    std::string contentDisposition = data.substr(fileFieldPos, dispEnd - fileFieldPos);
+    // The data is on disk already; publish it under its final name
+    bool closed = close(tempFd_) == 0;
+    tempFd_ = -1;
+    if (!closed || std::rename(tempPath_.c_str(), filepath.c_str()) != 0) {
+        return "500 Internal Server Error: Failed to save file";
+    }
+    tempPath_.clear();
     
-    // Check if this is the "file" field
-    if (contentDisposition.find("name=\"file\"") == std::string::npos) {
-        return "400 Bad Request: Expected field name 'file'";
+    return "200 OK: File uploaded successfully as " + savedFilename;
+}
+
+bool UploadHandler::onPartBegin(const std::map<std::string, std::string>& headers) {
+    // Only the first "file" field is stored; other fields are skipped
+    auto disposition = headers.find("content-disposition");
+    if (fileDone_ || disposition == headers.end()) {
+        return true;
+    }
+    const std::string& value = disposition->second;
+    size_t namePos = value.find("name=\"file\"");
+    while (namePos != std::string::npos && namePos > 0 && value[namePos - 1] != ' ' && value[namePos - 1] != ';') {
+        namePos = value.find("name=\"file\"", namePos + 1);  // not the end of filename="file"
+    }
+    if (namePos == std::string::npos) {
+        return true;
     }
     
-    // Extract filename
-    std::string filename = extractFilename(contentDisposition);
+    // Extract filename, without any directory a client put in front of it
+    std::string filename = extractFilename(value);
+    filename = filename.substr(filename.find_last_of("/\\") + 1);
     if (filename.empty()) {
-        return "400 Bad Request: No filename provided";
+        result_ = "400 Bad Request: No filename provided";
+        return false;
     }
     
     // Validate file extension
     if (!isValidImageExtension(filename)) {
-        return "400 Bad Request: Invalid file type. Only JPG, PNG, GIF, and BMP are allowed.";
+        result_ = "400 Bad Request: Invalid file type. Only JPG, PNG, GIF, and BMP are allowed.";
+        return false;
     }
     
-    // Find where the file data starts (after all part headers)
-    // Start searching from the Content-Disposition line
-    size_t search_pos = fileFieldPos;
-    
-    // Find file data start - support both \r\n\r\n and \n\n
-    size_t file_data_start = data.find("\r\n\r\n", search_pos);
-    if (file_data_start == std::string::npos) {
-        file_data_start = data.find("\n\n", search_pos);
-        if (file_data_start == std::string::npos) {
-            return "400 Bad Request: No file data found";
-        }
-        file_data_start += 2;
-    } else {
-        file_data_start += 4;
+    // Stream into a hidden temporary file next to its final location
+    std::string tempPath = uploadDir_ + "/.upload-XXXXXX";
+    tempFd_ = mkstemp(&tempPath[0]);
+    if (tempFd_ >= 0) {
+        fchmod(tempFd_, 0644);  // mkstemp creates it owner-only
     }
-    
-    // Find file data end (boundary)
-    size_t file_data_end = data.find(boundary, file_data_start);
-    if (file_data_end == std::string::npos) {
-        // Fallback to end of data if boundary not found
-        file_data_end = data.length();
+    if (tempFd_ < 0) {
+        result_ = "500 Internal Server Error: Failed to save file";
+        return false;
     }
-    
-    // Extract file data (binary-safe using vector)
-    std::vector<char> fileData;
-    if (file_data_start < body.size() && file_data_end <= body.size()) {
-        fileData.assign(body.begin() + file_data_start, body.begin() + file_data_end);
-    } else {
-        return "400 Bad Request: Invalid file data range";
+    tempPath_ = tempPath;
+    filename_ = filename;
+    inFilePart_ = true;
+    return true;
+}
+
+bool UploadHandler::onPartData(const char* data, size_t size) {
+    if (!inFilePart_) {
+        return true;
+    }
+    size_t written = 0;
+    while (written < size) {
+        ssize_t n = write(tempFd_, data + written, size - written);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            result_ = "500 Internal Server Error: Failed to save file";
+            return false;
+        }
+        written += static_cast<size_t>(n);
     }
-    
-    // Remove trailing newlines from file data
-    while (!fileData.empty() && (fileData.back() == '\n' || fileData.back() == '\r')) {
-        fileData.pop_back();
+    fileSize_ += size;
+    return true;
+}
+
+bool UploadHandler::onPartEnd() {
+    if (inFilePart_) {
+        inFilePart_ = false;
+        fileDone_ = true;
     }
-    
-    if (fileData.empty()) {
-        return "400 Bad Request: Empty file data";
+    return true;
+}
+
+void UploadHandler::removeTempFile() {
+    if (tempFd_ >= 0) {
+        close(tempFd_);
+        tempFd_ = -1;
     }
-    
-    // Generate unique filename with timestamp
-    std::string timestamp = generateTimestamp();
-    std::string savedFilename = timestamp + "_" + filename;
-    std::string filepath = "Data/" + savedFilename;
-    
-    // Save file
-    if (!saveFile(filepath, fileData)) {
-        return "500 Internal Server Error: Failed to save file";
+    if (!tempPath_.empty()) {
+        unlink(tempPath_.c_str());
+        tempPath_.clear();
     }
-    
-    return "200 OK: File uploaded successfully as " + savedFilename;
 }
 
 bool UploadHandler::isValidImageExtension(const std::string& filename) {
@@ -132,18 +204,6 @@ std::string UploadHandler::getFileExtension(const std::string& filename) {
     return ext;
 }
 
-bool UploadHandler::saveFile(const std::string& filepath, const std::vector<char>& data) {
-    std::ofstream file(filepath, std::ios::binary);
-    if (!file.is_open()) {
-        return false;
-    }
-    
-    file.write(data.data(), data.size());
-    file.close();
-    
-    return file.good();
-}
-
 std::string UploadHandler::generateTimestamp() {
     auto now = std::chrono::system_clock::now();
     auto timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(
@@ -2,17 +2,48 @@
 #define UPLOAD_HANDLER_H
 
 #include <string>
-#include <vector>
+#include <map>
+#include <memory>
+#include "MultipartParser.h"
 
+// Receives a multipart/form-data body chunk by chunk. The "file" part is
+// written to a temporary file in the upload directory as it arrives and
+// renamed to <timestamp>_<name> once the body is complete, so an upload
+// never has to fit in memory.
 class UploadHandler {
 public:
-    std::string handle(const std::vector<char>& body, const std::string& contentType);
+    UploadHandler(const std::string& uploadDir = "Data");
+    ~UploadHandler();  // removes the temporary file of an unfinished upload
+    
+    UploadHandler(const UploadHandler&) = delete;
+    UploadHandler& operator=(const UploadHandler&) = delete;
+    
+    // Returns an error result, or "" if the body can be fed
+    std::string begin(const std::string& contentType);
+    // False once the upload has failed; further data is ignored
+    bool feed(const char* data, size_t size);
+    // Call after the whole body: "200 OK: ...", "400 ..." or "500 ..."
+    std::string finish();
     
 private:
+    std::string uploadDir_;
+    std::unique_ptr<MultipartParser> parser_;
+    std::string result_;      // first error, empty while the upload is fine
+    std::string filename_;
+    std::string tempPath_;
+    int tempFd_;
+    size_t fileSize_;
+    bool inFilePart_;
+    bool fileDone_;
+    
+    bool onPartBegin(const std::map<std::string, std::string>& headers);
+    bool onPartData(const char* data, size_t size);
+    bool onPartEnd();
+    void removeTempFile();
+    
     bool isValidImageExtension(const std::string& filename);
     std::string extractFilename(const std::string& contentDisposition);
     std::string getFileExtension(const std::string& filename);
-    bool saveFile(const std::string& filepath, const std::vector<char>& data);
     std::string generateTimestamp();
 };
 
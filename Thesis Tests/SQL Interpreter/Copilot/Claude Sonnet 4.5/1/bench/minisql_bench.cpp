@@ -0,0 +1,378 @@
+// MiniSQL benchmark suite and load generator.
+//
+// Builds a synthetic table in a scratch data directory and measures the
+// hot paths of the interpreter. Without --data-dir the scratch directory is
+// made with mkdtemp(); a given directory must be empty or not exist yet.
+// Either way everything the run wrote is removed again at exit. Results are written as JSON so runs from
+// different commits can be diffed or compared by a script.
+//
+//   minisql_bench [--rows N] [--columns N] [--cardinality N]
+//                 [--queries N] [--writers N] [--data-dir DIR] [--output FILE]
+
+#include "Engine.h"
+#include "Lexer.h"
+#include "Parser.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <ctime>
+#include <vector>
+#include <dirent.h>
+#include <ftw.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+    size_t rows = 2000;
+    size_t columns = 4;
+    size_t cardinality = 16;   // distinct values in the "grp" column
+    size_t queries = 500;
+    size_t writers = 2;        // INSERT threads running during the concurrent SELECT phase
+    std::string dataDir;       // empty: a fresh mkdtemp() directory
+    std::string output;
+};
+
+// Reader throughput over one phase of the concurrent test. The calling
+// thread's CPU time and context switches tell the two causes of a lower rate
+// apart: involuntary switches mean the reader was preempted because the cores
+// are shared, voluntary ones that it blocked (on a lock, for instance).
+struct ReadPhase {
+    double selectsPerSec = 0;
+    double cpuUsPerSelect = 0;
+    long voluntarySwitches = 0;
+    long involuntarySwitches = 0;
+};
+
+struct LatencyStats {
+    double p50Us = 0;
+    double p99Us = 0;
+    double meanUs = 0;
+};
+
+double elapsedSeconds(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+LatencyStats summarize(std::vector<double> samplesUs) {
+    LatencyStats stats;
+    if (samplesUs.empty()) {
+        return stats;
+    }
+    std::sort(samplesUs.begin(), samplesUs.end());
+    double sum = 0;
+    for (double s : samplesUs) sum += s;
+    stats.meanUs = sum / samplesUs.size();
+    stats.p50Us = samplesUs[samplesUs.size() / 2];
+    stats.p99Us = samplesUs[std::min(samplesUs.size() - 1, samplesUs.size() * 99 / 100)];
+    return stats;
+}
+
+// Data directory of one run. It starts out empty, so everything in it was
+// written by the benchmark and is removed on destruction; a directory the
+// user created is emptied but kept.
+class ScratchDir {
+public:
+    ~ScratchDir() {
+        if (path_.empty()) {
+            return;
+        }
+        nftw(path_.c_str(), removeEntry, 16, FTW_DEPTH | FTW_PHYS);
+        if (!created_) {
+            mkdir(path_.c_str(), 0755);
+        }
+    }
+
+    bool open(const std::string& dir, std::string& error) {
+        if (dir.empty()) {
+            char pattern[] = "/tmp/minisql_bench.XXXXXX";
+            if (!mkdtemp(pattern)) {
+                error = std::string("Could not create a scratch directory: ") + std::strerror(errno);
+                return false;
+            }
+            path_ = pattern;
+            created_ = true;
+            return true;
+        }
+        if (mkdir(dir.c_str(), 0755) == 0) {
+            path_ = dir;
+            created_ = true;
+            return true;
+        }
+        DIR* d = errno == EEXIST ? opendir(dir.c_str()) : nullptr;
+        if (!d) {
+            error = "Could not use data directory '" + dir + "'";
+            return false;
+        }
+        bool empty = true;
+        struct dirent* entry;
+        while (empty && (entry = readdir(d)) != nullptr) {
+            std::string name = entry->d_name;
+            empty = name == "." || name == "..";
+        }
+        closedir(d);
+        if (!empty) {
+            error = "Data directory '" + dir + "' is not empty; the benchmark only runs in an empty one";
+            return false;
+        }
+        path_ = dir;
+        return true;
+    }
+
+    const std::string& path() const { return path_; }
+
+private:
+    std::string path_;
+    bool created_ = false;
+
+    static int removeEntry(const char* path, const struct stat*, int, struct FTW*) {
+        remove(path);
+        return 0;
+    }
+};
+
+std::string createSql(const Options& opt) {
+    std::string sql = "CREATE TABLE bench (id, grp";
+    for (size_t c = 2; c < opt.columns; ++c) {
+        sql += ", c" + std::to_string(c);
+    }
+    return sql + ");";
+}
+
+std::string insertSql(const Options& opt, size_t id, std::mt19937& rng) {
+    std::string sql = "INSERT INTO bench VALUES (" + std::to_string(id) + ", " +
+                      std::to_string(rng() % opt.cardinality);
+    for (size_t c = 2; c < opt.columns; ++c) {
+        sql += ", 'v" + std::to_string(rng() % 100000) + "'";
+    }
+    return sql + ");";
+}
+
+bool parseArgs(int argc, char* argv[], Options& opt) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "Error: Missing value for " << arg << "\n";
+            return false;
+        }
+        std::string value = argv[++i];
+        if (arg == "--rows") {
+            opt.rows = std::strtoul(value.c_str(), nullptr, 10);
+        } else if (arg == "--columns") {
+            opt.columns = std::max<size_t>(2, std::strtoul(value.c_str(), nullptr, 10));
+        } else if (arg == "--cardinality") {
+            opt.cardinality = std::max<size_t>(1, std::strtoul(value.c_str(), nullptr, 10));
+        } else if (arg == "--queries") {
+            opt.queries = std::max<size_t>(1, std::strtoul(value.c_str(), nullptr, 10));
+        } else if (arg == "--writers") {
+            opt.writers = std::strtoul(value.c_str(), nullptr, 10);
+        } else if (arg == "--data-dir") {
+            opt.dataDir = value;
+        } else if (arg == "--output") {
+            opt.output = value;
+        } else {
+            std::cerr << "Error: Unknown option " << arg << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+double threadCpuSeconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void writePhase(std::ostream& out, const char* name, const ReadPhase& phase) {
+    out << "      \"" << name << "\": {\"selects_per_sec\": " << phase.selectsPerSec
+        << ", \"cpu_us_per_select\": " << phase.cpuUsPerSelect
+        << ", \"voluntary_switches\": " << phase.voluntarySwitches
+        << ", \"involuntary_switches\": " << phase.involuntarySwitches << "}";
+}
+
+void writeLatency(std::ostream& out, const char* name, const LatencyStats& stats) {
+    out << "    \"" << name << "\": {\"p50_us\": " << stats.p50Us
+        << ", \"p99_us\": " << stats.p99Us << ", \"mean_us\": " << stats.meanUs << "}";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options opt;
+    if (!parseArgs(argc, argv, opt)) {
+        std::cerr << "Usage: " << argv[0]
+                  << " [--rows N] [--columns N] [--cardinality N] [--queries N] [--writers N]"
+                  << " [--data-dir DIR] [--output FILE]\n";
+        return 1;
+    }
+
+    // Declared before the engines so it is cleaned up after they have saved
+    ScratchDir scratch;
+    std::string error;
+    if (!scratch.open(opt.dataDir, error)) {
+        std::cerr << "Error: " << error << "\n";
+        return 1;
+    }
+    opt.dataDir = scratch.path();
+
+    std::mt19937 rng(42);
+
+    // Lex/parse throughput over a representative statement mix
+    std::vector<std::string> statements;
+    size_t statementBytes = 0;
+    for (size_t i = 0; i < opt.queries; ++i) {
+        statements.push_back(insertSql(opt, i, rng));
+        statements.push_back("SELECT * FROM bench WHERE id = " + std::to_string(i) + ";");
+        statementBytes += statements[statements.size() - 2].size() + statements.back().size();
+    }
+    auto start = Clock::now();
+    size_t parsed = 0;
+    for (const std::string& sql : statements) {
+        Lexer lexer(sql);
+        Parser parser(lexer.tokenize());
+        if (parser.parseStatement()) {
+            ++parsed;
+        }
+    }
+    double parseSeconds = elapsedSeconds(start);
+
+    // INSERT rate
+    double insertSeconds = 0;
+    {
+        Engine engine(opt.dataDir);
+        engine.executeQuery(createSql(opt));
+        start = Clock::now();
+        for (size_t i = 0; i < opt.rows; ++i) {
+            engine.executeQuery(insertSql(opt, i, rng));
+        }
+        insertSeconds = elapsedSeconds(start);
+    }
+
+    // Startup load time (the previous engine saved everything on destruction)
+    start = Clock::now();
+    Engine engine(opt.dataDir);
+    double loadSeconds = elapsedSeconds(start);
+
+    // Point SELECT: unique key lookup
+    std::vector<double> pointUs;
+    for (size_t i = 0; i < opt.queries; ++i) {
+        std::string sql = "SELECT * FROM bench WHERE id = " + std::to_string(rng() % opt.rows) + ";";
+        auto t = Clock::now();
+        engine.executeQuery(sql);
+        pointUs.push_back(elapsedSeconds(t) * 1e6);
+    }
+
+    // Range SELECT: a window of ids, as many rows as one "grp" value holds
+    std::vector<double> rangeUs;
+    size_t span = std::max<size_t>(1, opt.rows / opt.cardinality);
+    for (size_t i = 0; i < opt.queries; ++i) {
+        size_t low = rng() % std::max<size_t>(1, opt.rows - std::min(opt.rows, span) + 1);
+        std::string sql = "SELECT * FROM bench WHERE id >= " + std::to_string(low) +
+                          " AND id < " + std::to_string(low + span) + ";";
+        auto t = Clock::now();
+        engine.executeQuery(sql);
+        rangeUs.push_back(elapsedSeconds(t) * 1e6);
+    }
+
+    // SELECT throughput in three phases: alone, with writer threads inserting
+    // into another table, and alone again. Readers run on published snapshots
+    // and take no lock a writer holds, so the reader's rate only matches the
+    // baseline while every writer has a core of its own. With fewer cores the
+    // drop shows up as involuntary switches, not as CPU time or voluntary ones.
+    auto readPhase = [&](size_t count) {
+        struct rusage before, after;
+        getrusage(RUSAGE_THREAD, &before);
+        double cpu = threadCpuSeconds();
+        auto t = Clock::now();
+        for (size_t i = 0; i < count; ++i) {
+            engine.executeQuery("SELECT * FROM bench WHERE grp = " + std::to_string(i % opt.cardinality) + ";");
+        }
+        ReadPhase phase;
+        phase.selectsPerSec = count / std::max(elapsedSeconds(t), 1e-9);
+        phase.cpuUsPerSelect = (threadCpuSeconds() - cpu) * 1e6 / count;
+        getrusage(RUSAGE_THREAD, &after);
+        phase.voluntarySwitches = after.ru_nvcsw - before.ru_nvcsw;
+        phase.involuntarySwitches = after.ru_nivcsw - before.ru_nivcsw;
+        return phase;
+    };
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    ReadPhase baseline = readPhase(opt.queries);
+
+    engine.executeQuery("CREATE TABLE bench_writes (id, grp, payload);");
+    std::atomic<bool> stop(false);
+    std::atomic<size_t> written(0);
+    std::vector<std::thread> writers;
+    for (size_t w = 0; w < opt.writers; ++w) {
+        writers.emplace_back([&, w] {
+            for (size_t i = 0; !stop; ++i) {
+                engine.executeQuery("INSERT INTO bench_writes VALUES (" + std::to_string(w) + ", " +
+                                    std::to_string(i) + ", 'row" + std::to_string(i) + "');");
+                ++written;
+            }
+        });
+    }
+    start = Clock::now();
+    ReadPhase withWriters = readPhase(opt.queries);
+    double writeSeconds = elapsedSeconds(start);
+    stop = true;
+    for (std::thread& writer : writers) {
+        writer.join();
+    }
+    ReadPhase afterWriters = readPhase(opt.queries);
+
+    std::ostringstream json;
+    json << "{\n";
+    json << "  \"config\": {\"rows\": " << opt.rows << ", \"columns\": " << opt.columns
+         << ", \"cardinality\": " << opt.cardinality << ", \"queries\": " << opt.queries << "},\n";
+    json << "  \"lex_parse\": {\"statements\": " << parsed
+         << ", \"statements_per_sec\": " << (parsed / std::max(parseSeconds, 1e-9))
+         << ", \"mb_per_sec\": " << (statementBytes / 1e6 / std::max(parseSeconds, 1e-9)) << "},\n";
+    json << "  \"insert\": {\"rows\": " << opt.rows
+         << ", \"rows_per_sec\": " << (opt.rows / std::max(insertSeconds, 1e-9)) << "},\n";
+    json << "  \"startup_load_ms\": " << loadSeconds * 1e3 << ",\n";
+    json << "  \"select\": {\n";
+    writeLatency(json, "point", summarize(pointUs));
+    json << ",\n";
+    writeLatency(json, "range", summarize(rangeUs));
+    json << "\n  },\n";
+    json << "  \"concurrent\": {\n";
+    json << "    \"cores\": " << cores << ", \"writers\": " << opt.writers
+         << ", \"spare_cores\": " << (opt.writers + 1 <= cores ? "true" : "false")
+         << ", \"writer_rows_per_sec\": " << (written / std::max(writeSeconds, 1e-9)) << ",\n";
+    json << "    \"read_rate_vs_baseline\": " << withWriters.selectsPerSec / std::max(baseline.selectsPerSec, 1e-9)
+         << ",\n";
+    json << "    \"phases\": {\n";
+    writePhase(json, "baseline", baseline);
+    json << ",\n";
+    writePhase(json, "with_writers", withWriters);
+    json << ",\n";
+    writePhase(json, "after_writers", afterWriters);
+    json << "\n    }\n  }\n}\n";
+
+    if (opt.output.empty()) {
+        std::cout << json.str();
+    } else {
+        std::ofstream file(opt.output);
+        if (!file.is_open()) {
+            std::cerr << "Error: Could not open file '" << opt.output << "'\n";
+            return 1;
+        }
+        file << json.str();
+    }
+
+    return 0;
+}
@@ -4,11 +4,21 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <unordered_set>
+#include "Catalog.h"
+#include "Value.h"
 
 enum class StatementType {
     CREATE_TABLE,
     INSERT,
-    SELECT
+    SELECT,
+    ANALYZE,
+    EXPLAIN,
+    CREATE_INDEX,
+    CREATE_VIEW,
+    EXPORT,
+    IMPORT,
+    SHOW_TABLES
 };
 
 // Base statement class
@@ -21,6 +31,13 @@ struct Statement {
 struct CreateTableStatement : Statement {
     std::string tableName;
     std::vector<std::string> columns;
+    std::string primaryKey;                     // empty if none
+    
+    // Optional PARTITION BY clause
+    PartitionKind partitionKind = PartitionKind::NONE;
+    std::string partitionColumn;
+    uint32_t partitionCount = 1;                // HASH
+    std::vector<std::string> partitionBounds;   // RANGE
     
     StatementType type() const override {
         return StatementType::CREATE_TABLE;
@@ -30,23 +47,206 @@ struct CreateTableStatement : Statement {
 // INSERT INTO statement
 struct InsertStatement : Statement {
     std::string tableName;
-    std::vector<std::string> values;
+    TableId tableId = INVALID_ID;      // resolved against the catalog while parsing
+    std::vector<std::string> values;   // canonical text of each literal, as stored
+    
+    // ON CONFLICT [(column)] DO UPDATE | DO NOTHING
+    ConflictAction onConflict = ConflictAction::ABORT;
+    std::string conflictColumn;        // empty if not given
     
     StatementType type() const override {
         return StatementType::INSERT;
     }
 };
 
+enum class CompareOp {
+    EQUALS,
+    LIKE,
+    ILIKE,
+    NOT_EQUALS,
+    LESS,
+    LESS_EQUAL,
+    GREATER,
+    GREATER_EQUAL,
+    IS_NULL,
+    IS_NOT_NULL,
+    IN                                 // IN (SELECT ...)
+};
+
+struct SelectStatement;
+
+// WHERE condition: column <op> value, column IS [NOT] NULL, or column IN (SELECT ...).
+// The value of a comparison may also be a scalar (SELECT ...).
+struct Condition {
+    std::string column;
+    CompareOp op = CompareOp::EQUALS;
+    Value value;                       // typed literal (unused for IS [NOT] NULL)
+    uint32_t columnId = INVALID_ID;    // resolved while parsing
+    
+    // Uncorrelated subquery, run once before the statement is planned: a
+    // scalar one becomes value, an IN list becomes members
+    std::shared_ptr<SelectStatement> subquery;
+    std::shared_ptr<const std::unordered_set<std::string>> members;  // equality keys (see equalityKey)
+};
+
+enum class WindowFunction {
+    ROW_NUMBER,
+    RANK,
+    DENSE_RANK,
+    COUNT,
+    SUM,
+    AVG,
+    MIN,
+    MAX
+};
+
+// ORDER BY item
+struct SortKey {
+    std::string column;
+    bool descending = false;
+    uint32_t columnId = INVALID_ID;    // resolved while parsing
+};
+
+// fn([column | *]) OVER ([PARTITION BY column, ...] [ORDER BY column [ASC|DESC], ...]),
+// or an aggregate fn([column | *]) without OVER, evaluated once per GROUP BY group
+struct WindowCall {
+    WindowFunction function = WindowFunction::ROW_NUMBER;
+    std::string argument;              // empty for ROW_NUMBER/RANK/DENSE_RANK and COUNT(*)
+    std::vector<std::string> partitionBy;
+    std::vector<SortKey> orderBy;
+    std::string alias;                 // output column name
+    size_t position = 0;               // index in the select list
+    
+    // Resolved while parsing
+    uint32_t argumentId = INVALID_ID;
+    std::vector<uint32_t> partitionIds;
+};
+
+// [INNER] JOIN table ON column = column
+struct JoinClause {
+    std::string tableName;             // empty if the SELECT has no JOIN
+    std::string leftColumn;            // as written; either side may name either table
+    std::string rightColumn;
+    
+    // Resolved while parsing
+    TableId tableId = INVALID_ID;
+    uint32_t leftColumnId = INVALID_ID;
+    uint32_t rightColumnId = INVALID_ID;
+};
+
+// WITH name [(column, ...)] AS (SELECT ...)
+struct CommonTableExpr {
+    std::string name;
+    std::vector<std::string> columns;  // empty: the SELECT's own column names
+    std::shared_ptr<SelectStatement> select;
+};
+
 // SELECT statement
 struct SelectStatement : Statement {
+    std::vector<CommonTableExpr> with; // visible to later CTEs, the body and its subqueries
     std::string tableName;
-    bool hasWhere = false;
-    std::string whereColumn;
-    std::string whereValue;
+    JoinClause join;
+    std::vector<std::string> columns;  // projected columns; empty means '*' (unless windows are given)
+    std::vector<WindowCall> windows;   // window functions, interleaved with columns by position
+    std::vector<WindowCall> aggregates; // COUNT/SUM/AVG/MIN/MAX without OVER, also by position
+    std::vector<Condition> where;      // conjunction (AND) of conditions
+    std::vector<std::string> groupBy;
+    
+    // Resolved against the catalog while parsing (INVALID_ID if unknown).
+    // A name that is not a table may be a materialized view; column ids then
+    // refer to the view's columns. With a JOIN, column ids index the FROM
+    // table's columns followed by the joined table's; columns may be written
+    // table.column and must be, when both tables have one of that name.
+    TableId tableId = INVALID_ID;
+    ViewId viewId = INVALID_ID;
+    std::vector<uint32_t> columnIds;
+    std::vector<uint32_t> groupIds;
+    
+    bool grouped() const { return !aggregates.empty() || !groupBy.empty(); }
+    bool joined() const { return !join.tableName.empty(); }
+    bool hasSubqueries() const {
+        for (const Condition& condition : where) {
+            if (condition.subquery) return true;
+        }
+        return !with.empty();
+    }
     
     StatementType type() const override {
         return StatementType::SELECT;
     }
 };
 
+// ANALYZE table statement
+struct AnalyzeStatement : Statement {
+    std::string tableName;
+    TableId tableId = INVALID_ID;
+    
+    StatementType type() const override {
+        return StatementType::ANALYZE;
+    }
+};
+
+// EXPORT TABLE t TO 'file': writes the table as a Parquet file
+struct ExportStatement : Statement {
+    std::string tableName;
+    std::string file;                           // name inside <data dir>/exports
+    TableId tableId = INVALID_ID;
+    
+    StatementType type() const override {
+        return StatementType::EXPORT;
+    }
+};
+
+// IMPORT TABLE t FROM 'file': appends a Parquet file's rows, creating t if needed
+struct ImportStatement : Statement {
+    std::string tableName;
+    std::string file;
+    TableId tableId = INVALID_ID;
+    
+    StatementType type() const override {
+        return StatementType::IMPORT;
+    }
+};
+
+// SHOW TABLES: per-table memory and access counters
+struct ShowTablesStatement : Statement {
+    StatementType type() const override {
+        return StatementType::SHOW_TABLES;
+    }
+};
+
+// CREATE INDEX name ON table (column) USING kind
+struct CreateIndexStatement : Statement {
+    std::string indexName;
+    std::string tableName;
+    std::string column;
+    std::string method;
+    TableId tableId = INVALID_ID;
+    uint32_t columnId = INVALID_ID;
+    
+    StatementType type() const override {
+        return StatementType::CREATE_INDEX;
+    }
+};
+
+// CREATE MATERIALIZED VIEW name AS <select with GROUP BY or aggregates>
+struct CreateViewStatement : Statement {
+    std::string viewName;
+    std::unique_ptr<SelectStatement> select;
+    
+    StatementType type() const override {
+        return StatementType::CREATE_VIEW;
+    }
+};
+
+// EXPLAIN [ANALYZE] <select> statement
+struct ExplainStatement : Statement {
+    std::unique_ptr<SelectStatement> select;
+    bool analyze = false;              // run the query and report actual row counts
+    
+    StatementType type() const override {
+        return StatementType::EXPLAIN;
+    }
+};
+
 #endif // AST_H
@@ -0,0 +1,362 @@
+#include "AsyncIO.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#define MINISQL_HAVE_IO_URING 1
+#endif
+#endif
+
+namespace {
+
+AsyncIO::Backend requestedBackend = AsyncIO::Backend::AUTO;
+
+const unsigned RING_ENTRIES = 256;
+const size_t WORKER_THREADS = 4;
+
+} // namespace
+
+#ifdef MINISQL_HAVE_IO_URING
+
+struct AsyncIO::Ring {
+    int fd = -1;
+    unsigned entries = 0;
+    void* sqMap = nullptr;
+    size_t sqMapSize = 0;
+    void* cqMap = nullptr;
+    size_t cqMapSize = 0;
+    io_uring_sqe* sqes = nullptr;
+    size_t sqesSize = 0;
+    
+    unsigned* sqTail = nullptr;
+    unsigned* sqMask = nullptr;
+    unsigned* sqArray = nullptr;
+    unsigned* cqHead = nullptr;
+    unsigned* cqTail = nullptr;
+    unsigned* cqMask = nullptr;
+    io_uring_cqe* cqes = nullptr;
+    
+    ~Ring() {
+        if (sqes) munmap(sqes, sqesSize);
+        if (cqMap && cqMap != sqMap) munmap(cqMap, cqMapSize);
+        if (sqMap) munmap(sqMap, sqMapSize);
+        if (fd >= 0) close(fd);
+    }
+};
+
+bool AsyncIO::setupRing() {
+    std::unique_ptr<Ring> ring(new Ring());
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    ring->fd = static_cast<int>(syscall(__NR_io_uring_setup, RING_ENTRIES, &params));
+    if (ring->fd < 0) {
+        return false;  // old kernel, seccomp filter or io_uring disabled by sysctl
+    }
+    ring->entries = params.sq_entries;
+    
+    ring->sqMapSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cqMapSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool singleMap = false;
+#ifdef IORING_FEAT_SINGLE_MMAP
+    singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+#endif
+    if (singleMap) {
+        ring->sqMapSize = ring->cqMapSize = std::max(ring->sqMapSize, ring->cqMapSize);
+    }
+    
+    ring->sqMap = mmap(nullptr, ring->sqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                       ring->fd, IORING_OFF_SQ_RING);
+    if (ring->sqMap == MAP_FAILED) {
+        ring->sqMap = nullptr;
+        return false;
+    }
+    if (singleMap) {
+        ring->cqMap = ring->sqMap;
+    } else {
+        ring->cqMap = mmap(nullptr, ring->cqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                           ring->fd, IORING_OFF_CQ_RING);
+        if (ring->cqMap == MAP_FAILED) {
+            ring->cqMap = nullptr;
+            return false;
+        }
+    }
+    ring->sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = mmap(nullptr, ring->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ring->fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        return false;
+    }
+    ring->sqes = static_cast<io_uring_sqe*>(sqes);
+    
+    char* sq = static_cast<char*>(ring->sqMap);
+    char* cq = static_cast<char*>(ring->cqMap);
+    ring->sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    ring->sqMask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    ring->sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    ring->cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    ring->cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    ring->cqMask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    ring->cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    
+    ring_ = std::move(ring);
+    return true;
+}
+
+// Caller holds mutex_ and has ensured a free slot
+bool AsyncIO::pushToRing(Op* op) {
+    Ring& ring = *ring_;
+    unsigned tail = *ring.sqTail;
+    unsigned index = tail & *ring.sqMask;
+    io_uring_sqe* sqe = &ring.sqes[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    
+    switch (op->kind) {
+        case Op::READ:  sqe->opcode = IORING_OP_READV; break;
+        case Op::WRITE: sqe->opcode = IORING_OP_WRITEV; break;
+        case Op::FSYNC: sqe->opcode = IORING_OP_FSYNC; break;
+    }
+    sqe->fd = op->fd;
+    if (op->kind != Op::FSYNC) {
+        sqe->addr = reinterpret_cast<uint64_t>(&op->iov);
+        sqe->len = 1;
+        sqe->off = op->offset;
+    }
+    sqe->user_data = op->ticket;
+    
+    ring.sqArray[index] = index;
+    __atomic_store_n(ring.sqTail, tail + 1, __ATOMIC_RELEASE);
+    
+    long submitted;
+    do {
+        submitted = syscall(__NR_io_uring_enter, ring.fd, 1, 0, 0, nullptr, 0);
+    } while (submitted < 0 && (errno == EINTR || errno == EAGAIN || errno == EBUSY));
+    return submitted == 1;
+}
+
+// Caller holds mutex_
+void AsyncIO::drainRing() {
+    Ring& ring = *ring_;
+    unsigned head = *ring.cqHead;
+    unsigned tail = __atomic_load_n(ring.cqTail, __ATOMIC_ACQUIRE);
+    for (; head != tail; ++head) {
+        const io_uring_cqe& cqe = ring.cqes[head & *ring.cqMask];
+        results_[cqe.user_data] = cqe.res;
+        inFlight_.erase(cqe.user_data);
+    }
+    __atomic_store_n(ring.cqHead, head, __ATOMIC_RELEASE);
+}
+
+// There is no reaper thread: one waiting thread at a time blocks in the
+// kernel for completions and hands them to the others, so a completion wakes
+// the thread that needs it directly
+void AsyncIO::waitForRing(std::unique_lock<std::mutex>& lock, const std::function<bool()>& done) {
+    while (true) {
+        drainRing();
+        if (done()) {
+            return;
+        }
+        if (reaping_) {
+            completed_.wait(lock);
+            continue;
+        }
+        reaping_ = true;
+        lock.unlock();
+        syscall(__NR_io_uring_enter, ring_->fd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+        lock.lock();
+        reaping_ = false;
+        drainRing();
+        completed_.notify_all();
+    }
+}
+
+#else
+
+struct AsyncIO::Ring {};
+
+bool AsyncIO::setupRing() {
+    return false;
+}
+
+bool AsyncIO::pushToRing(Op*) {
+    return false;
+}
+
+void AsyncIO::drainRing() {}
+
+void AsyncIO::waitForRing(std::unique_lock<std::mutex>&, const std::function<bool()>&) {}
+
+#endif
+
+void AsyncIO::configure(Backend backend) {
+    requestedBackend = backend;
+}
+
+AsyncIO& AsyncIO::instance() {
+    static AsyncIO io(requestedBackend);
+    return io;
+}
+
+AsyncIO::AsyncIO(Backend backend) {
+    if (backend != Backend::THREADS && setupRing()) {
+        return;
+    }
+    for (size_t i = 0; i < WORKER_THREADS; ++i) {
+        workers_.emplace_back(&AsyncIO::workerLoop, this);
+    }
+}
+
+AsyncIO::~AsyncIO() {
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        stopping_ = true;
+        queued_.notify_all();
+    }
+    for (std::thread& worker : workers_) {
+        worker.join();
+    }
+}
+
+const char* AsyncIO::backendName() const {
+    return ring_ ? "io_uring" : "threads";
+}
+
+AsyncIO::Ticket AsyncIO::submitRead(int fd, char* buffer, size_t length, uint64_t offset) {
+    return submit(Op::READ, fd, buffer, length, offset);
+}
+
+AsyncIO::Ticket AsyncIO::submitWrite(int fd, const char* data, size_t length, uint64_t offset) {
+    // The iovec is shared between reads and writes; writes never modify it
+    return submit(Op::WRITE, fd, const_cast<char*>(data), length, offset);
+}
+
+AsyncIO::Ticket AsyncIO::submitFsync(int fd) {
+    return submit(Op::FSYNC, fd, nullptr, 0, 0);
+}
+
+AsyncIO::Ticket AsyncIO::submit(Op::Kind kind, int fd, char* buffer, size_t length, uint64_t offset) {
+    std::unique_ptr<Op> op(new Op());
+    op->kind = kind;
+    op->fd = fd;
+    op->iov.iov_base = buffer;
+    op->iov.iov_len = length;
+    op->offset = offset;
+    
+    std::unique_lock<std::mutex> lock(mutex_);
+    Ticket ticket = op->ticket = nextTicket_++;
+    
+    if (ring_) {
+        // Never more requests in flight than the ring has slots, so the
+        // completion queue (twice as large) cannot overflow
+        waitForRing(lock, [this] { return inFlight_.size() < ring_->entries; });
+        Op* raw = op.get();
+        inFlight_[ticket] = std::move(op);
+        if (!pushToRing(raw)) {
+            // The entry stays queued in the ring and may still be consumed by a
+            // later submission, so the Op (and its iovec) must stay alive
+            results_[ticket] = errno ? -errno : -EIO;
+            completed_.notify_all();
+        }
+        return ticket;
+    }
+    
+    queue_.push_back(std::move(op));
+    queued_.notify_one();
+    return ticket;
+}
+
+void AsyncIO::complete(Ticket ticket, int64_t result) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    results_[ticket] = result;
+    completed_.notify_all();
+}
+
+int64_t AsyncIO::wait(Ticket ticket) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto done = [&] { return results_.count(ticket) != 0; };
+    if (ring_) {
+        waitForRing(lock, done);
+    } else {
+        completed_.wait(lock, done);
+    }
+    int64_t result = results_[ticket];
+    results_.erase(ticket);
+    return result;
+}
+
+bool AsyncIO::writeAll(int fd, const char* data, size_t length, uint64_t offset) {
+    return completeWrite(submitWrite(fd, data, length, offset), fd, data, length, offset);
+}
+
+bool AsyncIO::completeWrite(Ticket ticket, int fd, const char* data, size_t length, uint64_t offset) {
+    int64_t written = wait(ticket);
+    if (written < 0) {
+        return false;
+    }
+    // A short write (rare for regular files) is finished synchronously
+    Op rest;
+    rest.kind = Op::WRITE;
+    rest.fd = fd;
+    rest.iov.iov_base = const_cast<char*>(data) + written;
+    rest.iov.iov_len = length - static_cast<size_t>(written);
+    rest.offset = offset + static_cast<uint64_t>(written);
+    return rest.iov.iov_len == 0 || perform(rest) == static_cast<int64_t>(rest.iov.iov_len);
+}
+
+bool AsyncIO::completeRead(Ticket ticket, int fd, char* buffer, size_t length, uint64_t offset) {
+    int64_t read = wait(ticket);
+    if (read < 0) {
+        return false;
+    }
+    Op rest;
+    rest.kind = Op::READ;
+    rest.fd = fd;
+    rest.iov.iov_base = buffer + read;
+    rest.iov.iov_len = length - static_cast<size_t>(read);
+    rest.offset = offset + static_cast<uint64_t>(read);
+    return rest.iov.iov_len == 0 || perform(rest) == static_cast<int64_t>(rest.iov.iov_len);
+}
+
+void AsyncIO::workerLoop() {
+    while (true) {
+        std::unique_ptr<Op> op;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            queued_.wait(lock, [this] { return !queue_.empty() || stopping_; });
+            if (queue_.empty()) {
+                return;
+            }
+            op = std::move(queue_.front());
+            queue_.pop_front();
+        }
+        complete(op->ticket, perform(*op));
+    }
+}
+
+// Blocking execution of one request, retrying until it is fully transferred
+int64_t AsyncIO::perform(const Op& op) {
+    if (op.kind == Op::FSYNC) {
+        return fsync(op.fd) == 0 ? 0 : -errno;
+    }
+    char* buffer = static_cast<char*>(op.iov.iov_base);
+    size_t done = 0;
+    while (done < op.iov.iov_len) {
+        ssize_t n = op.kind == Op::READ
+            ? pread(op.fd, buffer + done, op.iov.iov_len - done, static_cast<off_t>(op.offset + done))
+            : pwrite(op.fd, buffer + done, op.iov.iov_len - done, static_cast<off_t>(op.offset + done));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -errno;
+        }
+        if (n == 0) {
+            break;  // end of file
+        }
+        done += static_cast<size_t>(n);
+    }
+    return static_cast<int64_t>(done);
+}
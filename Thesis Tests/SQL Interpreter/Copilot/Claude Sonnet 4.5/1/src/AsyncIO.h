@@ -0,0 +1,94 @@
+#ifndef ASYNCIO_H
+#define ASYNCIO_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <thread>
+#include <cstdint>
+#include <cstddef>
+#include <sys/uio.h>
+
+// Completion-based file I/O shared by all storage code. Requests are submitted
+// without blocking the caller and waited for by ticket, so one thread can keep
+// many reads or writes in flight. Uses io_uring (raw syscalls, no liburing)
+// when the kernel allows it and a small worker pool doing pread/pwrite otherwise.
+//
+// Buffers passed to submitRead/submitWrite must stay alive until wait() returns.
+class AsyncIO {
+public:
+    typedef uint64_t Ticket;
+    
+    enum class Backend {
+        AUTO,
+        IO_URING,
+        THREADS
+    };
+    
+    // Choose the backend before first use; AUTO tries io_uring first
+    static void configure(Backend backend);
+    static AsyncIO& instance();
+    
+    ~AsyncIO();
+    AsyncIO(const AsyncIO&) = delete;
+    AsyncIO& operator=(const AsyncIO&) = delete;
+    
+    Ticket submitRead(int fd, char* buffer, size_t length, uint64_t offset);
+    Ticket submitWrite(int fd, const char* data, size_t length, uint64_t offset);
+    Ticket submitFsync(int fd);
+    
+    // Bytes transferred (0 for fsync), or -errno
+    int64_t wait(Ticket ticket);
+    
+    // Wait for a submitted read/write and finish a short transfer synchronously;
+    // true once all length bytes were transferred
+    bool completeWrite(Ticket ticket, int fd, const char* data, size_t length, uint64_t offset);
+    bool completeRead(Ticket ticket, int fd, char* buffer, size_t length, uint64_t offset);
+    bool writeAll(int fd, const char* data, size_t length, uint64_t offset);
+    
+    const char* backendName() const;
+    
+private:
+    struct Op {
+        enum Kind { READ, WRITE, FSYNC } kind;
+        int fd;
+        struct iovec iov;
+        uint64_t offset;
+        Ticket ticket;
+    };
+    
+    explicit AsyncIO(Backend backend);
+    
+    Ticket submit(Op::Kind kind, int fd, char* buffer, size_t length, uint64_t offset);
+    void complete(Ticket ticket, int64_t result);
+    
+    std::mutex mutex_;
+    std::condition_variable completed_;
+    std::unordered_map<Ticket, int64_t> results_;
+    Ticket nextTicket_ = 1;
+    bool stopping_ = false;
+    
+    // io_uring state
+    struct Ring;
+    std::unique_ptr<Ring> ring_;
+    std::unordered_map<Ticket, std::unique_ptr<Op>> inFlight_;  // keeps iovecs alive
+    bool reaping_ = false;  // a thread is blocked in the kernel for completions
+    bool setupRing();
+    bool pushToRing(Op* op);
+    void drainRing();
+    void waitForRing(std::unique_lock<std::mutex>& lock, const std::function<bool()>& done);
+    
+    // Thread pool state
+    std::deque<std::unique_ptr<Op>> queue_;
+    std::condition_variable queued_;
+    std::vector<std::thread> workers_;
+    void workerLoop();
+    static int64_t perform(const Op& op);
+};
+
+#endif // ASYNCIO_H
@@ -0,0 +1,152 @@
+#include "BPlusTree.h"
+#include <algorithm>
+
+BPlusTree::BPlusTree() : root_(new Node()) {}
+
+BPlusTree::~BPlusTree() = default;
+
+bool BPlusTree::find(const std::string& key, uint32_t& rowId) const {
+    const Node* node = root_.get();
+    while (!node->leaf) {
+        size_t i = std::upper_bound(node->keys.begin(), node->keys.end(), key) - node->keys.begin();
+        node = node->children[i].get();
+    }
+    auto it = std::lower_bound(node->keys.begin(), node->keys.end(), key);
+    if (it == node->keys.end() || *it != key) {
+        return false;
+    }
+    rowId = node->rowIds[it - node->keys.begin()];
+    return true;
+}
+
+bool BPlusTree::insert(const std::string& key, uint32_t rowId) {
+    std::string splitKey;
+    bool inserted = false;
+    std::unique_ptr<Node> right = insertInto(root_.get(), key, rowId, splitKey, inserted);
+    if (right) {
+        // The root split: grow the tree by one level
+        std::unique_ptr<Node> root(new Node());
+        root->leaf = false;
+        root->keys.push_back(std::move(splitKey));
+        root->children.push_back(std::move(root_));
+        root->children.push_back(std::move(right));
+        root_ = std::move(root);
+    }
+    if (inserted) {
+        ++size_;
+    }
+    return inserted;
+}
+
+// Insert below node; returns the new right sibling if node had to split,
+// with the separator for the parent in splitKey
+std::unique_ptr<BPlusTree::Node> BPlusTree::insertInto(Node* node, const std::string& key, uint32_t rowId,
+                                                       std::string& splitKey, bool& inserted) {
+    if (node->leaf) {
+        auto it = std::lower_bound(node->keys.begin(), node->keys.end(), key);
+        size_t pos = it - node->keys.begin();
+        if (it != node->keys.end() && *it == key) {
+            return nullptr;
+        }
+        node->keys.insert(it, key);
+        node->rowIds.insert(node->rowIds.begin() + pos, rowId);
+        inserted = true;
+        
+        if (node->keys.size() <= MAX_KEYS) {
+            return nullptr;
+        }
+        size_t mid = node->keys.size() / 2;
+        std::unique_ptr<Node> right(new Node());
+        right->keys.assign(std::make_move_iterator(node->keys.begin() + mid),
+                           std::make_move_iterator(node->keys.end()));
+        right->rowIds.assign(node->rowIds.begin() + mid, node->rowIds.end());
+        node->keys.resize(mid);
+        node->rowIds.resize(mid);
+        right->next = node->next;
+        node->next = right.get();
+        splitKey = right->keys.front();
+        return right;
+    }
+    
+    size_t i = std::upper_bound(node->keys.begin(), node->keys.end(), key) - node->keys.begin();
+    std::string childSplit;
+    std::unique_ptr<Node> child = insertInto(node->children[i].get(), key, rowId, childSplit, inserted);
+    if (!child) {
+        return nullptr;
+    }
+    node->keys.insert(node->keys.begin() + i, std::move(childSplit));
+    node->children.insert(node->children.begin() + i + 1, std::move(child));
+    
+    if (node->keys.size() <= MAX_KEYS) {
+        return nullptr;
+    }
+    // The middle key moves up; it does not stay in either half
+    size_t mid = node->keys.size() / 2;
+    std::unique_ptr<Node> right(new Node());
+    right->leaf = false;
+    splitKey = std::move(node->keys[mid]);
+    right->keys.assign(std::make_move_iterator(node->keys.begin() + mid + 1),
+                       std::make_move_iterator(node->keys.end()));
+    right->children.assign(std::make_move_iterator(node->children.begin() + mid + 1),
+                           std::make_move_iterator(node->children.end()));
+    node->keys.resize(mid);
+    node->children.resize(mid + 1);
+    return right;
+}
+
+void BPlusTree::bulkLoad(const std::vector<std::pair<std::string, uint32_t>>& entries) {
+    root_.reset(new Node());
+    size_ = entries.size();
+    if (entries.empty()) {
+        return;
+    }
+    
+    // Packed leaves, each paired with the smallest key of its subtree
+    std::vector<std::pair<std::unique_ptr<Node>, std::string>> level;
+    Node* previous = nullptr;
+    for (size_t i = 0; i < entries.size(); i += MAX_KEYS) {
+        std::unique_ptr<Node> leaf(new Node());
+        size_t end = std::min(entries.size(), i + MAX_KEYS);
+        for (size_t j = i; j < end; ++j) {
+            leaf->keys.push_back(entries[j].first);
+            leaf->rowIds.push_back(entries[j].second);
+        }
+        if (previous) {
+            previous->next = leaf.get();
+        }
+        previous = leaf.get();
+        level.emplace_back(std::move(leaf), entries[i].first);
+    }
+    
+    // Spread children evenly over as few internal nodes as fit MAX_KEYS + 1
+    // children each (so no node ends up with a single child) until one remains
+    while (level.size() > 1) {
+        std::vector<std::pair<std::unique_ptr<Node>, std::string>> parents;
+        size_t nodes = (level.size() + MAX_KEYS) / (MAX_KEYS + 1);
+        size_t i = 0;
+        for (size_t n = 0; n < nodes; ++n) {
+            size_t end = i + level.size() / nodes + (n < level.size() % nodes ? 1 : 0);
+            std::unique_ptr<Node> parent(new Node());
+            parent->leaf = false;
+            std::string minKey = level[i].second;
+            for (size_t j = i; j < end; ++j) {
+                if (j > i) {
+                    parent->keys.push_back(std::move(level[j].second));
+                }
+                parent->children.push_back(std::move(level[j].first));
+            }
+            parents.emplace_back(std::move(parent), std::move(minKey));
+            i = end;
+        }
+        level = std::move(parents);
+    }
+    root_ = std::move(level.front().first);
+}
+
+size_t BPlusTree::height() const {
+    size_t levels = 1;
+    for (const Node* node = root_.get(); !node->leaf; node = node->children.front().get()) {
+        ++levels;
+    }
+    return levels;
+}
@@ -0,0 +1,46 @@
+#ifndef BPLUSTREE_H
+#define BPLUSTREE_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <utility>
+#include <cstdint>
+
+// Unique B+tree from key strings to row ids, used for primary keys. Keys are
+// compared bytewise; leaves are chained so the tree can be walked in order.
+class BPlusTree {
+public:
+    BPlusTree();
+    ~BPlusTree();
+    
+    // Returns false (and leaves the tree unchanged) if the key already exists
+    bool insert(const std::string& key, uint32_t rowId);
+    bool find(const std::string& key, uint32_t& rowId) const;
+    
+    // Replace the contents with entries sorted by key and free of duplicates;
+    // builds packed leaves bottom-up in O(n)
+    void bulkLoad(const std::vector<std::pair<std::string, uint32_t>>& entries);
+    
+    size_t size() const { return size_; }
+    size_t height() const;
+    
+private:
+    static const size_t MAX_KEYS = 64;
+    
+    struct Node {
+        bool leaf = true;
+        std::vector<std::string> keys;
+        std::vector<std::unique_ptr<Node>> children;  // internal: keys.size() + 1
+        std::vector<uint32_t> rowIds;                 // leaf: one per key
+        Node* next = nullptr;                         // leaf chain
+    };
+    
+    std::unique_ptr<Node> root_;
+    size_t size_ = 0;
+    
+    std::unique_ptr<Node> insertInto(Node* node, const std::string& key, uint32_t rowId,
+                                     std::string& splitKey, bool& inserted);
+};
+
+#endif // BPLUSTREE_H
@@ -0,0 +1,206 @@
+#include "BinaryServer.h"
+#include "WireProtocol.h"
+#include <iostream>
+#include <algorithm>
+#include <thread>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+// Pending output is sent once it grows beyond this many bytes
+static const size_t FLUSH_THRESHOLD = 256 * 1024;
+
+BinaryServer::BinaryServer(Engine* engine, int port)
+    : engine_(engine), port_(port), serverSocket_(-1), running_(false) {}
+
+BinaryServer::~BinaryServer() {
+    stop();
+}
+
+bool BinaryServer::start() {
+    serverSocket_ = socket(AF_INET, SOCK_STREAM, 0);
+    if (serverSocket_ < 0) {
+        std::cerr << "Error: Failed to create socket\n";
+        return false;
+    }
+    
+    int opt = 1;
+    if (setsockopt(serverSocket_, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0) {
+        std::cerr << "Error: Failed to set socket options\n";
+        close(serverSocket_);
+        return false;
+    }
+    
+    struct sockaddr_in address;
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = INADDR_ANY;
+    address.sin_port = htons(port_);
+    
+    if (bind(serverSocket_, (struct sockaddr*)&address, sizeof(address)) < 0) {
+        std::cerr << "Error: Failed to bind to port " << port_ << "\n";
+        close(serverSocket_);
+        return false;
+    }
+    
+    if (listen(serverSocket_, 128) < 0) {
+        std::cerr << "Error: Failed to listen on socket\n";
+        close(serverSocket_);
+        return false;
+    }
+    
+    running_ = true;
+    std::cout << "Binary protocol server started on port " << port_ << "\n";
+    
+    // Each connection is long-lived, so it gets its own thread; the engine
+    // serializes the statements internally.
+    while (running_) {
+        struct sockaddr_in clientAddress;
+        socklen_t clientLen = sizeof(clientAddress);
+        
+        int clientSocket = accept(serverSocket_, (struct sockaddr*)&clientAddress, &clientLen);
+        if (clientSocket < 0) {
+            if (running_) {
+                std::cerr << "Error: Failed to accept connection\n";
+            }
+            continue;
+        }
+        
+        int noDelay = 1;
+        setsockopt(clientSocket, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+        
+        std::thread([this, clientSocket]() {
+            handleClient(clientSocket);
+            close(clientSocket);
+        }).detach();
+    }
+    
+    return true;
+}
+
+void BinaryServer::stop() {
+    running_ = false;
+    if (serverSocket_ >= 0) {
+        close(serverSocket_);
+        serverSocket_ = -1;
+    }
+}
+
+void BinaryServer::handleClient(int clientSocket) {
+    std::string input;
+    std::string output;
+    char buffer[65536];
+    
+    while (true) {
+        ssize_t bytesRead = recv(clientSocket, buffer, sizeof(buffer), 0);
+        if (bytesRead <= 0) {
+            return;
+        }
+        input.append(buffer, static_cast<size_t>(bytesRead));
+        
+        // Answer every complete frame that has arrived; pipelined queries are
+        // batched into a single send once the input is drained.
+        size_t offset = 0;
+        uint8_t type;
+        std::string payload;
+        while (true) {
+            if (input.size() - offset >= 4) {
+                uint32_t length = Wire::getU32(input.data() + offset);
+                if (length == 0 || length > Wire::MAX_FRAME_SIZE) {
+                    Wire::appendFrame(output, Wire::ERROR, "Error: Invalid frame length");
+                    sendAll(clientSocket, output);
+                    return;
+                }
+            }
+            if (!Wire::readFrame(input, offset, type, payload)) {
+                break;
+            }
+            
+            if (type == Wire::TERMINATE) {
+                sendAll(clientSocket, output);
+                return;
+            } else if (type == Wire::QUERY) {
+                if (!encodeResult(clientSocket, engine_->executeQuery(payload), output)) {
+                    return;
+                }
+            } else {
+                Wire::appendFrame(output, Wire::ERROR, "Error: Unknown frame type");
+            }
+        }
+        input.erase(0, offset);
+        
+        if (!output.empty()) {
+            if (!sendAll(clientSocket, output)) {
+                return;
+            }
+            output.clear();
+        }
+    }
+}
+
+bool BinaryServer::encodeResult(int clientSocket, const QueryResult& result, std::string& out) {
+    if (!result.ok) {
+        Wire::appendFrame(out, Wire::ERROR, result.message);
+        return true;
+    }
+    
+    if (result.hasRows) {
+        size_t frame = Wire::beginFrame(out, Wire::ROW_DESC);
+        Wire::putU16(out, static_cast<uint16_t>(result.columns.size()));
+        for (const std::string& column : result.columns) {
+            out += static_cast<char>(Wire::TYPE_ANY);
+            Wire::putU16(out, static_cast<uint16_t>(column.size()));
+            out += column;
+        }
+        Wire::endFrame(out, frame);
+        
+        // Stream batches; large results are flushed as they are encoded so the
+        // output buffer stays bounded even when the rows were spilled to disk
+        size_t remaining = result.rows.size();
+        size_t inBatch = 0;
+        bool sendOk = true;
+        result.rows.forEach([&](const Row& row) {
+            if (inBatch == 0) {
+                frame = Wire::beginFrame(out, Wire::ROW_BATCH);
+                Wire::putU32(out, static_cast<uint32_t>(std::min(remaining, Wire::ROWS_PER_BATCH)));
+            }
+            // Stored rows carry their cells; computed ones are typed here
+            bool typed = row.cells.size() == row.values.size();
+            for (size_t c = 0; c < row.values.size(); ++c) {
+                Wire::putValue(out, typed ? row.cells[c] : Cell::classify(row.values[c]), row.values[c]);
+            }
+            --remaining;
+            if (++inBatch == Wire::ROWS_PER_BATCH || remaining == 0) {
+                Wire::endFrame(out, frame);
+                inBatch = 0;
+                if (out.size() >= FLUSH_THRESHOLD) {
+                    sendOk = sendAll(clientSocket, out);
+                    out.clear();
+                }
+            }
+            return sendOk;
+        });
+        if (!sendOk) {
+            return false;
+        }
+    }
+    
+    size_t frame = Wire::beginFrame(out, Wire::COMPLETE);
+    Wire::putU32(out, static_cast<uint32_t>(result.rows.size()));
+    out += result.message;
+    Wire::endFrame(out, frame);
+    return true;
+}
+
+bool BinaryServer::sendAll(int clientSocket, const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = send(clientSocket, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0) {
+            return false;
+        }
+        sent += static_cast<size_t>(n);
+    }
+    return true;
+}
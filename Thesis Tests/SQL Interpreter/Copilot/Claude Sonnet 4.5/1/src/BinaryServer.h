@@ -0,0 +1,27 @@
+#ifndef BINARYSERVER_H
+#define BINARYSERVER_H
+
+#include <string>
+#include "Engine.h"
+
+// Persistent-connection server speaking the length-prefixed protocol in WireProtocol.h
+class BinaryServer {
+public:
+    BinaryServer(Engine* engine, int port = 9090);
+    ~BinaryServer();
+    
+    bool start();
+    void stop();
+    
+private:
+    Engine* engine_;
+    int port_;
+    int serverSocket_;
+    bool running_;
+    
+    void handleClient(int clientSocket);
+    bool encodeResult(int clientSocket, const QueryResult& result, std::string& out);
+    bool sendAll(int clientSocket, const std::string& data);
+};
+
+#endif // BINARYSERVER_H
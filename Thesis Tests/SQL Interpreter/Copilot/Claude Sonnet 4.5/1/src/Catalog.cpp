@@ -0,0 +1,418 @@
+#include "Catalog.h"
+#include "Utils.h"
+#include <fstream>
+#include <cstring>
+
+namespace {
+
+// The last magic byte is the format version: '1' had no partitioning, '2' adds it,
+// '3' adds the primary key column, '4' materialized views
+const char CATALOG_MAGIC[7] = {'M', 'S', 'Q', 'L', 'C', 'A', 'T'};
+const char CATALOG_VERSION = '4';
+
+inline unsigned char lowerByte(char c) {
+    unsigned char u = static_cast<unsigned char>(c);
+    return (u >= 'A' && u <= 'Z') ? static_cast<unsigned char>(u + 32) : u;
+}
+
+void writeU8(std::string& out, uint8_t v) {
+    out += static_cast<char>(v);
+}
+
+void writeU16(std::string& out, uint16_t v) {
+    out += static_cast<char>(v & 0xFF);
+    out += static_cast<char>((v >> 8) & 0xFF);
+}
+
+void writeU32(std::string& out, uint32_t v) {
+    for (int i = 0; i < 4; ++i) {
+        out += static_cast<char>((v >> (8 * i)) & 0xFF);
+    }
+}
+
+// Bounds-checked little-endian reader over the catalog file contents
+struct Reader {
+    const std::string& data;
+    size_t pos;
+    bool ok;
+    
+    bool need(size_t n) {
+        if (!ok || data.size() - pos < n) {
+            ok = false;
+        }
+        return ok;
+    }
+    uint8_t u8() {
+        if (!need(1)) return 0;
+        return static_cast<uint8_t>(data[pos++]);
+    }
+    uint16_t u16() {
+        if (!need(2)) return 0;
+        uint16_t v = static_cast<uint16_t>(static_cast<unsigned char>(data[pos]) |
+                                           (static_cast<unsigned char>(data[pos + 1]) << 8));
+        pos += 2;
+        return v;
+    }
+    uint32_t u32() {
+        if (!need(4)) return 0;
+        uint32_t v = 0;
+        for (int i = 0; i < 4; ++i) {
+            v |= static_cast<uint32_t>(static_cast<unsigned char>(data[pos + i])) << (8 * i);
+        }
+        pos += 4;
+        return v;
+    }
+};
+
+} // namespace
+
+Catalog::Catalog() : slots_(64, 0) {}
+
+uint32_t Catalog::hashName(const std::string& name) {
+    // FNV-1a over the lower-cased bytes
+    uint32_t hash = 2166136261u;
+    for (char c : name) {
+        hash ^= lowerByte(c);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+bool Catalog::equalsIgnoreCase(const std::string& a, const std::string& b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (lowerByte(a[i]) != lowerByte(b[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+IdentId Catalog::lookup(const std::string& name) const {
+    size_t mask = slots_.size() - 1;
+    for (size_t i = hashName(name) & mask;; i = (i + 1) & mask) {
+        uint32_t slot = slots_[i];
+        if (slot == 0) {
+            return INVALID_ID;
+        }
+        if (equalsIgnoreCase(names_[slot - 1], name)) {
+            return slot - 1;
+        }
+    }
+}
+
+IdentId Catalog::intern(const std::string& name) {
+    IdentId id = lookup(name);
+    if (id != INVALID_ID) {
+        return id;
+    }
+    
+    id = static_cast<IdentId>(names_.size());
+    names_.push_back(Utils::toLower(name));
+    
+    // Keep the load factor below one half
+    if (names_.size() * 2 > slots_.size()) {
+        rehash();
+    } else {
+        insertSlot(id);
+    }
+    return id;
+}
+
+void Catalog::insertSlot(IdentId id) {
+    size_t mask = slots_.size() - 1;
+    size_t i = hashName(names_[id]) & mask;
+    while (slots_[i] != 0) {
+        i = (i + 1) & mask;
+    }
+    slots_[i] = id + 1;
+}
+
+void Catalog::rehash() {
+    slots_.assign(slots_.size() * 2, 0);
+    for (IdentId id = 0; id < names_.size(); ++id) {
+        insertSlot(id);
+    }
+}
+
+TableId Catalog::addTable(const std::string& name, const std::vector<std::string>& columns,
+                          const PartitionSpec& partitioning, uint32_t primaryKey) {
+    TableSchema schema;
+    schema.name = intern(name);
+    schema.partitioning = partitioning;
+    schema.primaryKey = primaryKey;
+    for (const std::string& column : columns) {
+        ColumnSchema col;
+        col.name = intern(column);
+        col.type = ColumnType::TEXT;
+        schema.columnByName[col.name] = static_cast<uint32_t>(schema.columns.size());
+        schema.columns.push_back(col);
+    }
+    
+    TableId id = static_cast<TableId>(tables_.size());
+    tableByName_[schema.name] = id;
+    tables_.push_back(std::move(schema));
+    return id;
+}
+
+TableId Catalog::findTable(const std::string& name) const {
+    IdentId ident = lookup(name);
+    if (ident == INVALID_ID) {
+        return INVALID_ID;
+    }
+    auto it = tableByName_.find(ident);
+    return it == tableByName_.end() ? INVALID_ID : it->second;
+}
+
+uint32_t Catalog::findColumn(TableId table, const std::string& name) const {
+    IdentId ident = lookup(name);
+    if (ident == INVALID_ID || table >= tables_.size()) {
+        return INVALID_ID;
+    }
+    const TableSchema& schema = tables_[table];
+    auto it = schema.columnByName.find(ident);
+    return it == schema.columnByName.end() ? INVALID_ID : it->second;
+}
+
+const IndexSchema* Catalog::findIndex(TableId table, const std::string& name) const {
+    IdentId ident = lookup(name);
+    if (ident == INVALID_ID || table >= tables_.size()) {
+        return nullptr;
+    }
+    for (const IndexSchema& index : tables_[table].indexes) {
+        if (index.name == ident) {
+            return &index;
+        }
+    }
+    return nullptr;
+}
+
+void Catalog::addIndex(TableId table, const std::string& name, uint32_t column, IndexKind kind) {
+    IndexSchema index;
+    index.name = intern(name);
+    index.column = column;
+    index.kind = kind;
+    tables_[table].indexes.push_back(index);
+}
+
+ViewId Catalog::addView(const std::string& name, TableId table, const std::vector<std::string>& columns,
+                        const std::string& definition) {
+    ViewSchema schema;
+    schema.name = intern(name);
+    schema.table = table;
+    schema.definition = definition;
+    for (const std::string& column : columns) {
+        IdentId ident = intern(column);
+        schema.columnByName[ident] = static_cast<uint32_t>(schema.columns.size());
+        schema.columns.push_back(ident);
+    }
+    
+    ViewId id = static_cast<ViewId>(views_.size());
+    viewByName_[schema.name] = id;
+    views_.push_back(std::move(schema));
+    return id;
+}
+
+ViewId Catalog::findView(const std::string& name) const {
+    IdentId ident = lookup(name);
+    if (ident == INVALID_ID) {
+        return INVALID_ID;
+    }
+    auto it = viewByName_.find(ident);
+    return it == viewByName_.end() ? INVALID_ID : it->second;
+}
+
+uint32_t Catalog::findViewColumn(ViewId view, const std::string& name) const {
+    IdentId ident = lookup(name);
+    if (ident == INVALID_ID || view >= views_.size()) {
+        return INVALID_ID;
+    }
+    const ViewSchema& schema = views_[view];
+    auto it = schema.columnByName.find(ident);
+    return it == schema.columnByName.end() ? INVALID_ID : it->second;
+}
+
+bool Catalog::save(const std::string& path) {
+    // Layout (little-endian): magic + version, u32 identCount, {u16 len, bytes}*,
+    // u32 tableCount, per table: u32 name, u16 colCount, {u32 name, u8 type}*,
+    // u16 indexCount, {u32 name, u32 column, u8 kind}*,
+    // u8 partitionKind, u32 partitionColumn, u32 partitionCount, u16 boundCount, {u16 len, bytes}*,
+    // u32 primaryKey,
+    // u32 viewCount, per view: u32 name, u32 table, u16 colCount, {u32 name}*, u32 len, definition
+    std::string out(CATALOG_MAGIC, sizeof(CATALOG_MAGIC));
+    out += CATALOG_VERSION;
+    writeU32(out, static_cast<uint32_t>(names_.size()));
+    for (const std::string& name : names_) {
+        writeU16(out, static_cast<uint16_t>(name.size()));
+        out += name;
+    }
+    writeU32(out, static_cast<uint32_t>(tables_.size()));
+    for (const TableSchema& schema : tables_) {
+        writeU32(out, schema.name);
+        writeU16(out, static_cast<uint16_t>(schema.columns.size()));
+        for (const ColumnSchema& col : schema.columns) {
+            writeU32(out, col.name);
+            writeU8(out, static_cast<uint8_t>(col.type));
+        }
+        writeU16(out, static_cast<uint16_t>(schema.indexes.size()));
+        for (const IndexSchema& index : schema.indexes) {
+            writeU32(out, index.name);
+            writeU32(out, index.column);
+            writeU8(out, static_cast<uint8_t>(index.kind));
+        }
+        const PartitionSpec& part = schema.partitioning;
+        writeU8(out, static_cast<uint8_t>(part.kind));
+        writeU32(out, part.column);
+        writeU32(out, part.count);
+        writeU16(out, static_cast<uint16_t>(part.rangeBounds.size()));
+        for (const std::string& bound : part.rangeBounds) {
+            writeU16(out, static_cast<uint16_t>(bound.size()));
+            out += bound;
+        }
+        writeU32(out, schema.primaryKey);
+    }
+    writeU32(out, static_cast<uint32_t>(views_.size()));
+    for (const ViewSchema& view : views_) {
+        writeU32(out, view.name);
+        writeU32(out, view.table);
+        writeU16(out, static_cast<uint16_t>(view.columns.size()));
+        for (IdentId column : view.columns) {
+            writeU32(out, column);
+        }
+        writeU32(out, static_cast<uint32_t>(view.definition.size()));
+        out += view.definition;
+    }
+    
+    // Write to a temporary file and rename so a crash never leaves a torn catalog
+    std::string tmpPath = path + ".tmp";
+    std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        lastError_ = "Failed to open file: " + tmpPath;
+        return false;
+    }
+    file.write(out.data(), static_cast<std::streamsize>(out.size()));
+    file.close();
+    if (!file || std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+        lastError_ = "Failed to write catalog: " + path;
+        return false;
+    }
+    return true;
+}
+
+bool Catalog::load(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    
+    if (data.size() < sizeof(CATALOG_MAGIC) + 1 ||
+        std::memcmp(data.data(), CATALOG_MAGIC, sizeof(CATALOG_MAGIC)) != 0 ||
+        data[sizeof(CATALOG_MAGIC)] < '1' || data[sizeof(CATALOG_MAGIC)] > CATALOG_VERSION) {
+        lastError_ = "Invalid catalog file: " + path;
+        return false;
+    }
+    char version = data[sizeof(CATALOG_MAGIC)];
+    
+    Reader in{data, sizeof(CATALOG_MAGIC) + 1, true};
+    Catalog loaded;
+    
+    uint32_t identCount = in.u32();
+    for (uint32_t i = 0; in.ok && i < identCount; ++i) {
+        uint16_t length = in.u16();
+        if (!in.need(length)) break;
+        loaded.intern(data.substr(in.pos, length));
+        in.pos += length;
+    }
+    
+    uint32_t tableCount = in.u32();
+    for (uint32_t t = 0; in.ok && t < tableCount; ++t) {
+        TableSchema schema;
+        schema.name = in.u32();
+        uint16_t columnCount = in.u16();
+        for (uint16_t c = 0; in.ok && c < columnCount; ++c) {
+            ColumnSchema col;
+            col.name = in.u32();
+            col.type = static_cast<ColumnType>(in.u8());
+            if (col.name >= loaded.names_.size()) {
+                in.ok = false;
+            }
+            schema.columnByName[col.name] = c;
+            schema.columns.push_back(col);
+        }
+        uint16_t indexCount = in.u16();
+        for (uint16_t i = 0; in.ok && i < indexCount; ++i) {
+            IndexSchema index;
+            index.name = in.u32();
+            index.column = in.u32();
+            index.kind = static_cast<IndexKind>(in.u8());
+            schema.indexes.push_back(index);
+        }
+        if (version >= '2') {
+            PartitionSpec& part = schema.partitioning;
+            part.kind = static_cast<PartitionKind>(in.u8());
+            part.column = in.u32();
+            part.count = in.u32();
+            uint16_t boundCount = in.u16();
+            for (uint16_t b = 0; in.ok && b < boundCount; ++b) {
+                uint16_t length = in.u16();
+                if (!in.need(length)) break;
+                part.rangeBounds.push_back(data.substr(in.pos, length));
+                in.pos += length;
+            }
+            if (part.count == 0 || part.column >= schema.columns.size()) {
+                in.ok = false;
+            }
+        }
+        if (version >= '3') {
+            schema.primaryKey = in.u32();
+            if (schema.primaryKey != INVALID_ID && schema.primaryKey >= schema.columns.size()) {
+                in.ok = false;
+            }
+        }
+        if (schema.name >= loaded.names_.size()) {
+            in.ok = false;
+        }
+        if (in.ok) {
+            loaded.tableByName_[schema.name] = static_cast<TableId>(loaded.tables_.size());
+            loaded.tables_.push_back(std::move(schema));
+        }
+    }
+    
+    uint32_t viewCount = version >= '4' ? in.u32() : 0;
+    for (uint32_t v = 0; in.ok && v < viewCount; ++v) {
+        ViewSchema view;
+        view.name = in.u32();
+        view.table = in.u32();
+        uint16_t columnCount = in.u16();
+        for (uint16_t c = 0; in.ok && c < columnCount; ++c) {
+            IdentId column = in.u32();
+            if (column >= loaded.names_.size()) {
+                in.ok = false;
+            }
+            view.columnByName[column] = c;
+            view.columns.push_back(column);
+        }
+        uint32_t length = in.u32();
+        if (!in.need(length)) break;
+        view.definition = data.substr(in.pos, length);
+        in.pos += length;
+        if (view.name >= loaded.names_.size() || view.table >= loaded.tables_.size()) {
+            in.ok = false;
+        }
+        if (in.ok) {
+            loaded.viewByName_[view.name] = static_cast<ViewId>(loaded.views_.size());
+            loaded.views_.push_back(std::move(view));
+        }
+    }
+    
+    if (!in.ok) {
+        lastError_ = "Truncated catalog file: " + path;
+        return false;
+    }
+    
+    *this = std::move(loaded);
+    return true;
+}
@@ -0,0 +1,126 @@
+#ifndef CATALOG_H
+#define CATALOG_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+typedef uint32_t IdentId;   // interned identifier
+typedef uint32_t TableId;   // position of a table in the catalog
+typedef uint32_t ViewId;    // position of a materialized view in the catalog
+
+const uint32_t INVALID_ID = 0xFFFFFFFFu;
+
+enum class ColumnType : uint8_t {
+    TEXT = 1
+};
+
+enum class IndexKind : uint8_t {
+    NONE = 0,
+    TRIGRAM = 1
+};
+
+enum class PartitionKind : uint8_t {
+    NONE = 0,
+    HASH = 1,
+    RANGE = 2
+};
+
+// What an INSERT does when a row's primary key already exists
+enum class ConflictAction : uint8_t {
+    ABORT = 0,     // reject the whole statement
+    NOTHING = 1,   // skip the row
+    UPDATE = 2     // overwrite the existing row
+};
+
+// How rows are spread over partition files
+struct PartitionSpec {
+    PartitionKind kind = PartitionKind::NONE;
+    uint32_t column = 0;
+    uint32_t count = 1;                     // number of partitions
+    std::vector<std::string> rangeBounds;   // RANGE: exclusive upper bounds, count - 1 of them
+};
+
+struct ColumnSchema {
+    IdentId name;
+    ColumnType type;
+};
+
+struct IndexSchema {
+    IdentId name;
+    uint32_t column;
+    IndexKind kind;
+};
+
+struct TableSchema {
+    IdentId name;
+    std::vector<ColumnSchema> columns;
+    std::vector<IndexSchema> indexes;
+    PartitionSpec partitioning;
+    uint32_t primaryKey = INVALID_ID;   // column index, INVALID_ID if the table has no key
+    std::unordered_map<IdentId, uint32_t> columnByName;  // derived, not persisted
+};
+
+// Materialized view: a GROUP BY query over one table, kept up to date on INSERT
+struct ViewSchema {
+    IdentId name;
+    TableId table;                    // source table
+    std::vector<IdentId> columns;     // output columns, in select-list order
+    std::string definition;           // canonical SELECT, planned again on startup
+    std::unordered_map<IdentId, uint32_t> columnByName;  // derived, not persisted
+};
+
+// Schema catalog. Identifiers are interned once (case-insensitively) and
+// referred to by integer ids afterwards; lookups hash the caller's text
+// directly, so resolving a name never allocates.
+class Catalog {
+public:
+    Catalog();
+    
+    IdentId intern(const std::string& name);
+    IdentId lookup(const std::string& name) const;
+    const std::string& identifier(IdentId id) const { return names_[id]; }
+    
+    TableId addTable(const std::string& name, const std::vector<std::string>& columns,
+                     const PartitionSpec& partitioning = PartitionSpec(),
+                     uint32_t primaryKey = INVALID_ID);
+    TableId findTable(const std::string& name) const;
+    uint32_t findColumn(TableId table, const std::string& name) const;
+    const IndexSchema* findIndex(TableId table, const std::string& name) const;
+    void addIndex(TableId table, const std::string& name, uint32_t column, IndexKind kind);
+    
+    // Tables and views share one namespace; callers check both before adding
+    ViewId addView(const std::string& name, TableId table, const std::vector<std::string>& columns,
+                   const std::string& definition);
+    ViewId findView(const std::string& name) const;
+    uint32_t findViewColumn(ViewId view, const std::string& name) const;
+    
+    size_t tableCount() const { return tables_.size(); }
+    const TableSchema& table(TableId id) const { return tables_[id]; }
+    TableSchema& table(TableId id) { return tables_[id]; }
+    const std::string& tableName(TableId id) const { return names_[tables_[id].name]; }
+    size_t viewCount() const { return views_.size(); }
+    const ViewSchema& view(ViewId id) const { return views_[id]; }
+    const std::string& viewName(ViewId id) const { return names_[views_[id].name]; }
+    
+    bool save(const std::string& path);
+    bool load(const std::string& path);
+    std::string getLastError() const { return lastError_; }
+
+private:
+    std::vector<std::string> names_;     // canonical (lower-case) spelling per IdentId
+    std::vector<uint32_t> slots_;        // open addressing: 0 = empty, otherwise id + 1
+    std::vector<TableSchema> tables_;
+    std::unordered_map<IdentId, TableId> tableByName_;
+    std::vector<ViewSchema> views_;
+    std::unordered_map<IdentId, ViewId> viewByName_;
+    std::string lastError_;
+    
+    static uint32_t hashName(const std::string& name);
+    static bool equalsIgnoreCase(const std::string& a, const std::string& b);
+    void insertSlot(IdentId id);
+    void rehash();
+};
+
+#endif // CATALOG_H
@@ -0,0 +1,109 @@
+#ifndef CHUNKEDVECTOR_H
+#define CHUNKEDVECTOR_H
+
+#include <memory>
+#include <algorithm>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// Append-mostly array whose versions share storage, for publishing table
+// contents to lock-free readers (RCU style). Elements live in fixed-size
+// chunks; copying a ChunkedVector copies one pointer, and the copy keeps
+// seeing exactly its own prefix:
+//   - push_back fills the slot past the writer's size in place. Every copy
+//     has a size no larger than the writer's, so no reader can see that slot.
+//   - set() copies the chunk it changes (and the chunk directory) unless the
+//     writer created them after its last snapshot(), so published copies never
+//     see an element change.
+// One writer at a time; readers only use copies made with snapshot().
+template <typename T>
+class ChunkedVector {
+public:
+    static constexpr size_t CHUNK_SIZE = 1024;
+    
+    class const_iterator {
+    public:
+        const_iterator(const ChunkedVector* owner, size_t index) : owner_(owner), index_(index) {}
+        const T& operator*() const { return (*owner_)[index_]; }
+        const_iterator& operator++() { ++index_; return *this; }
+        bool operator!=(const const_iterator& other) const { return index_ != other.index_; }
+    private:
+        const ChunkedVector* owner_;
+        size_t index_;
+    };
+    
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    const T& operator[](size_t i) const { return directory_->chunks[i / CHUNK_SIZE]->items[i % CHUNK_SIZE]; }
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, size_); }
+    
+    void push_back(T value) {
+        if (size_ % CHUNK_SIZE == 0) {
+            ownDirectory();
+            directory_->chunks.push_back(std::make_shared<Chunk>(generation_));
+        }
+        directory_->chunks[size_ / CHUNK_SIZE]->items[size_ % CHUNK_SIZE] = std::move(value);
+        ++size_;
+    }
+    
+    void set(size_t i, T value) {
+        std::shared_ptr<Chunk>& chunk = directory_->chunks[i / CHUNK_SIZE];
+        if (chunk->generation != generation_) {
+            ownDirectory();
+            std::shared_ptr<Chunk>& owned = directory_->chunks[i / CHUNK_SIZE];
+            size_t used = std::min(CHUNK_SIZE, size_ - i / CHUNK_SIZE * CHUNK_SIZE);
+            owned = std::make_shared<Chunk>(*owned, used, generation_);
+            owned->items[i % CHUNK_SIZE] = std::move(value);
+            return;
+        }
+        chunk->items[i % CHUNK_SIZE] = std::move(value);
+    }
+    
+    void clear() {
+        directory_ = std::make_shared<Directory>(generation_);
+        size_ = 0;
+    }
+    
+    // Copy for readers; afterwards every existing chunk counts as shared
+    ChunkedVector snapshot() {
+        ChunkedVector copy(*this);
+        ++generation_;
+        return copy;
+    }
+    
+private:
+    struct Chunk {
+        std::unique_ptr<T[]> items;
+        uint64_t generation;   // writer generation allowed to modify it in place
+        
+        explicit Chunk(uint64_t gen) : items(new T[CHUNK_SIZE]), generation(gen) {}
+        Chunk(const Chunk& other, size_t used, uint64_t gen) : items(new T[CHUNK_SIZE]), generation(gen) {
+            for (size_t i = 0; i < used; ++i) {
+                items[i] = other.items[i];
+            }
+        }
+    };
+    
+    struct Directory {
+        std::vector<std::shared_ptr<Chunk>> chunks;
+        uint64_t generation;
+        
+        explicit Directory(uint64_t gen) : generation(gen) {}
+    };
+    
+    std::shared_ptr<Directory> directory_ = std::make_shared<Directory>(0);
+    size_t size_ = 0;
+    uint64_t generation_ = 0;
+    
+    void ownDirectory() {
+        if (directory_->generation != generation_) {
+            auto copy = std::make_shared<Directory>(generation_);
+            copy->chunks = directory_->chunks;
+            directory_ = copy;
+        }
+    }
+};
+
+#endif // CHUNKEDVECTOR_H
@@ -4,10 +4,265 @@
 #include <iostream>
 #include <fstream>
 #include <sstream>
-#include <iomanip>
 #include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <deque>
+#include <set>
+#include <thread>
+#include <condition_variable>
+#include "ScriptReader.h"
+#include "WindowOperator.h"
+#include "GroupAggregate.h"
+#include "MaterializedView.h"
+#include "ResultEncoder.h"
+#include "HashJoin.h"
+#include "ParquetFile.h"
+
+namespace {
+
+// Statements the script parser may run ahead of execution
+const size_t SCRIPT_QUEUE_DEPTH = 256;
+// Consecutive INSERTs combined into one storage write
+const size_t SCRIPT_BATCH_ROWS = 1024;
+
+QueryResult errorResult(const std::string& message) {
+    QueryResult result;
+    result.ok = false;
+    result.message = message;
+    return result;
+}
+
+// True when row satisfies every WHERE condition of a table plan
+bool passesFilters(const Plan& plan, const Row& row) {
+    for (const PlannedFilter& filter : plan.filters) {
+        if (!filter.matches(row)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Feeds the rows a table plan's access path reads, before filtering, to
+// visit; stops and returns false as soon as visit does
+template <typename Visit>
+bool scanTable(const Plan& plan, const TableSnapshot& table, Visit&& visit) {
+    if (table.access) {
+        table.access->touch();
+        if (plan.access == AccessPath::PRIMARY_KEY_LOOKUP) {
+            table.access->lookups.fetch_add(plan.indexKeys.size(), std::memory_order_relaxed);
+        } else {
+            table.access->scans.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    if (plan.access == AccessPath::TRIGRAM_SCAN) {
+        // Candidates from the index are re-checked against every filter. The
+        // index is shared with the writer, so it may name rows newer than the
+        // snapshot; those are skipped.
+        const TrigramIndex* index = table.trigramIndex(plan.filters[plan.indexFilter].column);
+        std::vector<uint32_t> candidates;
+        {
+            std::shared_lock<std::shared_mutex> indexGuard(*table.indexLock);
+            index->candidates(plan.indexKeys, candidates);
+        }
+        for (uint32_t rowId : candidates) {
+            if (rowId < table.rows.size() && !visit(table.rows[rowId])) return false;
+        }
+    } else if (plan.access == AccessPath::PRIMARY_KEY_LOOKUP) {
+        std::vector<uint32_t> rowIds;
+        {
+            std::shared_lock<std::shared_mutex> indexGuard(*table.indexLock);
+            uint32_t rowId;
+            for (const std::string& key : plan.indexKeys) {
+                if (table.primaryIndex->find(key, rowId)) rowIds.push_back(rowId);
+            }
+        }
+        for (uint32_t rowId : rowIds) {
+            if (rowId < table.rows.size() && !visit(table.rows[rowId])) return false;
+        }
+    } else if (plan.partitions.size() < plan.partitionCount) {
+        // Pruned scan: only the partitions that can hold matching rows
+        for (uint32_t p : plan.partitions) {
+            for (uint32_t rowId : table.partitions[p]) {
+                if (!visit(table.rows[rowId])) return false;
+            }
+        }
+    } else {
+        for (const Row& row : table.rows) {
+            if (!visit(row)) return false;
+        }
+    }
+    return true;
+}
+
+// Planner cost of a SELECT plus its CTEs and subqueries. A body reading a
+// CTE cannot be planned before the CTE is materialized; only the CTE counts.
+double selectCost(const StorageSnapshot& snapshot, const SelectStatement& stmt) {
+    double cost = 0;
+    for (const CommonTableExpr& cte : stmt.with) {
+        cost += selectCost(snapshot, *cte.select);
+    }
+    for (const Condition& condition : stmt.where) {
+        if (condition.subquery) {
+            cost += selectCost(snapshot, *condition.subquery);
+        }
+    }
+    Planner planner(snapshot);
+    Plan plan;
+    if (planner.plan(stmt, plan)) {
+        cost += plan.cost + plan.windowCost + plan.aggregateCost;
+    }
+    return cost;
+}
+
+// Tables a SELECT reads, including those of its CTEs and subqueries
+void collectTables(const SelectStatement& stmt, std::vector<TableId>& ids) {
+    for (const CommonTableExpr& cte : stmt.with) {
+        collectTables(*cte.select, ids);
+    }
+    for (const Condition& condition : stmt.where) {
+        if (condition.subquery) {
+            collectTables(*condition.subquery, ids);
+        }
+    }
+    ids.push_back(stmt.tableId);
+    if (stmt.joined()) {
+        ids.push_back(stmt.join.tableId);
+    }
+}
 
-Engine::Engine() {}
+// Parsed (or failed) statement handed from the parser thread to the executor
+struct ScriptItem {
+    std::unique_ptr<Statement> stmt;
+    std::string error;
+};
+
+// Bounded single-producer/single-consumer queue between the two threads
+class ScriptQueue {
+public:
+    explicit ScriptQueue(size_t capacity) : capacity_(capacity) {}
+    
+    bool push(ScriptItem item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        notFull_.wait(lock, [this] { return items_.size() < capacity_ || closed_; });
+        if (closed_) {
+            return false;
+        }
+        items_.push_back(std::move(item));
+        notEmpty_.notify_one();
+        return true;
+    }
+    
+    // Blocks until an item arrives; false once the queue is closed and drained
+    bool pop(ScriptItem& item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        notEmpty_.wait(lock, [this] { return !items_.empty() || closed_; });
+        return take(item);
+    }
+    
+    bool tryPop(ScriptItem& item) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return take(item);
+    }
+    
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        notEmpty_.notify_all();
+        notFull_.notify_all();
+    }
+
+private:
+    std::deque<ScriptItem> items_;
+    size_t capacity_;
+    bool closed_ = false;
+    std::mutex mutex_;
+    std::condition_variable notEmpty_;
+    std::condition_variable notFull_;
+    
+    bool take(ScriptItem& item) {
+        if (items_.empty()) {
+            return false;
+        }
+        item = std::move(items_.front());
+        items_.pop_front();
+        notFull_.notify_one();
+        return true;
+    }
+};
+
+} // namespace
+
+Engine::Engine(const std::string& dataDir) : storage_(dataDir) {}
+
+Engine::~Engine() {
+    {
+        std::lock_guard<std::mutex> lock(evictionMutex_);
+        stopping_ = true;
+    }
+    evictionWake_.notify_all();
+    if (evictionThread_.joinable()) {
+        evictionThread_.join();
+    }
+}
+
+void Engine::setEvictAfter(uint32_t seconds) {
+    evictAfterSec_ = seconds;
+    if (seconds > 0 && !evictionThread_.joinable()) {
+        evictionThread_ = std::thread([this]() { evictionLoop(); });
+    }
+}
+
+void Engine::evictionLoop() {
+    // Sweeps a few times per timeout, so a table leaves memory soon after it goes cold
+    auto interval = std::chrono::seconds(std::min<uint32_t>(std::max<uint32_t>(evictAfterSec_ / 4, 1), 60));
+    uint64_t minIdleMs = static_cast<uint64_t>(evictAfterSec_) * 1000;
+    std::unique_lock<std::mutex> lock(evictionMutex_);
+    while (!evictionWake_.wait_for(lock, interval, [this] { return stopping_; })) {
+        lock.unlock();
+        std::shared_ptr<const StorageSnapshot> snapshot = storage_.snapshot();
+        for (TableId id = 0; id < snapshot->tables.size(); ++id) {
+            const TableSnapshot* table = snapshot->table(id);
+            if (!table || table->evicted || !table->access || table->access->idleMs() < minIdleMs) {
+                continue;
+            }
+            // Locked like an INSERT; evictTable checks idleness again under the lock
+            std::shared_lock<std::shared_mutex> engineLock(mutex_);
+            std::lock_guard<std::mutex> tableLock(storage_.writeLock(id));
+            if (!storage_.evictTable(id, minIdleMs) && !storage_.getLastError().empty()) {
+                std::cerr << "Warning: Cannot evict table '" << snapshot->catalog->tableName(id)
+                          << "': " << storage_.getLastError() << "\n";
+            }
+        }
+        lock.lock();
+    }
+}
+
+bool Engine::reloadEvicted(const Statement& stmt, const StorageSnapshot& snapshot, bool& reloaded,
+                           std::string& error) {
+    std::vector<TableId> ids;
+    if (stmt.type() == StatementType::SELECT) {
+        collectTables(static_cast<const SelectStatement&>(stmt), ids);
+    } else if (stmt.type() == StatementType::EXPLAIN) {
+        collectTables(*static_cast<const ExplainStatement&>(stmt).select, ids);
+    } else if (stmt.type() == StatementType::EXPORT) {
+        ids.push_back(static_cast<const ExportStatement&>(stmt).tableId);
+    }
+    for (TableId id : ids) {
+        const TableSnapshot* table = snapshot.table(id);
+        if (!table || !table->evicted) {
+            continue;
+        }
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        std::lock_guard<std::mutex> tableLock(storage_.writeLock(id));
+        if (!storage_.ensureLoaded(id)) {
+            error = "Error: " + storage_.getLastError();
+            return false;
+        }
+        reloaded = true;
+    }
+    return true;
+}
 
 void Engine::repl() {
     std::cout << "MiniSQL Interpreter v1.0\n";
@@ -28,6 +283,12 @@ void Engine::repl() {
             break;
         }
         
+        if (line == ".memory") {
+            std::string report = memoryReport();
+            std::cout << (report.empty() ? "No query executed yet" : report) << "\n";
+            continue;
+        }
+        
         if (line.empty()) {
             continue;
         }
@@ -43,196 +304,971 @@ void Engine::repl() {
 }
 
 void Engine::executeScript(const std::string& filename) {
-    std::ifstream file(filename);
-    if (!file.is_open()) {
-        std::cerr << "Error: Could not open file '" << filename << "'\n";
+    ScriptReader reader;
+    if (!reader.open(filename)) {
+        std::cerr << "Error: " << reader.getError() << "\n";
         return;
     }
     
-    std::string buffer;
-    std::string line;
+    // A parser thread splits, lexes and parses ahead of execution. Statements
+    // are parsed without the catalog and bound right before they run, so an
+    // INSERT may follow the CREATE TABLE it depends on.
+    ScriptQueue queue(SCRIPT_QUEUE_DEPTH);
+    std::thread parserThread([&reader, &queue] {
+        std::string sql;
+        while (reader.next(sql)) {
+            ScriptItem item;
+            Lexer lexer(sql);
+            std::vector<Token> tokens = lexer.tokenize();
+            if (!lexer.getError().empty()) {
+                item.error = "Lexer error: " + lexer.getError();
+            } else {
+                Parser parser(tokens);
+                item.stmt = parser.parseStatement();
+                if (parser.hasError()) {
+                    item.error = "Parse error: " + parser.getError();
+                    item.stmt.reset();
+                } else if (!item.stmt) {
+                    item.error = "Error: Failed to parse statement";
+                }
+            }
+            if (!queue.push(std::move(item))) {
+                break;
+            }
+        }
+        queue.close();
+    });
     
-    while (std::getline(file, line)) {
-        line = Utils::trim(line);
-        
-        if (line.empty() || line[0] == '#' || line.substr(0, 2) == "--") {
-            continue; // Skip comments and empty lines
+    auto batchable = [](const ScriptItem& item) {
+        return item.stmt && item.stmt->type() == StatementType::INSERT;
+    };
+    auto insertOf = [](const ScriptItem& item) {
+        return static_cast<InsertStatement*>(item.stmt.get());
+    };
+    
+    ScriptItem item;
+    bool have = queue.pop(item);
+    while (have) {
+        if (!batchable(item)) {
+            QueryResult result = item.error.empty() ? executeParsed(*item.stmt) : errorResult(item.error);
+            printResult(result);
+            have = queue.pop(item);
+            continue;
         }
         
-        buffer += line + " ";
+        // Gather consecutive INSERTs into the same table that are already parsed
+        std::vector<ScriptItem> batch;
+        batch.push_back(std::move(item));
+        have = false;
+        ScriptItem next;
+        while (batch.size() < SCRIPT_BATCH_ROWS && queue.tryPop(next)) {
+            if (batchable(next) &&
+                Utils::toLower(insertOf(next)->tableName) == Utils::toLower(insertOf(batch[0])->tableName) &&
+                insertOf(next)->onConflict == insertOf(batch[0])->onConflict) {
+                batch.push_back(std::move(next));
+            } else {
+                item = std::move(next);
+                have = true;
+                break;
+            }
+        }
         
-        // Check if statement is complete
-        if (line.find(';') != std::string::npos) {
-            executeStatement(buffer);
-            buffer.clear();
+        std::vector<InsertStatement*> inserts;
+        for (ScriptItem& queued : batch) {
+            inserts.push_back(insertOf(queued));
+        }
+        for (QueryResult& result : executeInsertBatch(inserts)) {
+            printResult(result);
+        }
+        if (!have) {
+            have = queue.pop(item);
         }
     }
     
-    file.close();
+    parserThread.join();
 }
 
-std::string Engine::executeStatementWeb(const std::string& sql) {
-    return executeStatementInternal(sql, true);
+std::string Engine::executeStatementWeb(const std::string& sql, std::shared_ptr<QueryControl> control) {
+    return executeStatementInternal(sql, true, control);
 }
 
 void Engine::executeStatement(const std::string& sql) {
-    std::string result = executeStatementInternal(sql, false);
+    std::string result = executeStatementInternal(sql, false, nullptr);
     if (!result.empty()) {
         std::cout << result << "\n";
     }
 }
 
-std::string Engine::executeStatementInternal(const std::string& sql, bool returnOutput) {
+void Engine::printResult(QueryResult& result) {
+    std::string output = renderResult(result, false);
+    if (!output.empty()) {
+        std::cout << output << "\n";
+    }
+}
+
+std::string Engine::executeStatementInternal(const std::string& sql, bool returnOutput,
+                                             std::shared_ptr<QueryControl> control) {
     std::string trimmedSql = Utils::trim(sql);
     if (trimmedSql.empty()) {
         return "";
     }
     
+    QueryResult result = executeQuery(trimmedSql, control);
+    return renderResult(result, returnOutput);
+}
+
+std::string Engine::renderResult(QueryResult& result, bool returnOutput) {
+    // Errors go to stderr only on the console; the callers print what is returned
+    if (!result.ok) {
+        if (!returnOutput) {
+            std::cerr << result.message << "\n";
+            return "";
+        }
+        return result.message;
+    }
+    
+    if (result.hasRows) {
+        std::string output = formatSelectResult(result);
+        recordMemoryReport(result.memory->report());
+        return output;
+    }
+    return result.message;
+}
+
+QueryResult Engine::executeQuery(const std::string& sql, std::shared_ptr<QueryControl> control) {
+    QueryResult result;
+    
     // Tokenize
-    Lexer lexer(trimmedSql);
+    Lexer lexer(sql);
     std::vector<Token> tokens = lexer.tokenize();
     
     if (!lexer.getError().empty()) {
-        std::string error = "Lexer error: " + lexer.getError();
-        if (!returnOutput) {
-            std::cerr << error << "\n";
-        }
-        return error;
+        result.ok = false;
+        result.message = "Lexer error: " + lexer.getError();
+        return result;
     }
     
-    // Parse
-    Parser parser(tokens);
+    // Parse and bind names against the catalog of the current snapshot
+    std::shared_ptr<const StorageSnapshot> snapshot = storage_.snapshot();
+    Parser parser(tokens, snapshot->catalog.get());
     std::unique_ptr<Statement> stmt = parser.parseStatement();
     
     if (parser.hasError()) {
-        std::string error = "Parse error: " + parser.getError();
-        if (!returnOutput) {
-            std::cerr << error << "\n";
-        }
-        return error;
+        result.ok = false;
+        result.message = "Parse error: " + parser.getError();
+        return result;
     }
     
     if (!stmt) {
-        std::string error = "Error: Failed to parse statement";
-        if (!returnOutput) {
-            std::cerr << error << "\n";
+        result.ok = false;
+        result.message = "Error: Failed to parse statement";
+        return result;
+    }
+    
+    return execute(*stmt, *snapshot, control);
+}
+
+double Engine::estimateCost(const std::string& sql) {
+    Lexer lexer(sql);
+    std::vector<Token> tokens = lexer.tokenize();
+    if (!lexer.getError().empty()) {
+        return 0;
+    }
+    std::shared_ptr<const StorageSnapshot> snapshot = storage_.snapshot();
+    Parser parser(tokens, snapshot->catalog.get());
+    std::unique_ptr<Statement> stmt = parser.parseStatement();
+    if (!stmt || parser.hasError() || stmt->type() != StatementType::SELECT) {
+        return 0;
+    }
+    return selectCost(*snapshot, static_cast<const SelectStatement&>(*stmt));
+}
+
+QueryResult Engine::executeParsed(Statement& stmt) {
+    std::shared_ptr<const StorageSnapshot> snapshot = storage_.snapshot();
+    Parser::bind(stmt, *snapshot->catalog);
+    return execute(stmt, *snapshot);
+}
+
+void Engine::setChangeListener(ChangeListener* listener) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    storage_.setChangeListener(listener);
+}
+
+void Engine::withStorage(const std::function<void(const Storage&)>& fn) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    // fn reads the live rows, so evicted tables come back first
+    for (TableId id = 0; id < storage_.catalog().tableCount(); ++id) {
+        if (!storage_.ensureLoaded(id)) {
+            std::cerr << "Warning: " << storage_.getLastError() << "\n";
+        }
+    }
+    fn(storage_);
+}
+
+bool Engine::updateStorage(const std::function<bool(Storage&)>& fn) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    return fn(storage_);
+}
+
+std::string Engine::memoryReport() const {
+    std::lock_guard<std::mutex> lock(reportMutex_);
+    return lastMemoryReport_;
+}
+
+void Engine::recordMemoryReport(const std::string& report) {
+    std::lock_guard<std::mutex> lock(reportMutex_);
+    lastMemoryReport_ = report;
+}
+
+QueryResult Engine::execute(Statement& stmt, const StorageSnapshot& snapshot,
+                            std::shared_ptr<QueryControl> control) {
+    auto memory = std::make_shared<MemoryTracker>(memoryLimit_);
+    if (!control) {
+        control = std::make_shared<QueryControl>(queryTimeoutMs_);
+    }
+    // Reads of evicted tables load them back and run on a snapshot that has them
+    bool reloaded = false;
+    std::string reloadError;
+    std::shared_ptr<const StorageSnapshot> current;
+    if (!control->expired() && reloadEvicted(stmt, snapshot, reloaded, reloadError) && reloaded) {
+        current = storage_.snapshot();
+    }
+    const StorageSnapshot& source = current ? *current : snapshot;
+    
+    QueryResult result;
+    if (control->expired()) {
+        result = errorResult("Error: " + control->reason());  // e.g. while waiting for admission
+    } else if (!reloadError.empty()) {
+        result = errorResult(reloadError);
+    } else if (stmt.type() == StatementType::SELECT) {
+        result = handleSelect(static_cast<SelectStatement*>(&stmt), source, memory, *control);
+    } else if (stmt.type() == StatementType::EXPLAIN) {
+        result = handleExplain(static_cast<ExplainStatement*>(&stmt), source, memory, *control);
+    } else if (stmt.type() == StatementType::EXPORT) {
+        result = handleExport(static_cast<ExportStatement*>(&stmt), source, *control);
+    } else if (stmt.type() == StatementType::SHOW_TABLES) {
+        result = handleShowTables(source);
+    } else if (stmt.type() == StatementType::IMPORT) {
+        result = handleImport(static_cast<ImportStatement*>(&stmt));  // takes mutex_ itself
+    } else if (stmt.type() == StatementType::CREATE_TABLE || stmt.type() == StatementType::CREATE_INDEX ||
+               stmt.type() == StatementType::CREATE_VIEW) {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        result = executeWrite(stmt);
+    } else {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        result = executeWrite(stmt);
+    }
+    result.memory = memory;
+    recordMemoryReport(memory->report());
+    return result;
+}
+
+QueryResult Engine::executeWrite(Statement& statement) {
+    QueryResult result;
+    Statement* stmt = &statement;
+    
+    if (readOnly_ && stmt->type() != StatementType::ANALYZE) {
+        return errorResult("Error: This server is a read-only replica");
+    }
+    
+    // A table created since the snapshot was taken must resolve now
+    Parser::bind(statement, storage_.catalog());
+    std::unique_lock<std::mutex> tableLock;
+    if (stmt->type() == StatementType::INSERT || stmt->type() == StatementType::ANALYZE) {
+        TableId id = stmt->type() == StatementType::INSERT ? static_cast<InsertStatement*>(stmt)->tableId
+                                                           : static_cast<AnalyzeStatement*>(stmt)->tableId;
+        if (id != INVALID_ID) {
+            tableLock = std::unique_lock<std::mutex>(storage_.writeLock(id));
         }
-        return error;
     }
     
-    // Execute
-    std::string result;
     switch (stmt->type()) {
         case StatementType::CREATE_TABLE:
-            result = handleCreateTable(static_cast<CreateTableStatement*>(stmt.get()));
+            result = handleCreateTable(static_cast<CreateTableStatement*>(stmt));
             break;
         case StatementType::INSERT:
-            result = handleInsert(static_cast<InsertStatement*>(stmt.get()));
+            result = handleInsert(static_cast<InsertStatement*>(stmt));
             break;
-        case StatementType::SELECT:
-            result = handleSelect(static_cast<SelectStatement*>(stmt.get()));
+        case StatementType::CREATE_INDEX:
+            result = handleCreateIndex(static_cast<CreateIndexStatement*>(stmt));
+            break;
+        case StatementType::ANALYZE:
+            result = handleAnalyze(static_cast<AnalyzeStatement*>(stmt));
+            break;
+        case StatementType::CREATE_VIEW:
+            result = handleCreateView(static_cast<CreateViewStatement*>(stmt));
             break;
         default:
-            result = "Error: Unknown statement type";
+            result.ok = false;
+            result.message = "Error: Unknown statement type";
+    }
+    return result;
+}
+
+QueryResult Engine::handleCreateTable(const CreateTableStatement* stmt) {
+    auto columnIndex = [&](const std::string& name) {
+        std::string wanted = Utils::toLower(name);
+        for (uint32_t i = 0; i < stmt->columns.size(); ++i) {
+            if (Utils::toLower(stmt->columns[i]) == wanted) return i;
+        }
+        return INVALID_ID;
+    };
+    
+    uint32_t primaryKey = INVALID_ID;
+    if (!stmt->primaryKey.empty()) {
+        primaryKey = columnIndex(stmt->primaryKey);
+        if (primaryKey == INVALID_ID) {
+            return errorResult("Error: Primary key column '" + stmt->primaryKey + "' does not exist");
+        }
     }
     
+    PartitionSpec partitioning;
+    if (stmt->partitionKind != PartitionKind::NONE) {
+        uint32_t column = columnIndex(stmt->partitionColumn);
+        if (column == INVALID_ID) {
+            return errorResult("Error: Partition column '" + stmt->partitionColumn + "' does not exist");
+        }
+        // Keeps every key in one partition, so upserts never move rows
+        if (primaryKey != INVALID_ID && column != primaryKey) {
+            return errorResult("Error: A table with a primary key must be partitioned by that key");
+        }
+        if (stmt->partitionCount < 1 || stmt->partitionCount > 1024) {
+            return errorResult("Error: Partition count must be between 1 and 1024");
+        }
+        if (!std::is_sorted(stmt->partitionBounds.begin(), stmt->partitionBounds.end()) ||
+            std::adjacent_find(stmt->partitionBounds.begin(), stmt->partitionBounds.end()) !=
+                stmt->partitionBounds.end()) {
+            return errorResult("Error: Range bounds must be strictly increasing");
+        }
+        partitioning.kind = stmt->partitionKind;
+        partitioning.column = column;
+        partitioning.count = stmt->partitionCount;
+        partitioning.rangeBounds = stmt->partitionBounds;
+    }
+    
+    if (!storage_.createTable(stmt->tableName, stmt->columns, partitioning, primaryKey)) {
+        return errorResult("Error: " + storage_.getLastError());
+    }
+    QueryResult result;
+    result.message = "OK";
     return result;
 }
 
-std::string Engine::handleCreateTable(const CreateTableStatement* stmt) {
-    if (storage_.createTable(stmt->tableName, stmt->columns)) {
-        return "OK";
-    } else {
-        return "Error: " + storage_.getLastError();
+QueryResult Engine::handleInsert(const InsertStatement* stmt) {
+    if (stmt->tableId == INVALID_ID) {
+        return errorResult("Error: Table '" + stmt->tableName + "' does not exist");
     }
+    std::string error = checkConflictClause(stmt);
+    if (!error.empty()) {
+        return errorResult(error);
+    }
+    
+    std::vector<std::vector<std::string>> rows(1, stmt->values);
+    if (!storage_.insertRows(stmt->tableId, rows, stmt->onConflict)) {
+        return errorResult("Error: " + storage_.getLastError());
+    }
+    QueryResult result;
+    result.message = "OK";
+    return result;
 }
 
-std::string Engine::handleInsert(const InsertStatement* stmt) {
-    if (storage_.insertRow(stmt->tableName, stmt->values)) {
-        return "OK";
-    } else {
-        return "Error: " + storage_.getLastError();
+std::string Engine::checkConflictClause(const InsertStatement* stmt) const {
+    if (stmt->onConflict == ConflictAction::ABORT) {
+        return "";
+    }
+    uint32_t primaryKey = storage_.catalog().table(stmt->tableId).primaryKey;
+    if (primaryKey == INVALID_ID) {
+        return "Error: ON CONFLICT requires a table with a primary key";
     }
+    if (!stmt->conflictColumn.empty() &&
+        storage_.catalog().findColumn(stmt->tableId, stmt->conflictColumn) != primaryKey) {
+        return "Error: ON CONFLICT column '" + stmt->conflictColumn + "' is not the primary key";
+    }
+    return "";
 }
 
-std::string Engine::handleSelect(const SelectStatement* stmt) {
-    const Table* table = storage_.getTable(stmt->tableName);
+std::vector<QueryResult> Engine::executeInsertBatch(const std::vector<InsertStatement*>& batch) {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    std::vector<QueryResult> results(batch.size());
+    if (readOnly_) {
+        for (size_t i = 0; i < batch.size(); ++i) {
+            results[i] = executeWrite(*batch[i]);
+        }
+        return results;
+    }
     
-    if (!table) {
-        return "Error: Table '" + stmt->tableName + "' does not exist";
+    std::vector<std::vector<std::string>> rows;
+    rows.reserve(batch.size());
+    for (InsertStatement* stmt : batch) {
+        Parser::bind(*stmt, storage_.catalog());
+        rows.push_back(stmt->values);
     }
     
-    std::vector<size_t> matchingRows;
+    // Every statement targets the same table
+    const InsertStatement* first = batch.front();
+    std::unique_lock<std::mutex> tableLock;
+    if (first->tableId != INVALID_ID) {
+        tableLock = std::unique_lock<std::mutex>(storage_.writeLock(first->tableId));
+    }
     
-    if (stmt->hasWhere) {
-        // Find column index
-        auto it = std::find(table->columns.begin(), table->columns.end(), stmt->whereColumn);
-        if (it == table->columns.end()) {
-            return "Error: Column '" + stmt->whereColumn + "' does not exist";
+    // One storage write for the whole batch when every row would succeed
+    if (first->tableId != INVALID_ID && checkConflictClause(first).empty() &&
+        storage_.validateRows(first->tableId, rows, first->onConflict)) {
+        bool ok = storage_.insertRows(first->tableId, rows, first->onConflict);
+        for (QueryResult& result : results) {
+            result = ok ? QueryResult() : errorResult("Error: " + storage_.getLastError());
+            result.message = ok ? "OK" : result.message;
         }
-        size_t columnIndex = std::distance(table->columns.begin(), it);
-        
-        // Filter rows
-        for (size_t i = 0; i < table->rows.size(); ++i) {
-            if (table->rows[i].values[columnIndex] == stmt->whereValue) {
-                matchingRows.push_back(i);
+        return results;
+    }
+    
+    // Otherwise run them one by one so each statement reports its own outcome
+    for (size_t i = 0; i < batch.size(); ++i) {
+        results[i] = handleInsert(batch[i]);
+    }
+    return results;
+}
+
+QueryResult Engine::handleSelect(SelectStatement* stmt, const StorageSnapshot& snapshot,
+                                 std::shared_ptr<MemoryTracker> memory, QueryControl& control) {
+    // CTEs and subqueries run first; the CTEs become tables of scope
+    StorageSnapshot scope;
+    if (stmt->hasSubqueries()) {
+        scope = snapshot;
+        std::vector<std::string> notes;
+        std::string error;
+        if (!resolveSubqueries(*stmt, scope, memory, control, notes, error)) {
+            return errorResult(error);
+        }
+    }
+    const StorageSnapshot& source = stmt->hasSubqueries() ? scope : snapshot;
+    
+    Planner planner(source);
+    Plan plan;
+    if (!planner.plan(*stmt, plan)) {
+        return errorResult("Error: " + planner.getError());
+    }
+    PlanStats stats;
+    return executePlan(plan, source, memory, control, stats);
+}
+
+bool Engine::resolveSubqueries(SelectStatement& stmt, StorageSnapshot& scope, std::shared_ptr<MemoryTracker> memory,
+                               QueryControl& control, std::vector<std::string>& notes, std::string& error) {
+    // Each CTE runs once and is stored as a table of a query-local catalog,
+    // so every reference to it scans the stored rows instead of re-running
+    // the query. A CTE hides a table of the same name.
+    for (CommonTableExpr& cte : stmt.with) {
+        Parser::bind(*cte.select, *scope.catalog);
+        QueryResult result = handleSelect(cte.select.get(), scope, memory, control);
+        if (!result.ok) {
+            error = result.message;
+            return false;
+        }
+        std::vector<std::string> columns = cte.columns.empty() ? result.columns : cte.columns;
+        if (columns.size() != result.columns.size()) {
+            error = "Error: WITH " + cte.name + " names " + std::to_string(columns.size()) +
+                    " columns but its query returns " + std::to_string(result.columns.size());
+            return false;
+        }
+        std::set<std::string> names;
+        for (const std::string& column : columns) {
+            if (!names.insert(Utils::toLower(column)).second) {
+                error = "Error: WITH " + cte.name + " has two columns named '" + column +
+                        "'; name them with WITH " + cte.name + " (column, ...)";
+                return false;
             }
         }
-    } else {
-        // All rows
-        for (size_t i = 0; i < table->rows.size(); ++i) {
-            matchingRows.push_back(i);
+        
+        auto table = std::make_shared<TableSnapshot>();
+        table->columns = columns;
+        table->partitions.resize(1);
+        table->indexLock = std::make_shared<std::shared_mutex>();
+        size_t bytes = 0;
+        bool ok = result.rows.forEach([&](const Row& row) {
+            Row stored = row;
+            stored.classify();
+            bytes += RowBuffer::estimateSize(stored);
+            if (memory && !memory->reserve("cte", RowBuffer::estimateSize(stored))) {
+                return false;
+            }
+            table->partitions[0].push_back(static_cast<uint32_t>(table->rows.size()));
+            table->rows.push_back(std::move(stored));
+            return true;
+        });
+        if (!ok) {
+            error = result.rows.getError().empty()
+                        ? "Error: WITH " + cte.name + " of more than " + std::to_string(bytes) +
+                              " bytes exceeds the memory limit of " + std::to_string(memory->limit()) + " bytes"
+                        : "Error: " + result.rows.getError();
+            return false;
         }
+        
+        auto catalog = std::make_shared<Catalog>(*scope.catalog);
+        TableId id = catalog->addTable(cte.name, columns);
+        scope.tables.resize(std::max<size_t>(scope.tables.size(), id + 1));
+        scope.tables[id] = table;
+        scope.catalog = catalog;
+        notes.push_back("CTE " + cte.name + ": materialized once, " + std::to_string(table->rows.size()) + " rows");
     }
+    Parser::bind(stmt, *scope.catalog);
     
-    return formatSelectResult(table, matchingRows);
+    // Subqueries are uncorrelated, so each runs once before the scan: an IN
+    // list becomes a hash set, a scalar becomes the literal it is compared with
+    for (Condition& condition : stmt.where) {
+        if (!condition.subquery) {
+            continue;
+        }
+        QueryResult result = handleSelect(condition.subquery.get(), scope, memory, control);
+        if (!result.ok) {
+            error = result.message;
+            return false;
+        }
+        if (result.columns.size() != 1) {
+            error = "Error: The subquery compared with '" + condition.column + "' must return one column";
+            return false;
+        }
+        if (condition.op == CompareOp::IN) {
+            auto members = std::make_shared<std::unordered_set<std::string>>();
+            std::string key;
+            size_t bytes = 0;
+            result.rows.forEach([&](const Row& row) {
+                if (equalityKey(Cell::classify(row.values[0]), row.values[0], key) && members->insert(key).second) {
+                    bytes += key.size() + sizeof(std::string) + sizeof(void*);
+                }
+                return true;
+            });
+            if (memory && !memory->reserve("subquery", bytes)) {
+                error = "Error: IN list of " + std::to_string(bytes) + " bytes exceeds the memory limit of " +
+                        std::to_string(memory->limit()) + " bytes";
+                return false;
+            }
+            condition.members = members;
+            notes.push_back("SubPlan: " + condition.column + " IN (...) ran once, " +
+                            std::to_string(members->size()) + " distinct values");
+            continue;
+        }
+        if (result.rows.size() > 1) {
+            error = "Error: The scalar subquery compared with '" + condition.column + "' returned " +
+                    std::to_string(result.rows.size()) + " rows";
+            return false;
+        }
+        condition.value = Value::null();  // no row compares as NULL
+        result.rows.forEach([&](const Row& row) {
+            condition.value.text = row.values[0];
+            condition.value.cell = Cell::classify(row.values[0]);
+            return true;
+        });
+        notes.push_back("SubPlan: " + condition.column + " compared with (...) ran once, = " +
+                        condition.value.toSql());
+    }
+    return true;
 }
 
-std::string Engine::formatSelectResult(const Table* table, const std::vector<size_t>& rowIndices) {
-    std::ostringstream oss;
+QueryResult Engine::executePlan(const Plan& plan, const StorageSnapshot& snapshot,
+                                std::shared_ptr<MemoryTracker> memory, QueryControl& control, PlanStats& stats) {
+    if (plan.access == AccessPath::HASH_JOIN) {
+        return executeJoin(plan, snapshot, memory, control, stats);
+    }
+    const TableSnapshot* table = snapshot.table(plan.table);
+    
+    QueryResult result;
+    result.hasRows = true;
+    result.message = "OK";
+    result.rows.setTracker(memory, "scan");
+    result.columns = plan.columnNames(*snapshot.catalog);
     
-    if (table->columns.empty()) {
-        return "Empty table";
+    // Filter (most selective predicate first) and project in a single pass;
+    // only the projected columns are ever copied. With window functions the
+    // matching rows are only collected and projected after evaluation; with
+    // GROUP BY they are folded into their group and not kept at all. The
+    // deadline is polled every CHECK_INTERVAL rows visited.
+    std::vector<const Row*> matches;
+    std::unique_ptr<GroupAggregate> grouping;
+    if (plan.grouped()) {
+        grouping.reset(new GroupAggregate(plan.groupBy, plan.aggregates, plan.layout));
     }
+    auto visit = [&](const Row& row) {
+        if (++stats.scanned % QueryControl::CHECK_INTERVAL == 0 && control.expired()) {
+            return false;
+        }
+        if (!passesFilters(plan, row)) {
+            ++stats.removedByFilter;
+            return true;
+        }
+        ++stats.matched;
+        if (grouping) {
+            return grouping->add(row);
+        }
+        if (!plan.windows.empty()) {
+            matches.push_back(&row);
+            return true;
+        }
+        Row projected;
+        projected.values.reserve(plan.projection.size());
+        projected.cells.reserve(plan.projection.size());
+        for (uint32_t columnIndex : plan.projection) {
+            projected.values.push_back(row.values[columnIndex]);
+            projected.cells.push_back(row.cells[columnIndex]);
+        }
+        return result.rows.append(std::move(projected));
+    };
     
-    // Calculate column widths
-    std::vector<size_t> widths(table->columns.size());
-    for (size_t i = 0; i < table->columns.size(); ++i) {
-        widths[i] = table->columns[i].length();
+    bool ok = true;
+    if (plan.access == AccessPath::VIEW_SCAN) {
+        // The view's groups are already aggregated; only filter and project
+        std::vector<Row> groups;
+        std::string error;
+        if (!snapshot.view(plan.view)->read(groups, error)) {
+            return errorResult("Error: " + error);
+        }
+        for (const Row& row : groups) {
+            if (!(ok = visit(row))) break;
+        }
+    } else {
+        ok = scanTable(plan, *table, visit);
+    }
+    if (!ok && control.expired()) {
+        return errorResult("Error: " + control.reason());
+    }
+    if (!ok) {
+        return errorResult("Error: " + (grouping ? grouping->getError() : result.rows.getError()));
+    }
+    if (grouping) {
+        for (Row& row : grouping->results()) {
+            if (!result.rows.append(std::move(row))) {
+                return errorResult("Error: " + result.rows.getError());
+            }
+        }
+        stats.rows = result.rows.size();
+        return result;
+    }
+    if (plan.windows.empty()) {
+        stats.rows = stats.matched;
+        return result;
     }
     
-    for (size_t rowIdx : rowIndices) {
-        const Row& row = table->rows[rowIdx];
-        for (size_t i = 0; i < row.values.size() && i < widths.size(); ++i) {
-            widths[i] = std::max(widths[i], row.values[i].length());
+    WindowOperator windows(plan.windows);
+    std::vector<std::vector<std::string>> values;
+    std::vector<uint32_t> order;
+    if (!windows.evaluate(matches, values, order, control)) {
+        return errorResult("Error: " + windows.getError());
+    }
+    for (uint32_t i : order) {
+        Row projected;
+        projected.values.reserve(result.columns.size());
+        projected.cells.reserve(result.columns.size());
+        size_t column = 0;
+        size_t call = 0;
+        while (projected.values.size() < result.columns.size()) {
+            if (call < plan.windows.size() && plan.windows[call].position == projected.values.size()) {
+                // Window results are computed text, typed once here
+                projected.cells.push_back(Cell::classify(values[call][i]));
+                projected.values.push_back(std::move(values[call++][i]));
+            } else {
+                projected.values.push_back(matches[i]->values[plan.projection[column]]);
+                projected.cells.push_back(matches[i]->cells[plan.projection[column++]]);
+            }
+        }
+        if (!result.rows.append(std::move(projected))) {
+            return errorResult("Error: " + result.rows.getError());
         }
     }
+    stats.rows = order.size();
+    
+    return result;
+}
+
+QueryResult Engine::executeJoin(const Plan& plan, const StorageSnapshot& snapshot,
+                                std::shared_ptr<MemoryTracker> memory, QueryControl& control, PlanStats& stats) {
+    QueryResult result;
+    result.hasRows = true;
+    result.message = "OK";
+    result.rows.setTracker(memory, "scan");
+    result.columns = plan.columnNames(*snapshot.catalog);
+    
+    size_t buildSide = plan.buildSide;
+    size_t probeSide = 1 - buildSide;
+    const Plan& build = plan.inputs[buildSide];
+    const Plan& probe = plan.inputs[probeSide];
+    stats.inputs.assign(2, PlanStats());
+    PlanStats& buildStats = stats.inputs[buildSide];
+    PlanStats& probeStats = stats.inputs[probeSide];
+    HashJoin join(plan.joinKeys[buildSide], plan.joinKeys[probeSide], memory);
     
-    // Print header
-    for (size_t i = 0; i < table->columns.size(); ++i) {
-        if (i > 0) oss << " | ";
-        oss << std::left << std::setw(widths[i]) << table->columns[i];
+    // Build: the filtered rows of the smaller input are hashed on their key
+    bool ok = scanTable(build, *snapshot.table(build.table), [&](const Row& row) {
+        if (++buildStats.scanned % QueryControl::CHECK_INTERVAL == 0 && control.expired()) {
+            return false;
+        }
+        if (!passesFilters(build, row)) {
+            ++buildStats.removedByFilter;
+            return true;
+        }
+        ++buildStats.matched;
+        return join.build(row);
+    });
+    if (!ok) {
+        return errorResult("Error: " + (control.expired() ? control.reason() : join.getError()));
     }
-    oss << "\n";
+    join.finishBuild();
+    buildStats.rows = buildStats.matched;
     
-    // Print separator
-    for (size_t i = 0; i < table->columns.size(); ++i) {
-        if (i > 0) oss << "-+-";
-        oss << std::string(widths[i], '-');
+    // Probe: the Bloom filter runs inside the scan, right after the pushed-down
+    // conditions, so rows without a partner are dropped before the hash lookup
+    // and before anything is copied. An empty build side skips the scan.
+    size_t leftWidth = snapshot.table(plan.inputs[0].table)->columns.size();
+    const Row* sides[2] = {nullptr, nullptr};
+    if (join.buildRows() > 0) {
+        ok = scanTable(probe, *snapshot.table(probe.table), [&](const Row& row) {
+            if (++probeStats.scanned % QueryControl::CHECK_INTERVAL == 0 && control.expired()) {
+                return false;
+            }
+            if (!passesFilters(probe, row)) {
+                ++probeStats.removedByFilter;
+                return true;
+            }
+            bool bloomRejected;
+            const std::vector<const Row*>* partners = join.probe(row, bloomRejected);
+            if (bloomRejected) {
+                ++probeStats.removedByBloom;
+                return true;
+            }
+            ++probeStats.matched;
+            if (!partners) {
+                return true;
+            }
+            sides[probeSide] = &row;
+            for (const Row* partner : *partners) {
+                sides[buildSide] = partner;
+                Row projected;
+                projected.values.reserve(plan.projection.size());
+                projected.cells.reserve(plan.projection.size());
+                for (uint32_t column : plan.projection) {
+                    const Row& side = *sides[column < leftWidth ? 0 : 1];
+                    uint32_t index = column < leftWidth ? column : column - leftWidth;
+                    projected.values.push_back(side.values[index]);
+                    projected.cells.push_back(side.cells[index]);
+                }
+                if (!result.rows.append(std::move(projected))) {
+                    return false;
+                }
+                ++stats.rows;
+            }
+            return true;
+        });
+    }
+    probeStats.rows = probeStats.matched;
+    if (!ok) {
+        return errorResult("Error: " + (control.expired() ? control.reason() : result.rows.getError()));
+    }
+    return result;
+}
+
+QueryResult Engine::handleCreateIndex(const CreateIndexStatement* stmt) {
+    if (stmt->tableId == INVALID_ID) {
+        return errorResult("Error: Table '" + stmt->tableName + "' does not exist");
+    }
+    if (stmt->columnId == INVALID_ID) {
+        return errorResult("Error: Column '" + stmt->column + "' does not exist");
+    }
+    if (stmt->method != "trigram") {
+        return errorResult("Error: Unknown index method '" + stmt->method + "' (supported: trigram)");
+    }
+    if (!storage_.createIndex(stmt->tableId, stmt->indexName, stmt->columnId, IndexKind::TRIGRAM)) {
+        return errorResult("Error: " + storage_.getLastError());
+    }
+    QueryResult result;
+    result.message = "OK";
+    return result;
+}
+
+QueryResult Engine::handleCreateView(const CreateViewStatement* stmt) {
+    const SelectStatement& select = *stmt->select;
+    if (select.tableId == INVALID_ID) {
+        return errorResult("Error: Table '" + select.tableName + "' does not exist");
+    }
+    if (!select.windows.empty()) {
+        return errorResult("Error: A materialized view cannot use window functions");
+    }
+    if (select.joined()) {
+        return errorResult("Error: A materialized view cannot use JOIN");
+    }
+    if (select.hasSubqueries()) {
+        return errorResult("Error: A materialized view cannot use WITH or subqueries");
+    }
+    // Storage plans the canonical text, so what runs now is what reloads
+    if (!storage_.createView(stmt->viewName, MaterializedView::definitionSql(select))) {
+        return errorResult("Error: " + storage_.getLastError());
+    }
+    QueryResult result;
+    result.message = "OK";
+    return result;
+}
+
+QueryResult Engine::handleAnalyze(const AnalyzeStatement* stmt) {
+    if (stmt->tableId == INVALID_ID) {
+        return errorResult("Error: Table '" + stmt->tableName + "' does not exist");
+    }
+    if (!storage_.analyzeTable(stmt->tableId)) {
+        return errorResult("Error: " + storage_.getLastError());
+    }
+    QueryResult result;
+    result.message = "OK";
+    return result;
+}
+
+QueryResult Engine::handleExport(const ExportStatement* stmt, const StorageSnapshot& snapshot,
+                                 QueryControl& control) {
+    const TableSnapshot* table = snapshot.table(stmt->tableId);
+    if (!table) {
+        return errorResult("Error: Table '" + stmt->tableName + "' does not exist");
+    }
+    std::string path;
+    if (!storage_.exportPath(stmt->file, path)) {
+        return errorResult("Error: " + storage_.getLastError());
+    }
+    if (table->access) {
+        table->access->touch();
+        table->access->scans.fetch_add(1, std::memory_order_relaxed);
+    }
+    size_t rowGroups = 0;
+    std::string error;
+    if (!ParquetFile::write(path, *table, control, rowGroups, error)) {
+        return errorResult("Error: " + error);
+    }
+    QueryResult result;
+    result.message = "OK";
+    return result;
+}
+
+QueryResult Engine::handleShowTables(const StorageSnapshot& snapshot) {
+    QueryResult result;
+    result.hasRows = true;
+    result.columns = {"table", "state", "rows", "bytes", "scans", "lookups", "rows_written", "reloads",
+                      "idle_ms"};
+    for (TableId id = 0; id < snapshot.tables.size(); ++id) {
+        const TableSnapshot* table = snapshot.table(id);
+        if (!table || !table->access) {
+            continue;
+        }
+        const TableAccess& access = *table->access;
+        Row row;
+        row.values = {
+            snapshot.catalog->tableName(id),
+            table->evicted ? "cold" : "hot",
+            std::to_string(table->evicted ? table->evictedRows : table->rows.size()),
+            std::to_string(table->bytes),
+            std::to_string(access.scans.load(std::memory_order_relaxed)),
+            std::to_string(access.lookups.load(std::memory_order_relaxed)),
+            std::to_string(access.rowsWritten.load(std::memory_order_relaxed)),
+            std::to_string(access.reloads.load(std::memory_order_relaxed)),
+            std::to_string(access.idleMs()),
+        };
+        row.classify();
+        result.rows.append(std::move(row));
+    }
+    return result;
+}
+
+QueryResult Engine::handleImport(ImportStatement* stmt) {
+    if (readOnly_) {
+        return errorResult("Error: This server is a read-only replica");
+    }
+    std::string path;
+    if (!storage_.exportPath(stmt->file, path)) {
+        return errorResult("Error: " + storage_.getLastError());
+    }
+    // Decoded before taking the engine lock, so writers only wait for the insert
+    std::vector<std::string> columns;
+    std::vector<std::vector<std::string>> rows;
+    std::string error;
+    if (!ParquetFile::read(path, columns, rows, error)) {
+        return errorResult("Error: " + error);
     }
-    oss << "\n";
     
-    // Print rows
-    for (size_t rowIdx : rowIndices) {
-        const Row& row = table->rows[rowIdx];
-        for (size_t i = 0; i < row.values.size(); ++i) {
-            if (i > 0) oss << " | ";
-            oss << std::left << std::setw(widths[i]) << row.values[i];
+    // Exclusive, since the table may have to be created first
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    Parser::bind(*stmt, storage_.catalog());
+    if (stmt->tableId == INVALID_ID) {
+        if (!storage_.createTable(stmt->tableName, columns)) {
+            return errorResult("Error: " + storage_.getLastError());
         }
-        oss << "\n";
+        stmt->tableId = storage_.catalog().findTable(stmt->tableName);
+    } else if (storage_.catalog().table(stmt->tableId).columns.size() != columns.size()) {
+        return errorResult("Error: '" + stmt->file + "' has " + std::to_string(columns.size()) +
+                           " columns, table '" + stmt->tableName + "' has " +
+                           std::to_string(storage_.catalog().table(stmt->tableId).columns.size()));
+    }
+    // One insert: the whole file goes in, or nothing does
+    if (!rows.empty() && !storage_.insertRows(stmt->tableId, rows)) {
+        return errorResult("Error: " + storage_.getLastError());
+    }
+    QueryResult result;
+    result.message = "OK";
+    return result;
+}
+
+QueryResult Engine::handleExplain(ExplainStatement* stmt, const StorageSnapshot& snapshot,
+                                  std::shared_ptr<MemoryTracker> memory, QueryControl& control) {
+    // A plan depends on the values of the subqueries, so even plain EXPLAIN runs them
+    StorageSnapshot scope;
+    std::vector<std::string> notes;
+    if (stmt->select->hasSubqueries()) {
+        scope = snapshot;
+        std::string error;
+        if (!resolveSubqueries(*stmt->select, scope, memory, control, notes, error)) {
+            return errorResult(error);
+        }
+    }
+    const StorageSnapshot& source = stmt->select->hasSubqueries() ? scope : snapshot;
+    
+    Planner planner(source);
+    Plan plan;
+    if (!planner.plan(*stmt->select, plan)) {
+        return errorResult("Error: " + planner.getError());
     }
     
-    oss << "\n(" << rowIndices.size() << " row(s) returned)";
+    // EXPLAIN ANALYZE runs the query and discards its rows
+    PlanStats stats;
+    double elapsedMs = 0;
+    if (stmt->analyze) {
+        auto start = std::chrono::steady_clock::now();
+        QueryResult run = executePlan(plan, source, memory, control, stats);
+        if (!run.ok) {
+            return run;
+        }
+        elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
     
-    return oss.str();
+    QueryResult result;
+    result.hasRows = true;
+    result.message = "OK";
+    result.columns.push_back("QUERY PLAN");
+    std::string text = plan.explain(*source.catalog, stmt->analyze ? &stats : nullptr);
+    for (const std::string& note : notes) {
+        text += "\n" + note;
+    }
+    if (stmt->analyze) {
+        std::ostringstream time;
+        time << std::fixed << std::setprecision(3) << elapsedMs;
+        text += "\nExecution Time: " + time.str() + " ms";
+    }
+    std::istringstream lines(text);
+    std::string line;
+    while (std::getline(lines, line)) {
+        Row row;
+        row.values.push_back(line);
+        row.classify();
+        result.rows.append(std::move(row));
+    }
+    return result;
+}
+
+std::string Engine::formatSelectResult(const QueryResult& result) {
+    std::string output;
+    std::string error;
+    if (!ResultEncoder::encode(result, ResultFormat::TABLE, output, error)) {
+        return "Error: " + error;
+    }
+    return output;
 }
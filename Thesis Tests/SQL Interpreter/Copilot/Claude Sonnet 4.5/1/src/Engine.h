@@ -3,29 +3,121 @@
 
 #include <string>
 #include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <functional>
+#include <thread>
+#include <condition_variable>
 #include "Storage.h"
 #include "Parser.h"
+#include "RowBuffer.h"
+#include "MemoryTracker.h"
+#include "QueryControl.h"
+#include "Planner.h"
+
+// Structured outcome of a single statement (used by text and binary front-ends)
+struct QueryResult {
+    bool ok = true;
+    bool hasRows = false;                 // true for SELECT results
+    std::string message;                  // "OK" or error text
+    std::vector<std::string> columns;
+    RowBuffer rows;                       // may be spilled to disk
+    std::shared_ptr<MemoryTracker> memory; // accounting for this query
+};
 
 class Engine {
 public:
-    Engine();
+    explicit Engine(const std::string& dataDir = "data");
+    ~Engine();
     void repl();                                    // interactive mode
     void executeScript(const std::string& filename); // execute from file
-    std::string executeStatementWeb(const std::string& sql); // execute for web interface
+    // Without a control, queries get one with the default timeout
+    std::string executeStatementWeb(const std::string& sql,        // execute for web interface
+                                    std::shared_ptr<QueryControl> control = nullptr);
+    QueryResult executeQuery(const std::string& sql,               // execute for binary protocol
+                             std::shared_ptr<QueryControl> control = nullptr);
+    double estimateCost(const std::string& sql);  // planner cost of a SELECT, 0 for anything else
+    
+    void setMemoryLimit(size_t bytes) { memoryLimit_ = bytes; } // per-query budget, 0 = unlimited
+    void setQueryTimeout(uint32_t ms) { queryTimeoutMs_ = ms; } // default deadline, 0 = none
+    uint32_t queryTimeout() const { return queryTimeoutMs_; }
+    std::string memoryReport() const;
+    // Hot/cold tiering: a background sweep evicts tables idle for this long
+    // to their files, and the next statement using one reloads it. 0 = never.
+    void setEvictAfter(uint32_t seconds);
+    
+    // Log shipping (see Replication.h); both callbacks run under the engine lock
+    // in exclusive mode, so no statement is in flight
+    void setReadOnly(bool readOnly) { readOnly_ = readOnly; }  // replicas reject writes
+    void setChangeListener(ChangeListener* listener);
+    void withStorage(const std::function<void(const Storage&)>& fn);
+    bool updateStorage(const std::function<bool(Storage&)>& fn);
 
 private:
     Storage storage_;
+    // Exclusive for DDL and IMPORT; INSERT and ANALYZE hold it shared plus the
+    // table's write lock, as do eviction and the reload of an evicted table.
+    // SELECT, EXPLAIN and EXPORT take neither and read a published snapshot.
+    std::shared_mutex mutex_;
+    size_t memoryLimit_ = 0;
+    uint32_t queryTimeoutMs_ = 0;
+    bool readOnly_ = false;
+    mutable std::mutex reportMutex_;
+    std::string lastMemoryReport_;
+    uint32_t evictAfterSec_ = 0;
+    std::thread evictionThread_;
+    std::mutex evictionMutex_;
+    std::condition_variable evictionWake_;
+    bool stopping_ = false;
     
     void executeStatement(const std::string& sql);
-    std::string executeStatementInternal(const std::string& sql, bool returnOutput);
+    std::string executeStatementInternal(const std::string& sql, bool returnOutput,
+                                         std::shared_ptr<QueryControl> control);
+    // Console (returnOutput false): errors go to stderr and "" is returned
+    std::string renderResult(QueryResult& result, bool returnOutput);
+    void printResult(QueryResult& result);
+    
+    QueryResult executeParsed(Statement& stmt);  // binds, then executes
+    // Reads run on the snapshot stmt was bound against; writes take their
+    // locks and bind again against the live catalog
+    QueryResult execute(Statement& stmt, const StorageSnapshot& snapshot,
+                        std::shared_ptr<QueryControl> control = nullptr);
+    QueryResult executeWrite(Statement& stmt);   // caller holds mutex_ (shared or exclusive as needed)
+    void recordMemoryReport(const std::string& report);
+    std::vector<QueryResult> executeInsertBatch(const std::vector<InsertStatement*>& batch);
+    std::string checkConflictClause(const InsertStatement* stmt) const;
+    void evictionLoop();
+    // Loads the evicted tables a read statement uses; reloaded tells whether
+    // there were any, so the caller needs a newer snapshot
+    bool reloadEvicted(const Statement& stmt, const StorageSnapshot& snapshot, bool& reloaded,
+                       std::string& error);
     
     // Execution handlers
-    std::string handleCreateTable(const CreateTableStatement* stmt);
-    std::string handleInsert(const InsertStatement* stmt);
-    std::string handleSelect(const SelectStatement* stmt);
+    QueryResult handleCreateTable(const CreateTableStatement* stmt);
+    QueryResult handleInsert(const InsertStatement* stmt);
+    QueryResult handleSelect(SelectStatement* stmt, const StorageSnapshot& snapshot,
+                             std::shared_ptr<MemoryTracker> memory, QueryControl& control);
+    QueryResult handleAnalyze(const AnalyzeStatement* stmt);
+    QueryResult handleCreateIndex(const CreateIndexStatement* stmt);
+    QueryResult handleCreateView(const CreateViewStatement* stmt);
+    QueryResult handleExport(const ExportStatement* stmt, const StorageSnapshot& snapshot, QueryControl& control);
+    QueryResult handleImport(ImportStatement* stmt);
+    QueryResult handleShowTables(const StorageSnapshot& snapshot);
+    QueryResult handleExplain(ExplainStatement* stmt, const StorageSnapshot& snapshot,
+                              std::shared_ptr<MemoryTracker> memory, QueryControl& control);
+    // Run a planned SELECT, counting rows into stats for EXPLAIN ANALYZE
+    QueryResult executePlan(const Plan& plan, const StorageSnapshot& snapshot,
+                            std::shared_ptr<MemoryTracker> memory, QueryControl& control, PlanStats& stats);
+    // Materializes stmt's CTEs into scope (a copy of the snapshot with its own
+    // catalog), binds stmt against it and evaluates each subquery once.
+    // notes describe what ran, for EXPLAIN; error is a complete message.
+    bool resolveSubqueries(SelectStatement& stmt, StorageSnapshot& scope, std::shared_ptr<MemoryTracker> memory,
+                           QueryControl& control, std::vector<std::string>& notes, std::string& error);
+    QueryResult executeJoin(const Plan& plan, const StorageSnapshot& snapshot,
+                            std::shared_ptr<MemoryTracker> memory, QueryControl& control, PlanStats& stats);
     
     // Helper methods
-    std::string formatSelectResult(const Table* table, const std::vector<size_t>& rowIndices);
+    std::string formatSelectResult(const QueryResult& result);
 };
 
 #endif // ENGINE_H
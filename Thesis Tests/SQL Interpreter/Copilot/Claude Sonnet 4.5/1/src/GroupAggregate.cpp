@@ -0,0 +1,143 @@
+#include "GroupAggregate.h"
+#include <algorithm>
+
+GroupAggregate::GroupAggregate(const std::vector<uint32_t>& groupBy, const std::vector<WindowCall>& aggregates,
+                               const std::vector<uint32_t>& layout)
+    : groupBy_(groupBy), aggregates_(aggregates), layout_(layout) {}
+
+void GroupAggregate::clear() {
+    groups_.clear();
+    groupIndex_.clear();
+    error_.clear();
+}
+
+GroupAggregate::Group& GroupAggregate::groupFor(const Row& row) {
+    // Values are grouped by the key WHERE '=' and joins use, so 1 and 1.0 share
+    // a group. Length-prefixed, so ("a,b") and ("a", "b") never collide; all
+    // NULLs form one group
+    encoded_.clear();
+    for (uint32_t column : groupBy_) {
+        if (!equalityKey(row.cells[column], row.values[column], columnKey_)) {
+            encoded_ += 'N';
+            continue;
+        }
+        encoded_ += std::to_string(columnKey_.size());
+        encoded_ += ':';
+        encoded_ += columnKey_;
+    }
+    auto found = groupIndex_.find(encoded_);
+    if (found != groupIndex_.end()) {
+        return groups_[found->second];
+    }
+    
+    Group group;
+    for (uint32_t column : groupBy_) {
+        group.key.push_back(row.values[column]);
+        group.keyCells.push_back(row.cells[column]);
+    }
+    group.accumulators.resize(aggregates_.size());
+    groupIndex_.emplace(encoded_, groups_.size());
+    groups_.push_back(std::move(group));
+    return groups_.back();
+}
+
+bool GroupAggregate::add(const Row& row) {
+    if (failed()) {
+        return false;
+    }
+    Group& group = groupFor(row);
+    for (size_t a = 0; a < aggregates_.size(); ++a) {
+        if (!fold(group.accumulators[a], aggregates_[a], row)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool GroupAggregate::fold(Accumulator& acc, const WindowCall& call, const Row& row) {
+    ++acc.rows;
+    if (call.argumentId == INVALID_ID) {
+        return true;  // COUNT(*)
+    }
+    const Cell& cell = row.cells[call.argumentId];
+    const std::string& text = row.values[call.argumentId];
+    if (cell.type == ValueType::NULL_VALUE) {
+        return true;
+    }
+    ++acc.count;
+    if (call.function == WindowFunction::SUM || call.function == WindowFunction::AVG) {
+        if (!cell.isNumber()) {
+            error_ = "Cannot aggregate non-numeric value '" + text + "' in " + call.alias;
+            return false;
+        }
+        acc.sum += cell.type == ValueType::INT64 ? static_cast<double>(cell.integer) : cell.real;
+        if (acc.integral && (cell.type != ValueType::INT64 ||
+                             __builtin_add_overflow(acc.integerSum, cell.integer, &acc.integerSum))) {
+            acc.integral = false;
+        }
+    } else if (call.function == WindowFunction::MIN || call.function == WindowFunction::MAX) {
+        int order = acc.hasBest ? compareCells(cell, text, acc.bestCell, acc.best) : 0;
+        if (!acc.hasBest || (call.function == WindowFunction::MIN ? order < 0 : order > 0)) {
+            acc.hasBest = true;
+            acc.bestCell = cell;
+            acc.best = text;
+        }
+    }
+    return true;
+}
+
+std::string GroupAggregate::finish(const Accumulator& acc, const WindowCall& call) const {
+    switch (call.function) {
+        case WindowFunction::COUNT:
+            return std::to_string(call.argumentId == INVALID_ID ? acc.rows : acc.count);
+        case WindowFunction::SUM:
+            if (acc.count == 0) return NULL_TEXT;
+            return acc.integral ? std::to_string(acc.integerSum) : formatDouble(acc.sum);
+        case WindowFunction::AVG:
+            return acc.count == 0 ? NULL_TEXT : formatDouble(acc.sum / acc.count);
+        case WindowFunction::MIN:
+        case WindowFunction::MAX:
+            return acc.hasBest ? acc.best : NULL_TEXT;
+        default:
+            return NULL_TEXT;
+    }
+}
+
+std::vector<Row> GroupAggregate::results() const {
+    std::vector<const Group*> ordered;
+    ordered.reserve(groups_.size());
+    for (const Group& group : groups_) {
+        ordered.push_back(&group);
+    }
+    std::sort(ordered.begin(), ordered.end(), [](const Group* a, const Group* b) {
+        for (size_t k = 0; k < a->key.size(); ++k) {
+            int c = compareCells(a->keyCells[k], a->key[k], b->keyCells[k], b->key[k]);
+            if (c != 0) return c < 0;
+        }
+        return false;
+    });
+    
+    Group empty;
+    empty.accumulators.resize(aggregates_.size());
+    if (groupBy_.empty() && ordered.empty()) {
+        ordered.push_back(&empty);
+    }
+    
+    std::vector<Row> rows;
+    rows.reserve(ordered.size());
+    for (const Group* group : ordered) {
+        Row row;
+        row.values.reserve(layout_.size());
+        for (uint32_t item : layout_) {
+            if (item < groupBy_.size()) {
+                row.values.push_back(group->key[item]);
+            } else {
+                size_t a = item - groupBy_.size();
+                row.values.push_back(finish(group->accumulators[a], aggregates_[a]));
+            }
+        }
+        row.classify();
+        rows.push_back(std::move(row));
+    }
+    return rows;
+}
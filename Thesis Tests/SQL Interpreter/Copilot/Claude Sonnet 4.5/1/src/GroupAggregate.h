@@ -0,0 +1,68 @@
+#ifndef GROUPAGGREGATE_H
+#define GROUPAGGREGATE_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "Ast.h"
+#include "Storage.h"
+
+// Hash aggregation for GROUP BY. Rows are folded in one at a time and only
+// the per-group running state is kept, so the same operator answers a query
+// (fed by its scan) and a materialized view (fed by every INSERT).
+//
+// Aggregates follow the window functions: NULLs are skipped, SUM stays an
+// integer while every input is INT64, and MIN/MAX compare typed cells.
+// Groups follow WHERE '=': 1 and 1.0 are one group, shown as the first
+// spelling seen. Without GROUP BY there is exactly one group, even over no rows.
+class GroupAggregate {
+public:
+    // layout[i] says what output column i is: an index into groupBy, or
+    // groupBy.size() + an index into aggregates
+    GroupAggregate(const std::vector<uint32_t>& groupBy, const std::vector<WindowCall>& aggregates,
+                   const std::vector<uint32_t>& layout);
+    
+    // False once a SUM/AVG argument is not numeric; later rows are ignored
+    bool add(const Row& row);
+    void clear();
+    
+    size_t groupCount() const { return groups_.size(); }
+    bool failed() const { return !error_.empty(); }
+    std::string getError() const { return error_; }
+    
+    // One row per group in group-key order, laid out as requested
+    std::vector<Row> results() const;
+    
+private:
+    struct Accumulator {
+        size_t rows = 0;            // COUNT(*)
+        size_t count = 0;           // non-NULL arguments
+        bool integral = true;       // every value so far was INT64, without overflow
+        int64_t integerSum = 0;
+        double sum = 0;
+        bool hasBest = false;       // MIN / MAX
+        Cell bestCell;
+        std::string best;
+    };
+    
+    struct Group {
+        std::vector<std::string> key;
+        std::vector<Cell> keyCells;
+        std::vector<Accumulator> accumulators;
+    };
+    
+    std::vector<uint32_t> groupBy_;
+    std::vector<WindowCall> aggregates_;
+    std::vector<uint32_t> layout_;
+    std::vector<Group> groups_;
+    std::unordered_map<std::string, size_t> groupIndex_;  // encoded key -> position in groups_
+    std::string encoded_;                                 // scratch for the key of the current row
+    std::string columnKey_;                               // scratch for one column of it
+    std::string error_;
+    
+    Group& groupFor(const Row& row);
+    bool fold(Accumulator& acc, const WindowCall& call, const Row& row);
+    std::string finish(const Accumulator& acc, const WindowCall& call) const;
+};
+
+#endif // GROUPAGGREGATE_H
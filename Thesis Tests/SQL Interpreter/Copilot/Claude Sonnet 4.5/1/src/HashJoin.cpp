@@ -0,0 +1,124 @@
+#include "HashJoin.h"
+#include <algorithm>
+#include <functional>
+
+namespace {
+
+// Hash table bytes per build row beyond its key: the row pointer, and for a
+// new key the node, bucket and vector headers
+const size_t ROW_ENTRY_BYTES = sizeof(const Row*);
+const size_t KEY_ENTRY_BYTES = 64;
+
+// Mixes the string hash so block and bit choices use independent bits
+uint64_t mix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+} // namespace
+
+BloomFilter::BloomFilter(size_t keys) : blocks_(blocksFor(keys)) {
+    words_.assign(blocks_ * BLOCK_WORDS, 0);
+}
+
+size_t BloomFilter::blocksFor(size_t keys) {
+    size_t bits = std::max<size_t>(keys, 1) * BITS_PER_KEY;
+    return (bits + BLOCK_WORDS * 64 - 1) / (BLOCK_WORDS * 64);
+}
+
+size_t BloomFilter::bytesFor(size_t keys) {
+    return blocksFor(keys) * BLOCK_WORDS * sizeof(uint64_t);
+}
+
+size_t BloomFilter::block(uint64_t hash) const {
+    // Multiply-shift picks the block without a division
+    return static_cast<size_t>(((hash >> 32) * blocks_) >> 32) * BLOCK_WORDS;
+}
+
+void BloomFilter::add(uint64_t hash) {
+    uint64_t* words = &words_[block(hash)];
+    uint64_t bits = mix(hash);
+    for (unsigned i = 0; i < PROBES; ++i, bits >>= 9) {
+        words[(bits >> 6) & (BLOCK_WORDS - 1)] |= uint64_t(1) << (bits & 63);
+    }
+}
+
+bool BloomFilter::mayContain(uint64_t hash) const {
+    const uint64_t* words = &words_[block(hash)];
+    uint64_t bits = mix(hash);
+    for (unsigned i = 0; i < PROBES; ++i, bits >>= 9) {
+        if (!(words[(bits >> 6) & (BLOCK_WORDS - 1)] & (uint64_t(1) << (bits & 63)))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+HashJoin::HashJoin(uint32_t buildKey, uint32_t probeKey, std::shared_ptr<MemoryTracker> memory)
+    : buildKey_(buildKey), probeKey_(probeKey), memory_(std::move(memory)) {}
+
+HashJoin::~HashJoin() {
+    if (memory_ && reserved_ > 0) {
+        memory_->release("join", reserved_);
+    }
+}
+
+bool HashJoin::joinKey(const Row& row, uint32_t column, std::string& key) {
+    return equalityKey(row.cells[column], row.values[column], key);
+}
+
+uint64_t HashJoin::hashKey(const std::string& key) {
+    return static_cast<uint64_t>(std::hash<std::string>()(key));
+}
+
+bool HashJoin::build(const Row& row) {
+    if (!joinKey(row, buildKey_, key_)) {
+        return true;
+    }
+    auto found = table_.find(key_);
+    size_t bytes = ROW_ENTRY_BYTES + (found == table_.end() ? KEY_ENTRY_BYTES + key_.size() : 0);
+    if (memory_ && !memory_->reserve("join", bytes)) {
+        error_ = "Hash join build side of more than " + std::to_string(reserved_) +
+                 " bytes exceeds the memory limit of " + std::to_string(memory_->limit()) + " bytes";
+        return false;
+    }
+    reserved_ += bytes;
+    if (found == table_.end()) {
+        found = table_.emplace(key_, std::vector<const Row*>()).first;
+    }
+    found->second.push_back(&row);
+    ++buildRows_;
+    return true;
+}
+
+void HashJoin::finishBuild() {
+    // Sized for the distinct keys, which are only known now. The filter is
+    // only an optimization: without room for it in the budget, every probe
+    // row goes to the hash table instead.
+    size_t bytes = BloomFilter::bytesFor(table_.size());
+    if (memory_ && !memory_->reserve("join", bytes)) {
+        return;
+    }
+    reserved_ += bytes;
+    bloom_.reset(new BloomFilter(table_.size()));
+    for (const auto& entry : table_) {
+        bloom_->add(hashKey(entry.first));
+    }
+}
+
+const std::vector<const Row*>* HashJoin::probe(const Row& row, bool& bloomRejected) {
+    bloomRejected = false;
+    if (table_.empty() || !joinKey(row, probeKey_, key_)) {
+        return nullptr;
+    }
+    if (bloom_ && !bloom_->mayContain(hashKey(key_))) {
+        bloomRejected = true;
+        return nullptr;
+    }
+    auto found = table_.find(key_);
+    return found == table_.end() ? nullptr : &found->second;
+}
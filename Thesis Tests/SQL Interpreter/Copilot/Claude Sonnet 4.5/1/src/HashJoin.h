@@ -0,0 +1,76 @@
+#ifndef HASHJOIN_H
+#define HASHJOIN_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <unordered_map>
+#include "Storage.h"
+#include "MemoryTracker.h"
+
+// Blocked Bloom filter: every key sets PROBES bits inside one 512-bit block,
+// so a lookup touches a single cache line. At BITS_PER_KEY bits per key
+// about 1-2% of absent keys pass.
+class BloomFilter {
+public:
+    static const size_t BITS_PER_KEY = 10;
+    static const unsigned PROBES = 7;
+    
+    explicit BloomFilter(size_t keys);
+    
+    void add(uint64_t hash);
+    bool mayContain(uint64_t hash) const;
+    size_t bytes() const { return words_.size() * sizeof(uint64_t); }
+    static size_t bytesFor(size_t keys);  // bytes() of a filter for that many keys
+
+private:
+    static const size_t BLOCK_WORDS = 8;
+    
+    std::vector<uint64_t> words_;
+    size_t blocks_;
+    
+    size_t block(uint64_t hash) const;  // first word of the key's block
+    static size_t blocksFor(size_t keys);
+};
+
+// Inner equi-join of two single-table scans. The build side is hashed on its
+// key; once it is complete, a Bloom filter over the distinct build keys lets
+// the probe scan drop rows that cannot match before they are hashed and
+// looked up. NULL keys never match.
+//
+// Keys compare like WHERE equality (see equalityKey), so 5.0 joins 5.
+class HashJoin {
+public:
+    HashJoin(uint32_t buildKey, uint32_t probeKey, std::shared_ptr<MemoryTracker> memory);
+    ~HashJoin();
+    
+    // Build phase; false with an error once the query's memory budget runs out.
+    // Rows must outlive the join (they belong to the scanned snapshot).
+    bool build(const Row& row);
+    void finishBuild();                // sizes and fills the Bloom filter, if the budget has room
+    
+    size_t buildRows() const { return buildRows_; }
+    size_t distinctKeys() const { return table_.size(); }
+    std::string getError() const { return error_; }
+    
+    // Probe phase: the build rows with the probe row's key, or null. The
+    // pushed-down Bloom check runs first; bloomRejected says it dropped the row.
+    const std::vector<const Row*>* probe(const Row& row, bool& bloomRejected);
+
+private:
+    uint32_t buildKey_;
+    uint32_t probeKey_;
+    std::shared_ptr<MemoryTracker> memory_;
+    size_t reserved_ = 0;
+    size_t buildRows_ = 0;
+    std::unordered_map<std::string, std::vector<const Row*>> table_;
+    std::unique_ptr<BloomFilter> bloom_;
+    std::string key_;                  // scratch for the key of the current row
+    std::string error_;
+    
+    static bool joinKey(const Row& row, uint32_t column, std::string& key);
+    static uint64_t hashKey(const std::string& key);
+};
+
+#endif // HASHJOIN_H
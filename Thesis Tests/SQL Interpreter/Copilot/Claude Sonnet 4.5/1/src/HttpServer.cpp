@@ -1,11 +1,112 @@
 #include "HttpServer.h"
+#include "Utils.h"
 #include <iostream>
 #include <sstream>
 #include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <chrono>
 #include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#include <sys/uio.h>
+#include <sys/time.h>
+
+namespace {
+
+const size_t CONTROL_WORKERS = 2;  // workers beyond maxQueries, free for parsing, /cancel and /queries
+
+const size_t MAX_KEPT_BUFFER = 16 * 1024 * 1024;  // a worker's output buffer shrinks back beyond this
+
+const size_t MAX_REQUEST_SIZE = 1024 * 1024;  // headers plus body; larger requests get 413
+
+const int READ_TIMEOUT_MS = 5000;  // a whole request must arrive within this, or it gets 408
+const int SEND_TIMEOUT_MS = 5000;  // a response is abandoned once no byte of it is taken for this long
+
+// A connection whose request is still arriving. It is read by the accepting
+// thread and only reaches a worker once complete, so idle or slow clients
+// never hold a worker
+struct PendingClient {
+    int socket;
+    std::string request;
+    size_t total;  // headers plus Content-Length, npos until the headers are in
+    std::chrono::steady_clock::time_point deadline;
+};
+
+// Reads what is available. Returns 0 while more is needed, 200 once the
+// request is complete (trimmed to its length), an error status to answer
+// with, or -1 if the client went away
+int readPending(PendingClient& client) {
+    char buffer[16 * 1024];
+    while (true) {
+        ssize_t bytesRead = recv(client.socket, buffer, sizeof(buffer), 0);
+        if (bytesRead < 0 && errno == EINTR) {
+            continue;
+        }
+        if (bytesRead < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return 0;
+        }
+        if (bytesRead <= 0) {
+            return -1;
+        }
+        client.request.append(buffer, static_cast<size_t>(bytesRead));
+        
+        if (client.total == std::string::npos) {
+            size_t crlf = client.request.find("\r\n\r\n");
+            size_t lf = client.request.find("\n\n");
+            size_t headerEnd = std::min(crlf == std::string::npos ? crlf : crlf + 4,
+                                        lf == std::string::npos ? lf : lf + 2);
+            if (headerEnd == std::string::npos) {
+                if (client.request.size() > MAX_REQUEST_SIZE) {
+                    return 413;
+                }
+                continue;
+            }
+            
+            size_t contentLength = 0;
+            std::istringstream headers(client.request.substr(0, headerEnd));
+            std::string line;
+            while (std::getline(headers, line)) {
+                size_t colon = line.find(':');
+                if (colon == std::string::npos ||
+                    Utils::toLower(Utils::trim(line.substr(0, colon))) != "content-length") {
+                    continue;
+                }
+                std::string value = Utils::trim(line.substr(colon + 1));
+                if (value.empty() || value.size() > 9 || value.find_first_not_of("0123456789") != std::string::npos) {
+                    return 400;
+                }
+                contentLength = std::strtoul(value.c_str(), nullptr, 10);
+            }
+            client.total = headerEnd + contentLength;
+            if (client.total > MAX_REQUEST_SIZE) {
+                return 413;
+            }
+        }
+        if (client.request.size() >= client.total) {
+            client.request.resize(client.total);
+            return 200;
+        }
+    }
+}
+
+void escapeHtml(const std::string& text, std::string& out) {
+    out.clear();
+    size_t clean = 0;
+    size_t special;
+    while ((special = text.find_first_of("<>&", clean)) != std::string::npos) {
+        out.append(text, clean, special - clean);
+        out += text[special] == '<' ? "&lt;" : text[special] == '>' ? "&gt;" : "&amp;";
+        clean = special + 1;
+    }
+    out.append(text, clean, std::string::npos);
+}
+
+
+} // namespace
 
 HttpServer::HttpServer(Engine* engine, int port)
     : engine_(engine), port_(port), serverSocket_(-1), running_(false) {}
@@ -43,58 +144,233 @@ bool HttpServer::start() {
     }
     
     // Listen
-    if (listen(serverSocket_, 10) < 0) {
+    if (listen(serverSocket_, SOMAXCONN) < 0) {
         std::cerr << "Error: Failed to listen on socket\n";
         close(serverSocket_);
         return false;
     }
     
     running_ = true;
-    std::cout << "HTTP Server started on port " << port_ << "\n";
+    for (size_t i = 0; i < maxQueries_ + CONTROL_WORKERS; ++i) {
+        workers_.emplace_back(&HttpServer::workerLoop, this);
+    }
+    std::cout << "HTTP Server started on port " << port_ << " (" << maxQueries_ << " concurrent queries, "
+              << workers_.size() << " workers)\n";
     std::cout << "Open your browser to: http://localhost:" << port_ << "\n";
     std::cout << "Press Ctrl+C to stop the server\n\n";
     
-    // Accept connections
+    // Accept connections and read their requests without blocking; workers
+    // only get complete requests
+    std::vector<PendingClient> pending;
+    std::vector<struct pollfd> fds;
     while (running_) {
+        fds.clear();
+        fds.push_back({serverSocket_, POLLIN, 0});
+        for (const PendingClient& client : pending) {
+            fds.push_back({client.socket, POLLIN, 0});
+        }
+        if (poll(fds.data(), fds.size(), 100) < 0 && errno != EINTR) {
+            std::cerr << "Error: poll failed\n";
+            continue;
+        }
+        
+        auto now = std::chrono::steady_clock::now();
+        for (size_t i = pending.size(); i-- > 0;) {
+            PendingClient& client = pending[i];
+            int status = fds[i + 1].revents != 0 ? readPending(client) : 0;
+            if (status == 0 && now >= client.deadline) {
+                status = client.request.empty() ? -1 : 408;
+            }
+            if (status == 0) {
+                continue;
+            }
+            if (status == 200) {
+                // Workers write with blocking sends, which give up on a client that
+                // stops reading so it cannot hold the worker and its query slot
+                fcntl(client.socket, F_SETFL, fcntl(client.socket, F_GETFL) & ~O_NONBLOCK);
+                struct timeval sendTimeout = {SEND_TIMEOUT_MS / 1000, (SEND_TIMEOUT_MS % 1000) * 1000};
+                setsockopt(client.socket, SOL_SOCKET, SO_SNDTIMEO, &sendTimeout, sizeof(sendTimeout));
+                std::lock_guard<std::mutex> lock(mutex_);
+                requests_.emplace_back(client.socket, std::move(client.request));
+                work_.notify_one();
+            } else if (status == -1) {
+                close(client.socket);
+            } else {
+                respond(client.socket, createHttpResponse(status, "text/plain",
+                                                          status == 408 ? "Request Timeout" :
+                                                          status == 413 ? "Request too large" : "Bad Request"));
+            }
+            pending[i] = std::move(pending.back());
+            pending.pop_back();
+        }
+        
+        if (!(fds[0].revents & POLLIN)) {
+            continue;
+        }
         struct sockaddr_in clientAddress;
         socklen_t clientLen = sizeof(clientAddress);
-        
-        int clientSocket = accept(serverSocket_, (struct sockaddr*)&clientAddress, &clientLen);
+        int clientSocket = accept4(serverSocket_, (struct sockaddr*)&clientAddress, &clientLen, SOCK_NONBLOCK);
         if (clientSocket < 0) {
-            if (running_) {
+            if (running_ && errno != EAGAIN && errno != EINTR) {
                 std::cerr << "Error: Failed to accept connection\n";
             }
             continue;
         }
         
-        handleClient(clientSocket);
-        close(clientSocket);
+        size_t waiting;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            waiting = requests_.size() + pending.size();
+        }
+        if (waiting >= MAX_CONNECTIONS) {
+            respond(clientSocket, createHttpResponse(503, "text/plain", "Server busy, try again later",
+                                                     "Retry-After: 1\r\n"));
+            continue;
+        }
+        pending.push_back({clientSocket, std::string(), std::string::npos,
+                           now + std::chrono::milliseconds(READ_TIMEOUT_MS)});
     }
     
+    for (const PendingClient& client : pending) {
+        close(client.socket);
+    }
     return true;
 }
 
 void HttpServer::stop() {
     running_ = false;
     if (serverSocket_ >= 0) {
+        shutdown(serverSocket_, SHUT_RDWR);
         close(serverSocket_);
         serverSocket_ = -1;
     }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& query : queued_) {
+            query->control->cancel();
+        }
+        work_.notify_all();
+    }
+    for (std::thread& worker : workers_) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+    workers_.clear();
 }
 
-void HttpServer::handleClient(int clientSocket) {
-    char buffer[4096];
-    ssize_t bytesRead = recv(clientSocket, buffer, sizeof(buffer) - 1, 0);
-    
-    if (bytesRead <= 0) {
-        return;
+void HttpServer::workerLoop() {
+    while (true) {
+        std::shared_ptr<Query> query;
+        std::pair<int, std::string> request;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            while (!(query = nextAdmissible()) && requests_.empty() && running_) {
+                // Queued deadlines expire without a wakeup, so poll while anything waits
+                if (queued_.empty()) {
+                    work_.wait(lock);
+                } else {
+                    work_.wait_for(lock, std::chrono::milliseconds(50));
+                }
+            }
+            if (!query) {
+                if (requests_.empty()) {
+                    return;  // stopping
+                }
+                request = std::move(requests_.front());
+                requests_.pop_front();
+            }
+        }
+        if (query) {
+            runQuery(query);
+        } else {
+            handleClient(request.first, request.second);
+        }
+    }
+}
+
+bool HttpServer::canAdmit(bool heavy) const {
+    size_t heavyLimit = maxQueries_ > 1 ? maxQueries_ - 1 : 1;
+    return runningQueries_ < maxQueries_ && (!heavy || runningHeavy_ < heavyLimit);
+}
+
+std::shared_ptr<HttpServer::Query> HttpServer::nextAdmissible() {
+    // Oldest first, but a cheap query may pass heavy ones held back by their limit.
+    // Cancelled or timed-out queries leave without a slot; runQuery only reports them.
+    for (auto it = queued_.begin(); it != queued_.end(); ++it) {
+        std::shared_ptr<Query> query = *it;
+        bool expired = query->control->expired();
+        if (!expired && !canAdmit(query->heavy)) {
+            continue;
+        }
+        queued_.erase(it);
+        if (!expired) {
+            query->running = true;
+            ++runningQueries_;
+            runningHeavy_ += query->heavy ? 1 : 0;
+        }
+        return query;
+    }
+    return nullptr;
+}
+
+void HttpServer::runQuery(const std::shared_ptr<Query>& query) {
+    // Results are encoded into a per-worker buffer that keeps its capacity;
+    // a query that has expired in the queue fails before it is executed
+    static thread_local std::string output;
+    int status = 200;
+    const char* contentType = resultContentType(query->format);
+    std::string idHeader = "X-Query-Id: " + query->id + "\r\n";
+    if (query->running) {
+        std::cout << "Executing SQL [" << query->id << "]: " << query->sql << std::endl;
+    }
+    if (query->format == ResultFormat::TABLE) {
+        escapeHtml(engine_->executeStatementWeb(query->sql, query->control), output);
+    } else {
+        QueryResult result = engine_->executeQuery(query->sql, query->control);
+        std::string error = result.message;
+        if (result.ok && result.hasRows && !ResultEncoder::encode(result, query->format, output, error)) {
+            error = "Error: " + error;
+            result.ok = false;
+        }
+        if (!result.ok || !result.hasRows) {
+            // Statements without rows, and errors, get a small object or plain text
+            status = result.ok ? 200 : 400;
+            bool json = query->format == ResultFormat::JSON || query->format == ResultFormat::NDJSON;
+            output.clear();
+            if (json) {
+                output += result.ok ? "{\"message\":" : "{\"error\":";
+                ResultEncoder::appendJsonString(output, error);
+                output += "}\n";
+            } else {
+                output = error;
+                contentType = "text/plain; charset=utf-8";
+            }
+        }
+    }
+    respond(query->socket, createHttpHeader(status, contentType, output.size(), idHeader), output);
+    if (output.capacity() > MAX_KEPT_BUFFER) {
+        std::string().swap(output);
     }
     
-    buffer[bytesRead] = '\0';
-    std::string request(buffer);
-    
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (query->running) {
+        --runningQueries_;
+        runningHeavy_ -= query->heavy ? 1 : 0;
+    }
+    queries_.erase(query->id);
+    work_.notify_all();
+}
+
+void HttpServer::handleClient(int clientSocket, const std::string& request) {
     std::string method, path, body;
     parseHttpRequest(request, method, path, body);
+    std::string queryString;
+    size_t question = path.find('?');
+    if (question != std::string::npos) {
+        queryString = path.substr(question + 1);
+        path.erase(question);
+    }
     
     std::cout << "Request: " << method << " " << path << std::endl;
     
@@ -106,34 +382,144 @@ void HttpServer::handleClient(int clientSocket) {
         response = createHttpResponse(200, "text/html; charset=utf-8", html);
         std::cout << "Serving index.html (" << html.length() << " bytes)" << std::endl;
     } else if (method == "POST" && path == "/execute") {
-        // Execute SQL command
-        size_t sqlPos = body.find("sql=");
-        if (sqlPos != std::string::npos) {
-            std::string sql = urlDecode(body.substr(sqlPos + 4));
-            std::cout << "Executing SQL: " << sql << std::endl;
-            std::string result = engine_->executeStatementWeb(sql);
-            
-            // Escape HTML entities in result
-            std::string escapedResult;
-            for (char c : result) {
-                switch (c) {
-                    case '<': escapedResult += "&lt;"; break;
-                    case '>': escapedResult += "&gt;"; break;
-                    case '&': escapedResult += "&amp;"; break;
-                    default: escapedResult += c;
-                }
-            }
-            
-            response = createHttpResponse(200, "text/plain; charset=utf-8", escapedResult);
-        } else {
-            response = createHttpResponse(400, "text/plain", "Bad Request: Missing sql parameter");
-        }
+        handleExecute(clientSocket, queryString, body);  // responds now or once the query is admitted
+        return;
+    } else if (method == "POST" && path == "/cancel") {
+        int status = 200;
+        std::string message = handleCancel(body, status);
+        response = createHttpResponse(status, "text/plain; charset=utf-8", message);
+    } else if (method == "GET" && path == "/queries") {
+        response = createHttpResponse(200, "text/plain; charset=utf-8", listQueries());
     } else {
         response = createHttpResponse(404, "text/plain", "Not Found");
     }
     
-    ssize_t sent = send(clientSocket, response.c_str(), response.length(), 0);
+    respond(clientSocket, response);
+}
+
+void HttpServer::handleExecute(int clientSocket, const std::string& queryString, const std::string& body) {
+    std::string sql = Utils::trim(formField(body, "sql"));
+    if (sql.empty()) {
+        respond(clientSocket, createHttpResponse(400, "text/plain", "Bad Request: Missing sql parameter"));
+        return;
+    }
+    std::string formatName = formField(queryString, "format");
+    if (formatName.empty()) {
+        formatName = formField(body, "format");
+    }
+    ResultFormat format;
+    if (!parseResultFormat(formatName, format)) {
+        respond(clientSocket, createHttpResponse(400, "text/plain", "Bad Request: Unknown format '" + formatName +
+                                                 "' (use table, json, csv, ndjson or arrow-ipc)"));
+        return;
+    }
+    
+    auto query = std::make_shared<Query>();
+    query->format = format;
+    query->sql = sql;
+    query->socket = clientSocket;
+    std::string timeout = formField(body, "timeout_ms");
+    uint32_t timeoutMs = timeout.empty() ? engine_->queryTimeout()
+                                         : static_cast<uint32_t>(std::strtoul(timeout.c_str(), nullptr, 10));
+    query->control = std::make_shared<QueryControl>(timeoutMs);  // the deadline covers the wait in the queue
+    query->heavy = engine_->estimateCost(sql) >= heavyCost_;
+    
+    std::unique_lock<std::mutex> lock(mutex_);
+    query->id = formField(body, "id");
+    if (query->id.empty()) {
+        // Skip numbers a client already chose as its own id
+        do {
+            query->id = std::to_string(nextQueryId_++);
+        } while (queries_.count(query->id));
+    } else if (queries_.count(query->id)) {
+        lock.unlock();
+        respond(clientSocket, createHttpResponse(409, "text/plain", "Query id '" + query->id + "' is in use"));
+        return;
+    }
+    
+    bool waiting = false;  // an earlier query of the same class goes first
+    for (const auto& queued : queued_) {
+        waiting = waiting || queued->heavy == query->heavy;
+    }
+    if (!waiting && canAdmit(query->heavy)) {
+        query->running = true;
+        ++runningQueries_;
+        runningHeavy_ += query->heavy ? 1 : 0;
+        queries_[query->id] = query;
+        lock.unlock();
+        runQuery(query);
+        return;
+    }
+    if (queued_.size() >= MAX_QUEUED) {
+        lock.unlock();
+        respond(clientSocket, createHttpResponse(503, "text/plain", "Server busy, try again later",
+                                                 "Retry-After: 1\r\n"));
+        return;
+    }
+    queries_[query->id] = query;
+    queued_.push_back(query);
+}
+
+std::string HttpServer::handleCancel(const std::string& body, int& status) {
+    std::string id = formField(body, "id");
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto found = queries_.find(id);
+    if (found == queries_.end()) {
+        status = 404;
+        return "Unknown query id '" + id + "'";
+    }
+    // A running query stops at its next check; a queued one is answered by the next free worker
+    found->second->control->cancel();
+    work_.notify_all();
+    return "OK";
+}
+
+std::string HttpServer::listQueries() {
+    std::ostringstream out;
+    std::lock_guard<std::mutex> lock(mutex_);
+    out << "running " << runningQueries_ << "/" << maxQueries_ << ", queued " << queued_.size() << "\n";
+    for (const auto& entry : queries_) {
+        const Query& query = *entry.second;
+        out << entry.first << "\t" << (query.running ? "running" : "queued") << "\t"
+            << query.control->elapsedMs() << " ms\t" << (query.heavy ? "heavy" : "light")
+            << (query.control->cancelled() ? "\tcanceling" : "") << "\t" << query.sql << "\n";
+    }
+    return out.str();
+}
+
+void HttpServer::respond(int clientSocket, const std::string& response, const std::string& body) {
+    // Header and body go out in one sendmsg without being joined first
+    struct iovec parts[2];
+    parts[0].iov_base = const_cast<char*>(response.data());
+    parts[0].iov_len = response.size();
+    parts[1].iov_base = const_cast<char*>(body.data());
+    parts[1].iov_len = body.size();
+    struct msghdr message;
+    std::memset(&message, 0, sizeof(message));
+    message.msg_iov = parts;
+    message.msg_iovlen = 2;
+    
+    size_t sent = 0;
+    while (message.msg_iovlen > 0) {
+        ssize_t n = sendmsg(clientSocket, &message, MSG_NOSIGNAL);
+        if (n <= 0) {
+            break;
+        }
+        sent += static_cast<size_t>(n);
+        // Skip what was written; a partial write leaves the rest of an iovec
+        size_t done = static_cast<size_t>(n);
+        while (message.msg_iovlen > 0 && done >= message.msg_iov->iov_len) {
+            done -= message.msg_iov->iov_len;
+            ++message.msg_iov;
+            --message.msg_iovlen;
+        }
+        if (message.msg_iovlen > 0) {
+            message.msg_iov->iov_base = static_cast<char*>(message.msg_iov->iov_base) + done;
+            message.msg_iov->iov_len -= done;
+        }
+    }
     std::cout << "Sent " << sent << " bytes" << std::endl;
+    close(clientSocket);
 }
 
 std::string HttpServer::parseHttpRequest(const std::string& request, std::string& method, std::string& path, std::string& body) {
@@ -166,17 +552,32 @@ std::string HttpServer::parseHttpRequest(const std::string& request, std::string
     return headers;
 }
 
-std::string HttpServer::createHttpResponse(int statusCode, const std::string& contentType, const std::string& body) {
+std::string HttpServer::createHttpResponse(int statusCode, const std::string& contentType, const std::string& body,
+                                           const std::string& extraHeaders) {
+    return createHttpHeader(statusCode, contentType, body.size(), extraHeaders) + body;
+}
+
+std::string HttpServer::createHttpHeader(int statusCode, const std::string& contentType, size_t contentLength,
+                                         const std::string& extraHeaders) {
     std::ostringstream response;
     
-    std::string statusText = (statusCode == 200) ? "OK" : "Not Found";
+    std::string statusText;
+    switch (statusCode) {
+        case 200: statusText = "OK"; break;
+        case 400: statusText = "Bad Request"; break;
+        case 408: statusText = "Request Timeout"; break;
+        case 409: statusText = "Conflict"; break;
+        case 413: statusText = "Payload Too Large"; break;
+        case 503: statusText = "Service Unavailable"; break;
+        default: statusText = "Not Found"; break;
+    }
     
     response << "HTTP/1.1 " << statusCode << " " << statusText << "\r\n";
     response << "Content-Type: " << contentType << "\r\n";
-    response << "Content-Length: " << body.length() << "\r\n";
+    response << extraHeaders;
+    response << "Content-Length: " << contentLength << "\r\n";
     response << "Connection: close\r\n";
     response << "\r\n";
-    response << body;
     
     return response.str();
 }
@@ -414,3 +815,18 @@ std::string HttpServer::urlDecode(const std::string& str) {
     }
     return result;
 }
+
+std::string HttpServer::formField(const std::string& body, const std::string& name) {
+    size_t start = 0;
+    while (start <= body.size()) {
+        size_t end = body.find('&', start);
+        if (end == std::string::npos) {
+            end = body.size();
+        }
+        if (body.compare(start, name.size() + 1, name + "=") == 0) {
+            return urlDecode(body.substr(start + name.size() + 1, end - start - name.size() - 1));
+        }
+        start = end + 1;
+    }
+    return "";
+}
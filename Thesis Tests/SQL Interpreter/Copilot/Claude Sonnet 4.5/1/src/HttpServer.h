@@ -2,27 +2,93 @@
 #define HTTPSERVER_H
 
 #include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
 #include "Engine.h"
+#include "QueryControl.h"
+#include "ResultEncoder.h"
 
+// Web front-end. The accepting thread reads requests without blocking and
+// hands only complete ones to a fixed pool of workers, so idle or slow
+// clients never hold a worker. At most maxQueries statements run at once and
+// the rest wait in an admission queue. Queries whose estimated cost is at
+// least heavyCost may only use maxQueries - 1 of the slots, so cheap point
+// queries always find one free while reports run. A worker that cannot
+// admit a query parks it and goes back to the request queue, so /cancel and
+// /queries are answered even when every slot is busy.
+//
+//   POST /execute   sql=<statement>[&id=<name>][&timeout_ms=<n>][&format=<f>]
+//                   (?format= on the URL works too; see ResultEncoder.h)
+//   POST /cancel    id=<name>   (running or queued)
+//   GET  /queries   one line per running or queued query
 class HttpServer {
 public:
+    static const size_t MAX_QUEUED = 64;        // admission queue length; beyond it requests get 503
+    static const size_t MAX_CONNECTIONS = 256;  // accepted but not yet taken by a worker
+    
     HttpServer(Engine* engine, int port = 8080);
     ~HttpServer();
     
+    void setMaxQueries(size_t queries) { maxQueries_ = queries == 0 ? 1 : queries; }
+    void setHeavyCost(double cost) { heavyCost_ = cost; }
+    
     bool start();
     void stop();
     
 private:
+    // An /execute request from admission to response
+    struct Query {
+        std::string id;
+        std::string sql;
+        bool heavy = false;
+        ResultFormat format = ResultFormat::TABLE;
+        bool running = false;
+        int socket = -1;
+        std::shared_ptr<QueryControl> control;
+    };
+    
     Engine* engine_;
     int port_;
     int serverSocket_;
-    bool running_;
+    std::atomic<bool> running_;
+    size_t maxQueries_ = 4;
+    double heavyCost_ = 100000;
+    
+    std::mutex mutex_;
+    std::condition_variable work_;                 // a connection arrived or a slot freed
+    std::vector<std::thread> workers_;
+    std::deque<std::pair<int, std::string>> requests_;  // complete requests, by socket
+    std::deque<std::shared_ptr<Query>> queued_;    // admission queue, in arrival order
+    std::map<std::string, std::shared_ptr<Query>> queries_;  // running and queued, by id
+    size_t runningQueries_ = 0;
+    size_t runningHeavy_ = 0;
+    uint64_t nextQueryId_ = 1;
+    
+    void workerLoop();
+    bool canAdmit(bool heavy) const;               // caller holds mutex_
+    std::shared_ptr<Query> nextAdmissible();       // caller holds mutex_; marks it running
+    void runQuery(const std::shared_ptr<Query>& query);
+    
+    void handleClient(int clientSocket, const std::string& request);  // closes the socket unless it parks a query
+    void handleExecute(int clientSocket, const std::string& queryString, const std::string& body);
+    std::string handleCancel(const std::string& body, int& status);
+    std::string listQueries();
+    void respond(int clientSocket, const std::string& response, const std::string& body = "");
     
-    void handleClient(int clientSocket);
     std::string parseHttpRequest(const std::string& request, std::string& method, std::string& path, std::string& body);
-    std::string createHttpResponse(int statusCode, const std::string& contentType, const std::string& body);
+    std::string createHttpResponse(int statusCode, const std::string& contentType, const std::string& body,
+                                   const std::string& extraHeaders = "");
+    std::string createHttpHeader(int statusCode, const std::string& contentType, size_t contentLength,
+                                 const std::string& extraHeaders = "");
     std::string getIndexHtml();
     std::string urlDecode(const std::string& str);
+    std::string formField(const std::string& body, const std::string& name);  // decoded, "" if absent
 };
 
 #endif // HTTPSERVER_H
@@ -1,6 +1,8 @@
 #include "Lexer.h"
 #include "Utils.h"
 #include <cctype>
+#include <cerrno>
+#include <cstdlib>
 #include <unordered_map>
 
 Lexer::Lexer(const std::string& input)
@@ -37,9 +39,11 @@ std::vector<Token> Lexer::tokenize() {
         } else if (c == '=') {
             tokens.emplace_back(TokenType::EQUALS, "=", line_, column_);
             advance();
+        } else if (c == '<' || c == '>' || (c == '!' && peek() == '=')) {
+            tokens.push_back(readComparison());
         } else if (c == '"' || c == '\'') {
             tokens.push_back(readStringLiteral());
-        } else if (isDigit(c)) {
+        } else if (isDigit(c) || (c == '-' && isDigit(peek()))) {
             tokens.push_back(readNumber());
         } else if (isAlpha(c) || c == '_') {
             tokens.push_back(readIdentifierOrKeyword());
@@ -91,13 +95,19 @@ Token Lexer::readIdentifierOrKeyword() {
     int startColumn = column_;
     std::string text;
     
-    while (isAlphaNumeric(current()) || current() == '_') {
+    // A qualified name (table.column) is read as one identifier
+    while (isAlphaNumeric(current()) || current() == '_' ||
+           (current() == '.' && (isAlpha(peek()) || peek() == '_'))) {
         text += current();
         advance();
     }
     
     TokenType type = identifierType(text);
-    return Token(type, text, line_, startColumn);
+    Token token(type, text, line_, startColumn);
+    if (type == TokenType::NULL_KEYWORD) {
+        token.literal = Value::null();
+    }
+    return token;
 }
 
 Token Lexer::readStringLiteral() {
@@ -124,19 +134,60 @@ Token Lexer::readStringLiteral() {
         error_ = "Unterminated string literal";
     }
     
-    return Token(TokenType::STRING_LITERAL, text, line_, startColumn);
+    Token token(TokenType::STRING_LITERAL, text, line_, startColumn);
+    token.literal = Value::fromText(text);
+    return token;
 }
 
 Token Lexer::readNumber() {
     int startColumn = column_;
     std::string text;
+    if (current() == '-') {
+        text += current();
+        advance();
+    }
     
-    while (isDigit(current()) || current() == '.') {
+    bool fraction = false;
+    while (isDigit(current()) || (current() == '.' && !fraction)) {
+        fraction = fraction || current() == '.';
         text += current();
         advance();
     }
     
-    return Token(TokenType::NUMBER, text, line_, startColumn);
+    // Parsed to binary here, once; integers too large for int64 become doubles
+    Token token(TokenType::NUMBER, text, line_, startColumn);
+    errno = 0;
+    long long integer = fraction ? 0 : std::strtoll(text.c_str(), nullptr, 10);
+    if (!fraction && errno != ERANGE) {
+        token.literal = Value::fromInteger(integer);
+    } else {
+        token.literal = Value::fromDouble(std::strtod(text.c_str(), nullptr));
+    }
+    return token;
+}
+
+Token Lexer::readComparison() {
+    int startColumn = column_;
+    std::string text(1, current());
+    advance();
+    if (current() == '=' || (text == "<" && current() == '>')) {
+        text += current();
+        advance();
+    }
+    
+    TokenType type;
+    if (text == "<") {
+        type = TokenType::LESS;
+    } else if (text == "<=") {
+        type = TokenType::LESS_EQUAL;
+    } else if (text == ">") {
+        type = TokenType::GREATER;
+    } else if (text == ">=") {
+        type = TokenType::GREATER_EQUAL;
+    } else {
+        type = TokenType::NOT_EQUALS;
+    }
+    return Token(type, text, line_, startColumn);
 }
 
 bool Lexer::isAlpha(char c) const {
@@ -160,7 +211,20 @@ TokenType Lexer::identifierType(const std::string& text) const {
         {"VALUES", TokenType::VALUES},
         {"SELECT", TokenType::SELECT},
         {"FROM", TokenType::FROM},
-        {"WHERE", TokenType::WHERE}
+        {"WHERE", TokenType::WHERE},
+        {"AND", TokenType::AND},
+        {"ANALYZE", TokenType::ANALYZE},
+        {"EXPLAIN", TokenType::EXPLAIN},
+        {"LIKE", TokenType::LIKE},
+        {"ILIKE", TokenType::ILIKE},
+        {"INDEX", TokenType::INDEX},
+        {"ON", TokenType::ON},
+        {"USING", TokenType::USING},
+        {"PARTITION", TokenType::PARTITION},
+        {"BY", TokenType::BY},
+        {"IS", TokenType::IS},
+        {"NOT", TokenType::NOT},
+        {"NULL", TokenType::NULL_KEYWORD}
     };
     
     std::string upper = Utils::toUpper(text);
@@ -3,6 +3,7 @@
 
 #include <string>
 #include <vector>
+#include "Value.h"
 
 enum class TokenType {
     // Keywords
@@ -14,6 +15,19 @@ enum class TokenType {
     SELECT,
     FROM,
     WHERE,
+    AND,
+    ANALYZE,
+    EXPLAIN,
+    LIKE,
+    ILIKE,
+    INDEX,
+    ON,
+    USING,
+    PARTITION,
+    BY,
+    IS,
+    NOT,
+    NULL_KEYWORD,
     
     // Symbols
     LEFT_PAREN,    // (
@@ -22,6 +36,11 @@ enum class TokenType {
     SEMICOLON,     // ;
     ASTERISK,      // *
     EQUALS,        // =
+    NOT_EQUALS,    // <> or !=
+    LESS,          // <
+    LESS_EQUAL,    // <=
+    GREATER,       // >
+    GREATER_EQUAL, // >=
     
     // Literals and identifiers
     IDENTIFIER,
@@ -38,6 +57,7 @@ struct Token {
     std::string value;
     int line;
     int column;
+    Value literal;   // NUMBER, STRING_LITERAL and NULL, in binary form
     
     Token(TokenType t, const std::string& v = "", int l = 1, int c = 1)
         : type(t), value(v), line(l), column(c) {}
@@ -66,6 +86,7 @@ private:
     Token readIdentifierOrKeyword();
     Token readStringLiteral();
     Token readNumber();
+    Token readComparison();
     
     bool isAlpha(char c) const;
     bool isDigit(char c) const;
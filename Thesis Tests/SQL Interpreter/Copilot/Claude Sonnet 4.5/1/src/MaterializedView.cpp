@@ -0,0 +1,141 @@
+#include "MaterializedView.h"
+#include "Lexer.h"
+#include "Parser.h"
+#include <sstream>
+
+namespace {
+
+std::string literalSql(const Value& value) {
+    if (value.type() != ValueType::TEXT) {
+        return value.toSql();
+    }
+    std::string quoted = "'";
+    for (char c : value.text) {
+        if (c == '\'') quoted += '\\';
+        quoted += c;
+    }
+    return quoted + "'";
+}
+
+} // namespace
+
+MaterializedView::MaterializedView(const Plan& plan)
+    : table_(plan.table), filters_(plan.filters), aggregate_(plan.groupBy, plan.aggregates, plan.layout) {}
+
+void MaterializedView::fold(const Row& row) {
+    for (const PlannedFilter& filter : filters_) {
+        if (!filter.matches(row)) {
+            return;
+        }
+    }
+    aggregate_.add(row);  // a failure is kept and reported to readers
+}
+
+void MaterializedView::add(const Row& row) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    fold(row);
+}
+
+void MaterializedView::rebuild(const ChunkedVector<Row>& rows) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    aggregate_.clear();
+    for (const Row& row : rows) {
+        fold(row);
+    }
+}
+
+bool MaterializedView::read(std::vector<Row>& rows, std::string& error) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (aggregate_.failed()) {
+        error = aggregate_.getError();
+        return false;
+    }
+    rows = aggregate_.results();
+    return true;
+}
+
+size_t MaterializedView::groupCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return aggregate_.groupCount();
+}
+
+bool MaterializedView::plan(const StorageSnapshot& snapshot, const std::string& definition, Plan& plan,
+                            std::string& error) {
+    Lexer lexer(definition);
+    std::vector<Token> tokens = lexer.tokenize();
+    if (!lexer.getError().empty()) {
+        error = lexer.getError();
+        return false;
+    }
+    Parser parser(tokens, snapshot.catalog.get());
+    std::unique_ptr<Statement> stmt = parser.parseStatement();
+    if (!stmt || stmt->type() != StatementType::SELECT) {
+        error = parser.hasError() ? parser.getError() : "A view must be defined by a SELECT";
+        return false;
+    }
+    
+    const SelectStatement& select = static_cast<const SelectStatement&>(*stmt);
+    if (select.viewId != INVALID_ID) {
+        error = "A materialized view cannot read another view";
+        return false;
+    }
+    if (!select.windows.empty()) {
+        error = "A materialized view cannot use window functions";
+        return false;
+    }
+    if (select.joined()) {
+        error = "A materialized view cannot use JOIN";
+        return false;
+    }
+    if (select.hasSubqueries()) {
+        error = "A materialized view cannot use WITH or subqueries";
+        return false;
+    }
+    if (!select.grouped()) {
+        error = "A materialized view needs GROUP BY or an aggregate";
+        return false;
+    }
+    Planner planner(snapshot);
+    if (!planner.plan(select, plan)) {
+        error = planner.getError();
+        return false;
+    }
+    return true;
+}
+
+std::string MaterializedView::definitionSql(const SelectStatement& stmt) {
+    static const char* const functions[] = {"row_number", "rank", "dense_rank", "count", "sum", "avg", "min", "max"};
+    static const char* const ops[] = {"=", "LIKE", "ILIKE", "<>", "<", "<=", ">", ">=", "IS NULL", "IS NOT NULL", "IN"};
+    
+    std::ostringstream sql;
+    sql << "SELECT ";
+    size_t column = 0;
+    size_t aggregate = 0;
+    size_t width = stmt.columns.size() + stmt.aggregates.size();
+    for (size_t position = 0; position < width; ++position) {
+        sql << (position > 0 ? ", " : "");
+        if (aggregate < stmt.aggregates.size() && stmt.aggregates[aggregate].position == position) {
+            const WindowCall& call = stmt.aggregates[aggregate++];
+            sql << functions[static_cast<int>(call.function)] << "("
+                << (call.argument.empty() ? "*" : call.argument) << ") AS " << call.alias;
+        } else {
+            sql << stmt.columns[column++];
+        }
+    }
+    if (width == 0) {
+        sql << "*";
+    }
+    sql << " FROM " << stmt.tableName;
+    for (size_t i = 0; i < stmt.where.size(); ++i) {
+        const Condition& condition = stmt.where[i];
+        sql << (i == 0 ? " WHERE " : " AND ") << condition.column << " " << ops[static_cast<int>(condition.op)];
+        if (condition.op != CompareOp::IS_NULL && condition.op != CompareOp::IS_NOT_NULL) {
+            sql << " " << literalSql(condition.value);
+        }
+    }
+    for (size_t i = 0; i < stmt.groupBy.size(); ++i) {
+        sql << (i == 0 ? " GROUP BY " : ", ") << stmt.groupBy[i];
+    }
+    sql << ";";
+    return sql.str();
+}
@@ -0,0 +1,44 @@
+#ifndef MATERIALIZEDVIEW_H
+#define MATERIALIZEDVIEW_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include "Planner.h"
+#include "GroupAggregate.h"
+
+// A GROUP BY query over one table whose per-group state is updated by the
+// INSERT path, so reading it costs O(groups) however large the table grows.
+// An upsert that overwrites rows makes the writer rebuild the view from the
+// table instead, since MIN/MAX cannot be taken back incrementally.
+class MaterializedView {
+public:
+    explicit MaterializedView(const Plan& plan);  // grouped plan of the view's SELECT
+    
+    TableId table() const { return table_; }
+    
+    // Writer side; the caller holds the source table's write lock
+    void add(const Row& row);
+    void rebuild(const ChunkedVector<Row>& rows);
+    
+    // Reader side: a copy of the current groups, in group-key order
+    bool read(std::vector<Row>& rows, std::string& error) const;
+    size_t groupCount() const;
+    
+    // Plans the definition of a view against a snapshot; it must read a
+    // table (not a view), group or aggregate, and use no window functions
+    static bool plan(const StorageSnapshot& snapshot, const std::string& definition, Plan& plan,
+                     std::string& error);
+    // Canonical text of a SELECT, as stored in the catalog
+    static std::string definitionSql(const SelectStatement& stmt);
+    
+private:
+    TableId table_;
+    std::vector<PlannedFilter> filters_;
+    mutable std::mutex mutex_;  // held briefly by the writer folding rows and by readers copying out
+    GroupAggregate aggregate_;
+    
+    void fold(const Row& row);  // caller holds mutex_
+};
+
+#endif // MATERIALIZEDVIEW_H
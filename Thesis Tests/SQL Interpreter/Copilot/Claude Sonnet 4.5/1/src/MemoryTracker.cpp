@@ -0,0 +1,71 @@
+#include "MemoryTracker.h"
+#include <sstream>
+#include <cctype>
+#include <cstdlib>
+
+MemoryTracker::MemoryTracker(size_t limitBytes)
+    : limit_(limitBytes), used_(0), peak_(0) {}
+
+bool MemoryTracker::reserve(const std::string& op, size_t bytes) {
+    if (limit_ != 0 && used_ + bytes > limit_) {
+        return false;
+    }
+    
+    used_ += bytes;
+    if (used_ > peak_) {
+        peak_ = used_;
+    }
+    
+    Account& account = accounts_[op];
+    account.used += bytes;
+    if (account.used > account.peak) {
+        account.peak = account.used;
+    }
+    return true;
+}
+
+void MemoryTracker::release(const std::string& op, size_t bytes) {
+    auto it = accounts_.find(op);
+    if (it == accounts_.end()) {
+        return;
+    }
+    
+    size_t amount = bytes < it->second.used ? bytes : it->second.used;
+    it->second.used -= amount;
+    used_ -= amount;
+}
+
+std::string MemoryTracker::report() const {
+    std::ostringstream oss;
+    oss << "query: " << used_ << " / " << peak_ << " bytes";
+    if (limit_ != 0) {
+        oss << " (limit " << limit_ << ")";
+    }
+    for (const auto& pair : accounts_) {
+        oss << "\n  " << pair.first << ": " << pair.second.used << " / " << pair.second.peak << " bytes";
+    }
+    return oss.str();
+}
+
+bool parseByteSize(const std::string& text, size_t& bytes) {
+    if (text.empty() || !std::isdigit(static_cast<unsigned char>(text[0]))) {
+        return false;
+    }
+    
+    char* end = nullptr;
+    unsigned long long value = std::strtoull(text.c_str(), &end, 10);
+    std::string suffix(end);
+    
+    if (suffix.empty() || suffix == "B" || suffix == "b") {
+        bytes = value;
+    } else if (suffix == "K" || suffix == "k") {
+        bytes = value << 10;
+    } else if (suffix == "M" || suffix == "m") {
+        bytes = value << 20;
+    } else if (suffix == "G" || suffix == "g") {
+        bytes = value << 30;
+    } else {
+        return false;
+    }
+    return true;
+}
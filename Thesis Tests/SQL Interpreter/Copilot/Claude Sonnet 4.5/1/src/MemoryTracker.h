@@ -0,0 +1,40 @@
+#ifndef MEMORYTRACKER_H
+#define MEMORYTRACKER_H
+
+#include <string>
+#include <map>
+#include <cstddef>
+
+// Per-query memory accounting. Operators reserve bytes under their own name
+// before growing a buffer; a failed reservation means the query is over its
+// budget and the operator must spill or fail.
+class MemoryTracker {
+public:
+    explicit MemoryTracker(size_t limitBytes = 0);  // 0 = unlimited
+    
+    bool reserve(const std::string& op, size_t bytes);
+    void release(const std::string& op, size_t bytes);
+    
+    size_t used() const { return used_; }
+    size_t peak() const { return peak_; }
+    size_t limit() const { return limit_; }
+    
+    // One line per operator: "<op>: current / peak bytes"
+    std::string report() const;
+
+private:
+    struct Account {
+        size_t used = 0;
+        size_t peak = 0;
+    };
+    
+    size_t limit_;
+    size_t used_;
+    size_t peak_;
+    std::map<std::string, Account> accounts_;
+};
+
+// Parse sizes such as "65536", "512K", "64M", "1G"; returns false if malformed
+bool parseByteSize(const std::string& text, size_t& bytes);
+
+#endif // MEMORYTRACKER_H
@@ -0,0 +1,1175 @@
+#include "ParquetFile.h"
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include <fstream>
+#include <unistd.h>
+#ifdef MINISQL_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+// Assumes a little-endian host, like the rest of the on-disk formats.
+
+namespace {
+
+const char MAGIC[] = "PAR1";
+const size_t MAGIC_SIZE = 4;
+
+// Enum values from parquet.thrift
+const int32_t TYPE_BOOLEAN = 0;
+const int32_t TYPE_INT32 = 1;
+const int32_t TYPE_INT64 = 2;
+const int32_t TYPE_FLOAT = 4;
+const int32_t TYPE_DOUBLE = 5;
+const int32_t TYPE_BYTE_ARRAY = 6;
+
+const int32_t REPETITION_REQUIRED = 0;
+const int32_t REPETITION_OPTIONAL = 1;
+
+const int32_t CODEC_UNCOMPRESSED = 0;
+const int32_t CODEC_SNAPPY = 1;
+const int32_t CODEC_GZIP = 2;
+
+const int32_t ENCODING_PLAIN = 0;
+const int32_t ENCODING_PLAIN_DICTIONARY = 2;
+const int32_t ENCODING_RLE = 3;
+const int32_t ENCODING_RLE_DICTIONARY = 8;
+
+const int32_t PAGE_DATA = 0;
+const int32_t PAGE_DICTIONARY = 2;
+const int32_t PAGE_DATA_V2 = 3;
+
+const int32_t CONVERTED_UTF8 = 0;
+
+// Thrift compact protocol field types
+const uint8_t CT_BOOL_TRUE = 1;
+const uint8_t CT_BOOL_FALSE = 2;
+const uint8_t CT_BYTE = 3;
+const uint8_t CT_I16 = 4;
+const uint8_t CT_I32 = 5;
+const uint8_t CT_I64 = 6;
+const uint8_t CT_DOUBLE = 7;
+const uint8_t CT_BINARY = 8;
+const uint8_t CT_LIST = 9;
+const uint8_t CT_SET = 10;
+const uint8_t CT_MAP = 11;
+const uint8_t CT_STRUCT = 12;
+
+const int MAX_NESTING = 64;
+
+void appendVarint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out += static_cast<char>(value | 0x80);
+        value >>= 7;
+    }
+    out += static_cast<char>(value);
+}
+
+bool readVarint(const uint8_t*& p, const uint8_t* end, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64 && p < end; shift += 7) {
+        uint8_t byte = *p++;
+        value |= uint64_t(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+template <typename T>
+void appendLittleEndian(std::string& out, T value) {
+    char bytes[sizeof(T)];
+    std::memcpy(bytes, &value, sizeof(T));
+    out.append(bytes, sizeof(T));
+}
+
+template <typename T>
+T loadLittleEndian(const uint8_t* p) {
+    T value;
+    std::memcpy(&value, p, sizeof(T));
+    return value;
+}
+
+uint64_t zigzag(int64_t value) {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+int64_t unzigzag(uint64_t value) {
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+// Serializes Thrift structs field by field; nested structs are opened with
+// structField (or beginStruct for list elements) and closed with endStruct
+class CompactWriter {
+public:
+    std::string out;
+    
+    void beginStruct() { lastField_.push_back(0); }
+    void endStruct() {
+        out += '\0';
+        lastField_.pop_back();
+    }
+    void structField(int16_t id) {
+        field(id, CT_STRUCT);
+        beginStruct();
+    }
+    void i32(int16_t id, int32_t value) {
+        field(id, CT_I32);
+        appendVarint(out, zigzag(value));
+    }
+    void i64(int16_t id, int64_t value) {
+        field(id, CT_I64);
+        appendVarint(out, zigzag(value));
+    }
+    void binary(int16_t id, const std::string& value) {
+        field(id, CT_BINARY);
+        element(value);
+    }
+    void list(int16_t id, uint8_t elementType, size_t size) {
+        field(id, CT_LIST);
+        if (size < 15) {
+            out += static_cast<char>(size << 4 | elementType);
+        } else {
+            out += static_cast<char>(0xF0 | elementType);
+            appendVarint(out, size);
+        }
+    }
+    void element(int32_t value) { appendVarint(out, zigzag(value)); }
+    void element(const std::string& value) {
+        appendVarint(out, value.size());
+        out += value;
+    }
+    
+private:
+    std::vector<int16_t> lastField_;
+    
+    void field(int16_t id, uint8_t type) {
+        int delta = id - lastField_.back();
+        if (delta > 0 && delta <= 15) {
+            out += static_cast<char>(delta << 4 | type);
+        } else {
+            out += static_cast<char>(type);
+            appendVarint(out, zigzag(id));
+        }
+        lastField_.back() = id;
+    }
+};
+
+// Reads Thrift structs; any malformed input clears ok() and ends every loop
+class CompactReader {
+public:
+    CompactReader(const uint8_t* begin, const uint8_t* end) : p_(begin), end_(end) {}
+    
+    bool ok() const { return ok_; }
+    const uint8_t* position() const { return p_; }
+    
+    // Next field of the current struct; false at its end
+    bool nextField(int16_t& lastId, int16_t& id, uint8_t& type) {
+        uint8_t header = byte();
+        if (!ok_ || header == 0) {
+            return false;
+        }
+        type = header & 0x0F;
+        id = (header >> 4) ? static_cast<int16_t>(lastId + (header >> 4)) : static_cast<int16_t>(integer());
+        lastId = id;
+        return ok_;
+    }
+    
+    int64_t integer() { return unzigzag(varint()); }
+    
+    std::string binary() {
+        uint64_t size = varint();
+        if (!ok_ || size > static_cast<uint64_t>(end_ - p_)) {
+            ok_ = false;
+            return std::string();
+        }
+        std::string value(reinterpret_cast<const char*>(p_), size);
+        p_ += size;
+        return value;
+    }
+    
+    void listHeader(uint8_t& elementType, size_t& size) {
+        uint8_t header = byte();
+        elementType = header & 0x0F;
+        size = header >> 4;
+        if (size == 15) {
+            size = varint();
+        }
+    }
+    
+    // Skips a field value; list elements store booleans in a byte
+    void skip(uint8_t type, bool element = false, int depth = 0) {
+        if (depth > MAX_NESTING) {
+            ok_ = false;
+            return;
+        }
+        switch (type) {
+            case CT_BOOL_TRUE:
+            case CT_BOOL_FALSE:
+                if (element) byte();
+                break;
+            case CT_BYTE:
+                byte();
+                break;
+            case CT_I16:
+            case CT_I32:
+            case CT_I64:
+                varint();
+                break;
+            case CT_DOUBLE:
+                advance(8);
+                break;
+            case CT_BINARY:
+                advance(varint());
+                break;
+            case CT_LIST:
+            case CT_SET: {
+                uint8_t elementType;
+                size_t size;
+                listHeader(elementType, size);
+                for (size_t i = 0; i < size && ok_; ++i) {
+                    skip(elementType, true, depth + 1);
+                }
+                break;
+            }
+            case CT_MAP: {
+                uint64_t size = varint();
+                uint8_t types = size > 0 ? byte() : 0;
+                for (uint64_t i = 0; i < size && ok_; ++i) {
+                    skip(types >> 4, true, depth + 1);
+                    skip(types & 0x0F, true, depth + 1);
+                }
+                break;
+            }
+            case CT_STRUCT: {
+                int16_t lastId = 0, id;
+                uint8_t fieldType;
+                while (nextField(lastId, id, fieldType)) {
+                    skip(fieldType, false, depth + 1);
+                }
+                break;
+            }
+            default:
+                ok_ = false;
+        }
+    }
+    
+private:
+    const uint8_t* p_;
+    const uint8_t* end_;
+    bool ok_ = true;
+    
+    uint8_t byte() {
+        if (p_ >= end_) {
+            ok_ = false;
+            return 0;
+        }
+        return *p_++;
+    }
+    uint64_t varint() {
+        uint64_t value;
+        if (!readVarint(p_, end_, value)) {
+            ok_ = false;
+            return 0;
+        }
+        return value;
+    }
+    void advance(uint64_t bytes) {
+        if (bytes > static_cast<uint64_t>(end_ - p_)) {
+            ok_ = false;
+            return;
+        }
+        p_ += bytes;
+    }
+};
+
+// Calls parse once per struct element of a list field
+template <typename Parse>
+void readStructList(CompactReader& in, uint8_t type, Parse&& parse) {
+    if (type != CT_LIST) {
+        in.skip(type);
+        return;
+    }
+    uint8_t elementType;
+    size_t size;
+    in.listHeader(elementType, size);
+    for (size_t i = 0; i < size && in.ok(); ++i) {
+        if (elementType == CT_STRUCT) {
+            parse();
+        } else {
+            in.skip(elementType, true);
+        }
+    }
+}
+
+struct SchemaElement {
+    std::string name;
+    int32_t type = -1;  // physical type; -1 for groups
+    int32_t repetition = REPETITION_REQUIRED;
+    int32_t children = 0;
+};
+
+struct ChunkMeta {
+    bool present = false;
+    int32_t type = -1;
+    int32_t codec = CODEC_UNCOMPRESSED;
+    int64_t values = 0;
+    int64_t dataPageOffset = -1;
+    int64_t dictionaryPageOffset = -1;
+};
+
+struct RowGroupMeta {
+    int64_t rows = 0;
+    std::vector<ChunkMeta> columns;
+};
+
+struct FileMeta {
+    std::vector<SchemaElement> schema;
+    std::vector<RowGroupMeta> rowGroups;
+};
+
+struct PageHeader {
+    int32_t type = -1;
+    int32_t uncompressedSize = 0;
+    int32_t compressedSize = 0;
+    int32_t values = 0;
+    int32_t encoding = ENCODING_PLAIN;
+    int32_t defLevelsBytes = 0;   // data page v2 only
+    int32_t repLevelsBytes = 0;
+    bool compressed = true;
+};
+
+void parseSchemaElement(CompactReader& in, SchemaElement& element) {
+    int16_t lastId = 0, id;
+    uint8_t type;
+    while (in.nextField(lastId, id, type)) {
+        switch (id) {
+            case 1: element.type = static_cast<int32_t>(in.integer()); break;
+            case 3: element.repetition = static_cast<int32_t>(in.integer()); break;
+            case 4: element.name = in.binary(); break;
+            case 5: element.children = static_cast<int32_t>(in.integer()); break;
+            default: in.skip(type);
+        }
+    }
+}
+
+void parseColumnMeta(CompactReader& in, ChunkMeta& chunk) {
+    chunk.present = true;
+    int16_t lastId = 0, id;
+    uint8_t type;
+    while (in.nextField(lastId, id, type)) {
+        switch (id) {
+            case 1: chunk.type = static_cast<int32_t>(in.integer()); break;
+            case 4: chunk.codec = static_cast<int32_t>(in.integer()); break;
+            case 5: chunk.values = in.integer(); break;
+            case 9: chunk.dataPageOffset = in.integer(); break;
+            case 11: chunk.dictionaryPageOffset = in.integer(); break;
+            default: in.skip(type);
+        }
+    }
+}
+
+void parseRowGroup(CompactReader& in, RowGroupMeta& rowGroup) {
+    int16_t lastId = 0, id;
+    uint8_t type;
+    while (in.nextField(lastId, id, type)) {
+        if (id == 1) {
+            readStructList(in, type, [&]() {
+                rowGroup.columns.emplace_back();
+                int16_t chunkLastId = 0, chunkId;
+                uint8_t chunkType;
+                while (in.nextField(chunkLastId, chunkId, chunkType)) {
+                    if (chunkId == 3 && chunkType == CT_STRUCT) {
+                        parseColumnMeta(in, rowGroup.columns.back());
+                    } else {
+                        in.skip(chunkType);
+                    }
+                }
+            });
+        } else if (id == 3) {
+            rowGroup.rows = in.integer();
+        } else {
+            in.skip(type);
+        }
+    }
+}
+
+bool parseFileMeta(CompactReader& in, FileMeta& meta) {
+    int16_t lastId = 0, id;
+    uint8_t type;
+    while (in.nextField(lastId, id, type)) {
+        if (id == 2) {
+            readStructList(in, type, [&]() {
+                meta.schema.emplace_back();
+                parseSchemaElement(in, meta.schema.back());
+            });
+        } else if (id == 4) {
+            readStructList(in, type, [&]() {
+                meta.rowGroups.emplace_back();
+                parseRowGroup(in, meta.rowGroups.back());
+            });
+        } else {
+            in.skip(type);
+        }
+    }
+    return in.ok();
+}
+
+bool parsePageHeader(CompactReader& in, PageHeader& header) {
+    int16_t lastId = 0, id;
+    uint8_t type;
+    while (in.nextField(lastId, id, type)) {
+        if (id == 1) {
+            header.type = static_cast<int32_t>(in.integer());
+        } else if (id == 2) {
+            header.uncompressedSize = static_cast<int32_t>(in.integer());
+        } else if (id == 3) {
+            header.compressedSize = static_cast<int32_t>(in.integer());
+        } else if ((id == 5 || id == 7 || id == 8) && type == CT_STRUCT) {
+            // Data page, dictionary page and data page v2 headers
+            int16_t pageLastId = 0, pageId;
+            uint8_t pageType;
+            while (in.nextField(pageLastId, pageId, pageType)) {
+                if (pageId == 1) {
+                    header.values = static_cast<int32_t>(in.integer());
+                } else if ((pageId == 2 && id != 8) || (pageId == 4 && id == 8)) {
+                    header.encoding = static_cast<int32_t>(in.integer());
+                } else if (pageId == 5 && id == 8) {
+                    header.defLevelsBytes = static_cast<int32_t>(in.integer());
+                } else if (pageId == 6 && id == 8) {
+                    header.repLevelsBytes = static_cast<int32_t>(in.integer());
+                } else if (pageId == 7 && id == 8) {
+                    header.compressed = pageType == CT_BOOL_TRUE;
+                } else {
+                    in.skip(pageType);
+                }
+            }
+        } else {
+            in.skip(type);
+        }
+    }
+    return in.ok();
+}
+
+// Raw Snappy block (no framing), as Parquet stores it
+bool snappyDecompress(const uint8_t* p, const uint8_t* end, size_t expected, std::string& out) {
+    uint64_t length;
+    if (!readVarint(p, end, length) || length != expected) {
+        return false;
+    }
+    out.clear();
+    out.reserve(length);
+    while (p < end) {
+        uint8_t tag = *p++;
+        size_t size;
+        size_t offset;
+        if ((tag & 3) == 0) {
+            // Literal; long lengths follow the tag in 1-4 bytes
+            size = tag >> 2;
+            if (size >= 60) {
+                size_t bytes = size - 59;
+                if (static_cast<size_t>(end - p) < bytes) return false;
+                size = 0;
+                for (size_t i = 0; i < bytes; ++i) {
+                    size |= static_cast<size_t>(p[i]) << (8 * i);
+                }
+                p += bytes;
+            }
+            size += 1;
+            if (static_cast<size_t>(end - p) < size || out.size() + size > length) return false;
+            out.append(reinterpret_cast<const char*>(p), size);
+            p += size;
+            continue;
+        }
+        if ((tag & 3) == 1) {
+            if (p >= end) return false;
+            size = ((tag >> 2) & 7) + 4;
+            offset = (static_cast<size_t>(tag >> 5) << 8) | *p++;
+        } else if ((tag & 3) == 2) {
+            if (end - p < 2) return false;
+            size = (tag >> 2) + 1;
+            offset = loadLittleEndian<uint16_t>(p);
+            p += 2;
+        } else {
+            if (end - p < 4) return false;
+            size = (tag >> 2) + 1;
+            offset = loadLittleEndian<uint32_t>(p);
+            p += 4;
+        }
+        if (offset == 0 || offset > out.size() || out.size() + size > length) return false;
+        // Copies may overlap their own output, so go byte by byte
+        size_t from = out.size() - offset;
+        for (size_t i = 0; i < size; ++i) {
+            out += out[from + i];
+        }
+    }
+    return out.size() == length;
+}
+
+#ifdef MINISQL_HAVE_ZLIB
+bool gzipCompress(const std::string& in, std::string& out) {
+    z_stream stream;
+    std::memset(&stream, 0, sizeof(stream));
+    // Fastest level: a few percent larger than the default, several times quicker
+    if (deflateInit2(&stream, Z_BEST_SPEED, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+    }
+    out.resize(deflateBound(&stream, in.size()));
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+    stream.avail_in = static_cast<uInt>(in.size());
+    stream.next_out = reinterpret_cast<Bytef*>(&out[0]);
+    stream.avail_out = static_cast<uInt>(out.size());
+    int status = deflate(&stream, Z_FINISH);
+    out.resize(stream.total_out);
+    deflateEnd(&stream);
+    return status == Z_STREAM_END;
+}
+
+bool gzipDecompress(const uint8_t* data, size_t size, size_t expected, std::string& out) {
+    z_stream stream;
+    std::memset(&stream, 0, sizeof(stream));
+    if (inflateInit2(&stream, 15 + 32) != Z_OK) {
+        return false;
+    }
+    // One spare byte, so an empty page still has an output buffer
+    out.resize(expected + 1);
+    stream.next_in = const_cast<Bytef*>(data);
+    stream.avail_in = static_cast<uInt>(size);
+    stream.next_out = reinterpret_cast<Bytef*>(&out[0]);
+    stream.avail_out = static_cast<uInt>(out.size());
+    int status = inflate(&stream, Z_FINISH);
+    bool ok = status == Z_STREAM_END && stream.total_out == expected;
+    inflateEnd(&stream);
+    out.resize(expected);
+    return ok;
+}
+#endif
+
+bool decompress(int32_t codec, const uint8_t* data, size_t size, size_t expected, std::string& out,
+                std::string& error) {
+    if (codec == CODEC_UNCOMPRESSED) {
+        out.assign(reinterpret_cast<const char*>(data), size);
+        return true;
+    }
+    if (codec == CODEC_SNAPPY) {
+        if (!snappyDecompress(data, data + size, expected, out)) {
+            error = "corrupt SNAPPY page";
+            return false;
+        }
+        return true;
+    }
+    if (codec == CODEC_GZIP) {
+#ifdef MINISQL_HAVE_ZLIB
+        if (!gzipDecompress(data, size, expected, out)) {
+            error = "corrupt GZIP page";
+            return false;
+        }
+        return true;
+#else
+        error = "GZIP pages need a build with zlib";
+        return false;
+#endif
+    }
+    error = "unsupported compression codec " + std::to_string(codec) + " (UNCOMPRESSED, SNAPPY and GZIP are)";
+    return false;
+}
+
+// count values of an RLE / bit-packed hybrid run sequence
+bool decodeHybrid(const uint8_t* p, const uint8_t* end, unsigned bitWidth, size_t count,
+                  std::vector<uint32_t>& out) {
+    out.clear();
+    if (bitWidth > 32) {
+        return false;
+    }
+    uint32_t mask = bitWidth == 32 ? 0xFFFFFFFFu : (1u << bitWidth) - 1;
+    size_t valueBytes = (bitWidth + 7) / 8;
+    while (out.size() < count) {
+        uint64_t header;
+        if (!readVarint(p, end, header)) {
+            return false;
+        }
+        if (header & 1) {
+            // Groups of 8 values packed LSB first; writers may cut the last group short
+            size_t bytes = std::min<uint64_t>((header >> 1) * bitWidth, end - p);
+            size_t values = std::min<uint64_t>((header >> 1) * 8, count - out.size());
+            if (bitWidth > 0 && values > bytes * 8 / bitWidth) {
+                values = bytes * 8 / bitWidth;
+            }
+            if (values == 0) {
+                return false;
+            }
+            for (size_t i = 0; i < values; ++i) {
+                size_t bit = i * bitWidth;
+                uint64_t word = 0;
+                for (size_t k = 0; k < 5 && (bit >> 3) + k < bytes; ++k) {
+                    word |= static_cast<uint64_t>(p[(bit >> 3) + k]) << (8 * k);
+                }
+                out.push_back(static_cast<uint32_t>(word >> (bit & 7)) & mask);
+            }
+            p += bytes;
+        } else {
+            size_t run = std::min<uint64_t>(header >> 1, count - out.size());
+            if (run == 0 || static_cast<size_t>(end - p) < valueBytes) {
+                return false;
+            }
+            uint32_t value = 0;
+            for (size_t i = 0; i < valueBytes; ++i) {
+                value |= static_cast<uint32_t>(p[i]) << (8 * i);
+            }
+            p += valueBytes;
+            out.insert(out.end(), run, value);
+        }
+    }
+    return true;
+}
+
+// count PLAIN values of a physical type as stored texts
+bool decodePlain(int32_t type, const uint8_t* p, const uint8_t* end, size_t count,
+                 std::vector<std::string>& out) {
+    size_t available = end - p;
+    size_t width = type == TYPE_INT32 || type == TYPE_FLOAT ? 4 : 8;
+    if (type == TYPE_BOOLEAN) {
+        if (available < (count + 7) / 8) return false;
+        for (size_t i = 0; i < count; ++i) {
+            out.push_back((p[i >> 3] >> (i & 7)) & 1 ? "true" : "false");
+        }
+        return true;
+    }
+    if (type == TYPE_BYTE_ARRAY) {
+        for (size_t i = 0; i < count; ++i) {
+            if (end - p < 4) return false;
+            uint32_t size = loadLittleEndian<uint32_t>(p);
+            p += 4;
+            if (static_cast<size_t>(end - p) < size) return false;
+            out.emplace_back(reinterpret_cast<const char*>(p), size);
+            p += size;
+        }
+        return true;
+    }
+    if (available / width < count) {
+        return false;
+    }
+    for (size_t i = 0; i < count; ++i, p += width) {
+        switch (type) {
+            case TYPE_INT32: out.push_back(std::to_string(loadLittleEndian<int32_t>(p))); break;
+            case TYPE_INT64: out.push_back(std::to_string(loadLittleEndian<int64_t>(p))); break;
+            case TYPE_FLOAT: out.push_back(formatDouble(loadLittleEndian<float>(p))); break;
+            default: out.push_back(formatDouble(loadLittleEndian<double>(p)));
+        }
+    }
+    return true;
+}
+
+// Every value of one column chunk, NULL as NULL_TEXT
+bool readColumnChunk(const std::string& file, const ChunkMeta& chunk, const SchemaElement& column,
+                     std::vector<std::string>& out, std::string& error) {
+    const uint8_t* base = reinterpret_cast<const uint8_t*>(file.data());
+    int64_t start = chunk.dataPageOffset;
+    if (chunk.dictionaryPageOffset > 0 && chunk.dictionaryPageOffset < start) {
+        start = chunk.dictionaryPageOffset;
+    }
+    if (start < static_cast<int64_t>(MAGIC_SIZE) || start >= static_cast<int64_t>(file.size())) {
+        error = "column chunk offset out of range";
+        return false;
+    }
+    bool optional = column.repetition == REPETITION_OPTIONAL;
+    size_t pos = static_cast<size_t>(start);
+    std::vector<std::string> dictionary;
+    bool haveDictionary = false;
+    std::string page;
+    std::vector<uint32_t> levels;
+    std::vector<uint32_t> indices;
+    std::vector<std::string> values;
+    out.clear();
+    while (out.size() < static_cast<uint64_t>(chunk.values)) {
+        CompactReader in(base + pos, base + file.size());
+        PageHeader header;
+        if (!parsePageHeader(in, header) || header.compressedSize < 0 || header.values < 0 ||
+            header.uncompressedSize < 0 ||
+            static_cast<size_t>(header.compressedSize) > file.size() - (in.position() - base)) {
+            error = "corrupt page header";
+            return false;
+        }
+        const uint8_t* data = in.position();
+        pos = (data - base) + header.compressedSize;
+        
+        if (header.type == PAGE_DICTIONARY) {
+            dictionary.clear();
+            if (!decompress(chunk.codec, data, header.compressedSize, header.uncompressedSize, page, error)) {
+                return false;
+            }
+            const uint8_t* p = reinterpret_cast<const uint8_t*>(page.data());
+            if (!decodePlain(column.type, p, p + page.size(), header.values, dictionary)) {
+                error = "corrupt dictionary page";
+                return false;
+            }
+            haveDictionary = true;
+            continue;
+        }
+        if (header.type != PAGE_DATA && header.type != PAGE_DATA_V2) {
+            continue;  // index pages
+        }
+        
+        // Locate the definition levels and the values
+        const uint8_t* levelsBegin = nullptr;
+        const uint8_t* levelsEnd = nullptr;
+        if (header.type == PAGE_DATA) {
+            if (!decompress(chunk.codec, data, header.compressedSize, header.uncompressedSize, page, error)) {
+                return false;
+            }
+            levelsBegin = reinterpret_cast<const uint8_t*>(page.data());
+            levelsEnd = levelsBegin;
+            if (optional) {
+                if (page.size() < 4 || loadLittleEndian<uint32_t>(levelsBegin) > page.size() - 4) {
+                    error = "corrupt definition levels";
+                    return false;
+                }
+                levelsEnd = levelsBegin + 4 + loadLittleEndian<uint32_t>(levelsBegin);
+                levelsBegin += 4;
+            }
+        } else {
+            // v2: uncompressed levels ahead of the (maybe compressed) values
+            if (header.repLevelsBytes != 0) {
+                error = "repeated values are not supported";
+                return false;
+            }
+            if (header.defLevelsBytes < 0 || header.defLevelsBytes > header.compressedSize ||
+                header.defLevelsBytes > header.uncompressedSize) {
+                error = "corrupt definition levels";
+                return false;
+            }
+            std::string levelBytes(reinterpret_cast<const char*>(data), header.defLevelsBytes);
+            const uint8_t* valuesData = data + header.defLevelsBytes;
+            size_t valuesSize = header.compressedSize - header.defLevelsBytes;
+            int32_t codec = header.compressed ? chunk.codec : CODEC_UNCOMPRESSED;
+            if (!decompress(codec, valuesData, valuesSize, header.uncompressedSize - header.defLevelsBytes,
+                            page, error)) {
+                return false;
+            }
+            page.insert(0, levelBytes);
+            levelsBegin = reinterpret_cast<const uint8_t*>(page.data());
+            levelsEnd = levelsBegin + header.defLevelsBytes;
+        }
+        const uint8_t* valuesEnd = reinterpret_cast<const uint8_t*>(page.data()) + page.size();
+        
+        size_t count = header.values;
+        size_t present = count;
+        if (optional) {
+            if (!decodeHybrid(levelsBegin, levelsEnd, 1, count, levels)) {
+                error = "corrupt definition levels";
+                return false;
+            }
+            present = 0;
+            for (uint32_t level : levels) {
+                present += level;
+            }
+        }
+        
+        values.clear();
+        const uint8_t* p = levelsEnd;
+        if (header.encoding == ENCODING_PLAIN) {
+            if (!decodePlain(column.type, p, valuesEnd, present, values)) {
+                error = "corrupt data page";
+                return false;
+            }
+        } else if (header.encoding == ENCODING_PLAIN_DICTIONARY || header.encoding == ENCODING_RLE_DICTIONARY) {
+            if (!haveDictionary) {
+                error = "dictionary-encoded page without a dictionary";
+                return false;
+            }
+            if (present > 0 && (p >= valuesEnd || !decodeHybrid(p + 1, valuesEnd, *p, present, indices))) {
+                error = "corrupt dictionary indices";
+                return false;
+            }
+            for (size_t i = 0; i < present; ++i) {
+                if (indices[i] >= dictionary.size()) {
+                    error = "dictionary index out of range";
+                    return false;
+                }
+                values.push_back(dictionary[indices[i]]);
+            }
+        } else if (header.encoding == ENCODING_RLE && column.type == TYPE_BOOLEAN) {
+            // Length-prefixed hybrid runs of 1-bit values (data page v2 writers)
+            if (valuesEnd - p < 4 || !decodeHybrid(p + 4, valuesEnd, 1, present, indices)) {
+                error = "corrupt data page";
+                return false;
+            }
+            for (size_t i = 0; i < present; ++i) {
+                values.push_back(indices[i] ? "true" : "false");
+            }
+        } else {
+            error = "unsupported encoding " + std::to_string(header.encoding) +
+                    " (PLAIN, RLE booleans and dictionary encodings are)";
+            return false;
+        }
+        
+        size_t next = 0;
+        for (size_t i = 0; i < count; ++i) {
+            if (!optional || levels[i]) {
+                out.push_back(std::move(values[next++]));
+            } else {
+                out.push_back(NULL_TEXT);
+            }
+        }
+    }
+    return true;
+}
+
+// What a written column chunk needs in the footer
+struct ChunkInfo {
+    int32_t codec = CODEC_UNCOMPRESSED;
+    int64_t offset = 0;
+    int64_t compressedSize = 0;
+    int64_t uncompressedSize = 0;
+    int64_t nulls = 0;
+    bool hasMinMax = false;
+    std::string min;
+    std::string max;
+};
+
+// Physical type for a column: numeric only when every value is, so each
+// text reads back unchanged
+int32_t columnType(const TableSnapshot& table, uint32_t column) {
+    bool integers = true;
+    bool reals = true;
+    for (const Row& row : table.rows) {
+        ValueType type = row.cells[column].type;
+        if (type == ValueType::TEXT) {
+            return TYPE_BYTE_ARRAY;
+        }
+        integers = integers && type != ValueType::DOUBLE;
+        reals = reals && type != ValueType::INT64;
+    }
+    if (integers) {
+        return TYPE_INT64;
+    }
+    return reals ? TYPE_DOUBLE : TYPE_BYTE_ARRAY;
+}
+
+// PLAIN page body for rows [begin, end) of one column: 4-byte length and
+// definition levels, then the non-null values. Fills the chunk statistics.
+void encodePage(const TableSnapshot& table, uint32_t column, int32_t type, size_t begin, size_t end,
+                std::string& body, ChunkInfo& info) {
+    size_t count = end - begin;
+    std::string presentBits((count + 7) / 8, '\0');
+    std::string values;
+    int64_t minInt = std::numeric_limits<int64_t>::max(), maxInt = std::numeric_limits<int64_t>::min();
+    double minReal = 0, maxReal = 0;
+    const std::string* minText = nullptr;
+    const std::string* maxText = nullptr;
+    for (size_t i = 0; i < count; ++i) {
+        const Row& row = table.rows[begin + i];
+        const Cell& cell = row.cells[column];
+        if (cell.type == ValueType::NULL_VALUE) {
+            ++info.nulls;
+            continue;
+        }
+        presentBits[i >> 3] |= static_cast<char>(1 << (i & 7));
+        if (type == TYPE_INT64) {
+            appendLittleEndian(values, cell.integer);
+            minInt = std::min(minInt, cell.integer);
+            maxInt = std::max(maxInt, cell.integer);
+        } else if (type == TYPE_DOUBLE) {
+            appendLittleEndian(values, cell.real);
+            if (!std::isnan(cell.real)) {
+                minReal = info.hasMinMax ? std::min(minReal, cell.real) : cell.real;
+                maxReal = info.hasMinMax ? std::max(maxReal, cell.real) : cell.real;
+                info.hasMinMax = true;
+            }
+        } else {
+            const std::string& text = row.values[column];
+            appendLittleEndian(values, static_cast<uint32_t>(text.size()));
+            values += text;
+            if (!minText || text < *minText) minText = &text;
+            if (!maxText || *maxText < text) maxText = &text;
+        }
+    }
+    
+    if (type == TYPE_INT64 && minInt <= maxInt) {
+        info.hasMinMax = true;
+        appendLittleEndian(info.min, minInt);
+        appendLittleEndian(info.max, maxInt);
+    } else if (type == TYPE_DOUBLE && info.hasMinMax) {
+        appendLittleEndian(info.min, minReal);
+        appendLittleEndian(info.max, maxReal);
+    } else if (minText) {
+        info.hasMinMax = true;
+        info.min = *minText;
+        info.max = *maxText;
+    }
+    
+    // Definition levels: one RLE run of 1s without NULLs, else bit-packed
+    std::string levels;
+    if (info.nulls == 0) {
+        appendVarint(levels, static_cast<uint64_t>(count) << 1);
+        levels += '\1';
+    } else {
+        appendVarint(levels, static_cast<uint64_t>(presentBits.size()) << 1 | 1);
+        levels += presentBits;
+    }
+    body.clear();
+    appendLittleEndian(body, static_cast<uint32_t>(levels.size()));
+    body += levels;
+    body += values;
+}
+
+void writeSchema(CompactWriter& meta, const TableSnapshot& table, const std::vector<int32_t>& types) {
+    meta.list(2, CT_STRUCT, table.columns.size() + 1);
+    meta.beginStruct();
+    meta.binary(4, "schema");
+    meta.i32(5, static_cast<int32_t>(table.columns.size()));
+    meta.endStruct();
+    for (size_t c = 0; c < table.columns.size(); ++c) {
+        meta.beginStruct();
+        meta.i32(1, types[c]);
+        meta.i32(3, REPETITION_OPTIONAL);
+        meta.binary(4, table.columns[c]);
+        if (types[c] == TYPE_BYTE_ARRAY) {
+            meta.i32(6, CONVERTED_UTF8);
+            meta.structField(10);  // logicalType: STRING
+            meta.structField(1);
+            meta.endStruct();
+            meta.endStruct();
+        }
+        meta.endStruct();
+    }
+}
+
+void writeColumnChunk(CompactWriter& meta, const std::string& name, int32_t type, int64_t rows,
+                      const ChunkInfo& info) {
+    meta.beginStruct();
+    meta.i64(2, info.offset);
+    meta.structField(3);
+    meta.i32(1, type);
+    meta.list(2, CT_I32, 2);
+    meta.element(ENCODING_PLAIN);
+    meta.element(ENCODING_RLE);
+    meta.list(3, CT_BINARY, 1);
+    meta.element(name);
+    meta.i32(4, info.codec);
+    meta.i64(5, rows);
+    meta.i64(6, info.uncompressedSize);
+    meta.i64(7, info.compressedSize);
+    meta.i64(9, info.offset);
+    meta.structField(12);  // statistics
+    meta.i64(3, info.nulls);
+    if (info.hasMinMax) {
+        meta.binary(5, info.max);
+        meta.binary(6, info.min);
+    }
+    meta.endStruct();
+    meta.endStruct();
+    meta.endStruct();
+}
+
+} // namespace
+
+bool ParquetFile::write(const std::string& path, const TableSnapshot& table, QueryControl& control,
+                        size_t& rowGroups, std::string& error) {
+    size_t columnCount = table.columns.size();
+    size_t rowCount = table.rows.size();
+    std::vector<int32_t> types;
+    for (uint32_t c = 0; c < columnCount; ++c) {
+        types.push_back(columnType(table, c));
+    }
+    
+    std::string tmpPath = path + ".tmp";
+    FILE* file = std::fopen(tmpPath.c_str(), "wb");
+    if (!file) {
+        error = "Cannot write '" + path + "'";
+        return false;
+    }
+    int64_t offset = 0;
+    bool ok = true;
+    auto put = [&](const std::string& bytes) {
+        ok = ok && std::fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+        offset += bytes.size();
+    };
+    put(std::string(MAGIC, MAGIC_SIZE));
+    
+    std::vector<std::vector<ChunkInfo>> chunks;
+    std::string body;
+    std::string compressed;
+    for (size_t begin = 0; begin < rowCount && ok; begin += ROW_GROUP_ROWS) {
+        // Polled once per row group, which takes tens of milliseconds
+        if (control.expired()) {
+            error = control.reason();
+            ok = false;
+            break;
+        }
+        size_t end = std::min(rowCount, begin + ROW_GROUP_ROWS);
+        chunks.emplace_back(columnCount);
+        for (uint32_t c = 0; c < columnCount; ++c) {
+            ChunkInfo& info = chunks.back()[c];
+            encodePage(table, c, types[c], begin, end, body, info);
+            const std::string* page = &body;
+#ifdef MINISQL_HAVE_ZLIB
+            // Compressed only where it pays: random keys barely shrink
+            if (gzipCompress(body, compressed) && compressed.size() < body.size()) {
+                info.codec = CODEC_GZIP;
+                page = &compressed;
+            }
+#endif
+            CompactWriter header;
+            header.beginStruct();
+            header.i32(1, PAGE_DATA);
+            header.i32(2, static_cast<int32_t>(body.size()));
+            header.i32(3, static_cast<int32_t>(page->size()));
+            header.structField(5);
+            header.i32(1, static_cast<int32_t>(end - begin));
+            header.i32(2, ENCODING_PLAIN);
+            header.i32(3, ENCODING_RLE);
+            header.i32(4, ENCODING_RLE);
+            header.endStruct();
+            header.endStruct();
+            
+            info.offset = offset;
+            info.uncompressedSize = header.out.size() + body.size();
+            info.compressedSize = header.out.size() + page->size();
+            put(header.out);
+            put(*page);
+        }
+    }
+    
+    CompactWriter meta;
+    meta.beginStruct();
+    meta.i32(1, 1);
+    writeSchema(meta, table, types);
+    meta.i64(3, static_cast<int64_t>(rowCount));
+    meta.list(4, CT_STRUCT, chunks.size());
+    for (size_t g = 0; g < chunks.size(); ++g) {
+        int64_t rows = static_cast<int64_t>(std::min(ROW_GROUP_ROWS, rowCount - g * ROW_GROUP_ROWS));
+        int64_t bytes = 0;
+        meta.beginStruct();
+        meta.list(1, CT_STRUCT, columnCount);
+        for (uint32_t c = 0; c < columnCount; ++c) {
+            writeColumnChunk(meta, table.columns[c], types[c], rows, chunks[g][c]);
+            bytes += chunks[g][c].uncompressedSize;
+        }
+        meta.i64(2, bytes);
+        meta.i64(3, rows);
+        meta.endStruct();
+    }
+    meta.binary(6, "minisql version 1.0");
+    // Type-defined column order makes readers trust min_value/max_value
+    meta.list(7, CT_STRUCT, columnCount);
+    for (size_t c = 0; c < columnCount; ++c) {
+        meta.beginStruct();
+        meta.structField(1);
+        meta.endStruct();
+        meta.endStruct();
+    }
+    meta.endStruct();
+    
+    put(meta.out);
+    std::string footer;
+    appendLittleEndian(footer, static_cast<uint32_t>(meta.out.size()));
+    footer.append(MAGIC, MAGIC_SIZE);
+    put(footer);
+    
+    ok = ok && std::fflush(file) == 0 && fsync(fileno(file)) == 0;
+    ok = std::fclose(file) == 0 && ok;
+    if (!ok || std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+        std::remove(tmpPath.c_str());
+        if (error.empty()) {
+            error = "Cannot write '" + path + "'";
+        }
+        return false;
+    }
+    rowGroups = chunks.size();
+    return true;
+}
+
+bool ParquetFile::read(const std::string& path, std::vector<std::string>& columns,
+                       std::vector<std::vector<std::string>>& rows, std::string& error) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        error = "Cannot open '" + path + "'";
+        return false;
+    }
+    in.seekg(0, std::ios::end);
+    std::string file(static_cast<size_t>(in.tellg()), '\0');
+    in.seekg(0);
+    in.read(&file[0], file.size());
+    if (!in || file.size() < 2 * MAGIC_SIZE + 4 || file.compare(0, MAGIC_SIZE, MAGIC) != 0 ||
+        file.compare(file.size() - MAGIC_SIZE, MAGIC_SIZE, MAGIC) != 0) {
+        error = "'" + path + "' is not a Parquet file";
+        return false;
+    }
+    
+    const uint8_t* base = reinterpret_cast<const uint8_t*>(file.data());
+    size_t footerAt = file.size() - MAGIC_SIZE - 4;
+    uint32_t metaSize = loadLittleEndian<uint32_t>(base + footerAt);
+    FileMeta meta;
+    if (metaSize > footerAt - MAGIC_SIZE) {
+        error = "'" + path + "' has a corrupt footer";
+        return false;
+    }
+    CompactReader metaReader(base + footerAt - metaSize, base + footerAt);
+    if (!parseFileMeta(metaReader, meta) || meta.schema.empty()) {
+        error = "'" + path + "' has a corrupt footer";
+        return false;
+    }
+    
+    // Flat schemas only: a root group whose children are all leaf columns
+    std::vector<SchemaElement> leaves(meta.schema.begin() + 1, meta.schema.end());
+    if (leaves.empty() || meta.schema[0].children != static_cast<int32_t>(leaves.size())) {
+        error = "'" + path + "' has nested columns, which are not supported";
+        return false;
+    }
+    for (const SchemaElement& leaf : leaves) {
+        if (leaf.children > 0 || leaf.type < 0) {
+            error = "column '" + leaf.name + "' is nested, which is not supported";
+            return false;
+        }
+        if (leaf.repetition != REPETITION_REQUIRED && leaf.repetition != REPETITION_OPTIONAL) {
+            error = "column '" + leaf.name + "' is repeated, which is not supported";
+            return false;
+        }
+        if (leaf.type != TYPE_BOOLEAN && leaf.type != TYPE_INT32 && leaf.type != TYPE_INT64 &&
+            leaf.type != TYPE_FLOAT && leaf.type != TYPE_DOUBLE && leaf.type != TYPE_BYTE_ARRAY) {
+            error = "column '" + leaf.name + "' has an unsupported physical type";
+            return false;
+        }
+    }
+    
+    columns.clear();
+    for (const SchemaElement& leaf : leaves) {
+        columns.push_back(leaf.name);
+    }
+    rows.clear();
+    std::vector<std::string> values;
+    for (const RowGroupMeta& rowGroup : meta.rowGroups) {
+        if (rowGroup.columns.size() != leaves.size()) {
+            error = "'" + path + "' has a row group with the wrong column count";
+            return false;
+        }
+        size_t first = rows.size();
+        for (size_t c = 0; c < leaves.size(); ++c) {
+            const ChunkMeta& chunk = rowGroup.columns[c];
+            if (!chunk.present || chunk.type != leaves[c].type) {
+                error = "column '" + leaves[c].name + "' has no usable chunk metadata";
+                return false;
+            }
+            if (!readColumnChunk(file, chunk, leaves[c], values, error)) {
+                error = "column '" + leaves[c].name + "': " + error;
+                return false;
+            }
+            if (values.size() != static_cast<uint64_t>(rowGroup.rows)) {
+                error = "column '" + leaves[c].name + "' has " + std::to_string(values.size()) +
+                        " values in a row group of " + std::to_string(rowGroup.rows) + " rows";
+                return false;
+            }
+            if (c == 0) {
+                rows.resize(first + values.size(), std::vector<std::string>(leaves.size()));
+            }
+            for (size_t i = 0; i < values.size(); ++i) {
+                rows[first + i][c] = std::move(values[i]);
+            }
+        }
+    }
+    return true;
+}
@@ -0,0 +1,35 @@
+#ifndef PARQUETFILE_H
+#define PARQUETFILE_H
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include "Storage.h"
+#include "QueryControl.h"
+
+// Tables as Apache Parquet files, for EXPORT and IMPORT.
+//
+// Written files hold row groups of ROW_GROUP_ROWS rows. Each column chunk
+// is one PLAIN data page with min/max and null-count statistics. It is
+// GZIP-compressed when zlib is available and that makes it smaller.
+// Columns whose cells are all INT64 or all DOUBLE get that physical type;
+// anything else is a UTF-8 BYTE_ARRAY of the stored text. NULLs are
+// definition level 0, so the file reads back to the same cells.
+//
+// The reader handles flat schemas written by other tools too: PLAIN and
+// dictionary encodings, data pages v1 and v2, and UNCOMPRESSED, SNAPPY and
+// GZIP chunks. The physical types are BOOLEAN, INT32, INT64, FLOAT, DOUBLE
+// and BYTE_ARRAY.
+class ParquetFile {
+public:
+    static constexpr size_t ROW_GROUP_ROWS = 131072;
+    
+    // Writes path atomically (a temporary file renamed into place)
+    static bool write(const std::string& path, const TableSnapshot& table, QueryControl& control,
+                      size_t& rowGroups, std::string& error);
+    // Reads every row as stored texts, NULL as NULL_TEXT
+    static bool read(const std::string& path, std::vector<std::string>& columns,
+                     std::vector<std::vector<std::string>>& rows, std::string& error);
+};
+
+#endif // PARQUETFILE_H
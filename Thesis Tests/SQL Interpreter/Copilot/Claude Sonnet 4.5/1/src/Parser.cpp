@@ -1,10 +1,156 @@
 #include "Parser.h"
 #include "Utils.h"
+#include <cstdlib>
 
-Parser::Parser(const std::vector<Token>& tokens)
-    : tokens_(tokens), current_(0) {}
+Parser::Parser(const std::vector<Token>& tokens, const Catalog* catalog)
+    : tokens_(tokens), catalog_(catalog), current_(0) {}
 
 std::unique_ptr<Statement> Parser::parseStatement() {
+    std::unique_ptr<Statement> stmt = parseAnyStatement();
+    if (stmt && catalog_) {
+        bind(*stmt, *catalog_);
+    }
+    return stmt;
+}
+
+// Resolve table and column names to catalog ids; unknown names stay INVALID_ID
+void Parser::bind(Statement& statement, const Catalog& catalog) {
+    switch (statement.type()) {
+        case StatementType::INSERT: {
+            auto& stmt = static_cast<InsertStatement&>(statement);
+            stmt.tableId = catalog.findTable(stmt.tableName);
+            break;
+        }
+        case StatementType::SELECT:
+            bindSelect(static_cast<SelectStatement&>(statement), catalog);
+            break;
+        case StatementType::EXPLAIN:
+            bindSelect(*static_cast<ExplainStatement&>(statement).select, catalog);
+            break;
+        case StatementType::CREATE_VIEW:
+            bindSelect(*static_cast<CreateViewStatement&>(statement).select, catalog);
+            break;
+        case StatementType::ANALYZE: {
+            auto& stmt = static_cast<AnalyzeStatement&>(statement);
+            stmt.tableId = catalog.findTable(stmt.tableName);
+            break;
+        }
+        case StatementType::EXPORT: {
+            auto& stmt = static_cast<ExportStatement&>(statement);
+            stmt.tableId = catalog.findTable(stmt.tableName);
+            break;
+        }
+        case StatementType::IMPORT: {
+            auto& stmt = static_cast<ImportStatement&>(statement);
+            stmt.tableId = catalog.findTable(stmt.tableName);
+            break;
+        }
+        case StatementType::CREATE_INDEX: {
+            auto& stmt = static_cast<CreateIndexStatement&>(statement);
+            stmt.tableId = catalog.findTable(stmt.tableName);
+            if (stmt.tableId != INVALID_ID) {
+                stmt.columnId = catalog.findColumn(stmt.tableId, stmt.column);
+            }
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+void Parser::bindSelect(SelectStatement& stmt, const Catalog& catalog) {
+    // CTE names are only bound once the engine has materialized them
+    for (CommonTableExpr& cte : stmt.with) {
+        bindSelect(*cte.select, catalog);
+    }
+    for (Condition& condition : stmt.where) {
+        if (condition.subquery) {
+            bindSelect(*condition.subquery, catalog);
+        }
+    }
+    stmt.tableId = catalog.findTable(stmt.tableName);
+    stmt.viewId = stmt.tableId == INVALID_ID ? catalog.findView(stmt.tableName) : INVALID_ID;
+    stmt.columnIds.clear();
+    stmt.groupIds.clear();
+    if (stmt.viewId != INVALID_ID) {
+        for (const std::string& column : stmt.columns) {
+            stmt.columnIds.push_back(catalog.findViewColumn(stmt.viewId, column));
+        }
+        for (Condition& condition : stmt.where) {
+            condition.columnId = catalog.findViewColumn(stmt.viewId, condition.column);
+        }
+    }
+    if (stmt.joined()) {
+        stmt.join.tableId = catalog.findTable(stmt.join.tableName);
+        stmt.join.leftColumnId = resolveColumn(stmt, catalog, stmt.join.leftColumn);
+        stmt.join.rightColumnId = resolveColumn(stmt, catalog, stmt.join.rightColumn);
+    }
+    if (stmt.tableId != INVALID_ID) {
+        for (const std::string& column : stmt.columns) {
+            stmt.columnIds.push_back(resolveColumn(stmt, catalog, column));
+        }
+        for (Condition& condition : stmt.where) {
+            condition.columnId = resolveColumn(stmt, catalog, condition.column);
+        }
+        for (WindowCall& call : stmt.windows) {
+            call.argumentId = call.argument.empty() ? INVALID_ID : resolveColumn(stmt, catalog, call.argument);
+            call.partitionIds.clear();
+            for (const std::string& column : call.partitionBy) {
+                call.partitionIds.push_back(resolveColumn(stmt, catalog, column));
+            }
+            for (SortKey& key : call.orderBy) {
+                key.columnId = resolveColumn(stmt, catalog, key.column);
+            }
+        }
+        for (WindowCall& call : stmt.aggregates) {
+            call.argumentId = call.argument.empty() ? INVALID_ID : resolveColumn(stmt, catalog, call.argument);
+        }
+        for (const std::string& column : stmt.groupBy) {
+            stmt.groupIds.push_back(resolveColumn(stmt, catalog, column));
+        }
+    }
+}
+
+// A column of the FROM table, optionally written table.column; with a JOIN,
+// columns of the joined table follow the FROM table's. INVALID_ID if the name
+// is unknown, or unqualified and present in both tables.
+uint32_t Parser::resolveColumn(const SelectStatement& stmt, const Catalog& catalog, const std::string& name) {
+    std::string column = name;
+    TableId qualifier = INVALID_ID;
+    size_t dot = name.find('.');
+    if (dot != std::string::npos) {
+        qualifier = catalog.findTable(name.substr(0, dot));
+        column = name.substr(dot + 1);
+        if (qualifier == INVALID_ID) {
+            return INVALID_ID;
+        }
+    }
+    
+    uint32_t left = INVALID_ID;
+    if (qualifier == INVALID_ID || qualifier == stmt.tableId) {
+        left = catalog.findColumn(stmt.tableId, column);
+    }
+    if (!stmt.joined() || stmt.join.tableId == INVALID_ID) {
+        return qualifier == INVALID_ID || qualifier == stmt.tableId ? left : INVALID_ID;
+    }
+    
+    uint32_t right = INVALID_ID;
+    if (qualifier == INVALID_ID || qualifier == stmt.join.tableId) {
+        right = catalog.findColumn(stmt.join.tableId, column);
+    }
+    if (qualifier != INVALID_ID && qualifier == stmt.tableId && qualifier == stmt.join.tableId) {
+        return INVALID_ID;  // a self-join cannot tell the two sides apart
+    }
+    if (left != INVALID_ID && right != INVALID_ID) {
+        return INVALID_ID;
+    }
+    if (right != INVALID_ID) {
+        return static_cast<uint32_t>(catalog.table(stmt.tableId).columns.size()) + right;
+    }
+    return left;
+}
+
+std::unique_ptr<Statement> Parser::parseAnyStatement() {
     if (isAtEnd()) {
         error_ = "Unexpected end of input";
         return nullptr;
@@ -13,13 +159,22 @@ std::unique_ptr<Statement> Parser::parseStatement() {
     const Token& token = currentToken();
     
     if (token.type == TokenType::CREATE) {
-        return parseCreateTable();
+        return parseCreate();
     } else if (token.type == TokenType::INSERT) {
         return parseInsert();
-    } else if (token.type == TokenType::SELECT) {
+    } else if (token.type == TokenType::SELECT || startsQuery()) {
         return parseSelect();
+    } else if (token.type == TokenType::ANALYZE) {
+        return parseAnalyze();
+    } else if (token.type == TokenType::EXPLAIN) {
+        return parseExplain();
+    } else if (token.type == TokenType::IDENTIFIER &&
+               (Utils::toLower(token.value) == "export" || Utils::toLower(token.value) == "import")) {
+        return parseTransfer();
+    } else if (token.type == TokenType::IDENTIFIER && Utils::toLower(token.value) == "show") {
+        return parseShow();
     } else {
-        error_ = "Expected CREATE, INSERT, or SELECT statement";
+        error_ = "Expected CREATE, INSERT, SELECT, ANALYZE, EXPLAIN, EXPORT, IMPORT or SHOW statement";
         return nullptr;
     }
 }
@@ -71,6 +226,24 @@ bool Parser::expect(TokenType type, const std::string& message) {
     return false;
 }
 
+bool Parser::matchWord(const std::string& word) {
+    if (check(TokenType::IDENTIFIER) && Utils::toLower(currentToken().value) == word) {
+        advance();
+        return true;
+    }
+    return false;
+}
+
+std::unique_ptr<Statement> Parser::parseCreate() {
+    if (peek().type == TokenType::INDEX) {
+        return parseCreateIndex();
+    }
+    if (peek().type == TokenType::IDENTIFIER && Utils::toLower(peek().value) == "materialized") {
+        return parseCreateView();
+    }
+    return parseCreateTable();
+}
+
 std::unique_ptr<CreateTableStatement> Parser::parseCreateTable() {
     auto stmt = std::make_unique<CreateTableStatement>();
     
@@ -89,7 +262,7 @@ std::unique_ptr<CreateTableStatement> Parser::parseCreateTable() {
         error_ = "Expected table name";
         return nullptr;
     }
-    stmt->tableName = Utils::toLower(currentToken().value);
+    stmt->tableName = currentToken().value;
     advance();
     
     // (
@@ -97,9 +270,8 @@ std::unique_ptr<CreateTableStatement> Parser::parseCreateTable() {
         return nullptr;
     }
     
-    // column list
-    stmt->columns = parseColumnList();
-    if (hasError()) {
+    // column definitions
+    if (!parseColumnDefinitions(*stmt)) {
         return nullptr;
     }
     
@@ -108,6 +280,11 @@ std::unique_ptr<CreateTableStatement> Parser::parseCreateTable() {
         return nullptr;
     }
     
+    // [PARTITION BY ...]
+    if (check(TokenType::PARTITION) && !parsePartitionClause(*stmt)) {
+        return nullptr;
+    }
+    
     // ;
     if (!expect(TokenType::SEMICOLON, "Expected ';'")) {
         return nullptr;
@@ -116,6 +293,120 @@ std::unique_ptr<CreateTableStatement> Parser::parseCreateTable() {
     return stmt;
 }
 
+// col [PRIMARY KEY], ... [, PRIMARY KEY (col)]
+bool Parser::parseColumnDefinitions(CreateTableStatement& stmt) {
+    do {
+        if (!check(TokenType::IDENTIFIER)) {
+            error_ = stmt.columns.empty() ? "Expected column name" : "Expected column name after ','";
+            return false;
+        }
+        
+        // Table constraint: PRIMARY KEY (col)
+        if (Utils::toLower(currentToken().value) == "primary" &&
+            peek().type == TokenType::IDENTIFIER && Utils::toLower(peek().value) == "key" &&
+            peek(2).type == TokenType::LEFT_PAREN) {
+            advance();
+            advance();
+            advance();
+            if (!check(TokenType::IDENTIFIER)) {
+                error_ = "Expected primary key column";
+                return false;
+            }
+            if (!stmt.primaryKey.empty()) {
+                error_ = "Multiple primary keys are not allowed";
+                return false;
+            }
+            stmt.primaryKey = currentToken().value;
+            advance();
+            if (!expect(TokenType::RIGHT_PAREN, "Expected ')'")) {
+                return false;
+            }
+            continue;
+        }
+        
+        stmt.columns.push_back(currentToken().value);
+        advance();
+        
+        // Column constraint: col PRIMARY KEY
+        if (matchWord("primary")) {
+            if (!matchWord("key")) {
+                error_ = "Expected KEY after PRIMARY";
+                return false;
+            }
+            if (!stmt.primaryKey.empty()) {
+                error_ = "Multiple primary keys are not allowed";
+                return false;
+            }
+            stmt.primaryKey = stmt.columns.back();
+        }
+    } while (match(TokenType::COMMA));
+    
+    if (stmt.columns.empty()) {
+        error_ = "Expected column name";
+        return false;
+    }
+    return true;
+}
+
+// PARTITION BY HASH (column) PARTITIONS n
+// PARTITION BY RANGE (column) BOUNDS (v1, v2, ...)
+bool Parser::parsePartitionClause(CreateTableStatement& stmt) {
+    if (!expect(TokenType::PARTITION, "Expected PARTITION") ||
+        !expect(TokenType::BY, "Expected BY")) {
+        return false;
+    }
+    
+    if (matchWord("hash")) {
+        stmt.partitionKind = PartitionKind::HASH;
+    } else if (matchWord("range")) {
+        stmt.partitionKind = PartitionKind::RANGE;
+    } else {
+        error_ = "Expected HASH or RANGE after PARTITION BY";
+        return false;
+    }
+    
+    if (!expect(TokenType::LEFT_PAREN, "Expected '('")) {
+        return false;
+    }
+    if (!check(TokenType::IDENTIFIER)) {
+        error_ = "Expected partition column";
+        return false;
+    }
+    stmt.partitionColumn = currentToken().value;
+    advance();
+    if (!expect(TokenType::RIGHT_PAREN, "Expected ')'")) {
+        return false;
+    }
+    
+    if (stmt.partitionKind == PartitionKind::HASH) {
+        if (!matchWord("partitions")) {
+            error_ = "Expected PARTITIONS";
+            return false;
+        }
+        if (!check(TokenType::NUMBER)) {
+            error_ = "Expected partition count";
+            return false;
+        }
+        stmt.partitionCount = static_cast<uint32_t>(std::strtoul(currentToken().value.c_str(), nullptr, 10));
+        advance();
+        return true;
+    }
+    
+    if (!matchWord("bounds")) {
+        error_ = "Expected BOUNDS";
+        return false;
+    }
+    if (!expect(TokenType::LEFT_PAREN, "Expected '('")) {
+        return false;
+    }
+    stmt.partitionBounds = parseValueList();
+    if (hasError()) {
+        return false;
+    }
+    stmt.partitionCount = static_cast<uint32_t>(stmt.partitionBounds.size() + 1);
+    return expect(TokenType::RIGHT_PAREN, "Expected ')'");
+}
+
 std::unique_ptr<InsertStatement> Parser::parseInsert() {
     auto stmt = std::make_unique<InsertStatement>();
     
@@ -134,7 +425,7 @@ std::unique_ptr<InsertStatement> Parser::parseInsert() {
         error_ = "Expected table name";
         return nullptr;
     }
-    stmt->tableName = Utils::toLower(currentToken().value);
+    stmt->tableName = currentToken().value;
     advance();
     
     // VALUES
@@ -158,6 +449,11 @@ std::unique_ptr<InsertStatement> Parser::parseInsert() {
         return nullptr;
     }
     
+    // [ON CONFLICT ...]
+    if (check(TokenType::ON) && !parseConflictClause(*stmt)) {
+        return nullptr;
+    }
+    
     // ;
     if (!expect(TokenType::SEMICOLON, "Expected ';'")) {
         return nullptr;
@@ -166,17 +462,128 @@ std::unique_ptr<InsertStatement> Parser::parseInsert() {
     return stmt;
 }
 
+// ON CONFLICT [(column)] DO UPDATE
+// ON CONFLICT [(column)] DO NOTHING
+bool Parser::parseConflictClause(InsertStatement& stmt) {
+    if (!expect(TokenType::ON, "Expected ON") || !matchWord("conflict")) {
+        error_ = "Expected CONFLICT after ON";
+        return false;
+    }
+    
+    if (match(TokenType::LEFT_PAREN)) {
+        if (!check(TokenType::IDENTIFIER)) {
+            error_ = "Expected conflict column";
+            return false;
+        }
+        stmt.conflictColumn = currentToken().value;
+        advance();
+        if (!expect(TokenType::RIGHT_PAREN, "Expected ')'")) {
+            return false;
+        }
+    }
+    
+    if (!matchWord("do")) {
+        error_ = "Expected DO";
+        return false;
+    }
+    if (matchWord("update")) {
+        stmt.onConflict = ConflictAction::UPDATE;
+    } else if (matchWord("nothing")) {
+        stmt.onConflict = ConflictAction::NOTHING;
+    } else {
+        error_ = "Expected UPDATE or NOTHING after DO";
+        return false;
+    }
+    return true;
+}
+
 std::unique_ptr<SelectStatement> Parser::parseSelect() {
+    std::unique_ptr<SelectStatement> stmt = parseQuery();
+    if (!stmt) {
+        return nullptr;
+    }
+    
+    // ;
+    if (!expect(TokenType::SEMICOLON, "Expected ';'")) {
+        return nullptr;
+    }
+    
+    return stmt;
+}
+
+bool Parser::startsQuery() const {
+    return check(TokenType::SELECT) ||
+           (check(TokenType::IDENTIFIER) && Utils::toLower(currentToken().value) == "with");
+}
+
+// WITH name [(column, ...)] AS (query), ...
+bool Parser::parseWithClause(SelectStatement& stmt) {
+    do {
+        CommonTableExpr cte;
+        if (!check(TokenType::IDENTIFIER)) {
+            error_ = "Expected name in WITH clause";
+            return false;
+        }
+        cte.name = currentToken().value;
+        advance();
+        if (match(TokenType::LEFT_PAREN)) {
+            cte.columns = parseColumnList();
+            if (hasError() || !expect(TokenType::RIGHT_PAREN, "Expected ')' after WITH column list")) {
+                return false;
+            }
+        }
+        if (!matchWord("as")) {
+            error_ = "Expected AS after WITH " + cte.name;
+            return false;
+        }
+        cte.select = parseSubquery();
+        if (!cte.select) {
+            return false;
+        }
+        stmt.with.push_back(std::move(cte));
+    } while (match(TokenType::COMMA));
+    return true;
+}
+
+// ( [WITH ...] SELECT ... )
+std::shared_ptr<SelectStatement> Parser::parseSubquery() {
+    if (!expect(TokenType::LEFT_PAREN, "Expected '(' before subquery")) {
+        return nullptr;
+    }
+    if (!startsQuery()) {
+        error_ = "Expected SELECT in subquery";
+        return nullptr;
+    }
+    std::shared_ptr<SelectStatement> query = parseQuery();
+    if (!query || !expect(TokenType::RIGHT_PAREN, "Expected ')' after subquery")) {
+        return nullptr;
+    }
+    return query;
+}
+
+// A SELECT without its ';', as used by statements, CTEs and subqueries
+std::unique_ptr<SelectStatement> Parser::parseQuery() {
     auto stmt = std::make_unique<SelectStatement>();
     
+    // Optional WITH clause
+    if (matchWord("with") && !parseWithClause(*stmt)) {
+        return nullptr;
+    }
+    
     // SELECT
     if (!expect(TokenType::SELECT, "Expected SELECT")) {
         return nullptr;
     }
     
-    // *
-    if (!expect(TokenType::ASTERISK, "Expected '*'")) {
-        return nullptr;
+    // * or select list
+    if (!match(TokenType::ASTERISK)) {
+        if (!check(TokenType::IDENTIFIER)) {
+            error_ = "Expected '*' or column list (got: " + currentToken().value + ")";
+            return nullptr;
+        }
+        if (!parseSelectList(*stmt)) {
+            return nullptr;
+        }
     }
     
     // FROM
@@ -189,34 +596,198 @@ std::unique_ptr<SelectStatement> Parser::parseSelect() {
         error_ = "Expected table name";
         return nullptr;
     }
-    stmt->tableName = Utils::toLower(currentToken().value);
+    stmt->tableName = currentToken().value;
     advance();
     
-    // Optional WHERE clause
-    if (match(TokenType::WHERE)) {
-        stmt->hasWhere = true;
-        
-        // column name
+    // Optional [INNER] JOIN table ON column = column
+    bool inner = matchWord("inner");
+    if (matchWord("join")) {
         if (!check(TokenType::IDENTIFIER)) {
-            error_ = "Expected column name in WHERE clause";
+            error_ = "Expected table name after JOIN";
             return nullptr;
         }
-        stmt->whereColumn = Utils::toLower(currentToken().value);
+        stmt->join.tableName = currentToken().value;
         advance();
-        
-        // =
-        if (!expect(TokenType::EQUALS, "Expected '=' in WHERE clause")) {
+        if (!expect(TokenType::ON, "Expected ON after JOIN table")) {
             return nullptr;
         }
-        
-        // value
-        if (!check(TokenType::IDENTIFIER) && !check(TokenType::STRING_LITERAL) && !check(TokenType::NUMBER)) {
-            error_ = "Expected value in WHERE clause";
+        if (!check(TokenType::IDENTIFIER)) {
+            error_ = "Expected column name after ON";
             return nullptr;
         }
-        stmt->whereValue = currentToken().value;
+        stmt->join.leftColumn = currentToken().value;
         advance();
+        if (!expect(TokenType::EQUALS, "Only equality joins are supported (expected '=')")) {
+            return nullptr;
+        }
+        if (!check(TokenType::IDENTIFIER)) {
+            error_ = "Expected column name after '='";
+            return nullptr;
+        }
+        stmt->join.rightColumn = currentToken().value;
+        advance();
+    } else if (inner) {
+        error_ = "Expected JOIN after INNER";
+        return nullptr;
+    }
+    
+    // Optional WHERE clause: cond [AND cond]*
+    if (match(TokenType::WHERE)) {
+        do {
+            Condition condition;
+            if (!parseCondition(condition)) {
+                return nullptr;
+            }
+            stmt->where.push_back(std::move(condition));
+        } while (match(TokenType::AND));
+    }
+    
+    // Optional GROUP BY column, ...
+    if (matchWord("group")) {
+        if (!expect(TokenType::BY, "Expected BY after GROUP")) {
+            return nullptr;
+        }
+        stmt->groupBy = parseColumnList();
+        if (hasError()) {
+            return nullptr;
+        }
+    }
+    
+    return stmt;
+}
+
+bool Parser::parseCondition(Condition& condition) {
+    // column name
+    if (!check(TokenType::IDENTIFIER)) {
+        error_ = "Expected column name in WHERE clause";
+        return false;
+    }
+    condition.column = currentToken().value;
+    advance();
+    
+    // IN (SELECT ...)
+    if (matchWord("in")) {
+        condition.op = CompareOp::IN;
+        condition.subquery = parseSubquery();
+        return condition.subquery != nullptr;
+    }
+    
+    // IS [NOT] NULL
+    if (match(TokenType::IS)) {
+        condition.op = match(TokenType::NOT) ? CompareOp::IS_NOT_NULL : CompareOp::IS_NULL;
+        if (!expect(TokenType::NULL_KEYWORD, "Expected NULL after IS")) {
+            return false;
+        }
+        return true;
+    }
+    
+    // = / <> / < / <= / > / >= / LIKE / ILIKE
+    static const struct {
+        TokenType token;
+        CompareOp op;
+    } operators[] = {
+        {TokenType::EQUALS, CompareOp::EQUALS},
+        {TokenType::NOT_EQUALS, CompareOp::NOT_EQUALS},
+        {TokenType::LESS, CompareOp::LESS},
+        {TokenType::LESS_EQUAL, CompareOp::LESS_EQUAL},
+        {TokenType::GREATER, CompareOp::GREATER},
+        {TokenType::GREATER_EQUAL, CompareOp::GREATER_EQUAL},
+        {TokenType::LIKE, CompareOp::LIKE},
+        {TokenType::ILIKE, CompareOp::ILIKE}
+    };
+    bool found = false;
+    for (const auto& entry : operators) {
+        if (match(entry.token)) {
+            condition.op = entry.op;
+            found = true;
+            break;
+        }
+    }
+    if (!found) {
+        error_ = "Expected comparison operator, LIKE, ILIKE, IN or IS in WHERE clause (got: " +
+                 currentToken().value + ")";
+        return false;
+    }
+    
+    // value, or a scalar subquery
+    if (check(TokenType::LEFT_PAREN)) {
+        if (condition.op == CompareOp::LIKE || condition.op == CompareOp::ILIKE) {
+            error_ = "LIKE and ILIKE need a literal pattern";
+            return false;
+        }
+        condition.subquery = parseSubquery();
+        return condition.subquery != nullptr;
+    }
+    if (!parseLiteral(condition.value)) {
+        error_ = "Expected value in WHERE clause";
+        return false;
+    }
+    return true;
+}
+
+bool Parser::parseLiteral(Value& value) {
+    if (check(TokenType::NUMBER) || check(TokenType::STRING_LITERAL) || check(TokenType::NULL_KEYWORD)) {
+        value = currentToken().literal;
+    } else if (check(TokenType::IDENTIFIER)) {
+        value = Value::fromText(currentToken().value);  // bare words are text
+    } else {
+        return false;
+    }
+    advance();
+    return true;
+}
+
+std::unique_ptr<CreateIndexStatement> Parser::parseCreateIndex() {
+    auto stmt = std::make_unique<CreateIndexStatement>();
+    
+    // CREATE INDEX
+    if (!expect(TokenType::CREATE, "Expected CREATE") || !expect(TokenType::INDEX, "Expected INDEX")) {
+        return nullptr;
+    }
+    
+    // index_name
+    if (!check(TokenType::IDENTIFIER)) {
+        error_ = "Expected index name";
+        return nullptr;
+    }
+    stmt->indexName = currentToken().value;
+    advance();
+    
+    // ON table_name
+    if (!expect(TokenType::ON, "Expected ON")) {
+        return nullptr;
+    }
+    if (!check(TokenType::IDENTIFIER)) {
+        error_ = "Expected table name";
+        return nullptr;
+    }
+    stmt->tableName = currentToken().value;
+    advance();
+    
+    // ( column )
+    if (!expect(TokenType::LEFT_PAREN, "Expected '('")) {
+        return nullptr;
+    }
+    if (!check(TokenType::IDENTIFIER)) {
+        error_ = "Expected column name";
+        return nullptr;
     }
+    stmt->column = currentToken().value;
+    advance();
+    if (!expect(TokenType::RIGHT_PAREN, "Expected ')'")) {
+        return nullptr;
+    }
+    
+    // USING method
+    if (!expect(TokenType::USING, "Expected USING")) {
+        return nullptr;
+    }
+    if (!check(TokenType::IDENTIFIER)) {
+        error_ = "Expected index method";
+        return nullptr;
+    }
+    stmt->method = Utils::toLower(currentToken().value);
+    advance();
     
     // ;
     if (!expect(TokenType::SEMICOLON, "Expected ';'")) {
@@ -226,6 +797,279 @@ std::unique_ptr<SelectStatement> Parser::parseSelect() {
     return stmt;
 }
 
+std::unique_ptr<CreateViewStatement> Parser::parseCreateView() {
+    auto stmt = std::make_unique<CreateViewStatement>();
+    
+    // CREATE MATERIALIZED VIEW
+    if (!expect(TokenType::CREATE, "Expected CREATE") || !matchWord("materialized")) {
+        error_ = "Expected MATERIALIZED";
+        return nullptr;
+    }
+    if (!matchWord("view")) {
+        error_ = "Expected VIEW after MATERIALIZED";
+        return nullptr;
+    }
+    
+    // view_name
+    if (!check(TokenType::IDENTIFIER)) {
+        error_ = "Expected view name";
+        return nullptr;
+    }
+    stmt->viewName = currentToken().value;
+    advance();
+    
+    // AS SELECT ...;
+    if (!matchWord("as")) {
+        error_ = "Expected AS";
+        return nullptr;
+    }
+    if (!check(TokenType::SELECT)) {
+        error_ = "Expected SELECT after AS";
+        return nullptr;
+    }
+    stmt->select = parseSelect();
+    if (!stmt->select) {
+        return nullptr;
+    }
+    
+    return stmt;
+}
+
+std::unique_ptr<AnalyzeStatement> Parser::parseAnalyze() {
+    auto stmt = std::make_unique<AnalyzeStatement>();
+    
+    // ANALYZE
+    if (!expect(TokenType::ANALYZE, "Expected ANALYZE")) {
+        return nullptr;
+    }
+    
+    // table_name
+    if (!check(TokenType::IDENTIFIER)) {
+        error_ = "Expected table name";
+        return nullptr;
+    }
+    stmt->tableName = currentToken().value;
+    advance();
+    
+    // ;
+    if (!expect(TokenType::SEMICOLON, "Expected ';'")) {
+        return nullptr;
+    }
+    
+    return stmt;
+}
+
+// SHOW TABLES
+std::unique_ptr<Statement> Parser::parseShow() {
+    if (!matchWord("show") || !matchWord("tables")) {
+        error_ = "Expected SHOW TABLES";
+        return nullptr;
+    }
+    if (!expect(TokenType::SEMICOLON, "Expected ';'")) {
+        return nullptr;
+    }
+    return std::make_unique<ShowTablesStatement>();
+}
+
+// EXPORT TABLE name TO 'file' | IMPORT TABLE name FROM 'file'
+std::unique_ptr<Statement> Parser::parseTransfer() {
+    bool exporting = matchWord("export");
+    if (!exporting && !matchWord("import")) {
+        error_ = "Expected EXPORT or IMPORT";
+        return nullptr;
+    }
+    if (!expect(TokenType::TABLE, "Expected TABLE")) {
+        return nullptr;
+    }
+    if (!check(TokenType::IDENTIFIER)) {
+        error_ = "Expected table name";
+        return nullptr;
+    }
+    std::string tableName = currentToken().value;
+    advance();
+    
+    if (exporting ? !matchWord("to") : !match(TokenType::FROM)) {
+        error_ = exporting ? "Expected TO" : "Expected FROM";
+        return nullptr;
+    }
+    if (!check(TokenType::STRING_LITERAL)) {
+        error_ = "Expected a quoted file name";
+        return nullptr;
+    }
+    std::string file = currentToken().value;
+    advance();
+    
+    if (!expect(TokenType::SEMICOLON, "Expected ';'")) {
+        return nullptr;
+    }
+    
+    if (exporting) {
+        auto stmt = std::make_unique<ExportStatement>();
+        stmt->tableName = tableName;
+        stmt->file = file;
+        return stmt;
+    }
+    auto stmt = std::make_unique<ImportStatement>();
+    stmt->tableName = tableName;
+    stmt->file = file;
+    return stmt;
+}
+
+std::unique_ptr<ExplainStatement> Parser::parseExplain() {
+    auto stmt = std::make_unique<ExplainStatement>();
+    
+    // EXPLAIN
+    if (!expect(TokenType::EXPLAIN, "Expected EXPLAIN")) {
+        return nullptr;
+    }
+    
+    stmt->analyze = match(TokenType::ANALYZE);
+    if (!startsQuery()) {
+        error_ = stmt->analyze ? "Expected SELECT after EXPLAIN ANALYZE" : "Expected SELECT after EXPLAIN";
+        return nullptr;
+    }
+    stmt->select = parseSelect();
+    if (!stmt->select) {
+        return nullptr;
+    }
+    
+    return stmt;
+}
+
+// column | fn(...) [OVER (...)] [AS alias], separated by commas
+bool Parser::parseSelectList(SelectStatement& stmt) {
+    size_t position = 0;
+    do {
+        if (!check(TokenType::IDENTIFIER)) {
+            error_ = position == 0 ? "Expected column name" : "Expected column name after ','";
+            return false;
+        }
+        if (peek().type == TokenType::LEFT_PAREN) {
+            WindowCall call;
+            bool windowed = false;
+            if (!parseWindowCall(call, windowed)) {
+                return false;
+            }
+            call.position = position;
+            (windowed ? stmt.windows : stmt.aggregates).push_back(std::move(call));
+        } else {
+            stmt.columns.push_back(currentToken().value);
+            advance();
+        }
+        ++position;
+    } while (match(TokenType::COMMA));
+    return true;
+}
+
+bool Parser::parseWindowCall(WindowCall& call, bool& windowed) {
+    static const struct {
+        const char* name;
+        WindowFunction function;
+        bool takesColumn;
+    } functions[] = {
+        {"row_number", WindowFunction::ROW_NUMBER, false},
+        {"rank", WindowFunction::RANK, false},
+        {"dense_rank", WindowFunction::DENSE_RANK, false},
+        {"count", WindowFunction::COUNT, true},
+        {"sum", WindowFunction::SUM, true},
+        {"avg", WindowFunction::AVG, true},
+        {"min", WindowFunction::MIN, true},
+        {"max", WindowFunction::MAX, true},
+    };
+    
+    std::string name = Utils::toLower(currentToken().value);
+    bool takesColumn = false;
+    bool known = false;
+    for (const auto& entry : functions) {
+        if (name == entry.name) {
+            call.function = entry.function;
+            takesColumn = entry.takesColumn;
+            known = true;
+        }
+    }
+    if (!known) {
+        error_ = "Unknown function '" + currentToken().value + "'";
+        return false;
+    }
+    call.alias = name;
+    advance();
+    if (!expect(TokenType::LEFT_PAREN, "Expected '('")) {
+        return false;
+    }
+    
+    if (takesColumn) {
+        if (call.function == WindowFunction::COUNT && match(TokenType::ASTERISK)) {
+            // COUNT(*): no argument
+        } else if (check(TokenType::IDENTIFIER)) {
+            call.argument = currentToken().value;
+            advance();
+        } else {
+            error_ = "Expected column name in " + name + "()";
+            return false;
+        }
+    }
+    if (!expect(TokenType::RIGHT_PAREN, "Expected ')' after " + name + " arguments")) {
+        return false;
+    }
+    
+    windowed = matchWord("over");
+    if (!windowed) {
+        if (!takesColumn) {
+            error_ = name + "() requires an OVER clause";
+            return false;
+        }
+    } else if (!parseOverClause(call)) {
+        return false;
+    }
+    
+    if (matchWord("as")) {
+        if (!check(TokenType::IDENTIFIER)) {
+            error_ = "Expected alias after AS";
+            return false;
+        }
+        call.alias = currentToken().value;
+        advance();
+    }
+    return true;
+}
+
+// OVER ([PARTITION BY column, ...] [ORDER BY column [ASC|DESC], ...]), after the OVER keyword
+bool Parser::parseOverClause(WindowCall& call) {
+    if (!expect(TokenType::LEFT_PAREN, "Expected '(' after OVER")) {
+        return false;
+    }
+    if (match(TokenType::PARTITION)) {
+        if (!expect(TokenType::BY, "Expected BY after PARTITION")) {
+            return false;
+        }
+        call.partitionBy = parseColumnList();
+        if (hasError()) {
+            return false;
+        }
+    }
+    if (matchWord("order")) {
+        if (!expect(TokenType::BY, "Expected BY after ORDER")) {
+            return false;
+        }
+        do {
+            if (!check(TokenType::IDENTIFIER)) {
+                error_ = "Expected column name in ORDER BY";
+                return false;
+            }
+            SortKey key;
+            key.column = currentToken().value;
+            advance();
+            if (matchWord("desc")) {
+                key.descending = true;
+            } else {
+                matchWord("asc");
+            }
+            call.orderBy.push_back(std::move(key));
+        } while (match(TokenType::COMMA));
+    }
+    return expect(TokenType::RIGHT_PAREN, "Expected ')' to close OVER");
+}
+
 std::vector<std::string> Parser::parseColumnList() {
     std::vector<std::string> columns;
     
@@ -234,7 +1078,7 @@ std::vector<std::string> Parser::parseColumnList() {
         error_ = "Expected column name";
         return columns;
     }
-    columns.push_back(Utils::toLower(currentToken().value));
+    columns.push_back(currentToken().value);
     advance();
     
     // Additional columns
@@ -243,7 +1087,7 @@ std::vector<std::string> Parser::parseColumnList() {
             error_ = "Expected column name after ','";
             return columns;
         }
-        columns.push_back(Utils::toLower(currentToken().value));
+        columns.push_back(currentToken().value);
         advance();
     }
     
@@ -252,23 +1096,22 @@ std::vector<std::string> Parser::parseColumnList() {
 
 std::vector<std::string> Parser::parseValueList() {
     std::vector<std::string> values;
+    Value value;
     
     // First value
-    if (!check(TokenType::IDENTIFIER) && !check(TokenType::STRING_LITERAL) && !check(TokenType::NUMBER)) {
+    if (!parseLiteral(value)) {
         error_ = "Expected value";
         return values;
     }
-    values.push_back(currentToken().value);
-    advance();
+    values.push_back(std::move(value.text));
     
     // Additional values
     while (match(TokenType::COMMA)) {
-        if (!check(TokenType::IDENTIFIER) && !check(TokenType::STRING_LITERAL) && !check(TokenType::NUMBER)) {
+        if (!parseLiteral(value)) {
             error_ = "Expected value after ','";
             return values;
         }
-        values.push_back(currentToken().value);
-        advance();
+        values.push_back(std::move(value.text));
     }
     
     return values;
@@ -8,15 +8,19 @@
 
 class Parser {
 public:
-    explicit Parser(const std::vector<Token>& tokens);
+    explicit Parser(const std::vector<Token>& tokens, const Catalog* catalog = nullptr);
     
-    std::unique_ptr<Statement> parseStatement();
+    std::unique_ptr<Statement> parseStatement();  // parses, then binds if a catalog was given
+    
+    // Resolve names of an already parsed statement (e.g. one parsed ahead of time)
+    static void bind(Statement& statement, const Catalog& catalog);
     
     std::string getError() const { return error_; }
     bool hasError() const { return !error_.empty(); }
     
 private:
     std::vector<Token> tokens_;
+    const Catalog* catalog_;  // optional; used to bind names to ids
     size_t current_;
     std::string error_;
     
@@ -28,13 +32,36 @@ private:
     bool match(TokenType type);
     bool check(TokenType type) const;
     bool expect(TokenType type, const std::string& message);
+    bool matchWord(const std::string& word);  // contextual keyword (lowercase)
     
     // Statement parsing
+    std::unique_ptr<Statement> parseAnyStatement();
+    std::unique_ptr<Statement> parseCreate();
     std::unique_ptr<CreateTableStatement> parseCreateTable();
+    std::unique_ptr<CreateIndexStatement> parseCreateIndex();
+    std::unique_ptr<CreateViewStatement> parseCreateView();
     std::unique_ptr<InsertStatement> parseInsert();
     std::unique_ptr<SelectStatement> parseSelect();
+    std::unique_ptr<SelectStatement> parseQuery();
+    std::shared_ptr<SelectStatement> parseSubquery();
+    bool parseWithClause(SelectStatement& stmt);
+    bool startsQuery() const;  // SELECT or WITH
+    std::unique_ptr<AnalyzeStatement> parseAnalyze();
+    std::unique_ptr<Statement> parseTransfer();   // EXPORT / IMPORT
+    std::unique_ptr<Statement> parseShow();       // SHOW TABLES
+    std::unique_ptr<ExplainStatement> parseExplain();
+    bool parseCondition(Condition& condition);
+    bool parseLiteral(Value& value);
+    bool parseColumnDefinitions(CreateTableStatement& stmt);
+    bool parsePartitionClause(CreateTableStatement& stmt);
+    bool parseConflictClause(InsertStatement& stmt);
+    bool parseSelectList(SelectStatement& stmt);
+    bool parseWindowCall(WindowCall& call, bool& windowed);
+    bool parseOverClause(WindowCall& call);
     
     // Helper methods
+    static void bindSelect(SelectStatement& stmt, const Catalog& catalog);
+    static uint32_t resolveColumn(const SelectStatement& stmt, const Catalog& catalog, const std::string& name);
     std::vector<std::string> parseColumnList();
     std::vector<std::string> parseValueList();
 };
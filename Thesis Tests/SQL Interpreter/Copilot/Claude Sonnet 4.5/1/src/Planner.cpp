@@ -0,0 +1,766 @@
+#include "Planner.h"
+#include "WindowOperator.h"
+#include "MaterializedView.h"
+#include <algorithm>
+#include <sstream>
+#include <iomanip>
+#include <cmath>
+
+namespace {
+
+// Cost units: reading one tuple costs 1, evaluating one predicate 0.25
+const double CPU_TUPLE_COST = 1.0;
+const double CPU_OPERATOR_COST = 0.25;
+
+// Reading one posting list entry of a trigram index
+const double INDEX_POSTING_COST = 0.05;
+
+// Comparing the search key with one B+tree node on the way down
+const double BTREE_DESCENT_COST = 0.5;
+
+// Used when a table has not been analyzed
+const double DEFAULT_EQ_SELECTIVITY = 0.1;
+const double DEFAULT_LIKE_SELECTIVITY = 0.05;
+const double DEFAULT_RANGE_SELECTIVITY = 1.0 / 3.0;
+
+// Inserting one build row into a join's hash table, or looking one probe row up
+const double HASH_ROW_COST = 0.5;
+
+// Appends text as a child node: "->  " before its first line, indented below
+void appendChild(std::ostringstream& out, const std::string& text, const std::string& indent) {
+    std::istringstream lines(text);
+    std::string line;
+    for (bool first = true; std::getline(lines, line); first = false) {
+        out << "\n" << indent << (first ? "->  " : "    ") << line;
+    }
+}
+
+} // namespace
+
+Planner::Planner(const StorageSnapshot& snapshot) : snapshot_(snapshot) {}
+
+double Planner::equalitySelectivity(const TableStats* stats, uint32_t column, const std::string& value,
+                                    double rowCount) const {
+    if (!stats || column >= stats->columns.size() || stats->rowCount == 0) {
+        return DEFAULT_EQ_SELECTIVITY;
+    }
+    
+    const ColumnStats& col = stats->columns[column];
+    const Histogram& histogram = col.histogram;
+    if (!histogram.upperBounds.empty() &&
+        (value < histogram.minValue || value > histogram.upperBounds.back())) {
+        // Outside the analyzed range: assume at most one row
+        return rowCount > 0 ? 1.0 / rowCount : 0;
+    }
+    
+    double uniform = col.distinct > 0 ? 1.0 / col.distinct : DEFAULT_EQ_SELECTIVITY;
+    return std::max(uniform, histogram.equalFraction(value));
+}
+
+double Planner::likeSelectivity(const TableStats* stats, uint32_t column, const PlannedFilter& filter) const {
+    if (!stats || column >= stats->columns.size() || stats->rowCount == 0) {
+        return DEFAULT_LIKE_SELECTIVITY;
+    }
+    
+    // Case-sensitive prefix patterns can be estimated from the histogram bounds
+    std::vector<std::string> literals = filter.pattern->literals();
+    const Histogram& histogram = stats->columns[column].histogram;
+    if (filter.op == CompareOp::LIKE && filter.pattern->anchoredStart() && !literals.empty() &&
+        !histogram.upperBounds.empty() && filter.value.text.compare(0, literals[0].size(), literals[0]) == 0) {
+        const std::string& prefix = literals[0];
+        size_t hits = 0;
+        for (const std::string& bound : histogram.upperBounds) {
+            if (bound.compare(0, prefix.size(), prefix) == 0) ++hits;
+        }
+        double fromHistogram = static_cast<double>(hits) / histogram.upperBounds.size();
+        double distinct = stats->columns[column].distinct;
+        return std::max(fromHistogram, distinct > 0 ? 1.0 / distinct : DEFAULT_LIKE_SELECTIVITY);
+    }
+    return DEFAULT_LIKE_SELECTIVITY;
+}
+
+void Planner::considerTrigramIndex(const SelectStatement& stmt, Plan& plan, double perRowCost) {
+    for (size_t i = 0; i < plan.filters.size(); ++i) {
+        const PlannedFilter& filter = plan.filters[i];
+        if (filter.op != CompareOp::LIKE && filter.op != CompareOp::ILIKE) {
+            continue;
+        }
+        const TableSnapshot& table = *snapshot_.table(plan.table);
+        const TrigramIndex* index = table.trigramIndex(filter.column);
+        if (!index) {
+            continue;
+        }
+        
+        std::vector<std::string> literals = filter.pattern->literals();
+        bool usable = false;
+        for (const std::string& literal : literals) {
+            if (literal.size() >= 3) usable = true;
+        }
+        if (!usable) {
+            continue;
+        }
+        
+        // The intersection is at most as large as the shortest posting list
+        size_t shortest = 0;
+        size_t total = 0;
+        {
+            std::shared_lock<std::shared_mutex> indexGuard(*table.indexLock);
+            index->postingSizes(literals, shortest, total);
+        }
+        double candidates = static_cast<double>(shortest);
+        double cost = total * INDEX_POSTING_COST + candidates * perRowCost;
+        if (cost < plan.cost) {
+            plan.access = AccessPath::TRIGRAM_SCAN;
+            plan.cost = cost;
+            plan.indexFilter = i;
+            plan.indexKeys = literals;
+            for (const IndexSchema& schema : snapshot_.catalog->table(stmt.tableId).indexes) {
+                if (schema.kind == IndexKind::TRIGRAM && schema.column == filter.column) {
+                    plan.indexName = snapshot_.catalog->identifier(schema.name);
+                    break;
+                }
+            }
+        }
+    }
+}
+
+void Planner::prunePartitions(const TableSnapshot& table, Plan& plan) const {
+    const PartitionSpec& spec = snapshot_.catalog->table(plan.table).partitioning;
+    plan.partitionCount = static_cast<uint32_t>(table.partitions.size());
+    
+    // An equality filter on the partition column selects the partitions of the
+    // texts equal to its literal: one for text, at most two for a number
+    // ("30" and "30.0"), none for NULL
+    if (spec.kind != PartitionKind::NONE) {
+        for (const PlannedFilter& filter : plan.filters) {
+            if (filter.op == CompareOp::EQUALS && filter.column == spec.column) {
+                for (const std::string& text : filter.value.equalTexts()) {
+                    uint32_t p = Storage::partitionFor(spec, text);
+                    if (std::find(plan.partitions.begin(), plan.partitions.end(), p) == plan.partitions.end()) {
+                        plan.partitions.push_back(p);
+                    }
+                }
+                std::sort(plan.partitions.begin(), plan.partitions.end());
+                return;
+            }
+        }
+    }
+    for (uint32_t p = 0; p < plan.partitionCount; ++p) {
+        plan.partitions.push_back(p);
+    }
+}
+
+void Planner::considerPrimaryKey(const SelectStatement& stmt, Plan& plan, double perRowCost) {
+    const TableSnapshot& table = *snapshot_.table(plan.table);
+    const BPlusTree* index = table.primaryIndex.get();
+    if (!index) {
+        return;
+    }
+    uint32_t key = snapshot_.catalog->table(stmt.tableId).primaryKey;
+    for (size_t i = 0; i < plan.filters.size(); ++i) {
+        const PlannedFilter& filter = plan.filters[i];
+        bool in = filter.op == CompareOp::IN && filter.members;
+        if ((filter.op != CompareOp::EQUALS && !in) || filter.column != key) {
+            continue;
+        }
+        // One root-to-leaf descent per key text, then at most one row each to check
+        std::vector<std::string> keys = filter.value.equalTexts();
+        if (in) {
+            keys.clear();
+            for (const std::string& member : *filter.members) {
+                Value value;
+                value.text = member;
+                value.cell = Cell::classify(member);
+                for (std::string& text : value.equalTexts()) {
+                    keys.push_back(std::move(text));
+                }
+            }
+        }
+        size_t height;
+        {
+            std::shared_lock<std::shared_mutex> indexGuard(*table.indexLock);
+            height = index->height();
+        }
+        double cost = keys.size() * (height * BTREE_DESCENT_COST + perRowCost);
+        if (cost < plan.cost) {
+            plan.access = AccessPath::PRIMARY_KEY_LOOKUP;
+            plan.cost = cost;
+            plan.indexFilter = i;
+            plan.indexKeys = keys;
+            plan.indexName = snapshot_.catalog->tableName(plan.table) + "_pkey";
+            plan.estimatedRows = std::min(plan.estimatedRows, static_cast<double>(keys.size()));
+        }
+        return;
+    }
+}
+
+bool Planner::planFilters(const SelectStatement& stmt, const TableStats* stats, uint32_t primaryKey, Plan& plan) {
+    for (const Condition& condition : stmt.where) {
+        if (condition.columnId == INVALID_ID) {
+            error_ = "Column '" + condition.column + "' does not exist";
+            return false;
+        }
+        PlannedFilter filter;
+        filter.column = condition.columnId;
+        filter.op = condition.op;
+        filter.value = condition.value;
+        if (condition.op == CompareOp::EQUALS && condition.columnId == primaryKey) {
+            filter.selectivity = 1.0 / std::max(plan.tableRows, 1.0);  // unique
+        } else if (condition.op == CompareOp::EQUALS || condition.op == CompareOp::NOT_EQUALS) {
+            double equal = equalitySelectivity(stats, condition.columnId, condition.value.text, plan.tableRows);
+            filter.selectivity = condition.op == CompareOp::EQUALS ? equal : 1.0 - equal;
+        } else if (condition.op == CompareOp::IS_NULL || condition.op == CompareOp::IS_NOT_NULL) {
+            // NULLs are stored as NULL_TEXT, so the statistics count them like any value
+            double null = equalitySelectivity(stats, condition.columnId, NULL_TEXT, plan.tableRows);
+            filter.selectivity = condition.op == CompareOp::IS_NULL ? null : 1.0 - null;
+        } else if (condition.op == CompareOp::IN) {
+            // One equality per distinct value of the subquery; unevaluated
+            // subqueries (cost estimates) count as one
+            filter.members = condition.members;
+            double values = condition.members ? static_cast<double>(condition.members->size()) : 1.0;
+            double equal = DEFAULT_EQ_SELECTIVITY;
+            if (condition.columnId == primaryKey) {
+                equal = 1.0 / std::max(plan.tableRows, 1.0);
+            } else if (stats && condition.columnId < stats->columns.size() &&
+                       stats->columns[condition.columnId].distinct > 0) {
+                equal = 1.0 / stats->columns[condition.columnId].distinct;
+            }
+            filter.selectivity = std::min(1.0, values * equal);
+        } else if (condition.op == CompareOp::LIKE || condition.op == CompareOp::ILIKE) {
+            filter.pattern = std::make_shared<LikePattern>(condition.value.text, condition.op == CompareOp::ILIKE);
+            filter.selectivity = likeSelectivity(stats, condition.columnId, filter);
+        } else {
+            // The histograms are in text order, which says nothing about numeric ranges
+            filter.selectivity = DEFAULT_RANGE_SELECTIVITY;
+        }
+        plan.filters.push_back(filter);
+    }
+    
+    // All predicates cost the same to evaluate, so running the most selective
+    // first minimizes the expected number of evaluations per row
+    std::stable_sort(plan.filters.begin(), plan.filters.end(),
+                     [](const PlannedFilter& a, const PlannedFilter& b) {
+                         return a.selectivity < b.selectivity;
+                     });
+    return true;
+}
+
+bool Planner::planGrouping(const SelectStatement& stmt, const TableStats* stats, Plan& plan) {
+    if (!plan.windows.empty()) {
+        error_ = "Window functions cannot be combined with GROUP BY or aggregates";
+        return false;
+    }
+    if (stmt.columns.empty() && stmt.aggregates.empty()) {
+        error_ = "SELECT * cannot be used with GROUP BY";
+        return false;
+    }
+    for (size_t i = 0; i < stmt.groupIds.size(); ++i) {
+        if (stmt.groupIds[i] == INVALID_ID) {
+            error_ = "Column '" + stmt.groupBy[i] + "' does not exist";
+            return false;
+        }
+    }
+    for (const WindowCall& call : stmt.aggregates) {
+        if (!call.argument.empty() && call.argumentId == INVALID_ID) {
+            error_ = "Column '" + call.argument + "' does not exist";
+            return false;
+        }
+    }
+    plan.groupBy = stmt.groupIds;
+    plan.aggregates = stmt.aggregates;
+    
+    // Aggregates sit at their select-list positions; plain columns fill the
+    // rest in order and must be grouping columns
+    size_t width = plan.projection.size() + plan.aggregates.size();
+    size_t column = 0;
+    size_t aggregate = 0;
+    for (size_t position = 0; position < width; ++position) {
+        if (aggregate < plan.aggregates.size() && plan.aggregates[aggregate].position == position) {
+            plan.layout.push_back(static_cast<uint32_t>(plan.groupBy.size() + aggregate++));
+            continue;
+        }
+        uint32_t id = plan.projection[column];
+        auto key = std::find(plan.groupBy.begin(), plan.groupBy.end(), id);
+        if (key == plan.groupBy.end()) {
+            error_ = "Column '" + stmt.columns[column] + "' must appear in the GROUP BY clause";
+            return false;
+        }
+        plan.layout.push_back(static_cast<uint32_t>(key - plan.groupBy.begin()));
+        ++column;
+    }
+    
+    // At most one group per distinct key combination, and never more than rows
+    double groups = 1.0;
+    for (uint32_t id : plan.groupBy) {
+        bool known = stats && id < stats->columns.size() && stats->columns[id].distinct > 0;
+        groups *= known ? stats->columns[id].distinct : 1.0 / DEFAULT_EQ_SELECTIVITY;
+    }
+    plan.estimatedGroups = plan.groupBy.empty() ? 1.0 : std::min(groups, std::max(plan.estimatedRows, 1.0));
+    plan.aggregateCost = plan.estimatedRows * CPU_OPERATOR_COST * (1 + plan.aggregates.size());
+    return true;
+}
+
+bool Planner::planView(const SelectStatement& stmt, Plan& plan) {
+    const ViewSchema& schema = snapshot_.catalog->view(stmt.viewId);
+    const MaterializedView* view = snapshot_.view(stmt.viewId);
+    if (!view) {
+        error_ = "Materialized view '" + stmt.tableName + "' is unavailable";
+        return false;
+    }
+    if (!stmt.windows.empty() || stmt.grouped()) {
+        error_ = "Window functions and GROUP BY are not supported on materialized views";
+        return false;
+    }
+    
+    plan = Plan();
+    plan.view = stmt.viewId;
+    plan.table = schema.table;
+    plan.access = AccessPath::VIEW_SCAN;
+    if (stmt.columns.empty()) {
+        for (uint32_t i = 0; i < schema.columns.size(); ++i) {
+            plan.projection.push_back(i);
+        }
+    }
+    for (size_t i = 0; i < stmt.columnIds.size(); ++i) {
+        if (stmt.columnIds[i] == INVALID_ID) {
+            error_ = "Column '" + stmt.columns[i] + "' does not exist";
+            return false;
+        }
+        plan.projection.push_back(stmt.columnIds[i]);
+    }
+    
+    // Views have no statistics; the defaults order the filters
+    plan.tableRows = static_cast<double>(view->groupCount());
+    if (!planFilters(stmt, nullptr, INVALID_ID, plan)) {
+        return false;
+    }
+    double survivors = 1.0;
+    double perRow = CPU_TUPLE_COST;
+    for (const PlannedFilter& filter : plan.filters) {
+        perRow += CPU_OPERATOR_COST * survivors;
+        survivors *= filter.selectivity;
+    }
+    plan.estimatedRows = plan.tableRows * survivors;
+    plan.cost = plan.tableRows * perRow;
+    return true;
+}
+
+std::string Planner::columnError(const SelectStatement& stmt, const std::string& name) const {
+    if (name.find('.') == std::string::npos && stmt.tableId != INVALID_ID && stmt.join.tableId != INVALID_ID &&
+        snapshot_.catalog->findColumn(stmt.tableId, name) != INVALID_ID &&
+        snapshot_.catalog->findColumn(stmt.join.tableId, name) != INVALID_ID) {
+        return "Column '" + name + "' is ambiguous; write it as table.column";
+    }
+    return "Column '" + name + "' does not exist";
+}
+
+bool Planner::planJoin(const SelectStatement& stmt, Plan& plan) {
+    if (stmt.tableId == INVALID_ID) {
+        error_ = stmt.viewId != INVALID_ID ? "Materialized view '" + stmt.tableName + "' cannot be joined"
+                                           : "Table '" + stmt.tableName + "' does not exist";
+        return false;
+    }
+    if (stmt.join.tableId == INVALID_ID) {
+        error_ = "Table '" + stmt.join.tableName + "' does not exist";
+        return false;
+    }
+    if (stmt.join.tableId == stmt.tableId) {
+        error_ = "A table cannot be joined with itself";
+        return false;
+    }
+    if (!stmt.windows.empty() || stmt.grouped()) {
+        error_ = "Window functions and GROUP BY are not supported with JOIN";
+        return false;
+    }
+    
+    const Catalog& catalog = *snapshot_.catalog;
+    uint32_t leftWidth = static_cast<uint32_t>(catalog.table(stmt.tableId).columns.size());
+    uint32_t width = leftWidth + static_cast<uint32_t>(catalog.table(stmt.join.tableId).columns.size());
+    if (stmt.join.leftColumnId == INVALID_ID || stmt.join.rightColumnId == INVALID_ID) {
+        error_ = columnError(stmt, stmt.join.leftColumnId == INVALID_ID ? stmt.join.leftColumn
+                                                                        : stmt.join.rightColumn);
+        return false;
+    }
+    uint32_t leftKey = stmt.join.leftColumnId;
+    uint32_t rightKey = stmt.join.rightColumnId;
+    if ((leftKey < leftWidth) == (rightKey < leftWidth)) {
+        error_ = "JOIN ... ON must compare a column of each table";
+        return false;
+    }
+    if (leftKey >= leftWidth) {
+        std::swap(leftKey, rightKey);
+    }
+    
+    plan = Plan();
+    plan.table = stmt.tableId;
+    plan.access = AccessPath::HASH_JOIN;
+    plan.joinKeys = {leftKey, rightKey - leftWidth};
+    if (stmt.columns.empty()) {
+        for (uint32_t i = 0; i < width; ++i) {
+            plan.projection.push_back(i);
+        }
+    }
+    for (size_t i = 0; i < stmt.columnIds.size(); ++i) {
+        if (stmt.columnIds[i] == INVALID_ID) {
+            error_ = columnError(stmt, stmt.columns[i]);
+            return false;
+        }
+        plan.projection.push_back(stmt.columnIds[i]);
+    }
+    
+    // Every condition reads one table, so it is pushed into that table's scan
+    SelectStatement sides[2];
+    sides[0].tableName = stmt.tableName;
+    sides[0].tableId = stmt.tableId;
+    sides[1].tableName = stmt.join.tableName;
+    sides[1].tableId = stmt.join.tableId;
+    for (const Condition& condition : stmt.where) {
+        if (condition.columnId == INVALID_ID) {
+            error_ = columnError(stmt, condition.column);
+            return false;
+        }
+        bool right = condition.columnId >= leftWidth;
+        Condition local = condition;
+        local.columnId -= right ? leftWidth : 0;
+        sides[right].where.push_back(std::move(local));
+    }
+    plan.inputs.resize(2);
+    for (size_t i = 0; i < 2; ++i) {
+        if (!this->plan(sides[i], plan.inputs[i])) {
+            return false;
+        }
+    }
+    
+    // Each key of the side with fewer distinct keys is assumed to find its
+    // partners on the other side. Without statistics a primary key is
+    // unique and other columns get the GROUP BY default.
+    double distinct = 1.0;
+    for (size_t i = 0; i < 2; ++i) {
+        const Plan& input = plan.inputs[i];
+        const TableStats* stats = snapshot_.table(input.table)->stats.get();
+        uint32_t key = plan.joinKeys[i];
+        double keys = 1.0 / DEFAULT_EQ_SELECTIVITY;
+        if (stats && key < stats->columns.size() && stats->columns[key].distinct > 0) {
+            keys = stats->columns[key].distinct;
+        } else if (key == catalog.table(input.table).primaryKey) {
+            keys = input.tableRows;
+        }
+        distinct = std::max(distinct, std::min(keys, input.estimatedRows));
+    }
+    const Plan& left = plan.inputs[0];
+    const Plan& right = plan.inputs[1];
+    plan.estimatedRows = left.estimatedRows * right.estimatedRows / distinct;
+    plan.tableRows = left.tableRows + right.tableRows;
+    plan.analyzed = left.analyzed && right.analyzed;
+    
+    // Hash the smaller input; the larger one streams through the Bloom filter
+    plan.buildSide = left.estimatedRows < right.estimatedRows ? 0 : 1;
+    size_t probe = 1 - plan.buildSide;
+    plan.inputs[probe].bloomColumn = plan.joinKeys[probe];
+    plan.cost = left.cost + right.cost +
+                (plan.inputs[plan.buildSide].estimatedRows + plan.inputs[probe].estimatedRows) * HASH_ROW_COST +
+                plan.estimatedRows * CPU_TUPLE_COST;
+    return true;
+}
+
+bool Planner::plan(const SelectStatement& stmt, Plan& plan) {
+    if (stmt.joined()) {
+        return planJoin(stmt, plan);
+    }
+    if (stmt.viewId != INVALID_ID) {
+        return planView(stmt, plan);
+    }
+    const TableSnapshot* table = snapshot_.table(stmt.tableId);
+    if (!table) {
+        error_ = "Table '" + stmt.tableName + "' does not exist";
+        return false;
+    }
+    
+    plan = Plan();
+    plan.table = stmt.tableId;
+    
+    // Projection
+    if (stmt.columns.empty() && stmt.windows.empty() && !stmt.grouped()) {
+        for (uint32_t i = 0; i < table->columns.size(); ++i) {
+            plan.projection.push_back(i);
+        }
+    } else {
+        for (size_t i = 0; i < stmt.columnIds.size(); ++i) {
+            if (stmt.columnIds[i] == INVALID_ID) {
+                error_ = "Column '" + stmt.columns[i] + "' does not exist";
+                return false;
+            }
+            plan.projection.push_back(stmt.columnIds[i]);
+        }
+    }
+    
+    for (const WindowCall& call : stmt.windows) {
+        if (!call.argument.empty() && call.argumentId == INVALID_ID) {
+            error_ = "Column '" + call.argument + "' does not exist";
+            return false;
+        }
+        for (size_t i = 0; i < call.partitionIds.size(); ++i) {
+            if (call.partitionIds[i] == INVALID_ID) {
+                error_ = "Column '" + call.partitionBy[i] + "' does not exist";
+                return false;
+            }
+        }
+        for (const SortKey& key : call.orderBy) {
+            if (key.columnId == INVALID_ID) {
+                error_ = "Column '" + key.column + "' does not exist";
+                return false;
+            }
+        }
+        plan.windows.push_back(call);
+    }
+    
+    const TableSchema& schema = snapshot_.catalog->table(stmt.tableId);
+    const TableStats* stats = table->stats.get();
+    plan.analyzed = stats != nullptr;
+    plan.tableRows = static_cast<double>(table->rows.size());
+    
+    if (!planFilters(stmt, stats, schema.primaryKey, plan)) {
+        return false;
+    }
+    
+    double survivors = 1.0;
+    double perRow = CPU_TUPLE_COST;
+    for (const PlannedFilter& filter : plan.filters) {
+        perRow += CPU_OPERATOR_COST * survivors;
+        survivors *= filter.selectivity;
+    }
+    plan.estimatedRows = plan.tableRows * survivors;
+    
+    prunePartitions(*table, plan);
+    double scannedRows = 0;
+    for (uint32_t p : plan.partitions) {
+        scannedRows += static_cast<double>(table->partitions[p].size());
+    }
+    plan.cost = scannedRows * perRow;
+    
+    considerTrigramIndex(stmt, plan, perRow);
+    considerPrimaryKey(stmt, plan, perRow);
+    
+    if (stmt.grouped() && !planGrouping(stmt, stats, plan)) {
+        return false;
+    }
+    
+    // One sort of the surviving rows per distinct PARTITION BY / ORDER BY
+    double n = std::max(plan.estimatedRows, 1.0);
+    for (size_t i = 0; i < plan.windows.size(); ++i) {
+        bool shared = false;
+        for (size_t j = 0; j < i && !shared; ++j) {
+            shared = WindowOperator::sameOrdering(plan.windows[i], plan.windows[j]);
+        }
+        if (!shared) {
+            plan.windowCost += n * std::log2(n + 1) * CPU_OPERATOR_COST + n * CPU_TUPLE_COST;
+        }
+    }
+    
+    return true;
+}
+
+std::vector<std::string> Plan::columnNames(const Catalog& catalog) const {
+    std::vector<std::string> names;
+    if (access == AccessPath::HASH_JOIN) {
+        const TableSchema& left = catalog.table(inputs[0].table);
+        const TableSchema& right = catalog.table(inputs[1].table);
+        for (uint32_t column : projection) {
+            names.push_back(catalog.identifier(column < left.columns.size() ? left.columns[column].name
+                                                                            : right.columns[column - left.columns.size()].name));
+        }
+        return names;
+    }
+    if (access == AccessPath::VIEW_SCAN) {
+        for (uint32_t column : projection) {
+            names.push_back(catalog.identifier(catalog.view(view).columns[column]));
+        }
+        return names;
+    }
+    const TableSchema& schema = catalog.table(table);
+    if (grouped()) {
+        for (uint32_t item : layout) {
+            names.push_back(item < groupBy.size() ? catalog.identifier(schema.columns[groupBy[item]].name)
+                                                  : aggregates[item - groupBy.size()].alias);
+        }
+        return names;
+    }
+    for (uint32_t column : projection) {
+        names.push_back(catalog.identifier(schema.columns[column].name));
+    }
+    for (const WindowCall& call : windows) {
+        names.insert(names.begin() + call.position, call.alias);
+    }
+    return names;
+}
+
+std::string Plan::explain(const Catalog& catalog, const PlanStats* actual) const {
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(2);
+    
+    if (access == AccessPath::HASH_JOIN) {
+        auto qualified = [&](size_t side, uint32_t column) {
+            TableId id = inputs[side].table;
+            return catalog.tableName(id) + "." + catalog.identifier(catalog.table(id).columns[column].name);
+        };
+        const PlanStats* input[2] = {nullptr, nullptr};
+        if (actual && actual->inputs.size() == 2) {
+            input[0] = &actual->inputs[0];
+            input[1] = &actual->inputs[1];
+        }
+        size_t probe = 1 - buildSide;
+        size_t leftWidth = catalog.table(inputs[0].table).columns.size();
+        
+        oss << "Hash Join  (cost=" << cost << " rows=" << static_cast<size_t>(estimatedRows + 0.5) << ")";
+        if (actual) {
+            oss << " (actual rows=" << actual->rows << ")";
+        }
+        oss << "\n  Hash Cond: " << qualified(0, joinKeys[0]) << " = " << qualified(1, joinKeys[1]);
+        oss << "\n  Output: ";
+        for (size_t i = 0; i < projection.size(); ++i) {
+            oss << (i > 0 ? ", " : "")
+                << (projection[i] < leftWidth ? qualified(0, projection[i]) : qualified(1, projection[i] - leftWidth));
+        }
+        appendChild(oss, inputs[probe].explain(catalog, input[probe]), "  ");
+        std::ostringstream hash;
+        hash << std::fixed << std::setprecision(2);
+        hash << "Hash  (rows=" << static_cast<size_t>(inputs[buildSide].estimatedRows + 0.5) << ")";
+        if (input[buildSide]) {
+            hash << " (actual rows=" << input[buildSide]->rows << ")";
+        }
+        hash << "\n  Builds: Bloom Filter on " << qualified(buildSide, joinKeys[buildSide])
+             << ", pushed into the scan of " << catalog.tableName(inputs[probe].table);
+        appendChild(hash, inputs[buildSide].explain(catalog, input[buildSide]), "  ");
+        appendChild(oss, hash.str(), "  ");
+        return oss.str();
+    }
+    
+    const TableSchema& schema = catalog.table(table);
+    auto columnName = [&](uint32_t column) -> const std::string& {
+        return catalog.identifier(access == AccessPath::VIEW_SCAN ? catalog.view(view).columns[column]
+                                                                  : schema.columns[column].name);
+    };
+    auto describe = [&](const PlannedFilter& filter) {
+        static const char* const ops[] = {"=", "LIKE", "ILIKE", "<>", "<", "<=", ">", ">=", "IS NULL", "IS NOT NULL", "IN"};
+        std::ostringstream f;
+        f << columnName(filter.column) << " " << ops[static_cast<int>(filter.op)];
+        if (filter.op == CompareOp::IN) {
+            f << " (subquery, " << (filter.members ? filter.members->size() : 0) << " values)";
+        } else if (filter.op != CompareOp::IS_NULL && filter.op != CompareOp::IS_NOT_NULL) {
+            f << " " << filter.value.toSql();
+        }
+        return f.str();
+    };
+    
+    if (access == AccessPath::TRIGRAM_SCAN) {
+        oss << "Trigram Index Scan using " << indexName << " on " << catalog.tableName(table);
+    } else if (access == AccessPath::PRIMARY_KEY_LOOKUP) {
+        oss << "Index Scan using " << indexName << " on " << catalog.tableName(table);
+    } else if (access == AccessPath::VIEW_SCAN) {
+        oss << "Materialized View Scan on " << catalog.viewName(view);
+    } else {
+        oss << "Seq Scan on " << catalog.tableName(table);
+    }
+    oss << "  (cost=" << cost << " rows=" << static_cast<size_t>(estimatedRows + 0.5) << ")";
+    if (actual) {
+        oss << " (actual rows=" << actual->matched << ")";
+    }
+    
+    if (access == AccessPath::VIEW_SCAN) {
+        oss << "\n  Source: " << catalog.tableName(table) << ", maintained on INSERT";
+    } else if (access != AccessPath::SEQ_SCAN) {
+        oss << "\n  Index Cond: " << describe(filters[indexFilter]);
+    } else if (schema.partitioning.kind != PartitionKind::NONE) {
+        oss << "\n  Partitions: " << partitions.size() << " of " << partitionCount;
+    }
+    
+    if (!filters.empty()) {
+        oss << "\n  Filter: ";
+        for (size_t i = 0; i < filters.size(); ++i) {
+            if (i > 0) oss << " AND ";
+            oss << describe(filters[i]) << " (sel=" << std::setprecision(4)
+                << filters[i].selectivity << std::setprecision(2) << ")";
+        }
+        if (actual) {
+            oss << "\n  Rows Removed by Filter: " << actual->removedByFilter;
+        }
+    }
+    if (bloomColumn != INVALID_ID) {
+        oss << "\n  Bloom Filter: " << columnName(bloomColumn) << ", from the hash join build side";
+        if (actual) {
+            oss << "\n  Rows Removed by Bloom Filter: " << actual->removedByBloom;
+        }
+    }
+    
+    // A grouped scan only reads the grouping and aggregated columns
+    oss << "\n  Output: ";
+    if (grouped()) {
+        std::vector<uint32_t> read = groupBy;
+        for (const WindowCall& call : aggregates) {
+            if (call.argumentId != INVALID_ID && std::find(read.begin(), read.end(), call.argumentId) == read.end()) {
+                read.push_back(call.argumentId);
+            }
+        }
+        for (size_t i = 0; i < read.size(); ++i) {
+            oss << (i > 0 ? ", " : "") << columnName(read[i]);
+        }
+    } else {
+        for (size_t i = 0; i < projection.size(); ++i) {
+            oss << (i > 0 ? ", " : "") << columnName(projection[i]);
+        }
+    }
+    
+    if (access == AccessPath::VIEW_SCAN) {
+        oss << "\n  Groups: " << static_cast<size_t>(tableRows);
+        return oss.str();
+    }
+    oss << "\n  Statistics: " << (analyzed ? "analyzed" : "none (run ANALYZE)")
+        << ", table rows=" << static_cast<size_t>(tableRows);
+    if (windows.empty() && !grouped()) {
+        return oss.str();
+    }
+    
+    // Window functions or the aggregation run on top of the scan
+    static const char* const functions[] = {"row_number", "rank", "dense_rank", "count", "sum", "avg", "min", "max"};
+    std::ostringstream top;
+    top << std::fixed << std::setprecision(2);
+    if (grouped()) {
+        top << (groupBy.empty() ? "Aggregate" : "HashAggregate") << "  (cost=" << cost + aggregateCost
+            << " rows=" << static_cast<size_t>(estimatedGroups + 0.5) << ")";
+        if (actual) {
+            top << " (actual rows=" << actual->rows << ")";
+        }
+        if (!groupBy.empty()) {
+            top << "\n  Group Key: ";
+            for (size_t i = 0; i < groupBy.size(); ++i) {
+                top << (i > 0 ? ", " : "") << columnName(groupBy[i]);
+            }
+        }
+        for (const WindowCall& call : aggregates) {
+            top << "\n  Aggregate: " << functions[static_cast<int>(call.function)] << "("
+                << (call.argumentId == INVALID_ID ? "*" : columnName(call.argumentId)) << ") AS " << call.alias;
+        }
+    } else {
+        top << "WindowAgg  (cost=" << cost + windowCost << " rows=" << static_cast<size_t>(estimatedRows + 0.5) << ")";
+        if (actual) {
+            top << " (actual rows=" << actual->rows << ")";
+        }
+    }
+    for (const WindowCall& call : windows) {
+        top << "\n  Window: " << functions[static_cast<int>(call.function)] << "("
+            << (call.argumentId == INVALID_ID ? (call.function == WindowFunction::COUNT ? "*" : "")
+                                              : catalog.identifier(schema.columns[call.argumentId].name))
+            << ") OVER (";
+        for (size_t i = 0; i < call.partitionIds.size(); ++i) {
+            top << (i == 0 ? "PARTITION BY " : ", ") << catalog.identifier(schema.columns[call.partitionIds[i]].name);
+        }
+        for (size_t i = 0; i < call.orderBy.size(); ++i) {
+            top << (i == 0 ? (call.partitionIds.empty() ? "ORDER BY " : " ORDER BY ") : ", ")
+                << catalog.identifier(schema.columns[call.orderBy[i].columnId].name)
+                << (call.orderBy[i].descending ? " DESC" : "");
+        }
+        top << ") AS " << call.alias;
+    }
+    appendChild(top, oss.str(), "  ");
+    return top.str();
+}
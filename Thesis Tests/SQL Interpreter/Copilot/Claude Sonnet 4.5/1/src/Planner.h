@@ -0,0 +1,146 @@
+#ifndef PLANNER_H
+#define PLANNER_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include "Ast.h"
+#include "Storage.h"
+#include "Statistics.h"
+#include "TextSearch.h"
+
+enum class AccessPath {
+    SEQ_SCAN,
+    TRIGRAM_SCAN,
+    PRIMARY_KEY_LOOKUP,
+    VIEW_SCAN,           // the stored groups of a materialized view
+    HASH_JOIN            // two table scans joined on one equality
+};
+
+struct PlannedFilter {
+    uint32_t column;
+    CompareOp op;
+    Value value;
+    std::shared_ptr<LikePattern> pattern;  // compiled for LIKE / ILIKE
+    std::shared_ptr<const std::unordered_set<std::string>> members;  // IN: the subquery's equality keys
+    double selectivity;
+    
+    // Compares the row's typed cell with the literal parsed by the lexer
+    bool matches(const Row& row) const {
+        const Cell& cell = row.cells[column];
+        const std::string& text = row.values[column];
+        switch (op) {
+            case CompareOp::EQUALS:
+                if (value.type() == ValueType::TEXT) {
+                    return cell.type != ValueType::NULL_VALUE && text == value.text;
+                }
+                break;
+            case CompareOp::LIKE:
+            case CompareOp::ILIKE:
+                return cell.type != ValueType::NULL_VALUE && pattern->matches(text);
+            case CompareOp::IS_NULL:
+                return cell.type == ValueType::NULL_VALUE;
+            case CompareOp::IS_NOT_NULL:
+                return cell.type != ValueType::NULL_VALUE;
+            case CompareOp::IN: {
+                if (cell.type != ValueType::DOUBLE) {
+                    return cell.type != ValueType::NULL_VALUE && members && members->count(text) > 0;
+                }
+                std::string key;
+                return equalityKey(cell, text, key) && members && members->count(key) > 0;
+            }
+            default:
+                break;
+        }
+        int order;
+        if (!compareWithLiteral(cell, text, value, order)) {
+            return false;
+        }
+        switch (op) {
+            case CompareOp::EQUALS:        return order == 0;
+            case CompareOp::NOT_EQUALS:    return order != 0;
+            case CompareOp::LESS:          return order < 0;
+            case CompareOp::LESS_EQUAL:    return order <= 0;
+            case CompareOp::GREATER:       return order > 0;
+            case CompareOp::GREATER_EQUAL: return order >= 0;
+            default:                       return false;
+        }
+    }
+};
+
+// Row counts observed while a plan runs, for EXPLAIN ANALYZE
+struct PlanStats {
+    size_t scanned = 0;              // rows read by the access path
+    size_t removedByFilter = 0;
+    size_t removedByBloom = 0;       // probe side of a hash join
+    size_t matched = 0;              // rows the scan passed on
+    size_t rows = 0;                 // rows the plan produced
+    std::vector<PlanStats> inputs;   // HASH_JOIN: one per input
+};
+
+// Physical plan for a single-table SELECT, or a join of two of them
+struct Plan {
+    TableId table = INVALID_ID;
+    ViewId view = INVALID_ID;            // VIEW_SCAN: columns below are the view's
+    AccessPath access = AccessPath::SEQ_SCAN;
+    std::string indexName;               // for index access paths
+    std::vector<std::string> indexKeys;  // trigram literals, or the primary key texts to probe
+    size_t indexFilter = 0;              // filter answered by the index
+    std::vector<uint32_t> projection;
+    std::vector<WindowCall> windows;     // evaluated by WindowOperator after the scan
+    std::vector<uint32_t> groupBy;       // with aggregates: evaluated by GroupAggregate after the scan
+    std::vector<WindowCall> aggregates;
+    std::vector<uint32_t> layout;        // output columns of a grouped plan (see GroupAggregate)
+    std::vector<PlannedFilter> filters;  // in evaluation order
+    std::vector<uint32_t> partitions;    // partitions left after pruning
+    uint32_t partitionCount = 1;
+    bool analyzed = false;
+    double tableRows = 0;
+    double estimatedRows = 0;
+    double cost = 0;
+    double windowCost = 0;               // sorting for the window functions, on top of cost
+    double aggregateCost = 0;            // hashing and folding for GROUP BY, on top of cost
+    double estimatedGroups = 0;
+    
+    // HASH_JOIN: inputs[0] scans the FROM table and inputs[1] the joined one,
+    // each with the WHERE conditions on its own columns. The projection
+    // indexes the left table's columns followed by the right's.
+    std::vector<Plan> inputs;
+    std::vector<uint32_t> joinKeys;      // join column of each input
+    size_t buildSide = 1;                // input that is hashed; the other probes it
+    uint32_t bloomColumn = INVALID_ID;   // probe input: key checked against the build side's Bloom filter
+    
+    bool grouped() const { return !groupBy.empty() || !aggregates.empty(); }
+    std::vector<std::string> columnNames(const Catalog& catalog) const;
+    // With actual, the counters of a run are shown next to the estimates
+    std::string explain(const Catalog& catalog, const PlanStats* actual = nullptr) const;
+};
+
+// Cost-based planner. Uses the statistics collected by ANALYZE when present
+// and falls back to fixed selectivities otherwise.
+class Planner {
+public:
+    // Plans against one published snapshot, without taking the engine lock
+    explicit Planner(const StorageSnapshot& snapshot);
+    
+    bool plan(const SelectStatement& stmt, Plan& plan);
+    std::string getError() const { return error_; }
+
+private:
+    const StorageSnapshot& snapshot_;
+    std::string error_;
+    
+    double equalitySelectivity(const TableStats* stats, uint32_t column, const std::string& value,
+                               double rowCount) const;
+    double likeSelectivity(const TableStats* stats, uint32_t column, const PlannedFilter& filter) const;
+    void prunePartitions(const TableSnapshot& table, Plan& plan) const;
+    void considerTrigramIndex(const SelectStatement& stmt, Plan& plan, double perRowCost);
+    void considerPrimaryKey(const SelectStatement& stmt, Plan& plan, double perRowCost);
+    bool planFilters(const SelectStatement& stmt, const TableStats* stats, uint32_t primaryKey, Plan& plan);
+    bool planGrouping(const SelectStatement& stmt, const TableStats* stats, Plan& plan);
+    bool planView(const SelectStatement& stmt, Plan& plan);
+    bool planJoin(const SelectStatement& stmt, Plan& plan);
+    std::string columnError(const SelectStatement& stmt, const std::string& name) const;
+};
+
+#endif // PLANNER_H
@@ -0,0 +1,26 @@
+#include "QueryControl.h"
+
+QueryControl::QueryControl(uint32_t timeoutMs)
+    : start_(std::chrono::steady_clock::now()),
+      deadline_(start_ + std::chrono::milliseconds(timeoutMs)),
+      timeoutMs_(timeoutMs),
+      cancelled_(false) {}
+
+bool QueryControl::expired() const {
+    if (cancelled()) {
+        return true;
+    }
+    return timeoutMs_ != 0 && std::chrono::steady_clock::now() >= deadline_;
+}
+
+uint64_t QueryControl::elapsedMs() const {
+    auto elapsed = std::chrono::steady_clock::now() - start_;
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count());
+}
+
+std::string QueryControl::reason() const {
+    if (cancelled()) {
+        return "Query canceled";
+    }
+    return "Query timed out after " + std::to_string(timeoutMs_) + " ms";
+}
@@ -0,0 +1,33 @@
+#ifndef QUERYCONTROL_H
+#define QUERYCONTROL_H
+
+#include <string>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+// Cooperative deadline and cancellation for one query. Scan loops poll
+// expired() every CHECK_INTERVAL rows and fail the query once it is true;
+// cancel() may be called from any thread.
+class QueryControl {
+public:
+    static constexpr size_t CHECK_INTERVAL = 1024;
+    
+    explicit QueryControl(uint32_t timeoutMs = 0);  // 0 = no deadline
+    
+    void cancel() { cancelled_.store(true, std::memory_order_relaxed); }
+    bool cancelled() const { return cancelled_.load(std::memory_order_relaxed); }
+    bool expired() const;
+    
+    uint64_t elapsedMs() const;
+    std::string reason() const;  // why expired() is true
+    
+private:
+    std::chrono::steady_clock::time_point start_;
+    std::chrono::steady_clock::time_point deadline_;
+    uint32_t timeoutMs_;
+    std::atomic<bool> cancelled_;
+};
+
+#endif // QUERYCONTROL_H
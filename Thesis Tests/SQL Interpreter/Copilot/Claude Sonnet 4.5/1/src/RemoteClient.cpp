@@ -0,0 +1,239 @@
+#include "RemoteClient.h"
+#include "WireProtocol.h"
+#include "ScriptReader.h"
+#include "ResultEncoder.h"
+#include <iostream>
+#include <thread>
+#include <cstring>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+// Queued QUERY frames are sent once they grow beyond this many bytes
+static const size_t SEND_BATCH_BYTES = 256 * 1024;
+
+RemoteClient::RemoteClient(const std::string& host, int port)
+    : host_(host), port_(port), socket_(-1), inputPos_(0) {}
+
+RemoteClient::~RemoteClient() {
+    if (socket_ >= 0) {
+        close(socket_);
+    }
+}
+
+bool RemoteClient::connect() {
+    struct addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo* addresses = nullptr;
+    int status = getaddrinfo(host_.c_str(), std::to_string(port_).c_str(), &hints, &addresses);
+    if (status != 0) {
+        error_ = "Cannot resolve '" + host_ + "': " + gai_strerror(status);
+        return false;
+    }
+    for (struct addrinfo* address = addresses; address && socket_ < 0; address = address->ai_next) {
+        socket_ = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+        if (socket_ >= 0 && ::connect(socket_, address->ai_addr, address->ai_addrlen) < 0) {
+            close(socket_);
+            socket_ = -1;
+        }
+    }
+    freeaddrinfo(addresses);
+    if (socket_ < 0) {
+        error_ = "Cannot connect to " + host_ + ":" + std::to_string(port_) +
+                 " (is it running with --binary?)";
+        return false;
+    }
+    
+    int noDelay = 1;
+    setsockopt(socket_, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+    return true;
+}
+
+void RemoteClient::repl() {
+    std::cout << "MiniSQL client connected to " << host_ << ":" << port_ << "\n";
+    std::cout << "Type SQL commands or '.exit' to quit.\n\n";
+    
+    std::string buffer;
+    
+    while (true) {
+        std::cout << "minisql> ";
+        std::string line;
+        
+        if (!std::getline(std::cin, line)) {
+            break;
+        }
+        
+        if (line == ".exit" || line == ".quit") {
+            break;
+        }
+        
+        if (line.empty()) {
+            continue;
+        }
+        
+        buffer += line + " ";
+        
+        // Interactive statements wait for their answer before the next prompt
+        if (line.find(';') != std::string::npos) {
+            std::string frame;
+            Wire::appendFrame(frame, Wire::QUERY, buffer);
+            buffer.clear();
+            QueryResult result;
+            if (!sendAll(frame) || !readResult(result)) {
+                std::cerr << "Error: " << (error_.empty() ? "Connection closed by the server" : error_) << "\n";
+                return;
+            }
+            printResult(result);
+        }
+    }
+    
+    std::string frame;
+    Wire::appendFrame(frame, Wire::TERMINATE, "");
+    sendAll(frame);
+}
+
+bool RemoteClient::runScript(const std::string& filename) {
+    ScriptReader reader;
+    if (!reader.open(filename)) {
+        error_ = reader.getError();
+        return false;
+    }
+    
+    // Answers are printed as they arrive. After TERMINATE the server answers
+    // everything sent before it and closes, which ends the receiver.
+    std::thread receiver([this]() {
+        QueryResult result;
+        while (readResult(result)) {
+            printResult(result);
+            result = QueryResult();
+        }
+    });
+    
+    std::string out;
+    std::string sql;
+    bool sent = true;
+    while (sent && reader.next(sql)) {
+        Wire::appendFrame(out, Wire::QUERY, sql);
+        if (out.size() >= SEND_BATCH_BYTES) {
+            sent = sendAll(out);
+            out.clear();
+        }
+    }
+    Wire::appendFrame(out, Wire::TERMINATE, "");
+    sent = sent && sendAll(out);
+    if (!sent) {
+        shutdown(socket_, SHUT_RDWR);  // the server is gone; unblock the receiver
+    }
+    receiver.join();
+    
+    if (!sent) {
+        error_ = "Connection closed by the server";
+    }
+    return sent && error_.empty();
+}
+
+bool RemoteClient::sendAll(const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = send(socket_, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0) {
+            return false;
+        }
+        sent += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool RemoteClient::readFrame(uint8_t& type, std::string& payload) {
+    char buffer[65536];
+    while (!Wire::readFrame(input_, inputPos_, type, payload)) {
+        if (input_.size() - inputPos_ >= 4 && Wire::getU32(input_.data() + inputPos_) == 0) {
+            error_ = "Invalid frame from the server";
+            return false;
+        }
+        // Drop consumed frames before reading more
+        input_.erase(0, inputPos_);
+        inputPos_ = 0;
+        ssize_t bytesRead = recv(socket_, buffer, sizeof(buffer), 0);
+        if (bytesRead <= 0) {
+            return false;
+        }
+        input_.append(buffer, static_cast<size_t>(bytesRead));
+    }
+    return true;
+}
+
+bool RemoteClient::readResult(QueryResult& result) {
+    uint8_t type;
+    std::string payload;
+    while (readFrame(type, payload)) {
+        const char* p = payload.data();
+        const char* end = p + payload.size();
+        if (type == Wire::ERROR) {
+            result.ok = false;
+            result.message = payload;
+            return true;
+        }
+        if (type == Wire::COMPLETE) {
+            result.message = payload.size() >= 4 ? payload.substr(4) : "";
+            return true;
+        }
+        if (type == Wire::ROW_DESC && end - p >= 2) {
+            result.hasRows = true;
+            uint16_t count = Wire::getU16(p);
+            p += 2;
+            for (uint16_t i = 0; i < count && end - p >= 3; ++i) {
+                uint16_t length = Wire::getU16(p + 1);
+                p += 3;
+                if (end - p < length) break;
+                result.columns.emplace_back(p, length);
+                p += length;
+            }
+            if (result.columns.size() != count) {
+                error_ = "Malformed row description from the server";
+                return false;
+            }
+        } else if (type == Wire::ROW_BATCH && end - p >= 4) {
+            uint32_t rows = Wire::getU32(p);
+            p += 4;
+            for (uint32_t r = 0; r < rows; ++r) {
+                Row row;
+                row.values.resize(result.columns.size());
+                row.cells.resize(result.columns.size());
+                for (size_t c = 0; c < result.columns.size(); ++c) {
+                    if (!Wire::getValue(p, end, row.cells[c], row.values[c])) {
+                        error_ = "Truncated or malformed row batch from the server";
+                        return false;
+                    }
+                }
+                result.rows.append(std::move(row));
+            }
+        } else {
+            error_ = "Unexpected frame from the server";
+            return false;
+        }
+    }
+    return false;
+}
+
+void RemoteClient::printResult(const QueryResult& result) {
+    // Same output as a local script: tables or messages on stdout, errors on stderr
+    if (!result.ok) {
+        std::cerr << result.message << "\n";
+        return;
+    }
+    std::string output = result.message;
+    if (result.hasRows) {
+        std::string error;
+        if (!ResultEncoder::encode(result, ResultFormat::TABLE, output, error)) {
+            output = "Error: " + error;
+        }
+    }
+    if (!output.empty()) {
+        std::cout << output << "\n";
+    }
+}
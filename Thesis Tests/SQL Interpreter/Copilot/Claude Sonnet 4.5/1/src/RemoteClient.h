@@ -0,0 +1,43 @@
+#ifndef REMOTECLIENT_H
+#define REMOTECLIENT_H
+
+#include <string>
+#include "Engine.h"
+
+// Client mode (minisql --connect host:port): statements go to a running
+// BinaryServer over one persistent connection instead of an in-process
+// Engine, so the server's warm tables are shared and nothing is loaded.
+//
+// Scripts are pipelined. Statements are sent back to back while a receiver
+// thread prints the answers, which the server returns strictly in order, so
+// a long script costs bandwidth rather than a round trip per statement.
+class RemoteClient {
+public:
+    RemoteClient(const std::string& host, int port);
+    ~RemoteClient();
+    
+    RemoteClient(const RemoteClient&) = delete;
+    RemoteClient& operator=(const RemoteClient&) = delete;
+    
+    bool connect();
+    void repl();                                       // one statement at a time
+    bool runScript(const std::string& filename);       // pipelined
+    
+    std::string getError() const { return error_; }
+    
+private:
+    std::string host_;
+    int port_;
+    int socket_;
+    std::string input_;   // received bytes not yet decoded
+    size_t inputPos_;
+    std::string error_;
+    
+    bool sendAll(const std::string& data);
+    bool readFrame(uint8_t& type, std::string& payload);  // false once the connection ends
+    // Next answer: rows for ROW_DESC/ROW_BATCH, then COMPLETE or ERROR
+    bool readResult(QueryResult& result);
+    static void printResult(const QueryResult& result);
+};
+
+#endif // REMOTECLIENT_H
@@ -0,0 +1,596 @@
+#include "Replication.h"
+#include "WireProtocol.h"
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+namespace {
+
+// A replica this far behind is dropped rather than buffered for; it
+// re-bootstraps from a new snapshot when it reconnects
+const size_t MAX_PENDING_BYTES = 64u << 20;
+const int RECONNECT_DELAY_MS = 1000;
+
+void putU64(std::string& out, uint64_t v) {
+    Wire::putU32(out, static_cast<uint32_t>(v >> 32));
+    Wire::putU32(out, static_cast<uint32_t>(v));
+}
+
+void putString16(std::string& out, const std::string& s) {
+    Wire::putU16(out, static_cast<uint16_t>(s.size()));
+    out += s;
+}
+
+void putString32(std::string& out, const std::string& s) {
+    Wire::putU32(out, static_cast<uint32_t>(s.size()));
+    out += s;
+}
+
+// Bounds-checked decoding of a frame payload; any overrun marks it bad
+class PayloadReader {
+public:
+    explicit PayloadReader(const std::string& payload) : data_(payload), pos_(0), ok_(true) {}
+    
+    uint8_t u8() {
+        return need(1) ? static_cast<uint8_t>(data_[pos_++]) : 0;
+    }
+    
+    uint16_t u16() {
+        if (!need(2)) return 0;
+        uint16_t v = Wire::getU16(data_.data() + pos_);
+        pos_ += 2;
+        return v;
+    }
+    
+    uint32_t u32() {
+        if (!need(4)) return 0;
+        uint32_t v = Wire::getU32(data_.data() + pos_);
+        pos_ += 4;
+        return v;
+    }
+    
+    uint64_t u64() {
+        uint64_t high = u32();
+        return (high << 32) | u32();
+    }
+    
+    std::string bytes(size_t length) {
+        if (!need(length)) return std::string();
+        std::string s = data_.substr(pos_, length);
+        pos_ += length;
+        return s;
+    }
+    
+    std::string rest() {
+        return bytes(data_.size() - pos_);
+    }
+    
+    bool ok() const { return ok_ && pos_ == data_.size(); }
+    
+private:
+    const std::string& data_;
+    size_t pos_;
+    bool ok_;
+    
+    bool need(size_t n) {
+        if (data_.size() - pos_ < n) ok_ = false;
+        return ok_;
+    }
+};
+
+bool sendAll(int socket, const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = send(socket, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0) {
+            return false;
+        }
+        sent += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool makeAddress(const std::string& path, struct sockaddr_un& address) {
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+        return false;
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+} // namespace
+
+namespace Replication {
+
+void encodeTable(const Storage& storage, TableId id, std::string& out) {
+    const Catalog& catalog = storage.catalog();
+    const TableSchema& schema = catalog.table(id);
+    const Table* table = storage.getTable(id);
+    
+    size_t frame = Wire::beginFrame(out, TABLE);
+    Wire::putU32(out, id);
+    putString16(out, catalog.tableName(id));
+    Wire::putU16(out, static_cast<uint16_t>(table->columns.size()));
+    for (const std::string& column : table->columns) {
+        putString16(out, column);
+    }
+    const PartitionSpec& spec = schema.partitioning;
+    out += static_cast<char>(spec.kind);
+    Wire::putU32(out, spec.column);
+    Wire::putU32(out, spec.count);
+    Wire::putU16(out, static_cast<uint16_t>(spec.rangeBounds.size()));
+    for (const std::string& bound : spec.rangeBounds) {
+        putString32(out, bound);
+    }
+    Wire::putU32(out, schema.primaryKey);
+    Wire::endFrame(out, frame);
+}
+
+void encodeIndex(TableId id, const IndexSchema& index, const Catalog& catalog, std::string& out) {
+    size_t frame = Wire::beginFrame(out, INDEX);
+    Wire::putU32(out, id);
+    Wire::putU32(out, index.column);
+    out += static_cast<char>(index.kind);
+    out += catalog.identifier(index.name);
+    Wire::endFrame(out, frame);
+}
+
+void encodeRows(const Storage& storage, TableId id, const std::vector<uint32_t>& rowIds, std::string& out) {
+    const Table* table = storage.getTable(id);
+    for (size_t start = 0; start < rowIds.size(); start += Wire::ROWS_PER_BATCH) {
+        size_t end = std::min(rowIds.size(), start + Wire::ROWS_PER_BATCH);
+        size_t frame = Wire::beginFrame(out, ROWS);
+        Wire::putU32(out, id);
+        Wire::putU32(out, static_cast<uint32_t>(end - start));
+        for (size_t i = start; i < end; ++i) {
+            for (const std::string& value : table->rows[rowIds[i]].values) {
+                putString32(out, value);
+            }
+        }
+        Wire::endFrame(out, frame);
+    }
+}
+
+void encodeView(const Catalog& catalog, ViewId id, std::string& out) {
+    size_t frame = Wire::beginFrame(out, VIEW);
+    Wire::putU32(out, id);
+    putString16(out, catalog.viewName(id));
+    out += catalog.view(id).definition;
+    Wire::endFrame(out, frame);
+}
+
+void encodeSnapshot(const Storage& storage, std::string& out) {
+    const Catalog& catalog = storage.catalog();
+    for (TableId id = 0; id < catalog.tableCount(); ++id) {
+        encodeTable(storage, id, out);
+        for (const IndexSchema& index : catalog.table(id).indexes) {
+            encodeIndex(id, index, catalog, out);
+        }
+        std::vector<uint32_t> rowIds(storage.getTable(id)->rows.size());
+        for (uint32_t r = 0; r < rowIds.size(); ++r) {
+            rowIds[r] = r;
+        }
+        encodeRows(storage, id, rowIds, out);
+    }
+    for (ViewId id = 0; id < catalog.viewCount(); ++id) {
+        encodeView(catalog, id, out);
+    }
+}
+
+bool apply(Storage& storage, uint8_t type, const std::string& payload, std::string& error) {
+    PayloadReader reader(payload);
+    TableId id = reader.u32();
+    
+    if (type == TABLE) {
+        std::string name = reader.bytes(reader.u16());
+        std::vector<std::string> columns(reader.u16());
+        for (std::string& column : columns) {
+            column = reader.bytes(reader.u16());
+        }
+        PartitionSpec spec;
+        spec.kind = static_cast<PartitionKind>(reader.u8());
+        spec.column = reader.u32();
+        spec.count = reader.u32();
+        spec.rangeBounds.resize(reader.u16());
+        for (std::string& bound : spec.rangeBounds) {
+            bound = reader.bytes(reader.u32());
+        }
+        uint32_t primaryKey = reader.u32();
+        if (!reader.ok()) {
+            error = "Malformed TABLE frame";
+            return false;
+        }
+        if (id != storage.catalog().tableCount()) {
+            error = "Table '" + name + "' arrived out of order";
+            return false;
+        }
+        if (!storage.createTable(name, columns, spec, primaryKey)) {
+            error = storage.getLastError();
+            return false;
+        }
+        return true;
+    }
+    
+    if (type == VIEW) {
+        std::string name = reader.bytes(reader.u16());
+        std::string definition = reader.rest();
+        if (!reader.ok()) {
+            error = "Malformed VIEW frame";
+            return false;
+        }
+        if (id != storage.catalog().viewCount()) {
+            error = "View '" + name + "' arrived out of order";
+            return false;
+        }
+        if (!storage.createView(name, definition)) {
+            error = storage.getLastError();
+            return false;
+        }
+        return true;
+    }
+    
+    if (id >= storage.catalog().tableCount()) {
+        error = "Change for unknown table id " + std::to_string(id);
+        return false;
+    }
+    
+    if (type == INDEX) {
+        uint32_t column = reader.u32();
+        IndexKind kind = static_cast<IndexKind>(reader.u8());
+        std::string name = reader.rest();
+        if (!reader.ok()) {
+            error = "Malformed INDEX frame";
+            return false;
+        }
+        if (!storage.createIndex(id, name, column, kind)) {
+            error = storage.getLastError();
+            return false;
+        }
+        return true;
+    }
+    
+    if (type == ROWS) {
+        size_t columnCount = storage.getTable(id)->columns.size();
+        uint32_t rowCount = reader.u32();
+        if (static_cast<uint64_t>(rowCount) * columnCount * 4 > payload.size()) {
+            error = "Malformed ROWS frame";
+            return false;
+        }
+        std::vector<std::vector<std::string>> rows(rowCount);
+        for (auto& values : rows) {
+            values.resize(columnCount);
+            for (std::string& value : values) {
+                value = reader.bytes(reader.u32());
+            }
+        }
+        if (!reader.ok()) {
+            error = "Malformed ROWS frame";
+            return false;
+        }
+        ConflictAction onConflict = storage.catalog().table(id).primaryKey != INVALID_ID
+            ? ConflictAction::UPDATE : ConflictAction::ABORT;
+        if (!storage.insertRows(id, rows, onConflict)) {
+            error = storage.getLastError();
+            return false;
+        }
+        return true;
+    }
+    
+    error = "Unknown frame type";
+    return false;
+}
+
+} // namespace Replication
+
+ReplicationServer::ReplicationServer(Engine* engine, const std::string& socketPath)
+    : engine_(engine), socketPath_(socketPath), serverSocket_(-1), running_(false) {}
+
+ReplicationServer::~ReplicationServer() {
+    stop();
+}
+
+bool ReplicationServer::start() {
+    struct sockaddr_un address;
+    if (!makeAddress(socketPath_, address)) {
+        std::cerr << "Error: Invalid replication socket path '" << socketPath_ << "'\n";
+        return false;
+    }
+    
+    serverSocket_ = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (serverSocket_ < 0) {
+        std::cerr << "Error: Failed to create socket\n";
+        return false;
+    }
+    
+    // A socket left behind by an earlier run would make bind fail
+    struct stat st;
+    if (stat(socketPath_.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+        unlink(socketPath_.c_str());
+    }
+    
+    if (bind(serverSocket_, (struct sockaddr*)&address, sizeof(address)) < 0) {
+        std::cerr << "Error: Failed to bind to " << socketPath_ << "\n";
+        close(serverSocket_);
+        return false;
+    }
+    
+    if (listen(serverSocket_, 16) < 0) {
+        std::cerr << "Error: Failed to listen on socket\n";
+        close(serverSocket_);
+        return false;
+    }
+    
+    engine_->setChangeListener(this);
+    running_ = true;
+    std::cout << "Replication primary listening on " << socketPath_ << "\n";
+    
+    while (running_) {
+        int clientSocket = accept(serverSocket_, nullptr, nullptr);
+        if (clientSocket < 0) {
+            if (running_) {
+                std::cerr << "Error: Failed to accept connection\n";
+            }
+            continue;
+        }
+        
+        auto replica = std::make_shared<Replica>();
+        replica->socket = clientSocket;
+        std::thread(&ReplicationServer::serveReplica, this, replica).detach();
+    }
+    
+    return true;
+}
+
+void ReplicationServer::stop() {
+    running_ = false;
+    if (serverSocket_ >= 0) {
+        close(serverSocket_);
+        serverSocket_ = -1;
+        unlink(socketPath_.c_str());
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    changed_.notify_all();
+}
+
+void ReplicationServer::serveReplica(std::shared_ptr<Replica> replica) {
+    // Encoding the snapshot and subscribing happen under the engine lock, so
+    // every change reaches the replica exactly once: in the snapshot or after it
+    std::string snapshot;
+    engine_->withStorage([&](const Storage& storage) {
+        Replication::encodeSnapshot(storage, snapshot);
+        std::lock_guard<std::mutex> lock(mutex_);
+        size_t frame = Wire::beginFrame(snapshot, Replication::SNAPSHOT_END);
+        putU64(snapshot, lsn_);
+        Wire::endFrame(snapshot, frame);
+        replicas_.push_back(replica);
+    });
+    
+    // The snapshot is sent outside every lock; changes queue up meanwhile
+    bool ok = sendAll(replica->socket, snapshot);
+    std::string().swap(snapshot);
+    
+    std::string batch;
+    while (ok) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            changed_.wait(lock, [&] { return !replica->pending.empty() || replica->closed || !running_; });
+            if (replica->closed || !running_) {
+                break;
+            }
+            batch.swap(replica->pending);
+        }
+        ok = sendAll(replica->socket, batch);
+        batch.clear();
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        replicas_.erase(std::remove(replicas_.begin(), replicas_.end(), replica), replicas_.end());
+    }
+    close(replica->socket);
+}
+
+void ReplicationServer::publish(const std::string& frame) {
+    for (const auto& replica : replicas_) {
+        if (replica->closed) {
+            continue;
+        }
+        if (replica->pending.size() + frame.size() > MAX_PENDING_BYTES) {
+            std::cerr << "Warning: Dropping replica that fell " << replica->pending.size()
+                      << " bytes behind\n";
+            replica->closed = true;
+            shutdown(replica->socket, SHUT_RDWR);
+            continue;
+        }
+        replica->pending += frame;
+    }
+    changed_.notify_all();
+}
+
+void ReplicationServer::tableCreated(const Storage& storage, TableId id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++lsn_;
+    if (replicas_.empty()) {
+        return;
+    }
+    std::string frame;
+    Replication::encodeTable(storage, id, frame);
+    publish(frame);
+}
+
+void ReplicationServer::indexCreated(const Storage& storage, TableId id, const IndexSchema& index) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++lsn_;
+    if (replicas_.empty()) {
+        return;
+    }
+    std::string frame;
+    Replication::encodeIndex(id, index, storage.catalog(), frame);
+    publish(frame);
+}
+
+void ReplicationServer::viewCreated(const Storage& storage, ViewId id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++lsn_;
+    if (replicas_.empty()) {
+        return;
+    }
+    std::string frame;
+    Replication::encodeView(storage.catalog(), id, frame);
+    publish(frame);
+}
+
+void ReplicationServer::rowsWritten(const Storage& storage, TableId id, const std::vector<uint32_t>& rowIds) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++lsn_;
+    if (replicas_.empty()) {
+        return;
+    }
+    std::string frame;
+    Replication::encodeRows(storage, id, rowIds, frame);
+    publish(frame);
+}
+
+ReplicaClient::ReplicaClient(Engine* engine, const std::string& socketPath)
+    : engine_(engine), socketPath_(socketPath), running_(false), socket_(-1) {}
+
+ReplicaClient::~ReplicaClient() {
+    stop();
+}
+
+void ReplicaClient::start() {
+    running_ = true;
+    thread_ = std::thread(&ReplicaClient::run, this);
+}
+
+void ReplicaClient::stop() {
+    running_ = false;
+    int socket = socket_.load();
+    if (socket >= 0) {
+        shutdown(socket, SHUT_RDWR);
+    }
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+bool ReplicaClient::waitForSnapshot(int timeoutMs) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return bootstrapped_.wait_for(lock, std::chrono::milliseconds(timeoutMs), [this] { return hasSnapshot_; });
+}
+
+void ReplicaClient::run() {
+    bool warned = false;
+    while (running_) {
+        if (!follow() && !warned) {
+            std::cerr << "Replica: waiting for primary at " << socketPath_ << "\n";
+            warned = true;
+        }
+        for (int waited = 0; running_ && waited < RECONNECT_DELAY_MS; waited += 100) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+    }
+}
+
+bool ReplicaClient::follow() {
+    struct sockaddr_un address;
+    if (!makeAddress(socketPath_, address)) {
+        return false;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return false;
+    }
+    if (connect(fd, (struct sockaddr*)&address, sizeof(address)) < 0) {
+        close(fd);
+        return false;
+    }
+    socket_ = fd;
+    
+    // Snapshot frames are collected and applied in one step, so readers see
+    // either the previous state or the complete new snapshot
+    std::vector<std::pair<uint8_t, std::string>> snapshot;
+    bool bootstrapped = false;
+    std::string input;
+    std::string error;
+    char buffer[65536];
+    
+    while (running_ && error.empty()) {
+        ssize_t bytesRead = recv(fd, buffer, sizeof(buffer), 0);
+        if (bytesRead <= 0) {
+            break;
+        }
+        input.append(buffer, static_cast<size_t>(bytesRead));
+        
+        size_t offset = 0;
+        uint8_t type;
+        std::string payload;
+        std::vector<std::pair<uint8_t, std::string>> changes;
+        while (true) {
+            if (input.size() - offset >= 4 && Wire::getU32(input.data() + offset) > Wire::MAX_FRAME_SIZE) {
+                error = "Invalid frame length";
+                break;
+            }
+            if (!Wire::readFrame(input, offset, type, payload)) {
+                break;
+            }
+            if (bootstrapped) {
+                changes.emplace_back(type, std::move(payload));
+            } else if (type != Replication::SNAPSHOT_END) {
+                snapshot.emplace_back(type, std::move(payload));
+            } else {
+                uint64_t lsn = PayloadReader(payload).u64();
+                size_t tables = 0;
+                engine_->updateStorage([&](Storage& storage) {
+                    storage.clear();
+                    for (const auto& frame : snapshot) {
+                        if (!Replication::apply(storage, frame.first, frame.second, error)) {
+                            return false;
+                        }
+                    }
+                    tables = storage.catalog().tableCount();
+                    return true;
+                });
+                snapshot.clear();
+                if (!error.empty()) {
+                    break;
+                }
+                bootstrapped = true;
+                std::cerr << "Replica: bootstrapped " << tables << " table(s) from " << socketPath_
+                          << " at LSN " << lsn << "\n";
+                std::lock_guard<std::mutex> lock(mutex_);
+                hasSnapshot_ = true;
+                bootstrapped_.notify_all();
+            }
+        }
+        input.erase(0, offset);
+        
+        // Everything that arrived together is applied under one lock
+        if (!changes.empty() && error.empty()) {
+            engine_->updateStorage([&](Storage& storage) {
+                for (const auto& frame : changes) {
+                    if (!Replication::apply(storage, frame.first, frame.second, error)) {
+                        return false;
+                    }
+                }
+                return true;
+            });
+        }
+    }
+    
+    if (!error.empty()) {
+        std::cerr << "Replica: " << error << "; resynchronizing\n";
+    } else if (bootstrapped && running_) {
+        std::cerr << "Replica: lost connection to primary, reconnecting\n";
+    }
+    socket_ = -1;
+    close(fd);
+    return true;
+}
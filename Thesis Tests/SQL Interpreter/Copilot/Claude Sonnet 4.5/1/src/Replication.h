@@ -0,0 +1,116 @@
+#ifndef REPLICATION_H
+#define REPLICATION_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <cstdint>
+#include "Engine.h"
+
+// Log shipping from a primary (--primary <socket>) to read-only replicas
+// (--replica-of <socket>) over a Unix domain socket, using the frame layout
+// of WireProtocol.h.
+//
+// On connect the primary sends a snapshot taken under the engine lock, so it
+// matches exactly one point in the commit order:
+//   'S' TABLE         u32 tableId, u16 nameLen, name, u16 columnCount, {u16 len, name}*,
+//                     u8 partitionKind, u32 partitionColumn, u32 partitionCount,
+//                     u16 boundCount, {u32 len, bytes}*, u32 primaryKey
+//   'I' INDEX         u32 tableId, u32 column, u8 kind, name
+//   'R' ROWS          u32 tableId, u32 rowCount, then per row and column: u32 len, bytes
+//   'V' VIEW          u32 viewId, u16 nameLen, name, definition (after every table)
+//   'B' SNAPSHOT_END  u64 lsn (changes committed on the primary since it started)
+// and then one TABLE/INDEX/ROWS/VIEW frame per later change, in commit order.
+// Replicas create tables and views in the primary's order, so ids match, and
+// maintain the views from ROWS themselves. ROWS
+// carries the rows as written (the new version for upserts), so replicas
+// apply it with ON CONFLICT DO UPDATE semantics on keyed tables.
+namespace Replication {
+
+const uint8_t TABLE        = 'S';
+const uint8_t INDEX        = 'I';
+const uint8_t ROWS         = 'R';
+const uint8_t VIEW         = 'V';
+const uint8_t SNAPSHOT_END = 'B';
+
+void encodeTable(const Storage& storage, TableId id, std::string& out);
+void encodeIndex(TableId id, const IndexSchema& index, const Catalog& catalog, std::string& out);
+void encodeRows(const Storage& storage, TableId id, const std::vector<uint32_t>& rowIds, std::string& out);
+void encodeView(const Catalog& catalog, ViewId id, std::string& out);
+// Every table, index, row and view, as the frames above (without SNAPSHOT_END)
+void encodeSnapshot(const Storage& storage, std::string& out);
+
+// Apply one TABLE/INDEX/ROWS/VIEW frame; false with error set if it does not fit
+bool apply(Storage& storage, uint8_t type, const std::string& payload, std::string& error);
+
+} // namespace Replication
+
+// Primary side: accepts replicas and streams the snapshot plus every change
+class ReplicationServer : public ChangeListener {
+public:
+    ReplicationServer(Engine* engine, const std::string& socketPath);
+    ~ReplicationServer();
+    
+    bool start();  // blocks in the accept loop
+    void stop();
+    
+    void tableCreated(const Storage& storage, TableId id) override;
+    void indexCreated(const Storage& storage, TableId id, const IndexSchema& index) override;
+    void viewCreated(const Storage& storage, ViewId id) override;
+    void rowsWritten(const Storage& storage, TableId id, const std::vector<uint32_t>& rowIds) override;
+    
+private:
+    // One connected replica; frames queue in pending until its sender thread sends them
+    struct Replica {
+        int socket;
+        std::string pending;
+        bool closed = false;
+    };
+    
+    Engine* engine_;
+    std::string socketPath_;
+    int serverSocket_;
+    bool running_;
+    
+    std::mutex mutex_;
+    std::condition_variable changed_;
+    std::vector<std::shared_ptr<Replica>> replicas_;
+    uint64_t lsn_ = 0;  // changes committed since start
+    
+    void publish(const std::string& frame);  // caller holds mutex_
+    void serveReplica(std::shared_ptr<Replica> replica);
+};
+
+// Replica side: follows a primary, re-bootstrapping from a fresh snapshot
+// whenever the connection is (re)established
+class ReplicaClient {
+public:
+    ReplicaClient(Engine* engine, const std::string& socketPath);
+    ~ReplicaClient();
+    
+    void start();  // background thread
+    void stop();
+    
+    // Wait until the first snapshot is applied; false on timeout
+    bool waitForSnapshot(int timeoutMs);
+    
+private:
+    Engine* engine_;
+    std::string socketPath_;
+    std::atomic<bool> running_;
+    std::atomic<int> socket_;
+    std::thread thread_;
+    
+    std::mutex mutex_;
+    std::condition_variable bootstrapped_;
+    bool hasSnapshot_ = false;
+    
+    void run();
+    bool follow();  // one connection; returns when it drops
+};
+
+#endif // REPLICATION_H
@@ -0,0 +1,651 @@
+#include "ResultEncoder.h"
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+const size_t CHARGE_STEP = 64 * 1024;  // output bytes charged to the tracker at a time
+
+inline bool isNull(const std::string& value) {
+    return value.size() == 2 && value[0] == NULL_TEXT[0] && value[1] == NULL_TEXT[1];
+}
+
+// Result rows carry the cells of the rows they were projected from; rows
+// without them (from other sources) are typed here
+inline const Cell& cellOf(const Row& row, size_t column, Cell& scratch) {
+    if (row.cells.size() == row.values.size()) {
+        return row.cells[column];
+    }
+    scratch = Cell::classify(row.values[column]);
+    return scratch;
+}
+
+inline size_t alignUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// Charges out's growth to the query's MemoryTracker in CHARGE_STEP pieces
+class OutputBudget {
+public:
+    OutputBudget(const QueryResult& result, const std::string& out, std::string& error)
+        : memory_(result.memory.get()), out_(out), error_(error), reserved_(0) {}
+    
+    bool charge() {
+        if (out_.size() <= reserved_) {
+            return true;
+        }
+        size_t step = std::max(CHARGE_STEP, out_.size() - reserved_);
+        if (memory_ && !memory_->reserve("format", step)) {
+            error_ = "Result of more than " + std::to_string(reserved_) +
+                     " bytes exceeds the memory limit of " + std::to_string(memory_->limit()) + " bytes";
+            return false;
+        }
+        reserved_ += step;
+        return true;
+    }
+    
+private:
+    MemoryTracker* memory_;
+    const std::string& out_;
+    std::string& error_;
+    size_t reserved_;
+};
+
+void appendEscapedByte(std::string& out, unsigned char c) {
+    static const char hex[] = "0123456789abcdef";
+    switch (c) {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        case '\b': out += "\\b"; break;
+        case '\f': out += "\\f"; break;
+        default:
+            out += "\\u00";
+            out += hex[c >> 4];
+            out += hex[c & 0xF];
+    }
+}
+
+// Canonical numbers unquoted, NULL as null, everything else as a string
+void appendJsonValue(std::string& out, const Cell& cell, const std::string& value) {
+    switch (cell.type) {
+        case ValueType::NULL_VALUE:
+            out += "null";
+            break;
+        case ValueType::INT64:
+        case ValueType::DOUBLE:
+            out += value;
+            break;
+        default:
+            ResultEncoder::appendJsonString(out, value);
+    }
+}
+
+void appendCsvField(std::string& out, const std::string& value) {
+    if (isNull(value)) {
+        return;
+    }
+    if (!value.empty() && value.find_first_of(",\"\r\n") == std::string::npos) {
+        out += value;
+        return;
+    }
+    // Quoted, with embedded quotes doubled; "" is the empty string
+    out += '"';
+    size_t start = 0;
+    size_t quote;
+    while ((quote = value.find('"', start)) != std::string::npos) {
+        out.append(value, start, quote + 1 - start);
+        out += '"';
+        start = quote + 1;
+    }
+    out.append(value, start, std::string::npos);
+    out += '"';
+}
+
+bool encodeTable(const QueryResult& result, std::string& out, std::string& error) {
+    if (result.columns.empty()) {
+        out = "Empty table";
+        return true;
+    }
+    
+    auto display = [](const std::string& value) -> const std::string& {
+        static const std::string null = "NULL";
+        return isNull(value) ? null : value;
+    };
+    
+    // Column widths need a pass of their own
+    std::vector<size_t> widths(result.columns.size());
+    for (size_t i = 0; i < result.columns.size(); ++i) {
+        widths[i] = result.columns[i].length();
+    }
+    result.rows.forEach([&widths, &display](const Row& row) {
+        for (size_t i = 0; i < row.values.size() && i < widths.size(); ++i) {
+            widths[i] = std::max(widths[i], display(row.values[i]).length());
+        }
+        return true;
+    });
+    
+    // Every line (header, separator, rows) has the same padded length, so the
+    // output size is known before anything is written
+    size_t lineLength = 1;
+    for (size_t i = 0; i < widths.size(); ++i) {
+        lineLength += widths[i] + (i > 0 ? 3 : 0);
+    }
+    size_t outputBytes = lineLength * (result.rows.size() + 2) + 32;
+    if (result.memory && !result.memory->reserve("format", outputBytes)) {
+        error = "Result of " + std::to_string(outputBytes) + " bytes exceeds the memory limit of " +
+                std::to_string(result.memory->limit()) + " bytes";
+        return false;
+    }
+    out.reserve(outputBytes);
+    
+    auto cell = [&out, &widths](size_t i, const std::string& text) {
+        if (i > 0) out += " | ";
+        out += text;
+        out.append(widths[i] - std::min(widths[i], text.size()), ' ');
+    };
+    
+    for (size_t i = 0; i < result.columns.size(); ++i) {
+        cell(i, result.columns[i]);
+    }
+    out += '\n';
+    for (size_t i = 0; i < widths.size(); ++i) {
+        if (i > 0) out += "-+-";
+        out.append(widths[i], '-');
+    }
+    out += '\n';
+    result.rows.forEach([&out, &cell, &display](const Row& row) {
+        for (size_t i = 0; i < row.values.size(); ++i) {
+            cell(i, display(row.values[i]));
+        }
+        out += '\n';
+        return true;
+    });
+    out += "\n(";
+    out += std::to_string(result.rows.size());
+    out += " row(s) returned)";
+    return true;
+}
+
+bool encodeJson(const QueryResult& result, std::string& out, std::string& error) {
+    OutputBudget budget(result, out, error);
+    out += "{\"columns\":[";
+    for (size_t i = 0; i < result.columns.size(); ++i) {
+        if (i > 0) out += ',';
+        ResultEncoder::appendJsonString(out, result.columns[i]);
+    }
+    out += "],\"rows\":[";
+    bool first = true;
+    Cell scratch;
+    bool ok = result.rows.forEach([&](const Row& row) {
+        out += first ? "[" : ",[";
+        first = false;
+        for (size_t i = 0; i < row.values.size(); ++i) {
+            if (i > 0) out += ',';
+            appendJsonValue(out, cellOf(row, i, scratch), row.values[i]);
+        }
+        out += ']';
+        return budget.charge();
+    });
+    out += "],\"rowCount\":";
+    out += std::to_string(result.rows.size());
+    out += "}\n";
+    return ok && budget.charge();
+}
+
+bool encodeNdjson(const QueryResult& result, std::string& out, std::string& error) {
+    OutputBudget budget(result, out, error);
+    // Keys are escaped once; each row only adds its values
+    std::vector<std::string> keys(result.columns.size());
+    for (size_t i = 0; i < result.columns.size(); ++i) {
+        keys[i] = i == 0 ? "{" : ",";
+        ResultEncoder::appendJsonString(keys[i], result.columns[i]);
+        keys[i] += ':';
+    }
+    Cell scratch;
+    bool ok = result.rows.forEach([&](const Row& row) {
+        for (size_t i = 0; i < row.values.size(); ++i) {
+            out += keys[i];
+            appendJsonValue(out, cellOf(row, i, scratch), row.values[i]);
+        }
+        out += row.values.empty() ? "{}\n" : "}\n";
+        return budget.charge();
+    });
+    return ok && budget.charge();
+}
+
+bool encodeCsv(const QueryResult& result, std::string& out, std::string& error) {
+    OutputBudget budget(result, out, error);
+    for (size_t i = 0; i < result.columns.size(); ++i) {
+        if (i > 0) out += ',';
+        appendCsvField(out, result.columns[i]);
+    }
+    out += "\r\n";
+    bool ok = result.rows.forEach([&](const Row& row) {
+        for (size_t i = 0; i < row.values.size(); ++i) {
+            if (i > 0) out += ',';
+            appendCsvField(out, row.values[i]);
+        }
+        out += "\r\n";
+        return budget.charge();
+    });
+    return ok && budget.charge();
+}
+
+// --- Arrow IPC stream -------------------------------------------------------
+//
+// Each message is 0xFFFFFFFF, the metadata length, a FlatBuffers Message
+// (padded to 8 bytes) and the body; the stream ends with 0xFFFFFFFF 0. Only
+// the few tables the schema and record batches need are written, by hand.
+
+// Type ids and enum values from the Arrow format (Schema.fbs, Message.fbs)
+const uint8_t HEADER_SCHEMA = 1;
+const uint8_t HEADER_RECORD_BATCH = 3;
+const uint8_t TYPE_INT = 2;
+const uint8_t TYPE_FLOATING_POINT = 3;
+const uint8_t TYPE_UTF8 = 5;
+const uint16_t METADATA_V5 = 4;
+const uint16_t PRECISION_DOUBLE = 2;
+
+// Minimal FlatBuffers writer. Objects are laid out front to back: a table
+// comes before the strings, vectors and tables it refers to, and link()
+// fills in those offsets once the targets exist (offsets only point forward).
+// Assumes a little-endian host, like the rest of the on-disk formats.
+class FlatWriter {
+public:
+    struct Field {
+        uint16_t id;
+        uint8_t size;     // 1, 2, 4 or 8 bytes; offsets are 4 and linked later
+        uint64_t value;
+    };
+    
+    std::string bytes;
+    
+    FlatWriter() { put<uint32_t>(0); }  // root offset, linked by root()
+    
+    template <typename T>
+    void put(T value) { bytes.append(reinterpret_cast<const char*>(&value), sizeof(T)); }
+    
+    void root(size_t table) { link(0, table); }
+    void link(size_t at, size_t target) {
+        uint32_t offset = static_cast<uint32_t>(target - at);
+        std::memcpy(&bytes[at], &offset, sizeof(offset));
+    }
+    
+    // Writes a vtable and its table; at[id] is the position of field id
+    size_t table(std::vector<Field> fields, std::vector<size_t>& at) {
+        std::stable_sort(fields.begin(), fields.end(),
+                         [](const Field& a, const Field& b) { return a.size > b.size; });
+        size_t inlineSize = 4;  // soffset to the vtable
+        std::vector<uint16_t> offsets(fields.size());
+        uint16_t slots = 0;
+        for (size_t i = 0; i < fields.size(); ++i) {
+            inlineSize = alignUp(inlineSize, fields[i].size);
+            offsets[i] = static_cast<uint16_t>(inlineSize);
+            inlineSize += fields[i].size;
+            slots = std::max<uint16_t>(slots, static_cast<uint16_t>(fields[i].id + 1));
+        }
+        uint16_t vtableSize = static_cast<uint16_t>(4 + 2 * slots);
+        
+        // The vtable sits right before the table, which is 8-byte aligned
+        pad(2);
+        while ((bytes.size() + vtableSize) % 8 != 0) {
+            put<uint16_t>(0);
+        }
+        size_t vtable = bytes.size();
+        put<uint16_t>(vtableSize);
+        put<uint16_t>(static_cast<uint16_t>(inlineSize));
+        std::vector<uint16_t> slotOffsets(slots, 0);
+        for (size_t i = 0; i < fields.size(); ++i) {
+            slotOffsets[fields[i].id] = offsets[i];
+        }
+        for (uint16_t offset : slotOffsets) {
+            put<uint16_t>(offset);
+        }
+        
+        size_t table = bytes.size();
+        put<int32_t>(static_cast<int32_t>(table - vtable));
+        bytes.resize(table + inlineSize, '\0');
+        at.assign(slots, 0);
+        for (size_t i = 0; i < fields.size(); ++i) {
+            std::memcpy(&bytes[table + offsets[i]], &fields[i].value, fields[i].size);
+            at[fields[i].id] = table + offsets[i];
+        }
+        return table;
+    }
+    
+    // Vector of count offsets; element i is at the result + 4 + 4 * i
+    size_t offsetVector(size_t count) {
+        pad(4);
+        size_t vector = bytes.size();
+        put<uint32_t>(static_cast<uint32_t>(count));
+        bytes.resize(bytes.size() + 4 * count, '\0');
+        return vector;
+    }
+    
+    // Vector of structs made of 64-bit words (FieldNode, Buffer)
+    size_t structVector(const std::vector<int64_t>& words, size_t wordsPerStruct) {
+        pad(4);
+        while ((bytes.size() + 4) % 8 != 0) {
+            put<uint32_t>(0);
+        }
+        size_t vector = bytes.size();
+        put<uint32_t>(static_cast<uint32_t>(words.size() / wordsPerStruct));
+        for (int64_t word : words) {
+            put<int64_t>(word);
+        }
+        return vector;
+    }
+    
+    size_t string(const std::string& text) {
+        pad(4);
+        size_t position = bytes.size();
+        put<uint32_t>(static_cast<uint32_t>(text.size()));
+        bytes += text;
+        bytes += '\0';
+        return position;
+    }
+    
+private:
+    void pad(size_t alignment) {
+        while (bytes.size() % alignment != 0) {
+            bytes += '\0';
+        }
+    }
+};
+
+enum class ArrowType { UNKNOWN, INT64, DOUBLE, UTF8 };
+
+// Message table with its header; returns where the header offset goes
+size_t beginMessage(FlatWriter& fb, uint8_t headerType, int64_t bodyLength) {
+    std::vector<size_t> at;
+    size_t message = fb.table({{0, 2, METADATA_V5},
+                               {1, 1, headerType},
+                               {2, 4, 0},
+                               {3, 8, static_cast<uint64_t>(bodyLength)}}, at);
+    fb.root(message);
+    return at[2];
+}
+
+void appendMessage(std::string& out, const std::string& metadata) {
+    size_t padded = alignUp(metadata.size(), 8);
+    uint32_t continuation = 0xFFFFFFFF;
+    int32_t length = static_cast<int32_t>(padded);
+    out.append(reinterpret_cast<const char*>(&continuation), 4);
+    out.append(reinterpret_cast<const char*>(&length), 4);
+    out += metadata;
+    out.append(padded - metadata.size(), '\0');
+}
+
+void appendSchema(std::string& out, const std::vector<std::string>& names, const std::vector<ArrowType>& types) {
+    FlatWriter fb;
+    size_t header = beginMessage(fb, HEADER_SCHEMA, 0);
+    std::vector<size_t> at;
+    fb.link(header, fb.table({{1, 4, 0}}, at));
+    size_t fieldsAt = at[1];
+    size_t fields = fb.offsetVector(names.size());
+    fb.link(fieldsAt, fields);
+    
+    for (size_t i = 0; i < names.size(); ++i) {
+        uint8_t typeType = types[i] == ArrowType::INT64 ? TYPE_INT
+                         : types[i] == ArrowType::DOUBLE ? TYPE_FLOATING_POINT : TYPE_UTF8;
+        std::vector<size_t> fieldAt;
+        fb.link(fields + 4 + 4 * i, fb.table({{0, 4, 0}, {1, 1, 1}, {2, 1, typeType}, {3, 4, 0}, {5, 4, 0}},
+                                             fieldAt));
+        fb.link(fieldAt[0], fb.string(names[i]));
+        std::vector<size_t> typeAt;
+        if (typeType == TYPE_INT) {
+            fb.link(fieldAt[3], fb.table({{0, 4, 64}, {1, 1, 1}}, typeAt));  // bitWidth, is_signed
+        } else if (typeType == TYPE_FLOATING_POINT) {
+            fb.link(fieldAt[3], fb.table({{0, 2, PRECISION_DOUBLE}}, typeAt));
+        } else {
+            fb.link(fieldAt[3], fb.table({}, typeAt));
+        }
+        fb.link(fieldAt[5], fb.offsetVector(0));  // no children
+    }
+    appendMessage(out, fb.bytes);
+}
+
+// One record batch under construction, column by column
+class ArrowBatch {
+public:
+    explicit ArrowBatch(const std::vector<ArrowType>& types) : types_(types), columns_(types.size()) {}
+    
+    size_t rows() const { return rows_; }
+    bool full() const { return rows_ >= ResultEncoder::ARROW_BATCH_ROWS || textBytes_ >= (1u << 30); }
+    
+    void add(const Row& row) {
+        Cell scratch;
+        for (size_t c = 0; c < columns_.size(); ++c) {
+            Column& column = columns_[c];
+            const std::string& value = row.values[c];
+            const Cell& cell = cellOf(row, c, scratch);
+            bool valid = cell.type != ValueType::NULL_VALUE;
+            if (rows_ % 8 == 0) column.validity += '\0';
+            if (valid) {
+                column.validity.back() = static_cast<char>(column.validity.back() | (1 << (rows_ % 8)));
+            } else {
+                ++column.nulls;
+            }
+            if (types_[c] == ArrowType::UTF8) {
+                if (column.offsets.empty()) appendInt32(column.offsets, 0);
+                if (valid) {
+                    column.data += value;
+                    textBytes_ += value.size();
+                }
+                appendInt32(column.offsets, static_cast<int32_t>(column.data.size()));
+            } else {
+                if (types_[c] == ArrowType::INT64) {
+                    int64_t integer = valid ? cell.integer : 0;
+                    column.data.append(reinterpret_cast<const char*>(&integer), 8);
+                } else {
+                    double real = !valid ? 0 : cell.type == ValueType::INT64 ? static_cast<double>(cell.integer)
+                                                                            : cell.real;
+                    column.data.append(reinterpret_cast<const char*>(&real), 8);
+                }
+            }
+        }
+        ++rows_;
+    }
+    
+    // Appends the RecordBatch message and body, then starts a new batch
+    void flush(std::string& out) {
+        std::vector<int64_t> nodes;
+        std::vector<int64_t> buffers;
+        std::vector<const std::string*> bodies;
+        int64_t bodyLength = 0;
+        auto buffer = [&](const std::string* bytes) {
+            size_t length = bytes ? bytes->size() : 0;
+            buffers.push_back(bodyLength);
+            buffers.push_back(static_cast<int64_t>(length));
+            bodies.push_back(bytes);
+            bodyLength += static_cast<int64_t>(alignUp(length, 8));
+        };
+        for (size_t c = 0; c < columns_.size(); ++c) {
+            Column& column = columns_[c];
+            if (column.offsets.empty() && types_[c] == ArrowType::UTF8) {
+                appendInt32(column.offsets, 0);
+            }
+            nodes.push_back(static_cast<int64_t>(rows_));
+            nodes.push_back(static_cast<int64_t>(column.nulls));
+            buffer(column.nulls > 0 ? &column.validity : nullptr);  // no bitmap needed without nulls
+            if (types_[c] == ArrowType::UTF8) {
+                buffer(&column.offsets);
+            }
+            buffer(&column.data);
+        }
+        
+        FlatWriter fb;
+        size_t header = beginMessage(fb, HEADER_RECORD_BATCH, bodyLength);
+        std::vector<size_t> at;
+        fb.link(header, fb.table({{0, 8, static_cast<uint64_t>(rows_)}, {1, 4, 0}, {2, 4, 0}}, at));
+        fb.link(at[1], fb.structVector(nodes, 2));
+        fb.link(at[2], fb.structVector(buffers, 2));
+        appendMessage(out, fb.bytes);
+        for (const std::string* bytes : bodies) {
+            if (bytes) {
+                out += *bytes;
+                out.append(alignUp(bytes->size(), 8) - bytes->size(), '\0');
+            }
+        }
+        
+        for (Column& column : columns_) {
+            column.validity.clear();
+            column.offsets.clear();
+            column.data.clear();
+            column.nulls = 0;
+        }
+        rows_ = 0;
+        textBytes_ = 0;
+    }
+    
+private:
+    struct Column {
+        std::string validity;  // LSB-first bitmap
+        std::string offsets;   // int32, UTF8 only
+        std::string data;
+        size_t nulls = 0;
+    };
+    
+    const std::vector<ArrowType>& types_;
+    std::vector<Column> columns_;
+    size_t rows_ = 0;
+    size_t textBytes_ = 0;
+    
+    static void appendInt32(std::string& out, int32_t value) {
+        out.append(reinterpret_cast<const char*>(&value), 4);
+    }
+};
+
+bool encodeArrow(const QueryResult& result, std::string& out, std::string& error) {
+    OutputBudget budget(result, out, error);
+    
+    // First pass: a column is Int64 if every value is, Float64 if every value
+    // is a number, Utf8 otherwise (and when it holds only NULLs)
+    std::vector<ArrowType> types(result.columns.size(), ArrowType::UNKNOWN);
+    size_t undecided = types.size();
+    Cell scratch;
+    result.rows.forEach([&](const Row& row) {
+        for (size_t c = 0; c < types.size(); ++c) {
+            const Cell& cell = cellOf(row, c, scratch);
+            if (types[c] == ArrowType::UTF8 || cell.type == ValueType::NULL_VALUE) {
+                continue;
+            }
+            ArrowType type = cell.type == ValueType::INT64 ? ArrowType::INT64
+                           : cell.type == ValueType::DOUBLE ? ArrowType::DOUBLE : ArrowType::UTF8;
+            if (types[c] == ArrowType::UNKNOWN || type == ArrowType::UTF8 || type == ArrowType::DOUBLE) {
+                types[c] = type;
+            }
+            undecided -= type == ArrowType::UTF8 ? 1 : 0;
+        }
+        return undecided > 0;  // every column is text: no need to look further
+    });
+    for (ArrowType& type : types) {
+        if (type == ArrowType::UNKNOWN) type = ArrowType::UTF8;
+    }
+    
+    appendSchema(out, result.columns, types);
+    ArrowBatch batch(types);
+    bool ok = result.rows.forEach([&](const Row& row) {
+        batch.add(row);
+        if (batch.full()) {
+            batch.flush(out);
+            return budget.charge();
+        }
+        return true;
+    });
+    if (ok && batch.rows() > 0) {
+        batch.flush(out);
+    }
+    uint32_t endOfStream[2] = {0xFFFFFFFF, 0};
+    out.append(reinterpret_cast<const char*>(endOfStream), sizeof(endOfStream));
+    return ok && budget.charge();
+}
+
+} // namespace
+
+bool parseResultFormat(const std::string& name, ResultFormat& format) {
+    if (name.empty() || name == "table") {
+        format = ResultFormat::TABLE;
+    } else if (name == "json") {
+        format = ResultFormat::JSON;
+    } else if (name == "csv") {
+        format = ResultFormat::CSV;
+    } else if (name == "ndjson") {
+        format = ResultFormat::NDJSON;
+    } else if (name == "arrow-ipc" || name == "arrow") {
+        format = ResultFormat::ARROW;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* resultContentType(ResultFormat format) {
+    switch (format) {
+        case ResultFormat::JSON: return "application/json";
+        case ResultFormat::CSV: return "text/csv; charset=utf-8";
+        case ResultFormat::NDJSON: return "application/x-ndjson";
+        case ResultFormat::ARROW: return "application/vnd.apache.arrow.stream";
+        default: return "text/plain; charset=utf-8";
+    }
+}
+
+bool ResultEncoder::encode(const QueryResult& result, ResultFormat format, std::string& out, std::string& error) {
+    out.clear();
+    switch (format) {
+        case ResultFormat::JSON: return encodeJson(result, out, error);
+        case ResultFormat::CSV: return encodeCsv(result, out, error);
+        case ResultFormat::NDJSON: return encodeNdjson(result, out, error);
+        case ResultFormat::ARROW: return encodeArrow(result, out, error);
+        default: return encodeTable(result, out, error);
+    }
+}
+
+void ResultEncoder::appendJsonString(std::string& out, const std::string& text) {
+    const char* data = text.data();
+    const size_t n = text.size();
+    size_t i = 0;
+    size_t clean = 0;  // start of the bytes not yet copied
+    out += '"';
+    
+#if defined(__SSE2__)
+    // A 16-byte block needs work only if it holds '"', '\\' or a byte < 0x20
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i control = _mm_set1_epi8(0x1F);
+    while (i + 16 <= n) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        __m128i special = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(block, quote), _mm_cmpeq_epi8(block, backslash)),
+                                       _mm_cmpeq_epi8(_mm_max_epu8(block, control), control));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(special));
+        if (mask == 0) {
+            i += 16;
+            continue;
+        }
+        i += static_cast<size_t>(__builtin_ctz(mask));
+        out.append(data + clean, i - clean);
+        appendEscapedByte(out, static_cast<unsigned char>(data[i]));
+        clean = ++i;
+    }
+#endif
+    
+    for (; i < n; ++i) {
+        unsigned char c = static_cast<unsigned char>(data[i]);
+        if (c != '"' && c != '\\' && c >= 0x20) {
+            continue;
+        }
+        out.append(data + clean, i - clean);
+        appendEscapedByte(out, c);
+        clean = i + 1;
+    }
+    out.append(data + clean, n - clean);
+    out += '"';
+}
@@ -0,0 +1,37 @@
+#ifndef RESULTENCODER_H
+#define RESULTENCODER_H
+
+#include <string>
+#include <cstddef>
+#include "Engine.h"
+
+enum class ResultFormat {
+    TABLE,   // padded text table, as printed by the REPL
+    JSON,    // {"columns":[...],"rows":[[...],...],"rowCount":n}
+    CSV,     // RFC 4180 with a header line; NULL is an empty unquoted field
+    NDJSON,  // one {"column":value,...} object per line
+    ARROW    // Arrow IPC stream: schema, record batches, end-of-stream marker
+};
+
+// Accepts "table", "json", "csv", "ndjson" and "arrow-ipc" (or "arrow")
+bool parseResultFormat(const std::string& name, ResultFormat& format);
+const char* resultContentType(ResultFormat format);
+
+// Serializes a SELECT result straight into out, which is cleared but keeps
+// its capacity, so a caller reusing one buffer stops allocating once it has
+// grown to its usual size. Cell text is copied byte for byte; canonical
+// numbers are written unquoted in JSON and typed Int64 / Float64 in Arrow,
+// going by the cells the result rows carry, so no value is parsed again.
+// Output is charged to the query's tracker under "format" as it grows; false
+// with error set when the budget runs out.
+class ResultEncoder {
+public:
+    static const size_t ARROW_BATCH_ROWS = 65536;
+    
+    static bool encode(const QueryResult& result, ResultFormat format, std::string& out, std::string& error);
+    
+    // JSON string literal of text, quotes included; SSE2 skips clean 16-byte blocks
+    static void appendJsonString(std::string& out, const std::string& text);
+};
+
+#endif // RESULTENCODER_H
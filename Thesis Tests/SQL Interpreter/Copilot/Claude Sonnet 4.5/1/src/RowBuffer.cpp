@@ -0,0 +1,166 @@
+#include "RowBuffer.h"
+#include <cstdint>
+
+RowBuffer::RowBuffer()
+    : spillFile_(nullptr), count_(0), reserved_(0) {}
+
+RowBuffer::~RowBuffer() {
+    releaseAll();
+}
+
+RowBuffer::RowBuffer(RowBuffer&& other) noexcept
+    : rows_(std::move(other.rows_)), spillFile_(other.spillFile_), count_(other.count_),
+      reserved_(other.reserved_), tracker_(std::move(other.tracker_)),
+      op_(std::move(other.op_)), error_(std::move(other.error_)) {
+    other.spillFile_ = nullptr;
+    other.count_ = 0;
+    other.reserved_ = 0;
+}
+
+RowBuffer& RowBuffer::operator=(RowBuffer&& other) noexcept {
+    if (this != &other) {
+        releaseAll();
+        rows_ = std::move(other.rows_);
+        spillFile_ = other.spillFile_;
+        count_ = other.count_;
+        reserved_ = other.reserved_;
+        tracker_ = std::move(other.tracker_);
+        op_ = std::move(other.op_);
+        error_ = std::move(other.error_);
+        other.spillFile_ = nullptr;
+        other.count_ = 0;
+        other.reserved_ = 0;
+    }
+    return *this;
+}
+
+void RowBuffer::setTracker(std::shared_ptr<MemoryTracker> tracker, const std::string& op) {
+    tracker_ = std::move(tracker);
+    op_ = op;
+}
+
+size_t RowBuffer::estimateSize(const Row& row) {
+    return row.bytes();
+}
+
+bool RowBuffer::append(Row row) {
+    if (spillFile_) {
+        ++count_;
+        return writeRow(row);
+    }
+    
+    size_t bytes = estimateSize(row);
+    if (tracker_ && !tracker_->reserve(op_, bytes)) {
+        if (!spill()) {
+            return false;
+        }
+        ++count_;
+        return writeRow(row);
+    }
+    
+    reserved_ += bytes;
+    rows_.push_back(std::move(row));
+    ++count_;
+    return true;
+}
+
+bool RowBuffer::forEach(const std::function<bool(const Row&)>& fn) const {
+    if (spillFile_) {
+        // Spilled rows are stored as: u32 columnCount, u8 typed, then per value
+        // u32 len + bytes and, for typed rows, the Cell (u8 type + 8 bytes)
+        std::rewind(spillFile_);
+        Row row;
+        uint32_t columnCount;
+        uint8_t typed;
+        while (std::fread(&columnCount, sizeof(columnCount), 1, spillFile_) == 1 &&
+               std::fread(&typed, sizeof(typed), 1, spillFile_) == 1) {
+            row.values.resize(columnCount);
+            row.cells.resize(typed ? columnCount : 0);
+            for (uint32_t i = 0; i < columnCount; ++i) {
+                uint32_t length;
+                if (std::fread(&length, sizeof(length), 1, spillFile_) != 1) {
+                    std::fseek(spillFile_, 0, SEEK_END);
+                    return false;
+                }
+                row.values[i].resize(length);
+                if (length > 0 && std::fread(&row.values[i][0], 1, length, spillFile_) != length) {
+                    std::fseek(spillFile_, 0, SEEK_END);
+                    return false;
+                }
+                if (typed && (std::fread(&row.cells[i].type, sizeof(ValueType), 1, spillFile_) != 1 ||
+                              std::fread(&row.cells[i].integer, 8, 1, spillFile_) != 1)) {
+                    std::fseek(spillFile_, 0, SEEK_END);
+                    return false;
+                }
+            }
+            if (!fn(row)) {
+                break;
+            }
+        }
+        // Leave the file positioned for further appends
+        std::fseek(spillFile_, 0, SEEK_END);
+        return true;
+    }
+    
+    for (const Row& row : rows_) {
+        if (!fn(row)) {
+            break;
+        }
+    }
+    return true;
+}
+
+bool RowBuffer::spill() {
+    spillFile_ = std::tmpfile();
+    if (!spillFile_) {
+        error_ = "Failed to create spill file";
+        return false;
+    }
+    
+    for (const Row& row : rows_) {
+        if (!writeRow(row)) {
+            return false;
+        }
+    }
+    
+    rows_.clear();
+    rows_.shrink_to_fit();
+    if (tracker_) {
+        tracker_->release(op_, reserved_);
+    }
+    reserved_ = 0;
+    return true;
+}
+
+bool RowBuffer::writeRow(const Row& row) {
+    uint32_t columnCount = static_cast<uint32_t>(row.values.size());
+    uint8_t typed = row.cells.size() == row.values.size() ? 1 : 0;
+    if (std::fwrite(&columnCount, sizeof(columnCount), 1, spillFile_) != 1 ||
+        std::fwrite(&typed, sizeof(typed), 1, spillFile_) != 1) {
+        error_ = "Failed to write spill file";
+        return false;
+    }
+    for (uint32_t i = 0; i < columnCount; ++i) {
+        const std::string& value = row.values[i];
+        uint32_t length = static_cast<uint32_t>(value.size());
+        if (std::fwrite(&length, sizeof(length), 1, spillFile_) != 1 ||
+            std::fwrite(value.data(), 1, length, spillFile_) != length ||
+            (typed && (std::fwrite(&row.cells[i].type, sizeof(ValueType), 1, spillFile_) != 1 ||
+                       std::fwrite(&row.cells[i].integer, 8, 1, spillFile_) != 1))) {
+            error_ = "Failed to write spill file";
+            return false;
+        }
+    }
+    return true;
+}
+
+void RowBuffer::releaseAll() {
+    if (tracker_ && reserved_ > 0) {
+        tracker_->release(op_, reserved_);
+    }
+    reserved_ = 0;
+    if (spillFile_) {
+        std::fclose(spillFile_);
+        spillFile_ = nullptr;
+    }
+}
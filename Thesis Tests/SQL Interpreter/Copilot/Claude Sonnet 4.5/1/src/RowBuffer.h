@@ -0,0 +1,54 @@
+#ifndef ROWBUFFER_H
+#define ROWBUFFER_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <cstdio>
+#include "Storage.h"
+#include "MemoryTracker.h"
+
+// Append-only row container used for query results. Rows are kept in memory
+// while the owning query's MemoryTracker grants the space; once a reservation
+// fails the buffered rows are written to an anonymous temporary file and all
+// further rows go straight to disk.
+class RowBuffer {
+public:
+    RowBuffer();
+    ~RowBuffer();
+    RowBuffer(RowBuffer&& other) noexcept;
+    RowBuffer& operator=(RowBuffer&& other) noexcept;
+    RowBuffer(const RowBuffer&) = delete;
+    RowBuffer& operator=(const RowBuffer&) = delete;
+    
+    // Charge memory to tracker under the given operator name
+    void setTracker(std::shared_ptr<MemoryTracker> tracker, const std::string& op);
+    
+    bool append(Row row);           // false on spill I/O error (see getError)
+    size_t size() const { return count_; }
+    bool empty() const { return count_ == 0; }
+    bool spilled() const { return spillFile_ != nullptr; }
+    
+    // Visit rows in insertion order; stops early if fn returns false
+    bool forEach(const std::function<bool(const Row&)>& fn) const;
+    
+    std::string getError() const { return error_; }
+    
+    static size_t estimateSize(const Row& row);
+
+private:
+    std::vector<Row> rows_;
+    FILE* spillFile_;
+    size_t count_;
+    size_t reserved_;
+    std::shared_ptr<MemoryTracker> tracker_;
+    std::string op_;
+    std::string error_;
+    
+    bool spill();
+    bool writeRow(const Row& row);
+    void releaseAll();
+};
+
+#endif // ROWBUFFER_H
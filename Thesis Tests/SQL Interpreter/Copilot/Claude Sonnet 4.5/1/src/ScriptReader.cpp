@@ -0,0 +1,117 @@
+#include "ScriptReader.h"
+#include <fstream>
+#include <iterator>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+ScriptReader::ScriptReader() : data_(nullptr), size_(0), pos_(0), map_(nullptr) {}
+
+ScriptReader::~ScriptReader() {
+    close();
+}
+
+void ScriptReader::close() {
+    if (map_) {
+        munmap(map_, size_);
+        map_ = nullptr;
+    }
+    fallback_.clear();
+    data_ = nullptr;
+    size_ = 0;
+    pos_ = 0;
+}
+
+bool ScriptReader::open(const std::string& path) {
+    close();
+    
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        error_ = "Could not open file '" + path + "'";
+        return false;
+    }
+    
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        void* map = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            madvise(map, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+            map_ = map;
+            data_ = static_cast<const char*>(map);
+            size_ = static_cast<size_t>(st.st_size);
+        }
+    }
+    ::close(fd);
+    
+    // Pipes, empty files or failed mappings: read the whole file instead
+    if (!map_) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open()) {
+            error_ = "Could not open file '" + path + "'";
+            return false;
+        }
+        fallback_.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        data_ = fallback_.data();
+        size_ = fallback_.size();
+    }
+    return true;
+}
+
+bool ScriptReader::next(std::string& statement) {
+    statement.clear();
+    bool lineStart = true;
+    
+    while (pos_ < size_) {
+        char c = data_[pos_];
+        
+        // Comments
+        if ((c == '-' && pos_ + 1 < size_ && data_[pos_ + 1] == '-') || (c == '#' && lineStart)) {
+            while (pos_ < size_ && data_[pos_] != '\n') {
+                ++pos_;
+            }
+            continue;
+        }
+        
+        if (c == '\n') {
+            lineStart = true;
+            // Line breaks become spaces, as the line-based reader did
+            if (!statement.empty()) statement += ' ';
+            ++pos_;
+            continue;
+        }
+        if (c == ' ' || c == '\t' || c == '\r') {
+            if (!statement.empty()) statement += c;
+            ++pos_;
+            continue;
+        }
+        lineStart = false;
+        
+        // String literal, copied verbatim; same escape rule as the lexer (\')
+        if (c == '\'' || c == '"') {
+            size_t start = pos_++;
+            while (pos_ < size_ && data_[pos_] != c) {
+                if (data_[pos_] == '\\' && pos_ + 1 < size_ && data_[pos_ + 1] == c) {
+                    ++pos_;
+                }
+                ++pos_;
+            }
+            if (pos_ < size_) ++pos_;  // closing quote; the lexer reports a missing one
+            statement.append(data_ + start, pos_ - start);
+            continue;
+        }
+        
+        statement += c;
+        ++pos_;
+        if (c == ';') {
+            return true;
+        }
+    }
+    
+    // Trailing text without ';'
+    while (!statement.empty() && (statement.back() == ' ' || statement.back() == '\t' ||
+                                  statement.back() == '\r')) {
+        statement.pop_back();
+    }
+    return !statement.empty();
+}
@@ -0,0 +1,38 @@
+#ifndef SCRIPTREADER_H
+#define SCRIPTREADER_H
+
+#include <string>
+#include <cstddef>
+
+// Splits a SQL script into statements. The file is memory-mapped (read into
+// memory if mapping fails) and scanned once; a ';' only ends a statement
+// outside string literals, and "--" comments plus lines starting with '#'
+// are skipped.
+class ScriptReader {
+public:
+    ScriptReader();
+    ~ScriptReader();
+    
+    ScriptReader(const ScriptReader&) = delete;
+    ScriptReader& operator=(const ScriptReader&) = delete;
+    
+    bool open(const std::string& path);
+    
+    // Next statement including its ';'; a trailing statement without one is
+    // returned as-is so the parser can report it. Returns false at the end.
+    bool next(std::string& statement);
+    
+    std::string getError() const { return error_; }
+    
+private:
+    const char* data_;
+    size_t size_;
+    size_t pos_;
+    void* map_;             // nullptr when the file was read instead of mapped
+    std::string fallback_;
+    std::string error_;
+    
+    void close();
+};
+
+#endif // SCRIPTREADER_H
@@ -0,0 +1,125 @@
+#include "Statistics.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+namespace {
+
+uint64_t hashValue(const std::string& value) {
+    // FNV-1a followed by a splitmix64 finalizer for well-mixed high bits
+    uint64_t hash = 1469598103934665603ull;
+    for (char c : value) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ull;
+    }
+    hash ^= hash >> 30;
+    hash *= 0xbf58476d1ce4e5b9ull;
+    hash ^= hash >> 27;
+    hash *= 0x94d049bb133111ebull;
+    hash ^= hash >> 31;
+    return hash;
+}
+
+} // namespace
+
+HyperLogLog::HyperLogLog() : registers_(1u << PRECISION, 0) {}
+
+void HyperLogLog::add(const std::string& value) {
+    uint64_t hash = hashValue(value);
+    uint32_t index = static_cast<uint32_t>(hash >> (64 - PRECISION));
+    uint64_t rest = (hash << PRECISION) | (1ull << (PRECISION - 1));  // guard bit bounds the rank
+    uint8_t rank = 1;
+    while ((rest & (1ull << 63)) == 0) {
+        ++rank;
+        rest <<= 1;
+    }
+    registers_[index] = std::max(registers_[index], rank);
+}
+
+double HyperLogLog::estimate() const {
+    const double m = static_cast<double>(registers_.size());
+    double sum = 0;
+    size_t zeros = 0;
+    for (uint8_t r : registers_) {
+        sum += std::ldexp(1.0, -r);
+        if (r == 0) ++zeros;
+    }
+    
+    double alpha = 0.7213 / (1.0 + 1.079 / m);
+    double estimate = alpha * m * m / sum;
+    
+    // Small-range correction (linear counting)
+    if (estimate <= 2.5 * m && zeros > 0) {
+        estimate = m * std::log(m / static_cast<double>(zeros));
+    }
+    return estimate;
+}
+
+double Histogram::equalFraction(const std::string& value) const {
+    if (upperBounds.empty()) {
+        return 0;
+    }
+    if (value < minValue || value > upperBounds.back()) {
+        return 0;
+    }
+    // A value that is the bound of several buckets covers at least that many buckets
+    auto range = std::equal_range(upperBounds.begin(), upperBounds.end(), value);
+    size_t buckets = static_cast<size_t>(std::distance(range.first, range.second));
+    return static_cast<double>(buckets) / upperBounds.size();
+}
+
+TableStats analyzeTable(const Table& table, size_t histogramBuckets) {
+    TableStats stats;
+    stats.rowCount = table.rows.size();
+    stats.columns.resize(table.columns.size());
+    const size_t columns = table.columns.size();
+    
+    // One pass over the rows feeds every column: its sketch, its exact
+    // minimum and maximum, and a uniform reservoir sample for the histogram.
+    // Samples point into the rows, which the caller's write lock keeps alive.
+    std::vector<HyperLogLog> sketches(columns);
+    std::vector<std::vector<const std::string*>> samples(columns);
+    std::vector<const std::string*> minimum(columns, nullptr);
+    std::vector<const std::string*> maximum(columns, nullptr);
+    std::mt19937_64 random(42);  // fixed seed: ANALYZE of the same rows gives the same histograms
+    size_t seen = 0;
+    for (const Row& row : table.rows) {
+        size_t slot = seen < HISTOGRAM_SAMPLE ? seen : random() % (seen + 1);
+        ++seen;
+        for (size_t c = 0; c < columns; ++c) {
+            const std::string& value = row.values[c];
+            sketches[c].add(value);
+            if (!minimum[c] || value < *minimum[c]) minimum[c] = &value;
+            if (!maximum[c] || value > *maximum[c]) maximum[c] = &value;
+            if (slot >= HISTOGRAM_SAMPLE) {
+                continue;
+            }
+            if (slot == samples[c].size()) {
+                samples[c].push_back(&value);
+            } else {
+                samples[c][slot] = &value;
+            }
+        }
+    }
+    
+    for (size_t c = 0; c < columns; ++c) {
+        ColumnStats& column = stats.columns[c];
+        column.distinct = std::min(sketches[c].estimate(), static_cast<double>(seen));
+        
+        std::vector<const std::string*>& sample = samples[c];
+        if (sample.empty()) {
+            continue;
+        }
+        std::sort(sample.begin(), sample.end(),
+                  [](const std::string* a, const std::string* b) { return *a < *b; });
+        size_t buckets = std::min(histogramBuckets, sample.size());
+        column.histogram.minValue = *minimum[c];
+        for (size_t b = 0; b + 1 < buckets; ++b) {
+            column.histogram.upperBounds.push_back(*sample[(b + 1) * sample.size() / buckets - 1]);
+        }
+        column.histogram.upperBounds.push_back(*maximum[c]);  // the last bucket ends at the true maximum
+        column.histogram.rowsPerBucket = static_cast<double>(seen) / buckets;
+    }
+    
+    return stats;
+}
@@ -0,0 +1,49 @@
+#ifndef STATISTICS_H
+#define STATISTICS_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "Storage.h"
+
+// HyperLogLog distinct-value sketch (2^10 registers, ~3% standard error)
+class HyperLogLog {
+public:
+    HyperLogLog();
+    void add(const std::string& value);
+    double estimate() const;
+
+private:
+    static const int PRECISION = 10;
+    std::vector<uint8_t> registers_;
+};
+
+// Equi-depth histogram: every bucket holds (roughly) the same number of rows
+struct Histogram {
+    std::string minValue;
+    std::vector<std::string> upperBounds;  // inclusive upper bound per bucket, ascending
+    double rowsPerBucket = 0;
+    
+    // Fraction of rows expected to equal value (0 if unknown)
+    double equalFraction(const std::string& value) const;
+};
+
+struct ColumnStats {
+    double distinct = 0;
+    Histogram histogram;
+};
+
+struct TableStats {
+    size_t rowCount = 0;
+    std::vector<ColumnStats> columns;
+};
+
+// Histograms are built from a uniform sample of this many rows per column;
+// smaller tables are histogrammed exactly
+const size_t HISTOGRAM_SAMPLE = 16384;
+
+// Scan a table once and collect row count, distinct estimates and histograms
+// for all columns in that one pass
+TableStats analyzeTable(const Table& table, size_t histogramBuckets = 16);
+
+#endif // STATISTICS_H
@@ -1,12 +1,188 @@
 #include "Storage.h"
 #include "Utils.h"
-#include <fstream>
+#include "Statistics.h"
+#include "AsyncIO.h"
+#include "MaterializedView.h"
 #include <sstream>
 #include <iostream>
 #include <sys/stat.h>
 #include <dirent.h>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cctype>
+#include <unordered_map>
+#include <unordered_set>
+#include <chrono>
 
-Storage::Storage() : dataDir_("data") {
+namespace {
+
+// WAL records a partition accumulates before its snapshot is rewritten: at
+// least this many, and never fewer than the rows already in the snapshot, so
+// the rewrite cost stays amortized O(1) per insert as the table grows
+const size_t CHECKPOINT_INTERVAL = 1024;
+
+uint32_t hashPartitionKey(const std::string& value) {
+    uint32_t hash = 2166136261u;
+    for (char c : value) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Largest single read submitted while loading files
+const size_t READ_CHUNK = 1 << 20;
+
+const char SNAPSHOT_TAG[] = "#snapshot ";
+
+// First line of every WAL: size and FNV-1a hash of the snapshot its records
+// were logged against. A WAL whose tag does not match the snapshot on disk
+// was already folded into it by a checkpoint that stopped after the rename.
+std::string snapshotTag(const std::string& snapshot) {
+    uint64_t hash = 14695981039346656037ull;
+    for (char c : snapshot) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ull;
+    }
+    char tag[64];
+    snprintf(tag, sizeof(tag), "%s%zu %016llx\n", SNAPSHOT_TAG, snapshot.size(),
+             static_cast<unsigned long long>(hash));
+    return tag;
+}
+
+void writeCsvRow(std::string& out, const std::vector<std::string>& values) {
+    for (size_t i = 0; i < values.size(); ++i) {
+        if (i > 0) out += ',';
+        out += Utils::escapeCsv(values[i]);
+    }
+    out += '\n';
+}
+
+void parseCsvText(const std::string& text, std::vector<Row>& rows) {
+    size_t start = 0;
+    while (start < text.size()) {
+        size_t end = text.find('\n', start);
+        if (end == std::string::npos) end = text.size();
+        if (end > start) {
+            Row row;
+            row.values = Utils::parseCsvLine(text.substr(start, end - start));
+            row.classify();
+            rows.push_back(std::move(row));
+        }
+        start = end + 1;
+    }
+}
+
+// Stats files are CSV: the row count, then one row per column with its
+// distinct estimate, rows per bucket, bucket count, minimum and bucket bounds
+std::string encodeStats(const TableStats& stats) {
+    std::string out;
+    writeCsvRow(out, std::vector<std::string>(1, std::to_string(stats.rowCount)));
+    char number[32];
+    for (const ColumnStats& column : stats.columns) {
+        std::vector<std::string> fields;
+        snprintf(number, sizeof(number), "%.17g", column.distinct);
+        fields.push_back(number);
+        snprintf(number, sizeof(number), "%.17g", column.histogram.rowsPerBucket);
+        fields.push_back(number);
+        fields.push_back(std::to_string(column.histogram.upperBounds.size()));
+        fields.push_back(column.histogram.minValue);
+        fields.insert(fields.end(), column.histogram.upperBounds.begin(),
+                      column.histogram.upperBounds.end());
+        writeCsvRow(out, fields);
+    }
+    return out;
+}
+
+bool decodeStats(const std::string& text, size_t columnCount, TableStats& stats) {
+    std::vector<Row> rows;
+    parseCsvText(text, rows);
+    if (rows.size() != columnCount + 1 || rows[0].values.size() != 1) {
+        return false;
+    }
+    stats.rowCount = std::strtoull(rows[0].values[0].c_str(), nullptr, 10);
+    for (size_t c = 1; c < rows.size(); ++c) {
+        const std::vector<std::string>& fields = rows[c].values;
+        if (fields.size() < 4 || fields.size() - 4 != std::strtoull(fields[2].c_str(), nullptr, 10)) {
+            return false;
+        }
+        ColumnStats column;
+        column.distinct = std::strtod(fields[0].c_str(), nullptr);
+        column.histogram.rowsPerBucket = std::strtod(fields[1].c_str(), nullptr);
+        column.histogram.minValue = fields[3];
+        column.histogram.upperBounds.assign(fields.begin() + 4, fields.end());
+        stats.columns.push_back(std::move(column));
+    }
+    return true;
+}
+
+// Upserts are logged as full rows, so a key can appear several times in
+// snapshot + WAL; the last version wins and keeps the first one's position
+void keepLatestPerKey(std::vector<Row>& rows, uint32_t key) {
+    std::unordered_map<std::string, size_t> seen;
+    std::vector<Row> unique;
+    unique.reserve(rows.size());
+    for (Row& row : rows) {
+        if (key >= row.values.size()) {
+            continue;
+        }
+        auto it = seen.find(row.values[key]);
+        if (it != seen.end()) {
+            unique[it->second] = std::move(row);
+        } else {
+            seen.emplace(row.values[key], unique.size());
+            unique.push_back(std::move(row));
+        }
+    }
+    rows.swap(unique);
+}
+
+} // namespace
+
+void Row::classify() {
+    cells.resize(values.size());
+    for (size_t i = 0; i < values.size(); ++i) {
+        cells[i] = Cell::classify(values[i]);
+    }
+}
+
+size_t Row::bytes() const {
+    size_t bytes = sizeof(Row) + values.capacity() * sizeof(std::string) + cells.capacity() * sizeof(Cell);
+    for (const std::string& value : values) {
+        bytes += value.size();
+    }
+    return bytes;
+}
+
+thread_local std::string Storage::lastError_;
+
+int64_t TableAccess::nowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint64_t TableAccess::idleMs() const {
+    int64_t idle = nowMs() - lastAccessMs.load(std::memory_order_relaxed);
+    return idle > 0 ? static_cast<uint64_t>(idle) : 0;
+}
+
+const TrigramIndex* TableSnapshot::trigramIndex(uint32_t column) const {
+    for (const auto& index : trigramIndexes) {
+        if (index->column() == column) {
+            return index.get();
+        }
+    }
+    return nullptr;
+}
+
+Storage::Storage(const std::string& dataDir) : dataDir_(dataDir) {
+    publishAll();
+    if (dataDir_.empty()) {
+        return;
+    }
+    
     // Create data directory if it doesn't exist
     struct stat st;
     if (stat(dataDir_.c_str(), &st) != 0) {
@@ -18,168 +194,966 @@ Storage::Storage() : dataDir_("data") {
     }
     
     loadAllTables();
+    publishAll();
+    loadViews();
 }
 
 Storage::~Storage() {
-    // Save all tables on exit
-    for (const auto& pair : tables_) {
-        saveTable(pair.first);
+    // Fold every WAL into its snapshot on exit
+    for (TableId id = 0; id < tables_.size() && !dataDir_.empty(); ++id) {
+        checkpointTable(id);
+        for (auto& partition : tables_[id].partitions) {
+            if (partition->walFd >= 0) {
+                close(partition->walFd);
+            }
+        }
     }
 }
 
-bool Storage::createTable(const std::string& name, const std::vector<std::string>& columns) {
-    std::string lowerName = Utils::toLower(name);
-    
-    if (tables_.find(lowerName) != tables_.end()) {
+bool Storage::createTable(const std::string& name, const std::vector<std::string>& columns,
+                          const PartitionSpec& partitioning, uint32_t primaryKey) {
+    if (catalog_.findTable(name) != INVALID_ID) {
         lastError_ = "Table '" + name + "' already exists";
         return false;
     }
+    if (catalog_.findView(name) != INVALID_ID) {
+        lastError_ = "A materialized view named '" + name + "' already exists";
+        return false;
+    }
     
     if (columns.empty()) {
         lastError_ = "Table must have at least one column";
         return false;
     }
     
+    TableId id = catalog_.addTable(name, columns, partitioning, primaryKey);
+    
+    // Column names are stored in their canonical (interned) spelling
     Table table;
-    table.columns = columns;
-    tables_[lowerName] = table;
+    for (const ColumnSchema& column : catalog_.table(id).columns) {
+        table.columns.push_back(catalog_.identifier(column.name));
+    }
+    tables_.push_back(std::move(table));
+    stats_.resize(tables_.size());
+    trigramIndexes_.resize(tables_.size());
+    primaryIndexes_.resize(tables_.size());
+    initPartitions(id);
+    buildPrimaryIndex(id);
+    publish(id, true);
     
-    // Immediately save to CSV
-    return saveTable(lowerName);
+    // Immediately save schema and empty partition snapshots
+    if (!saveCatalog()) {
+        return false;
+    }
+    for (auto& partition : tables_[id].partitions) {
+        if (!checkpointPartition(tables_[id], *partition)) {
+            return false;
+        }
+    }
+    if (listener_) {
+        listener_->tableCreated(*this, id);
+    }
+    return true;
+}
+
+void Storage::clear() {
+    if (!dataDir_.empty()) {
+        return;
+    }
+    catalog_ = Catalog();
+    tables_.clear();
+    stats_.clear();
+    trigramIndexes_.clear();
+    primaryIndexes_.clear();
+    views_.clear();
+    publishAll();
 }
 
 bool Storage::insertRow(const std::string& tableName, const std::vector<std::string>& values) {
-    std::string lowerName = Utils::toLower(tableName);
-    
-    auto it = tables_.find(lowerName);
-    if (it == tables_.end()) {
+    TableId id = catalog_.findTable(tableName);
+    if (id == INVALID_ID) {
         lastError_ = "Table '" + tableName + "' does not exist";
         return false;
     }
+    return insertRow(id, values);
+}
+
+bool Storage::insertRow(TableId id, const std::vector<std::string>& values) {
+    return insertRows(id, std::vector<std::vector<std::string>>(1, values));
+}
+
+bool Storage::validateRows(TableId id, const std::vector<std::vector<std::string>>& rows,
+                           ConflictAction onConflict) {
+    if (!ensureLoaded(id)) {
+        return false;
+    }
+    
+    const Table& table = tables_[id];
+    
+    for (const auto& values : rows) {
+        if (values.size() != table.columns.size()) {
+            lastError_ = "Column count mismatch: expected " + 
+                         std::to_string(table.columns.size()) + 
+                         ", got " + std::to_string(values.size());
+            return false;
+        }
+    }
+    
+    // Duplicate keys reject the whole statement before anything is applied
+    const BPlusTree* primary = primaryIndexes_[id].get();
+    uint32_t key = catalog_.table(id).primaryKey;
+    if (primary) {
+        for (const auto& values : rows) {
+            if (values[key] == NULL_TEXT) {
+                lastError_ = "Primary key " + table.columns[key] + " cannot be NULL";
+                return false;
+            }
+        }
+    }
+    if (primary && onConflict == ConflictAction::ABORT) {
+        std::unordered_set<std::string> batchKeys;
+        for (const auto& values : rows) {
+            uint32_t existing;
+            if (primary->find(values[key], existing) || !batchKeys.insert(values[key]).second) {
+                lastError_ = "Duplicate value '" + values[key] + "' for primary key " +
+                             table.columns[key];
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool Storage::insertRows(TableId id, const std::vector<std::vector<std::string>>& rows,
+                         ConflictAction onConflict) {
+    if (!validateRows(id, rows, onConflict)) {
+        return false;
+    }
     
-    Table& table = it->second;
+    Table& table = tables_[id];
+    const TableSchema& schema = catalog_.table(id);
+    BPlusTree* primary = primaryIndexes_[id].get();
+    uint32_t key = schema.primaryKey;
     
-    if (values.size() != table.columns.size()) {
-        lastError_ = "Column count mismatch: expected " + 
-                     std::to_string(table.columns.size()) + 
-                     ", got " + std::to_string(values.size());
+    // Route every row to its partition (INVALID_ID: skipped by ON CONFLICT DO
+    // NOTHING) before anything changes, so the WAL can be written first
+    const PartitionSpec& spec = schema.partitioning;
+    std::vector<uint32_t> partitionOf(rows.size(), INVALID_ID);
+    std::vector<std::string> walData(table.partitions.size());
+    std::unordered_set<std::string> batchKeys;
+    for (size_t i = 0; i < rows.size(); ++i) {
+        const auto& values = rows[i];
+        uint32_t existing;
+        if (primary && onConflict == ConflictAction::NOTHING &&
+            (primary->find(values[key], existing) || !batchKeys.insert(values[key]).second)) {
+            continue;
+        }
+        partitionOf[i] = spec.kind == PartitionKind::NONE ? 0 : partitionFor(id, values[spec.column]);
+        if (!dataDir_.empty()) {
+            writeCsvRow(walData[partitionOf[i]], values);
+        }
+    }
+    
+    // Each partition has its own WAL and lock; all appends are submitted
+    // before waiting for any, so partitions are written concurrently
+    struct PendingAppend {
+        Partition* partition;
+        std::string data;
+        uint64_t offset;
+        size_t records;
+        AsyncIO::Ticket ticket;
+    };
+    AsyncIO& io = AsyncIO::instance();
+    std::vector<std::unique_lock<std::mutex>> locks;
+    std::vector<PendingAppend> appends;
+    for (uint32_t p = 0; p < walData.size(); ++p) {
+        if (walData[p].empty()) {
+            continue;
+        }
+        Partition& partition = *table.partitions[p];
+        locks.emplace_back(partition.lock);
+        if (!openWal(partition)) {
+            return false;
+        }
+        PendingAppend append;
+        append.partition = &partition;
+        append.offset = partition.walBytes;
+        append.records = std::count(walData[p].begin(), walData[p].end(), '\n');
+        // An empty or already checkpointed WAL starts over, tagged with the current snapshot
+        if (partition.walTag != partition.snapshotTag) {
+            if (partition.walBytes > 0 && ftruncate(partition.walFd, 0) != 0) {
+                lastError_ = "Failed to truncate file: " + partition.walFile;
+                return false;
+            }
+            partition.walBytes = 0;
+            partition.walRecords = 0;
+            append.offset = 0;
+            append.data = partition.snapshotTag;
+        }
+        append.data += walData[p];
+        appends.push_back(std::move(append));
+    }
+    for (PendingAppend& append : appends) {
+        append.ticket = io.submitWrite(append.partition->walFd, append.data.data(), append.data.size(),
+                                       append.offset);
+    }
+    
+    bool ok = true;
+    for (PendingAppend& append : appends) {
+        Partition& partition = *append.partition;
+        if (!io.completeWrite(append.ticket, partition.walFd, append.data.data(), append.data.size(),
+                              append.offset)) {
+            lastError_ = "Failed to write partition file: " + partition.walFile;
+            ok = false;
+        }
+    }
+    if (!ok) {
+        // Cut every WAL back to where this statement started, so no partition
+        // replays rows the statement reported as not inserted
+        for (PendingAppend& append : appends) {
+            if (ftruncate(append.partition->walFd, static_cast<off_t>(append.offset)) != 0) {
+                lastError_ += "; failed to roll back " + append.partition->walFile;
+            }
+        }
         return false;
     }
+    for (PendingAppend& append : appends) {
+        append.partition->walBytes = append.offset + append.data.size();
+        append.partition->walRecords += append.records;
+        append.partition->walTag = append.partition->snapshotTag;
+    }
+    
+    // Logged; now append (or update) in memory
+    std::vector<uint32_t> written;
+    written.reserve(rows.size());
+    bool overwritten = false;
+    std::unique_lock<std::shared_mutex> indexGuard(*table.indexLock);
+    for (size_t i = 0; i < rows.size(); ++i) {
+        uint32_t p = partitionOf[i];
+        if (p == INVALID_ID) {
+            continue;
+        }
+        const auto& values = rows[i];
+        
+        uint32_t existing;
+        if (primary && primary->find(values[key], existing)) {
+            // The partition column is the key, so the row stays in its partition;
+            // the WAL logs the new version and replay keeps the last one per key
+            Row updated;
+            updated.values = values;
+            updated.classify();
+            table.bytes += updated.bytes() - table.rows[existing].bytes();
+            table.rows.set(existing, std::move(updated));
+            overwritten = true;
+            written.push_back(existing);
+            indexRow(id, existing);
+            continue;
+        }
+        
+        Row row;
+        row.values = values;
+        row.classify();
+        table.bytes += row.bytes();
+        table.rows.push_back(std::move(row));
+        
+        uint32_t rowId = static_cast<uint32_t>(table.rows.size() - 1);
+        table.partitions[p]->rowIds.push_back(rowId);
+        written.push_back(rowId);
+        indexRow(id, rowId);
+        if (primary) {
+            primary->insert(values[key], rowId);
+        }
+    }
+    
+    indexGuard.unlock();
+    table.access->rowsWritten.fetch_add(written.size(), std::memory_order_relaxed);
+    table.access->touch();
     
-    Row row;
-    row.values = values;
-    table.rows.push_back(row);
+    // Fold the new rows into the table's views; overwrites need a rebuild
+    for (const auto& view : views_) {
+        if (!view || view->table() != id) {
+            continue;
+        }
+        if (overwritten) {
+            view->rebuild(table.rows);
+            continue;
+        }
+        for (uint32_t rowId : written) {
+            view->add(table.rows[rowId]);
+        }
+    }
+    publish(id);
+    
+    if (listener_ && !written.empty()) {
+        listener_->rowsWritten(*this, id, written);
+    }
     
-    // Immediately save to CSV
-    return saveTable(lowerName);
+    for (PendingAppend& append : appends) {
+        Partition& partition = *append.partition;
+        if (partition.walRecords >= std::max(CHECKPOINT_INTERVAL, partition.rowIds.size() / 2) &&
+            !checkpointPartition(table, partition)) {
+            return false;
+        }
+    }
+    return true;
 }
 
 const Table* Storage::getTable(const std::string& name) const {
-    std::string lowerName = Utils::toLower(name);
-    auto it = tables_.find(lowerName);
-    if (it != tables_.end()) {
-        return &(it->second);
+    return getTable(catalog_.findTable(name));
+}
+
+const Table* Storage::getTable(TableId id) const {
+    if (id < tables_.size()) {
+        return &tables_[id];
+    }
+    return nullptr;
+}
+
+uint32_t Storage::partitionFor(TableId id, const std::string& value) const {
+    return partitionFor(catalog_.table(id).partitioning, value);
+}
+
+uint32_t Storage::partitionFor(const PartitionSpec& spec, const std::string& value) {
+    switch (spec.kind) {
+        case PartitionKind::HASH:
+            return hashPartitionKey(value) % spec.count;
+        case PartitionKind::RANGE:
+            // Partition i holds values below rangeBounds[i]; the last one the rest
+            return static_cast<uint32_t>(
+                std::upper_bound(spec.rangeBounds.begin(), spec.rangeBounds.end(), value) -
+                spec.rangeBounds.begin());
+        default:
+            return 0;
+    }
+}
+
+const TableStats* Storage::getStats(TableId id) const {
+    if (id < stats_.size()) {
+        return stats_[id].get();
     }
     return nullptr;
 }
 
+bool Storage::analyzeTable(TableId id) {
+    if (!ensureLoaded(id)) {
+        return false;
+    }
+    auto stats = std::make_shared<TableStats>(::analyzeTable(tables_[id]));
+    // Saved so that plans after a restart still have them
+    if (!dataDir_.empty() && !replaceFile(statsFile(id), encodeStats(*stats))) {
+        return false;
+    }
+    stats_[id] = stats;
+    publish(id);
+    return true;
+}
+
+bool Storage::createIndex(TableId id, const std::string& name, uint32_t column, IndexKind kind) {
+    if (id >= tables_.size()) {
+        lastError_ = "Table does not exist";
+        return false;
+    }
+    if (catalog_.findIndex(id, name)) {
+        lastError_ = "Index '" + name + "' already exists";
+        return false;
+    }
+    if (column >= tables_[id].columns.size()) {
+        lastError_ = "Column does not exist";
+        return false;
+    }
+    if (!ensureLoaded(id)) {
+        return false;
+    }
+    
+    catalog_.addIndex(id, name, column, kind);
+    {
+        std::unique_lock<std::shared_mutex> indexGuard(*tables_[id].indexLock);
+        buildIndexes(id);
+    }
+    publish(id, true);
+    if (!saveCatalog()) {
+        return false;
+    }
+    if (listener_) {
+        listener_->indexCreated(*this, id, catalog_.table(id).indexes.back());
+    }
+    return true;
+}
+
+bool Storage::createView(const std::string& name, const std::string& definition) {
+    if (catalog_.findTable(name) != INVALID_ID || catalog_.findView(name) != INVALID_ID) {
+        lastError_ = "Relation '" + name + "' already exists";
+        return false;
+    }
+    
+    Plan plan;
+    std::string error;
+    if (!MaterializedView::plan(*snapshot(), definition, plan, error)) {
+        lastError_ = error;
+        return false;
+    }
+    std::vector<std::string> columns = plan.columnNames(catalog_);
+    for (size_t i = 0; i < columns.size(); ++i) {
+        if (std::find(columns.begin(), columns.begin() + i, columns[i]) != columns.begin() + i) {
+            lastError_ = "Column '" + columns[i] + "' appears twice in view '" + name + "' (use AS)";
+            return false;
+        }
+    }
+    
+    // The caller excludes writers, so no row arrives between the fold and the publish
+    if (!ensureLoaded(plan.table)) {
+        return false;
+    }
+    auto view = std::make_shared<MaterializedView>(plan);
+    view->rebuild(tables_[plan.table].rows);
+    std::vector<Row> groups;
+    if (!view->read(groups, error)) {
+        lastError_ = error;
+        return false;
+    }
+    ViewId id = catalog_.addView(name, plan.table, columns, definition);
+    views_.push_back(view);
+    publish(plan.table, true);
+    if (!saveCatalog()) {
+        return false;
+    }
+    if (listener_) {
+        listener_->viewCreated(*this, id);
+    }
+    return true;
+}
+
+void Storage::loadViews() {
+    for (ViewId id = 0; id < catalog_.viewCount(); ++id) {
+        const ViewSchema& schema = catalog_.view(id);
+        Plan plan;
+        std::string error;
+        if (!MaterializedView::plan(*snapshot(), schema.definition, plan, error)) {
+            std::cerr << "Warning: Materialized view '" << catalog_.viewName(id) << "' is unavailable: "
+                      << error << "\n";
+            views_.emplace_back();
+            continue;
+        }
+        auto view = std::make_shared<MaterializedView>(plan);
+        view->rebuild(tables_[plan.table].rows);
+        views_.push_back(view);
+    }
+    publishAll();
+}
+
+const TrigramIndex* Storage::getTrigramIndex(TableId id, uint32_t column) const {
+    if (id >= trigramIndexes_.size()) {
+        return nullptr;
+    }
+    for (const auto& index : trigramIndexes_[id]) {
+        if (index->column() == column) {
+            return index.get();
+        }
+    }
+    return nullptr;
+}
+
+void Storage::buildIndexes(TableId id) {
+    trigramIndexes_[id].clear();
+    const Table& table = tables_[id];
+    for (const IndexSchema& schema : catalog_.table(id).indexes) {
+        if (schema.kind != IndexKind::TRIGRAM || schema.column >= table.columns.size()) {
+            continue;
+        }
+        auto index = std::make_shared<TrigramIndex>(schema.column);
+        for (size_t r = 0; r < table.rows.size(); ++r) {
+            if (schema.column < table.rows[r].values.size()) {
+                index->add(static_cast<uint32_t>(r), table.rows[r].values[schema.column]);
+            }
+        }
+        trigramIndexes_[id].push_back(index);
+    }
+}
+
+const BPlusTree* Storage::getPrimaryIndex(TableId id) const {
+    return id < primaryIndexes_.size() ? primaryIndexes_[id].get() : nullptr;
+}
+
+void Storage::buildPrimaryIndex(TableId id) {
+    uint32_t key = catalog_.table(id).primaryKey;
+    if (key == INVALID_ID) {
+        primaryIndexes_[id].reset();
+        return;
+    }
+    
+    const Table& table = tables_[id];
+    std::vector<std::pair<std::string, uint32_t>> entries;
+    entries.reserve(table.rows.size());
+    for (uint32_t r = 0; r < table.rows.size(); ++r) {
+        entries.emplace_back(table.rows[r].values[key], r);
+    }
+    std::sort(entries.begin(), entries.end());
+    
+    auto index = std::make_shared<BPlusTree>();
+    index->bulkLoad(entries);
+    primaryIndexes_[id] = index;
+}
+
+bool Storage::exportPath(const std::string& file, std::string& path) const {
+    if (dataDir_.empty()) {
+        lastError_ = "EXPORT and IMPORT need a data directory";
+        return false;
+    }
+    bool plain = !file.empty() && file[0] != '.';
+    for (char c : file) {
+        plain = plain && (std::isalnum(static_cast<unsigned char>(c)) || c == '.' || c == '_' || c == '-');
+    }
+    if (!plain) {
+        lastError_ = "File name '" + file + "' must be a plain name of letters, digits, '.', '_' and '-'";
+        return false;
+    }
+    std::string dir = dataDir_ + "/exports";
+    struct stat st;
+    if (stat(dir.c_str(), &st) != 0) {
+        #ifdef _WIN32
+        _mkdir(dir.c_str());
+        #else
+        mkdir(dir.c_str(), 0755);
+        #endif
+    }
+    path = dir + "/" + file;
+    return true;
+}
+
+bool Storage::evictTable(TableId id, uint64_t minIdleMs) {
+    // Without a data directory the rows have nowhere to go
+    if (id >= tables_.size() || dataDir_.empty()) {
+        return false;
+    }
+    lastError_.clear();
+    Table& table = tables_[id];
+    if (table.evicted || table.access->idleMs() < minIdleMs) {
+        return false;
+    }
+    // Every partition snapshot holds its rows from here on and the WALs are empty
+    if (!checkpointTable(id)) {
+        return false;
+    }
+    {
+        std::unique_lock<std::shared_mutex> indexGuard(*table.indexLock);
+        table.evictedRows = table.rows.size();
+        table.rows.clear();
+        for (auto& partition : table.partitions) {
+            partition->rowIds.clear();
+        }
+        trigramIndexes_[id].clear();
+        primaryIndexes_[id].reset();
+        table.bytes = 0;
+        table.evicted = true;
+    }
+    // Queries still running on older snapshots keep their rows until they finish
+    publish(id);
+    return true;
+}
+
+bool Storage::ensureLoaded(TableId id) {
+    if (id >= tables_.size()) {
+        lastError_ = "Table does not exist";
+        return false;
+    }
+    Table& table = tables_[id];
+    if (!table.evicted) {
+        return true;
+    }
+    
+    std::vector<std::string> paths;
+    for (auto& partition : table.partitions) {
+        paths.push_back(partition->dataFile);
+        paths.push_back(partition->walFile);
+    }
+    std::vector<std::string> contents;
+    std::vector<bool> found = readFiles(paths, contents);
+    for (size_t i = 0; i < paths.size(); i += 2) {
+        if (!found[i]) {
+            lastError_ = "Failed to reload evicted table from " + paths[i];
+            return false;
+        }
+    }
+    {
+        std::unique_lock<std::shared_mutex> indexGuard(*table.indexLock);
+        size_t file = 0;
+        loadPartitions(id, contents, file);
+        buildIndexes(id);
+        buildPrimaryIndex(id);
+        table.evicted = false;
+        table.evictedRows = 0;
+    }
+    table.access->reloads.fetch_add(1, std::memory_order_relaxed);
+    table.access->touch();
+    publish(id);
+    return true;
+}
+
 std::string Storage::getLastError() const {
     return lastError_;
 }
 
+std::shared_ptr<const TableSnapshot> Storage::snapshotTable(TableId id) {
+    Table& table = tables_[id];
+    auto snapshot = std::make_shared<TableSnapshot>();
+    snapshot->columns = table.columns;
+    snapshot->rows = table.rows.snapshot();
+    for (auto& partition : table.partitions) {
+        snapshot->partitions.push_back(partition->rowIds.snapshot());
+    }
+    snapshot->stats = stats_[id];
+    snapshot->primaryIndex = primaryIndexes_[id];
+    snapshot->trigramIndexes.assign(trigramIndexes_[id].begin(), trigramIndexes_[id].end());
+    snapshot->indexLock = table.indexLock;
+    snapshot->access = table.access;
+    snapshot->bytes = table.bytes;
+    snapshot->evicted = table.evicted;
+    snapshot->evictedRows = table.evictedRows;
+    return snapshot;
+}
+
+void Storage::publish(TableId id, bool catalogChanged) {
+    // Build the table's view outside publishMutex_; the caller holds its write lock
+    std::shared_ptr<const TableSnapshot> table = snapshotTable(id);
+    std::shared_ptr<const Catalog> catalog;
+    if (catalogChanged) {
+        catalog = std::make_shared<Catalog>(catalog_);
+    }
+    
+    std::lock_guard<std::mutex> lock(publishMutex_);
+    auto next = std::make_shared<StorageSnapshot>(*snapshot_);
+    if (catalog) {
+        next->catalog = catalog;
+        next->views.assign(views_.begin(), views_.end());
+    }
+    if (next->tables.size() <= id) {
+        next->tables.resize(id + 1);
+    }
+    next->tables[id] = table;
+    std::atomic_store(&snapshot_, std::shared_ptr<const StorageSnapshot>(next));
+}
+
+void Storage::publishAll() {
+    auto next = std::make_shared<StorageSnapshot>();
+    next->catalog = std::make_shared<Catalog>(catalog_);
+    for (TableId id = 0; id < tables_.size(); ++id) {
+        next->tables.push_back(snapshotTable(id));
+    }
+    next->views.assign(views_.begin(), views_.end());
+    std::lock_guard<std::mutex> lock(publishMutex_);
+    std::atomic_store(&snapshot_, std::shared_ptr<const StorageSnapshot>(next));
+}
+
+void Storage::initPartitions(TableId id) {
+    Table& table = tables_[id];
+    const PartitionSpec& spec = catalog_.table(id).partitioning;
+    std::string base = dataDir_ + "/" + catalog_.tableName(id);
+    
+    table.partitions.clear();
+    for (uint32_t p = 0; p < spec.count; ++p) {
+        auto partition = std::make_unique<Partition>();
+        std::string stem = spec.kind == PartitionKind::NONE ? base : base + ".p" + std::to_string(p);
+        partition->dataFile = stem + ".csv";
+        partition->walFile = stem + ".wal";
+        partition->snapshotTag = snapshotTag(std::string());  // no snapshot file reads as empty
+        table.partitions.push_back(std::move(partition));
+    }
+}
+
+void Storage::indexRow(TableId id, uint32_t rowId) {
+    const Row& row = tables_[id].rows[rowId];
+    for (const auto& index : trigramIndexes_[id]) {
+        if (index->column() < row.values.size()) {
+            index->add(rowId, row.values[index->column()]);
+        }
+    }
+}
+
 void Storage::loadAllTables() {
+    // The catalog is authoritative for schemas; partition files hold the rows
+    std::string catalogPath = dataDir_ + "/catalog.bin";
+    if (!catalog_.load(catalogPath) && !catalog_.getLastError().empty()) {
+        std::cerr << "Warning: " << catalog_.getLastError() << "\n";
+    }
+    
+    // Issue the reads for every snapshot and WAL of every table up front so
+    // a cold start keeps the disk busy instead of reading file by file
+    std::vector<std::string> paths;
+    for (TableId id = 0; id < catalog_.tableCount(); ++id) {
+        Table table;
+        for (const ColumnSchema& column : catalog_.table(id).columns) {
+            table.columns.push_back(catalog_.identifier(column.name));
+        }
+        tables_.push_back(std::move(table));
+        stats_.emplace_back();
+        trigramIndexes_.emplace_back();
+        primaryIndexes_.emplace_back();
+        initPartitions(id);
+        for (auto& partition : tables_[id].partitions) {
+            paths.push_back(partition->dataFile);
+            paths.push_back(partition->walFile);
+        }
+    }
+    std::vector<std::string> contents;
+    readFiles(paths, contents);
+    
+    size_t file = 0;
+    for (TableId id = 0; id < catalog_.tableCount(); ++id) {
+        loadPartitions(id, contents, file);
+        buildIndexes(id);
+        buildPrimaryIndex(id);
+    }
+    
+    // Statistics of each table's last ANALYZE, if it had one
+    paths.clear();
+    for (TableId id = 0; id < catalog_.tableCount(); ++id) {
+        paths.push_back(statsFile(id));
+    }
+    readFiles(paths, contents);
+    for (TableId id = 0; id < catalog_.tableCount(); ++id) {
+        auto stats = std::make_shared<TableStats>();
+        if (!contents[id].empty() && decodeStats(contents[id], tables_[id].columns.size(), *stats)) {
+            stats_[id] = stats;
+        }
+    }
+    
+    // Pick up CSV files that predate the catalog
     DIR* dir = opendir(dataDir_.c_str());
     if (!dir) {
         return; // Directory doesn't exist or can't be opened
     }
     
+    bool catalogChanged = false;
     struct dirent* entry;
     while ((entry = readdir(dir)) != nullptr) {
         std::string filename = entry->d_name;
         
-        // Check if it's a CSV file
+        // Check if it's a CSV file (partition files are "<table>.p<n>.csv")
         if (filename.length() > 4 && 
             filename.substr(filename.length() - 4) == ".csv") {
-            loadTable(filename);
+            std::string tableName = filename.substr(0, filename.length() - 4);
+            if (tableName.find('.') != std::string::npos ||
+                catalog_.findTable(tableName) != INVALID_ID) {
+                continue;
+            }
+            
+            std::vector<std::string> columns;
+            std::vector<Row> rows;
+            if (loadTable(filename, columns, rows) && !columns.empty()) {
+                TableId id = catalog_.addTable(tableName, columns);
+                Table table;
+                for (const ColumnSchema& column : catalog_.table(id).columns) {
+                    table.columns.push_back(catalog_.identifier(column.name));
+                }
+                for (Row& row : rows) {
+                    table.bytes += row.bytes();
+                    table.rows.push_back(std::move(row));
+                }
+                tables_.push_back(std::move(table));
+                stats_.emplace_back();
+                trigramIndexes_.emplace_back();
+                primaryIndexes_.emplace_back();
+                initPartitions(id);
+                for (uint32_t r = 0; r < tables_[id].rows.size(); ++r) {
+                    tables_[id].partitions[0]->rowIds.push_back(r);
+                }
+                catalogChanged = true;
+            }
         }
     }
     
     closedir(dir);
+    
+    if (catalogChanged) {
+        saveCatalog();
+    }
+}
+
+void Storage::loadPartitions(TableId id, std::vector<std::string>& contents, size_t& file) {
+    // Snapshot first (minus its header), then the rows logged since the last checkpoint
+    uint32_t key = catalog_.table(id).primaryKey;
+    Table& loaded = tables_[id];
+    for (auto& partition : loaded.partitions) {
+        std::vector<Row> rows;
+        parseCsvText(contents[file], rows);
+        if (!rows.empty()) {
+            rows.erase(rows.begin());
+        }
+        size_t snapshotRows = rows.size();
+        
+        // Untagged WALs predate the tag and always apply
+        std::string& wal = contents[file + 1];
+        partition->snapshotTag = snapshotTag(contents[file]);
+        partition->walTag = wal.empty() ? std::string() : partition->snapshotTag;
+        partition->walBytes = wal.size();
+        if (wal.compare(0, sizeof(SNAPSHOT_TAG) - 1, SNAPSHOT_TAG) == 0) {
+            size_t end = wal.find('\n');
+            partition->walTag = wal.substr(0, end == std::string::npos ? wal.size() : end + 1);
+            wal.erase(0, partition->walTag == partition->snapshotTag ? partition->walTag.size()
+                                                                      : wal.size());
+        }
+        parseCsvText(wal, rows);
+        partition->walRecords = rows.size() - snapshotRows;
+        std::string().swap(contents[file]);
+        std::string().swap(contents[file + 1]);
+        file += 2;
+        if (key != INVALID_ID) {
+            keepLatestPerKey(rows, key);
+        }
+        for (Row& row : rows) {
+            partition->rowIds.push_back(static_cast<uint32_t>(loaded.rows.size()));
+            loaded.bytes += row.bytes();
+            loaded.rows.push_back(std::move(row));
+        }
+    }
 }
 
-bool Storage::saveTable(const std::string& tableName) {
-    auto it = tables_.find(tableName);
-    if (it == tables_.end()) {
-        lastError_ = "Table '" + tableName + "' not found";
+bool Storage::saveCatalog() {
+    if (dataDir_.empty()) {
+        return true;
+    }
+    if (!catalog_.save(dataDir_ + "/catalog.bin")) {
+        lastError_ = catalog_.getLastError();
         return false;
     }
-    
-    const Table& table = it->second;
-    std::string filename = dataDir_ + "/" + tableName + ".csv";
-    
-    std::ofstream file(filename);
-    if (!file.is_open()) {
-        lastError_ = "Failed to open file: " + filename;
+    return true;
+}
+
+bool Storage::openWal(Partition& partition) {
+    if (partition.walFd >= 0) {
+        return true;
+    }
+    partition.walFd = open(partition.walFile.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+    if (partition.walFd < 0) {
+        lastError_ = "Failed to open file: " + partition.walFile;
         return false;
     }
+    struct stat st;
+    partition.walBytes = fstat(partition.walFd, &st) == 0 ? static_cast<uint64_t>(st.st_size) : 0;
+    return true;
+}
+
+bool Storage::checkpointPartition(Table& table, Partition& partition) {
+    if (dataDir_.empty()) {
+        return true;
+    }
     
-    // Write header
-    for (size_t i = 0; i < table.columns.size(); ++i) {
-        if (i > 0) file << ",";
-        file << Utils::escapeCsv(table.columns[i]);
+    std::string data;
+    writeCsvRow(data, table.columns);
+    for (uint32_t rowId : partition.rowIds) {
+        writeCsvRow(data, table.rows[rowId].values);
     }
-    file << "\n";
     
-    // Write rows
-    for (const Row& row : table.rows) {
-        for (size_t i = 0; i < row.values.size(); ++i) {
-            if (i > 0) file << ",";
-            file << Utils::escapeCsv(row.values[i]);
-        }
-        file << "\n";
+    // A crash before the WAL is truncated leaves it tagged with the old
+    // snapshot, so it is skipped on load instead of replayed on top of the new one
+    if (!replaceFile(partition.dataFile, data)) {
+        return false;
     }
+    // If the truncate fails, the next append sees the stale tag and retries it
+    partition.snapshotTag = snapshotTag(data);
     
-    file.close();
+    if (!openWal(partition) || ftruncate(partition.walFd, 0) != 0) {
+        lastError_ = "Failed to truncate file: " + partition.walFile;
+        return false;
+    }
+    partition.walBytes = 0;
+    partition.walRecords = 0;
+    partition.walTag.clear();
     return true;
 }
 
-bool Storage::loadTable(const std::string& filename) {
-    std::string filepath = dataDir_ + "/" + filename;
-    std::ifstream file(filepath);
-    
-    if (!file.is_open()) {
+bool Storage::replaceFile(const std::string& path, const std::string& data) {
+    // Write and sync next to the old file and rename, so a crash leaves one or the other
+    std::string tmpFile = path + ".tmp";
+    int fd = open(tmpFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        lastError_ = "Failed to open file: " + tmpFile;
         return false;
     }
+    AsyncIO& io = AsyncIO::instance();
+    bool ok = io.writeAll(fd, data.data(), data.size(), 0) && io.wait(io.submitFsync(fd)) == 0;
+    close(fd);
     
-    // Extract table name from filename (remove .csv extension)
-    std::string tableName = filename.substr(0, filename.length() - 4);
-    tableName = Utils::toLower(tableName);
-    
-    Table table;
-    std::string line;
-    bool isHeader = true;
-    
-    while (std::getline(file, line)) {
-        if (line.empty()) continue;
-        
-        std::vector<std::string> fields = Utils::parseCsvLine(line);
-        
-        if (isHeader) {
-            table.columns = fields;
-            isHeader = false;
-        } else {
-            Row row;
-            row.values = fields;
-            table.rows.push_back(row);
+    if (!ok || std::rename(tmpFile.c_str(), path.c_str()) != 0) {
+        lastError_ = "Failed to write file: " + path;
+        return false;
+    }
+    return true;
+}
+
+std::string Storage::statsFile(TableId id) const {
+    return dataDir_ + "/" + catalog_.tableName(id) + ".stats";
+}
+
+bool Storage::checkpointTable(TableId id) {
+    Table& table = tables_[id];
+    if (table.evicted) {
+        return true;  // the files already hold every row and memory holds none
+    }
+    bool ok = true;
+    for (auto& partition : table.partitions) {
+        std::lock_guard<std::mutex> lock(partition->lock);
+        if (partition->walRecords > 0 || access(partition->dataFile.c_str(), F_OK) != 0) {
+            ok = checkpointPartition(table, *partition) && ok;
         }
     }
+    return ok;
+}
+
+std::vector<bool> Storage::readFiles(const std::vector<std::string>& paths, std::vector<std::string>& contents) {
+    struct PendingRead {
+        size_t file;
+        size_t offset;
+        size_t length;
+        AsyncIO::Ticket ticket;
+    };
+    AsyncIO& io = AsyncIO::instance();
+    std::vector<int> fds(paths.size(), -1);
+    std::vector<bool> found(paths.size(), false);
+    std::vector<PendingRead> reads;
+    contents.assign(paths.size(), std::string());
     
-    file.close();
+    for (size_t i = 0; i < paths.size(); ++i) {
+        fds[i] = open(paths[i].c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat st;
+        if (fds[i] < 0 || fstat(fds[i], &st) != 0) {
+            continue;
+        }
+        found[i] = true;
+        contents[i].resize(static_cast<size_t>(st.st_size));
+        for (size_t offset = 0; offset < contents[i].size(); offset += READ_CHUNK) {
+            PendingRead read;
+            read.file = i;
+            read.offset = offset;
+            read.length = std::min(READ_CHUNK, contents[i].size() - offset);
+            read.ticket = io.submitRead(fds[i], &contents[i][offset], read.length, offset);
+            reads.push_back(read);
+        }
+    }
     
-    if (!table.columns.empty()) {
-        tables_[tableName] = table;
-        return true;
+    for (const PendingRead& read : reads) {
+        if (!io.completeRead(read.ticket, fds[read.file], &contents[read.file][read.offset],
+                             read.length, read.offset)) {
+            found[read.file] = false;
+        }
+    }
+    for (size_t i = 0; i < paths.size(); ++i) {
+        if (fds[i] >= 0) close(fds[i]);
+        if (!found[i]) contents[i].clear();
+    }
+    return found;
+}
+
+bool Storage::loadTable(const std::string& filename, std::vector<std::string>& columns, std::vector<Row>& rows) {
+    std::vector<std::string> contents;
+    if (!readFiles(std::vector<std::string>(1, dataDir_ + "/" + filename), contents)[0]) {
+        return false;
     }
     
-    return false;
+    parseCsvText(contents[0], rows);
+    if (!rows.empty()) {
+        columns = rows.front().values;
+        rows.erase(rows.begin());
+    }
+    return true;
 }
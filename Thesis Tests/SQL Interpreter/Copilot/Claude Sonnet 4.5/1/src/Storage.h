@@ -3,36 +3,217 @@
 
 #include <string>
 #include <vector>
-#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <atomic>
+#include "Catalog.h"
+#include "TrigramIndex.h"
+#include "BPlusTree.h"
+#include "Value.h"
+#include "ChunkedVector.h"
 
 struct Row {
     std::vector<std::string> values;
+    std::vector<Cell> cells;  // typed form of values; filled for stored rows only
+    
+    void classify();
+    
+    // Estimated heap bytes: the row, its value strings and its cells. Stored
+    // rows keep both forms, so every memory figure (table bytes, eviction,
+    // query budgets) must count both.
+    size_t bytes() const;
+};
+
+// On-disk unit of a table: a CSV snapshot, a write-ahead log of rows appended
+// since the last checkpoint, and a lock serializing I/O on those two files.
+// Unpartitioned tables have exactly one partition.
+struct Partition {
+    ChunkedVector<uint32_t> rowIds; // rows of Table::rows stored in this partition
+    std::string dataFile;
+    std::string walFile;
+    size_t walRecords = 0;
+    int walFd = -1;          // opened on first append, closed by ~Storage
+    uint64_t walBytes = 0;   // append offset
+    std::string snapshotTag; // tag of dataFile's contents, see snapshotTag() in Storage.cpp
+    std::string walTag;      // tag walFile starts with, empty if the file is empty
+    std::mutex lock;
+};
+
+struct TableStats;
+class MaterializedView;
+
+// Access counters of one table. The live table and all of its snapshots
+// share one instance, so readers count without taking locks.
+struct TableAccess {
+    std::atomic<uint64_t> scans{0};        // full, partition-pruned and trigram scans
+    std::atomic<uint64_t> lookups{0};      // primary-key probes
+    std::atomic<uint64_t> rowsWritten{0};
+    std::atomic<uint64_t> reloads{0};      // loads after an eviction
+    std::atomic<int64_t> lastAccessMs{nowMs()};
+    
+    void touch() { lastAccessMs.store(nowMs(), std::memory_order_relaxed); }
+    uint64_t idleMs() const;
+    static int64_t nowMs();  // steady clock
 };
 
 struct Table {
     std::vector<std::string> columns;
-    std::vector<Row> rows;
+    ChunkedVector<Row> rows;
+    std::vector<std::unique_ptr<Partition>> partitions;
+    std::unique_ptr<std::mutex> writeLock{new std::mutex};  // one writer per table at a time
+    std::shared_ptr<std::shared_mutex> indexLock{new std::shared_mutex};  // exclusive while indexes change
+    std::shared_ptr<TableAccess> access{new TableAccess};
+    size_t bytes = 0;         // estimated heap bytes of the rows in memory
+    bool evicted = false;     // rows and indexes dropped; the partition files hold them
+    size_t evictedRows = 0;   // row count when evicted
+};
+
+// Read-only view of one table as of a commit. Rows and row ids share chunks
+// with the live table (see ChunkedVector). The indexes are the live objects:
+// probe them holding indexLock shared, and ignore row ids >= rows.size().
+struct TableSnapshot {
+    std::vector<std::string> columns;
+    ChunkedVector<Row> rows;
+    std::vector<ChunkedVector<uint32_t>> partitions;  // row ids per partition
+    std::shared_ptr<const TableStats> stats;          // nullptr if never analyzed
+    std::shared_ptr<const BPlusTree> primaryIndex;    // nullptr if the table has no key
+    std::vector<std::shared_ptr<const TrigramIndex>> trigramIndexes;
+    std::shared_ptr<std::shared_mutex> indexLock;
+    std::shared_ptr<TableAccess> access;              // nullptr for query-local tables
+    size_t bytes = 0;
+    bool evicted = false;     // empty until Storage::ensureLoaded brings the rows back
+    size_t evictedRows = 0;
+    
+    const TrigramIndex* trigramIndex(uint32_t column) const;
+};
+
+// Everything a query reads, published atomically after every change.
+// Readers pin one with Storage::snapshot() and never lock.
+struct StorageSnapshot {
+    std::shared_ptr<const Catalog> catalog;
+    std::vector<std::shared_ptr<const TableSnapshot>> tables;  // indexed by TableId
+    // Views are shared with the writer; reading one copies its groups under
+    // the view's own lock (see MaterializedView)
+    std::vector<std::shared_ptr<const MaterializedView>> views;  // indexed by ViewId
+    
+    const TableSnapshot* table(TableId id) const { return id < tables.size() ? tables[id].get() : nullptr; }
+    const MaterializedView* view(ViewId id) const { return id < views.size() ? views[id].get() : nullptr; }
+};
+
+class Storage;
+
+// Told about every change once it is in the WAL; used for log shipping.
+// Called on the thread that made the change, with the engine lock held.
+class ChangeListener {
+public:
+    virtual ~ChangeListener() {}
+    virtual void tableCreated(const Storage& storage, TableId id) = 0;
+    virtual void indexCreated(const Storage& storage, TableId id, const IndexSchema& index) = 0;
+    virtual void viewCreated(const Storage& storage, ViewId id) = 0;
+    // Rows inserted or overwritten, in statement order
+    virtual void rowsWritten(const Storage& storage, TableId id, const std::vector<uint32_t>& rowIds) = 0;
 };
 
 class Storage {
 public:
-    Storage();  // Loads existing tables from data/ directory
-    ~Storage(); // Saves all tables to data/ directory
+    // Loads existing tables from dataDir; an empty dataDir keeps everything in
+    // memory (replicas)
+    explicit Storage(const std::string& dataDir = "data");
+    ~Storage(); // Checkpoints all tables to dataDir
+    
+    void setChangeListener(ChangeListener* listener) { listener_ = listener; }
+    void clear();  // Drop every table; in-memory storage only
     
-    bool createTable(const std::string& name, const std::vector<std::string>& columns);
+    bool createTable(const std::string& name, const std::vector<std::string>& columns,
+                     const PartitionSpec& partitioning = PartitionSpec(),
+                     uint32_t primaryKey = INVALID_ID);
     bool insertRow(const std::string& tableName, const std::vector<std::string>& values);
+    bool insertRow(TableId id, const std::vector<std::string>& values);
+    bool insertRows(TableId id, const std::vector<std::vector<std::string>>& rows,
+                    ConflictAction onConflict = ConflictAction::ABORT);
+    // The checks insertRows runs before changing anything (column count, duplicate keys)
+    bool validateRows(TableId id, const std::vector<std::vector<std::string>>& rows,
+                      ConflictAction onConflict);
     const Table* getTable(const std::string& name) const;
+    const Table* getTable(TableId id) const;
+    
+    // Partition a row with the given partition-column value belongs to
+    uint32_t partitionFor(TableId id, const std::string& value) const;
+    static uint32_t partitionFor(const PartitionSpec& spec, const std::string& value);
     
+    // Latest published state; safe to call from any thread without locks
+    std::shared_ptr<const StorageSnapshot> snapshot() const { return std::atomic_load(&snapshot_); }
+    // Writers of one table serialize on this; different tables write in parallel
+    // (schema changes still need the caller to exclude all writers)
+    std::mutex& writeLock(TableId id) { return *tables_[id].writeLock; }
+    
+    // Optimizer statistics collected by ANALYZE (nullptr if never analyzed)
+    const TableStats* getStats(TableId id) const;
+    bool analyzeTable(TableId id);
+    
+    // Secondary indexes (definitions live in the catalog, contents in memory)
+    bool createIndex(TableId id, const std::string& name, uint32_t column, IndexKind kind);
+    const TrigramIndex* getTrigramIndex(TableId id, uint32_t column) const;
+    const BPlusTree* getPrimaryIndex(TableId id) const;  // nullptr if the table has no key
+    
+    // Materialized views; the definition is a SELECT (see MaterializedView::definitionSql)
+    bool createView(const std::string& name, const std::string& definition);
+    
+    // Hot/cold tiering; the caller holds the table's write lock (or excludes
+    // every writer). evictTable checkpoints a table idle for at least
+    // minIdleMs and drops its rows and indexes from memory; schema, statistics
+    // and views stay. ensureLoaded reads an evicted table back and is a no-op
+    // for resident ones. Writes, ANALYZE and index or view creation call it
+    // themselves; readers see TableSnapshot::evicted and must call it.
+    // evictTable returns false when the table stays in memory, with
+    // getLastError() empty unless that was a failure.
+    bool evictTable(TableId id, uint64_t minIdleMs);
+    bool ensureLoaded(TableId id);
+    
+    // Path of an EXPORT / IMPORT file: a plain name ([A-Za-z0-9._-], no
+    // leading '.') inside <dataDir>/exports, created on demand, so statements
+    // arriving over the network cannot reach other files
+    bool exportPath(const std::string& file, std::string& path) const;
+    
+    const Catalog& catalog() const { return catalog_; }
     std::string getLastError() const;
 
 private:
-    std::unordered_map<std::string, Table> tables_;
-    std::string lastError_;
+    Catalog catalog_;
+    std::vector<Table> tables_;  // indexed by TableId
+    std::vector<std::shared_ptr<TableStats>> stats_;  // indexed by TableId
+    std::vector<std::vector<std::shared_ptr<TrigramIndex>>> trigramIndexes_;  // indexed by TableId
+    std::vector<std::shared_ptr<BPlusTree>> primaryIndexes_;  // indexed by TableId
+    std::vector<std::shared_ptr<MaterializedView>> views_;   // indexed by ViewId, nullptr if unplannable
+    static thread_local std::string lastError_;  // writers of different tables run concurrently
     std::string dataDir_;
+    ChangeListener* listener_ = nullptr;
+    
+    std::shared_ptr<const StorageSnapshot> snapshot_;
+    std::mutex publishMutex_;  // orders concurrent publishers; readers never take it
+    void publish(TableId id, bool catalogChanged = false);
+    void publishAll();
+    std::shared_ptr<const TableSnapshot> snapshotTable(TableId id);
     
-    void loadAllTables();  // Load CSV files on startup
-    bool saveTable(const std::string& tableName);  // Save table to CSV
-    bool loadTable(const std::string& filename);   // Load single CSV file
+    void loadAllTables();  // Load catalog, partition snapshots and WALs on startup
+    // Rows of a table's partitions from their snapshot and WAL contents, which
+    // start at contents[file]; advances file past them
+    void loadPartitions(TableId id, std::vector<std::string>& contents, size_t& file);
+    void loadViews();      // Plan every view in the catalog and fold the loaded rows
+    void initPartitions(TableId id);
+    bool openWal(Partition& partition);
+    bool checkpointPartition(Table& table, Partition& partition);  // Rewrite snapshot, truncate WAL
+    bool checkpointTable(TableId id);
+    bool replaceFile(const std::string& path, const std::string& data);  // tmp file, fsync, rename
+    std::string statsFile(TableId id) const;  // last ANALYZE of the table
+    bool saveCatalog();
+    void buildIndexes(TableId id);  // Rebuild in-memory indexes from the catalog
+    void buildPrimaryIndex(TableId id);
+    void indexRow(TableId id, uint32_t rowId);
+    bool loadTable(const std::string& filename, std::vector<std::string>& columns, std::vector<Row>& rows);
+    // Read whole files with all chunks in flight at once; missing files read as empty
+    static std::vector<bool> readFiles(const std::vector<std::string>& paths, std::vector<std::string>& contents);
 };
 
 #endif // STORAGE_H
@@ -0,0 +1,196 @@
+#include "TextSearch.h"
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+inline unsigned char foldByte(unsigned char c) {
+    return (c >= 'A' && c <= 'Z') ? static_cast<unsigned char>(c | 0x20) : c;
+}
+
+bool equalBytes(const char* a, const char* b, size_t n, bool caseInsensitive) {
+    if (!caseInsensitive) {
+        return std::memcmp(a, b, n) == 0;
+    }
+    for (size_t i = 0; i < n; ++i) {
+        if (foldByte(static_cast<unsigned char>(a[i])) != foldByte(static_cast<unsigned char>(b[i]))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+#if defined(__SSE2__)
+// Lower-case ASCII letters in a 16-byte block
+inline __m128i foldBlock(__m128i block) {
+    const __m128i aMinus1 = _mm_set1_epi8('A' - 1);
+    const __m128i zPlus1 = _mm_set1_epi8('Z' + 1);
+    __m128i isUpper = _mm_and_si128(_mm_cmpgt_epi8(block, aMinus1), _mm_cmplt_epi8(block, zPlus1));
+    return _mm_or_si128(block, _mm_and_si128(isUpper, _mm_set1_epi8(0x20)));
+}
+#endif
+
+} // namespace
+
+size_t findSubstring(const std::string& haystack, const std::string& needle, size_t from,
+                     bool caseInsensitive) {
+    const size_t n = needle.size();
+    if (n == 0) {
+        return from <= haystack.size() ? from : std::string::npos;
+    }
+    if (from > haystack.size() || haystack.size() - from < n) {
+        return std::string::npos;
+    }
+    
+    const char* text = haystack.data();
+    const size_t last = haystack.size() - n;  // last valid start position
+    size_t i = from;
+    
+#if defined(__SSE2__)
+    // Compare the needle's first and last byte against 16 candidate positions
+    // at once; only positions where both match are verified byte by byte.
+    unsigned char first = static_cast<unsigned char>(needle[0]);
+    unsigned char lastByte = static_cast<unsigned char>(needle[n - 1]);
+    if (caseInsensitive) {
+        first = foldByte(first);
+        lastByte = foldByte(lastByte);
+    }
+    const __m128i firstVec = _mm_set1_epi8(static_cast<char>(first));
+    const __m128i lastVec = _mm_set1_epi8(static_cast<char>(lastByte));
+    
+    for (; i + 16 <= last + 1; i += 16) {
+        __m128i blockFirst = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i));
+        __m128i blockLast = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i + n - 1));
+        if (caseInsensitive) {
+            blockFirst = foldBlock(blockFirst);
+            blockLast = foldBlock(blockLast);
+        }
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(blockFirst, firstVec), _mm_cmpeq_epi8(blockLast, lastVec))));
+        while (mask != 0) {
+            unsigned bit = static_cast<unsigned>(__builtin_ctz(mask));
+            if (n <= 2 || equalBytes(text + i + bit + 1, needle.data() + 1, n - 2, caseInsensitive)) {
+                return i + bit;
+            }
+            mask &= mask - 1;
+        }
+    }
+#endif
+    
+    // Scalar tail (or the whole search without SSE2)
+    for (; i <= last; ++i) {
+        if (equalBytes(text + i, needle.data(), n, caseInsensitive)) {
+            return i;
+        }
+    }
+    return std::string::npos;
+}
+
+LikePattern::LikePattern(const std::string& pattern, bool caseInsensitive)
+    : anchoredStart_(pattern.empty() || pattern.front() != '%'),
+      anchoredEnd_(pattern.empty() || pattern.back() != '%'),
+      caseInsensitive_(caseInsensitive) {
+    std::string segment;
+    for (char c : pattern) {
+        if (c == '%') {
+            if (!segment.empty()) {
+                segments_.push_back(segment);
+                segment.clear();
+            }
+        } else {
+            segment += c;
+        }
+    }
+    if (!segment.empty() || segments_.empty()) {
+        segments_.push_back(segment);
+    }
+    for (const std::string& s : segments_) {
+        hasUnderscore_.push_back(s.find('_') != std::string::npos);
+    }
+}
+
+bool LikePattern::segmentAt(const std::string& text, size_t pos, size_t segment) const {
+    const std::string& s = segments_[segment];
+    if (pos > text.size() || text.size() - pos < s.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < s.size(); ++i) {
+        if (s[i] == '_') continue;
+        unsigned char a = static_cast<unsigned char>(text[pos + i]);
+        unsigned char b = static_cast<unsigned char>(s[i]);
+        if (caseInsensitive_ ? foldByte(a) != foldByte(b) : a != b) {
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t LikePattern::findSegment(const std::string& text, size_t from, size_t segment) const {
+    if (!hasUnderscore_[segment]) {
+        return findSubstring(text, segments_[segment], from, caseInsensitive_);
+    }
+    for (size_t pos = from; pos + segments_[segment].size() <= text.size(); ++pos) {
+        if (segmentAt(text, pos, segment)) {
+            return pos;
+        }
+    }
+    return std::string::npos;
+}
+
+bool LikePattern::matches(const std::string& text) const {
+    const size_t count = segments_.size();
+    
+    // No '%' at all: the whole text must match the single segment
+    if (anchoredStart_ && anchoredEnd_ && count == 1) {
+        return text.size() == segments_[0].size() && segmentAt(text, 0, 0);
+    }
+    
+    size_t pos = 0;
+    size_t first = 0;
+    size_t end = count;
+    
+    if (anchoredStart_) {
+        if (!segmentAt(text, 0, 0)) return false;
+        pos = segments_[0].size();
+        first = 1;
+    }
+    
+    size_t tailStart = text.size();
+    if (anchoredEnd_ && end > first) {
+        const std::string& lastSegment = segments_[end - 1];
+        if (text.size() < lastSegment.size()) return false;
+        tailStart = text.size() - lastSegment.size();
+        if (tailStart < pos || !segmentAt(text, tailStart, end - 1)) return false;
+        --end;
+    }
+    
+    // Greedy leftmost matching of the floating segments
+    for (size_t s = first; s < end; ++s) {
+        size_t found = findSegment(text, pos, s);
+        if (found == std::string::npos || found + segments_[s].size() > tailStart) {
+            return false;
+        }
+        pos = found + segments_[s].size();
+    }
+    return true;
+}
+
+std::vector<std::string> LikePattern::literals() const {
+    std::vector<std::string> result;
+    for (const std::string& segment : segments_) {
+        std::string run;
+        for (char c : segment) {
+            if (c == '_') {
+                if (!run.empty()) result.push_back(run);
+                run.clear();
+            } else {
+                run += c;
+            }
+        }
+        if (!run.empty()) result.push_back(run);
+    }
+    return result;
+}
@@ -0,0 +1,37 @@
+#ifndef TEXTSEARCH_H
+#define TEXTSEARCH_H
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+// Find needle in haystack starting at from; returns npos if absent.
+// Uses an SSE2 first/last-byte filter where available, scalar code otherwise.
+size_t findSubstring(const std::string& haystack, const std::string& needle, size_t from,
+                     bool caseInsensitive);
+
+// Compiled LIKE / ILIKE pattern ('%' = any sequence, '_' = any single character)
+class LikePattern {
+public:
+    LikePattern(const std::string& pattern, bool caseInsensitive);
+    
+    bool matches(const std::string& text) const;
+    
+    // Literal runs of the pattern without wildcards (used for trigram lookups)
+    std::vector<std::string> literals() const;
+    
+    bool caseInsensitive() const { return caseInsensitive_; }
+    bool anchoredStart() const { return anchoredStart_; }
+
+private:
+    std::vector<std::string> segments_;  // pattern split on '%'
+    std::vector<bool> hasUnderscore_;
+    bool anchoredStart_;                 // pattern does not begin with '%'
+    bool anchoredEnd_;                   // pattern does not end with '%'
+    bool caseInsensitive_;
+    
+    bool segmentAt(const std::string& text, size_t pos, size_t segment) const;
+    size_t findSegment(const std::string& text, size_t from, size_t segment) const;
+};
+
+#endif // TEXTSEARCH_H
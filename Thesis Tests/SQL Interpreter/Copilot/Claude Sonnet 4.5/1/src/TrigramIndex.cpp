@@ -0,0 +1,80 @@
+#include "TrigramIndex.h"
+#include <algorithm>
+#include <iterator>
+#include <cstdint>
+
+namespace {
+
+inline uint32_t foldByte(char c) {
+    unsigned char u = static_cast<unsigned char>(c);
+    return (u >= 'A' && u <= 'Z') ? static_cast<uint32_t>(u | 0x20) : u;
+}
+
+} // namespace
+
+uint32_t TrigramIndex::trigramAt(const std::string& text, size_t pos) {
+    return (foldByte(text[pos]) << 16) | (foldByte(text[pos + 1]) << 8) | foldByte(text[pos + 2]);
+}
+
+void TrigramIndex::add(uint32_t rowId, const std::string& value) {
+    for (size_t i = 0; i + 3 <= value.size(); ++i) {
+        std::vector<uint32_t>& list = postings_[trigramAt(value, i)];
+        // A value can contain the same trigram several times; new rows arrive in
+        // ascending order, re-indexed (updated) rows are inserted in place
+        if (list.empty() || list.back() < rowId) {
+            list.push_back(rowId);
+        } else {
+            auto it = std::lower_bound(list.begin(), list.end(), rowId);
+            if (*it != rowId) {
+                list.insert(it, rowId);
+            }
+        }
+    }
+}
+
+bool TrigramIndex::candidates(const std::vector<std::string>& literals, std::vector<uint32_t>& rows) const {
+    std::vector<const std::vector<uint32_t>*> lists;
+    for (const std::string& literal : literals) {
+        for (size_t i = 0; i + 3 <= literal.size(); ++i) {
+            auto it = postings_.find(trigramAt(literal, i));
+            if (it == postings_.end()) {
+                rows.clear();   // some trigram never occurs: no row can match
+                return true;
+            }
+            lists.push_back(&it->second);
+        }
+    }
+    if (lists.empty()) {
+        return false;
+    }
+    
+    // Intersect shortest lists first so the working set shrinks quickly
+    std::sort(lists.begin(), lists.end(),
+              [](const std::vector<uint32_t>* a, const std::vector<uint32_t>* b) { return a->size() < b->size(); });
+    rows = *lists[0];
+    std::vector<uint32_t> next;
+    for (size_t i = 1; i < lists.size() && !rows.empty(); ++i) {
+        if (lists[i] == lists[i - 1]) continue;
+        next.clear();
+        std::set_intersection(rows.begin(), rows.end(), lists[i]->begin(), lists[i]->end(),
+                              std::back_inserter(next));
+        rows.swap(next);
+    }
+    return true;
+}
+
+void TrigramIndex::postingSizes(const std::vector<std::string>& literals, size_t& shortest, size_t& total) const {
+    shortest = SIZE_MAX;
+    total = 0;
+    for (const std::string& literal : literals) {
+        for (size_t i = 0; i + 3 <= literal.size(); ++i) {
+            auto it = postings_.find(trigramAt(literal, i));
+            size_t size = it == postings_.end() ? 0 : it->second.size();
+            shortest = std::min(shortest, size);
+            total += size;
+        }
+    }
+    if (shortest == SIZE_MAX) {
+        shortest = 0;
+    }
+}
@@ -0,0 +1,35 @@
+#ifndef TRIGRAMINDEX_H
+#define TRIGRAMINDEX_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+// Inverted index from case-folded 3-byte substrings to row ids. Answers
+// LIKE/ILIKE with a literal run of at least three characters by intersecting
+// posting lists; the candidates must still be checked against the pattern.
+class TrigramIndex {
+public:
+    explicit TrigramIndex(uint32_t column) : column_(column) {}
+    
+    void add(uint32_t rowId, const std::string& value);  // also used to re-index an updated row
+    
+    // Candidate rows containing every trigram of every literal; returns false
+    // if the literals are too short for the index to narrow anything down
+    bool candidates(const std::vector<std::string>& literals, std::vector<uint32_t>& rows) const;
+    
+    // Posting list sizes for the literals' trigrams, used by the planner:
+    // the shortest list bounds the candidate count, the total is the lookup work
+    void postingSizes(const std::vector<std::string>& literals, size_t& shortest, size_t& total) const;
+    
+    uint32_t column() const { return column_; }
+
+private:
+    uint32_t column_;
+    std::unordered_map<uint32_t, std::vector<uint32_t>> postings_;  // ascending row ids
+    
+    static uint32_t trigramAt(const std::string& text, size_t pos);
+};
+
+#endif // TRIGRAMINDEX_H
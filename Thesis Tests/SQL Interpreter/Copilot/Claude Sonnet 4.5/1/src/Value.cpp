@@ -0,0 +1,204 @@
+#include "Value.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cerrno>
+
+namespace {
+
+// 2^63: doubles in [-2^63, 2^63) convert to int64 without overflow
+const double INT64_LIMIT = 9223372036854775808.0;
+
+int sign(double a, double b) {
+    return a < b ? -1 : (a > b ? 1 : 0);
+}
+
+bool isCanonicalInteger(const std::string& text) {
+    size_t i = text[0] == '-' ? 1 : 0;
+    if (i == text.size() || (text[i] == '0' && (text.size() > i + 1 || i == 1))) {
+        return false;  // "", "-", "007", "-0"
+    }
+    for (; i < text.size(); ++i) {
+        if (text[i] < '0' || text[i] > '9') return false;
+    }
+    return true;
+}
+
+// Integer vs double, exact: the double is split into its integral part
+// (compared as int64) and a fractional remainder
+int compareMixed(int64_t integer, double real) {
+    if (real >= INT64_LIMIT) return -1;
+    if (real < -INT64_LIMIT) return 1;
+    double whole = std::floor(real);
+    int64_t truncated = static_cast<int64_t>(whole);
+    if (integer != truncated) {
+        return integer < truncated ? -1 : 1;
+    }
+    return real > whole ? -1 : 0;
+}
+
+} // namespace
+
+Cell Cell::classify(const std::string& text) {
+    Cell cell;
+    if (text.empty()) {
+        return cell;
+    }
+    char first = text[0];
+    if (first != '-' && (first < '0' || first > '9')) {
+        if (text == NULL_TEXT) {
+            cell.type = ValueType::NULL_VALUE;
+        }
+        return cell;
+    }
+    
+    if (isCanonicalInteger(text)) {
+        errno = 0;
+        long long value = std::strtoll(text.c_str(), nullptr, 10);
+        if (errno != ERANGE) {
+            cell.type = ValueType::INT64;
+            cell.integer = value;
+            return cell;
+        }
+    }
+    
+    char* end = nullptr;
+    double value = std::strtod(text.c_str(), &end);
+    if (end == text.c_str() + text.size() && std::isfinite(value) && formatDouble(value) == text) {
+        cell.type = ValueType::DOUBLE;
+        cell.real = value;
+    }
+    return cell;
+}
+
+Value Value::null() {
+    Value value;
+    value.cell.type = ValueType::NULL_VALUE;
+    value.text = NULL_TEXT;
+    return value;
+}
+
+Value Value::fromInteger(int64_t integer) {
+    Value value;
+    value.cell.type = ValueType::INT64;
+    value.cell.integer = integer;
+    value.text = std::to_string(integer);
+    return value;
+}
+
+Value Value::fromDouble(double real) {
+    Value value;
+    value.cell.type = ValueType::DOUBLE;
+    value.cell.real = real;
+    value.text = formatDouble(real);
+    return value;
+}
+
+Value Value::fromText(const std::string& text) {
+    Value value;
+    value.text = text;
+    return value;
+}
+
+std::string Value::toSql() const {
+    if (cell.type == ValueType::NULL_VALUE) {
+        return "NULL";
+    }
+    return cell.type == ValueType::TEXT ? "'" + text + "'" : text;
+}
+
+std::vector<std::string> Value::equalTexts() const {
+    std::vector<std::string> texts;
+    if (cell.type == ValueType::TEXT) {
+        texts.push_back(text);
+    } else if (cell.type == ValueType::INT64) {
+        texts.push_back(text);
+        double real = static_cast<double>(cell.integer);
+        if (compareMixed(cell.integer, real) == 0) {
+            texts.push_back(formatDouble(real));
+        }
+    } else if (cell.type == ValueType::DOUBLE) {
+        texts.push_back(text);
+        if (std::floor(cell.real) == cell.real && cell.real >= -INT64_LIMIT && cell.real < INT64_LIMIT) {
+            texts.push_back(std::to_string(static_cast<int64_t>(cell.real)));
+        }
+    }
+    return texts;
+}
+
+std::string formatDouble(double value) {
+    if (value == 0) {
+        value = 0;  // one text for -0.0 and 0.0
+    }
+    // Plain notation for everyday magnitudes, exponents outside them
+    double magnitude = std::fabs(value);
+    bool plain = value == 0 || (magnitude >= 1e-4 && magnitude < 1e15);
+    char buffer[64];
+    for (int precision = plain ? 0 : 1; precision <= 17; ++precision) {
+        std::snprintf(buffer, sizeof(buffer), plain ? "%.*f" : "%.*g", precision, value);
+        if (std::strtod(buffer, nullptr) == value) {
+            break;
+        }
+    }
+    std::string text = buffer;
+    if (text.find_first_of(".en") == std::string::npos) {
+        text += ".0";  // keep integral doubles distinct from integers
+    }
+    return text;
+}
+
+int compareNumbers(const Cell& a, const Cell& b) {
+    if (a.type == ValueType::INT64 && b.type == ValueType::INT64) {
+        return a.integer < b.integer ? -1 : (a.integer > b.integer ? 1 : 0);
+    }
+    if (a.type == ValueType::DOUBLE && b.type == ValueType::DOUBLE) {
+        return sign(a.real, b.real);
+    }
+    return a.type == ValueType::INT64 ? compareMixed(a.integer, b.real) : -compareMixed(b.integer, a.real);
+}
+
+int compareCells(const Cell& a, const std::string& aText, const Cell& b, const std::string& bText) {
+    // Rank: numbers 0, text 1, NULL 2
+    int rankA = a.isNumber() ? 0 : (a.type == ValueType::TEXT ? 1 : 2);
+    int rankB = b.isNumber() ? 0 : (b.type == ValueType::TEXT ? 1 : 2);
+    if (rankA != rankB) {
+        return rankA < rankB ? -1 : 1;
+    }
+    if (rankA == 0) {
+        return compareNumbers(a, b);
+    }
+    if (rankA == 1) {
+        int c = aText.compare(bText);
+        return c < 0 ? -1 : (c > 0 ? 1 : 0);
+    }
+    return 0;
+}
+
+bool equalityKey(const Cell& cell, const std::string& text, std::string& key) {
+    if (cell.type == ValueType::NULL_VALUE) {
+        return false;
+    }
+    if (cell.type == ValueType::DOUBLE && std::floor(cell.real) == cell.real &&
+        cell.real >= -INT64_LIMIT && cell.real < INT64_LIMIT) {
+        key = std::to_string(static_cast<int64_t>(cell.real));
+    } else {
+        key = text;
+    }
+    return true;
+}
+
+bool compareWithLiteral(const Cell& cell, const std::string& text, const Value& literal, int& result) {
+    if (cell.type == ValueType::NULL_VALUE || literal.cell.type == ValueType::NULL_VALUE) {
+        return false;
+    }
+    if (literal.cell.type == ValueType::TEXT) {
+        int c = text.compare(literal.text);
+        result = c < 0 ? -1 : (c > 0 ? 1 : 0);
+        return true;
+    }
+    if (!cell.isNumber()) {
+        return false;
+    }
+    result = compareNumbers(cell, literal.cell);
+    return true;
+}
@@ -0,0 +1,77 @@
+#ifndef VALUE_H
+#define VALUE_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+enum class ValueType : uint8_t {
+    NULL_VALUE,
+    INT64,
+    DOUBLE,
+    TEXT
+};
+
+// Stored text of a NULL cell (the PostgreSQL COPY convention)
+const char NULL_TEXT[] = "\\N";
+
+// Binary form of a stored cell. Cells stay text in files and the WAL; the
+// type is derived once when a row enters storage, so comparisons never
+// re-parse numbers. The binary protocol sends numbers in this form.
+struct Cell {
+    ValueType type = ValueType::TEXT;
+    union {
+        int64_t integer;
+        double real;
+    };
+    
+    Cell() : integer(0) {}
+    
+    bool isNumber() const { return type == ValueType::INT64 || type == ValueType::DOUBLE; }
+    
+    // Only canonical numbers ("30", "-4", "2.5") are numeric; anything else,
+    // including "030" or "2.50", stays text so no stored value changes meaning
+    static Cell classify(const std::string& text);
+};
+
+// A typed literal, parsed once by the lexer
+struct Value {
+    Cell cell;
+    std::string text;  // canonical text, as it is stored
+    
+    ValueType type() const { return cell.type; }
+    
+    static Value null();
+    static Value fromInteger(int64_t value);
+    static Value fromDouble(double value);
+    static Value fromText(const std::string& value);
+    
+    // Quoted text, bare numbers or NULL
+    std::string toSql() const;
+    
+    // Every stored text that compares equal to this value; used to probe
+    // text-keyed structures (primary key, hash/range partitions)
+    std::vector<std::string> equalTexts() const;
+};
+
+// Shortest text that reads back as the same double, always with a '.' or exponent
+std::string formatDouble(double value);
+
+// Three-way comparison of two numeric cells, exact across INT64 and DOUBLE
+int compareNumbers(const Cell& a, const Cell& b);
+
+// Total order used for sorting: numbers, then text, then NULL
+int compareCells(const Cell& a, const std::string& aText, const Cell& b, const std::string& bText);
+
+// Text shared by every cell that WHERE '=' finds equal to this one: the
+// stored text, except that an integral DOUBLE takes its INT64 spelling.
+// False for NULL, which equals nothing.
+bool equalityKey(const Cell& cell, const std::string& text, std::string& key);
+
+// WHERE semantics: three-way comparison of a stored cell with a literal.
+// Text literals compare with the cell's text; numeric literals compare with
+// numeric cells only. False when the result is unknown (NULL on either side,
+// or a number against text).
+bool compareWithLiteral(const Cell& cell, const std::string& text, const Value& literal, int& result);
+
+#endif // VALUE_H
@@ -0,0 +1,224 @@
+#include "WindowOperator.h"
+#include <algorithm>
+#include <numeric>
+
+namespace {
+
+bool isAggregate(WindowFunction function) {
+    return function != WindowFunction::ROW_NUMBER && function != WindowFunction::RANK &&
+           function != WindowFunction::DENSE_RANK;
+}
+
+// Running state of one aggregate over the current frame
+struct Accumulator {
+    size_t rows = 0;                    // COUNT(*)
+    size_t count = 0;                   // non-NULL arguments
+    bool integral = true;               // every value so far was INT64, without overflow
+    int64_t integerSum = 0;
+    double sum = 0;
+    const Row* best = nullptr;          // MIN / MAX
+};
+
+} // namespace
+
+WindowOperator::WindowOperator(const std::vector<WindowCall>& calls) : calls_(calls) {
+    for (size_t i = 0; i < calls_.size(); ++i) {
+        bool placed = false;
+        for (std::vector<size_t>& group : groups_) {
+            if (sameOrdering(calls_[group[0]], calls_[i])) {
+                group.push_back(i);
+                placed = true;
+                break;
+            }
+        }
+        if (!placed) {
+            groups_.push_back(std::vector<size_t>(1, i));
+        }
+    }
+}
+
+bool WindowOperator::sameOrdering(const WindowCall& a, const WindowCall& b) {
+    if (a.partitionIds != b.partitionIds || a.orderBy.size() != b.orderBy.size()) {
+        return false;
+    }
+    for (size_t k = 0; k < a.orderBy.size(); ++k) {
+        if (a.orderBy[k].columnId != b.orderBy[k].columnId ||
+            a.orderBy[k].descending != b.orderBy[k].descending) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool WindowOperator::evaluate(const std::vector<const Row*>& rows, std::vector<std::vector<std::string>>& values,
+                              std::vector<uint32_t>& order, const QueryControl& control) {
+    values.assign(calls_.size(), std::vector<std::string>(rows.size()));
+    for (size_t g = 0; g < groups_.size(); ++g) {
+        std::vector<uint32_t> sorted;
+        if (!evaluateGroup(rows, groups_[g], values, sorted, control)) {
+            return false;
+        }
+        if (g == 0) {
+            order.swap(sorted);
+        }
+    }
+    return true;
+}
+
+bool WindowOperator::expired(const QueryControl& control) {
+    if (!control.expired()) {
+        return false;
+    }
+    error_ = control.reason();
+    return true;
+}
+
+bool WindowOperator::evaluateGroup(const std::vector<const Row*>& rows, const std::vector<size_t>& group,
+                                   std::vector<std::vector<std::string>>& values, std::vector<uint32_t>& sorted,
+                                   const QueryControl& control) {
+    const WindowCall& spec = calls_[group[0]];
+    const size_t n = rows.size();
+    const size_t partitionKeys = spec.partitionIds.size();
+    const size_t width = partitionKeys + spec.orderBy.size();
+    
+    // Cells were typed when the rows were stored, so comparing never parses
+    auto compare = [&](uint32_t a, uint32_t b, size_t from, size_t to) {
+        const Row& left = *rows[a];
+        const Row& right = *rows[b];
+        for (size_t k = from; k < to; ++k) {
+            bool partition = k < partitionKeys;
+            uint32_t column = partition ? spec.partitionIds[k] : spec.orderBy[k - partitionKeys].columnId;
+            int c = compareCells(left.cells[column], left.values[column], right.cells[column], right.values[column]);
+            if (!partition && spec.orderBy[k - partitionKeys].descending) {
+                c = -c;
+            }
+            if (c != 0) {
+                return c;
+            }
+        }
+        return 0;
+    };
+    
+    // A stable merge sort in batches: runs of SORT_BATCH rows are sorted, then
+    // merged pairwise, and the deadline is checked between batches and merges
+    auto less = [&](uint32_t a, uint32_t b) { return compare(a, b, 0, width) < 0; };
+    sorted.resize(n);
+    std::iota(sorted.begin(), sorted.end(), 0u);
+    for (size_t from = 0; from < n; from += SORT_BATCH) {
+        if (expired(control)) {
+            return false;
+        }
+        std::stable_sort(sorted.begin() + from, sorted.begin() + std::min(n, from + SORT_BATCH), less);
+    }
+    for (size_t run = SORT_BATCH; run < n; run *= 2) {
+        for (size_t from = 0; from + run < n; from += 2 * run) {
+            if (expired(control)) {
+                return false;
+            }
+            std::inplace_merge(sorted.begin() + from, sorted.begin() + from + run,
+                               sorted.begin() + std::min(n, from + 2 * run), less);
+        }
+    }
+    
+    std::vector<Accumulator> accumulators(group.size());
+    size_t sinceCheck = 0;
+    for (size_t start = 0; start < n;) {
+        size_t end = start + 1;
+        while (end < n && compare(sorted[start], sorted[end], 0, partitionKeys) == 0) {
+            ++end;
+        }
+        std::fill(accumulators.begin(), accumulators.end(), Accumulator());
+        size_t denseRank = 0;
+        
+        // Peer groups (equal ORDER BY values) share a frame end, so each one is
+        // folded into the running aggregates once and then assigned to its rows
+        for (size_t peer = start; peer < end;) {
+            size_t peerEnd = peer + 1;
+            while (peerEnd < end && compare(sorted[peer], sorted[peerEnd], partitionKeys, width) == 0) {
+                ++peerEnd;
+            }
+            ++denseRank;
+            sinceCheck += peerEnd - peer;
+            if (sinceCheck >= QueryControl::CHECK_INTERVAL) {
+                sinceCheck = 0;
+                if (expired(control)) {
+                    return false;
+                }
+            }
+            
+            for (size_t c = 0; c < group.size(); ++c) {
+                const WindowCall& call = calls_[group[c]];
+                if (!isAggregate(call.function)) {
+                    continue;
+                }
+                Accumulator& acc = accumulators[c];
+                for (size_t r = peer; r < peerEnd; ++r) {
+                    ++acc.rows;
+                    if (call.argumentId == INVALID_ID) {
+                        continue;  // COUNT(*)
+                    }
+                    const Row& row = *rows[sorted[r]];
+                    const Cell& cell = row.cells[call.argumentId];
+                    if (cell.type == ValueType::NULL_VALUE) {
+                        continue;  // aggregates skip NULLs
+                    }
+                    ++acc.count;
+                    if (call.function == WindowFunction::SUM || call.function == WindowFunction::AVG) {
+                        if (!cell.isNumber()) {
+                            error_ = "Cannot aggregate non-numeric value '" + row.values[call.argumentId] +
+                                     "' in " + call.alias;
+                            return false;
+                        }
+                        double number = cell.type == ValueType::INT64 ? static_cast<double>(cell.integer) : cell.real;
+                        acc.sum += number;
+                        if (acc.integral && (cell.type != ValueType::INT64 ||
+                                             __builtin_add_overflow(acc.integerSum, cell.integer, &acc.integerSum))) {
+                            acc.integral = false;
+                        }
+                    } else if (call.function == WindowFunction::MIN || call.function == WindowFunction::MAX) {
+                        uint32_t column = call.argumentId;
+                        int order = acc.best ? compareCells(cell, row.values[column], acc.best->cells[column],
+                                                            acc.best->values[column]) : 0;
+                        if (!acc.best || (call.function == WindowFunction::MIN ? order < 0 : order > 0)) {
+                            acc.best = &row;
+                        }
+                    }
+                }
+            }
+            
+            for (size_t c = 0; c < group.size(); ++c) {
+                const WindowCall& call = calls_[group[c]];
+                const Accumulator& acc = accumulators[c];
+                std::string shared;
+                switch (call.function) {
+                    case WindowFunction::RANK:       shared = std::to_string(peer - start + 1); break;
+                    case WindowFunction::DENSE_RANK: shared = std::to_string(denseRank); break;
+                    case WindowFunction::COUNT:
+                        shared = std::to_string(call.argumentId == INVALID_ID ? acc.rows : acc.count);
+                        break;
+                    case WindowFunction::SUM:
+                        shared = acc.count == 0 ? NULL_TEXT
+                                                : (acc.integral ? std::to_string(acc.integerSum) : formatDouble(acc.sum));
+                        break;
+                    case WindowFunction::AVG:
+                        shared = acc.count == 0 ? NULL_TEXT : formatDouble(acc.sum / acc.count);
+                        break;
+                    case WindowFunction::MIN:
+                    case WindowFunction::MAX:
+                        shared = acc.best ? acc.best->values[call.argumentId] : NULL_TEXT;
+                        break;
+                    case WindowFunction::ROW_NUMBER:
+                        break;
+                }
+                std::vector<std::string>& out = values[group[c]];
+                for (size_t r = peer; r < peerEnd; ++r) {
+                    out[sorted[r]] = call.function == WindowFunction::ROW_NUMBER ? std::to_string(r - start + 1)
+                                                                                  : shared;
+                }
+            }
+            peer = peerEnd;
+        }
+        start = end;
+    }
+    return true;
+}
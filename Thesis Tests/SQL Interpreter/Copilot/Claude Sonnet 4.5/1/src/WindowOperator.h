@@ -0,0 +1,51 @@
+#ifndef WINDOWOPERATOR_H
+#define WINDOWOPERATOR_H
+
+#include <string>
+#include <vector>
+#include "Ast.h"
+#include "Storage.h"
+#include "QueryControl.h"
+
+// Evaluates window functions over the rows a scan produced. Calls that share
+// a PARTITION BY / ORDER BY specification share one sort; each specification
+// is then finished in a single pass that carries running aggregates from one
+// peer group to the next, so a query costs O(n log n) per distinct ordering.
+//
+// Frames follow the SQL default: with ORDER BY, from the partition start
+// through the current row's last peer; without it, the whole partition.
+// ORDER BY compares the typed cells: numbers by value, then text, then NULLs.
+// Aggregates skip NULLs; SUM stays an integer while every input is INT64.
+// The sort and the frame pass both poll the query's deadline and cancel flag.
+class WindowOperator {
+public:
+    explicit WindowOperator(const std::vector<WindowCall>& calls);
+    
+    // Rows sorted per batch before the batches are merged
+    static const size_t SORT_BATCH = 16 * QueryControl::CHECK_INTERVAL;
+    
+    // values[c][i] is the result of calls[c] for rows[i]; order lists the rows
+    // in the ordering of the first call, which is how they are returned.
+    // False with getError() set to control.reason() once the query expires.
+    bool evaluate(const std::vector<const Row*>& rows, std::vector<std::vector<std::string>>& values,
+                  std::vector<uint32_t>& order, const QueryControl& control);
+    
+    // Number of sorts evaluate() performs
+    size_t sortCount() const { return groups_.size(); }
+    
+    std::string getError() const { return error_; }
+    
+    static bool sameOrdering(const WindowCall& a, const WindowCall& b);
+    
+private:
+    const std::vector<WindowCall>& calls_;
+    std::vector<std::vector<size_t>> groups_;  // call indexes sharing one ordering
+    std::string error_;
+    
+    bool expired(const QueryControl& control);  // sets error_ if so
+    bool evaluateGroup(const std::vector<const Row*>& rows, const std::vector<size_t>& group,
+                       std::vector<std::vector<std::string>>& values, std::vector<uint32_t>& sorted,
+                       const QueryControl& control);
+};
+
+#endif // WINDOWOPERATOR_H
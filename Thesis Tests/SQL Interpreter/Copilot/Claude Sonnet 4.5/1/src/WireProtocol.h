@@ -0,0 +1,197 @@
+#ifndef WIREPROTOCOL_H
+#define WIREPROTOCOL_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include "Value.h"
+
+// Binary wire protocol shared by BinaryServer and protocol clients.
+//
+// Every frame is:  [u32 length][u8 type][payload]
+// where length counts the type byte plus the payload. All integers are
+// big-endian. A connection stays open until the client sends TERMINATE or
+// closes the socket; clients may pipeline any number of QUERY frames and the
+// server answers them strictly in order.
+//
+// Client -> server
+//   'Q' QUERY        payload: SQL text (one statement)
+//   'X' TERMINATE    payload: empty
+//
+// Server -> client (per query, in this order)
+//   'T' ROW_DESC     u16 columnCount, then per column: u8 typeTag, u16 nameLen, name
+//   'D' ROW_BATCH    u32 rowCount, then per row and column: u8 typeTag, value
+//                      TYPE_NULL    no bytes
+//                      TYPE_INT64   8 bytes, two's complement
+//                      TYPE_DOUBLE  8 bytes, IEEE 754 bits
+//                      TYPE_TEXT    u32 len, bytes
+//   'C' COMPLETE     u32 rowCount, then message text ("OK")
+//   'E' ERROR        message text (ends the query instead of COMPLETE)
+//
+// ROW_DESC and ROW_BATCH are only sent for statements that return rows.
+// Columns are untyped, so ROW_DESC tags them TYPE_ANY and every value
+// carries its own tag. Numbers go out in binary; a client renders them with
+// the canonical text the server stores (see Cell::classify).
+namespace Wire {
+
+const uint8_t QUERY     = 'Q';
+const uint8_t TERMINATE = 'X';
+const uint8_t ROW_DESC  = 'T';
+const uint8_t ROW_BATCH = 'D';
+const uint8_t COMPLETE  = 'C';
+const uint8_t ERROR     = 'E';
+
+// Type tags: TYPE_ANY for columns, the others for values
+const uint8_t TYPE_ANY    = 0;
+const uint8_t TYPE_TEXT   = 1;
+const uint8_t TYPE_INT64  = 2;
+const uint8_t TYPE_DOUBLE = 3;
+const uint8_t TYPE_NULL   = 4;
+const size_t HEADER_SIZE = 5;                 // u32 length + u8 type
+const uint32_t MAX_FRAME_SIZE = 64u << 20;    // reject absurd frames
+const size_t ROWS_PER_BATCH = 1024;
+
+inline void putU16(std::string& out, uint16_t v) {
+    out += static_cast<char>((v >> 8) & 0xFF);
+    out += static_cast<char>(v & 0xFF);
+}
+
+inline void putU32(std::string& out, uint32_t v) {
+    out += static_cast<char>((v >> 24) & 0xFF);
+    out += static_cast<char>((v >> 16) & 0xFF);
+    out += static_cast<char>((v >> 8) & 0xFF);
+    out += static_cast<char>(v & 0xFF);
+}
+
+inline void putU64(std::string& out, uint64_t v) {
+    putU32(out, static_cast<uint32_t>(v >> 32));
+    putU32(out, static_cast<uint32_t>(v));
+}
+
+inline uint16_t getU16(const char* p) {
+    const unsigned char* u = reinterpret_cast<const unsigned char*>(p);
+    return static_cast<uint16_t>((u[0] << 8) | u[1]);
+}
+
+inline uint32_t getU32(const char* p) {
+    const unsigned char* u = reinterpret_cast<const unsigned char*>(p);
+    return (static_cast<uint32_t>(u[0]) << 24) | (static_cast<uint32_t>(u[1]) << 16) |
+           (static_cast<uint32_t>(u[2]) << 8) | static_cast<uint32_t>(u[3]);
+}
+
+inline uint64_t getU64(const char* p) {
+    return (static_cast<uint64_t>(getU32(p)) << 32) | getU32(p + 4);
+}
+
+// Append one value of a ROW_BATCH; cell is the typed form of text
+inline void putValue(std::string& out, const Cell& cell, const std::string& text) {
+    switch (cell.type) {
+        case ValueType::NULL_VALUE:
+            out += static_cast<char>(TYPE_NULL);
+            break;
+        case ValueType::INT64:
+            out += static_cast<char>(TYPE_INT64);
+            putU64(out, static_cast<uint64_t>(cell.integer));
+            break;
+        case ValueType::DOUBLE: {
+            uint64_t bits;
+            std::memcpy(&bits, &cell.real, sizeof(bits));
+            out += static_cast<char>(TYPE_DOUBLE);
+            putU64(out, bits);
+            break;
+        }
+        case ValueType::TEXT:
+            out += static_cast<char>(TYPE_TEXT);
+            putU32(out, static_cast<uint32_t>(text.size()));
+            out += text;
+            break;
+    }
+}
+
+// Decode one value of a ROW_BATCH at p, advancing it. The text is what the
+// server stores for the value. False if the value is truncated or malformed.
+inline bool getValue(const char*& p, const char* end, Cell& cell, std::string& text) {
+    if (p == end) {
+        return false;
+    }
+    uint8_t tag = static_cast<uint8_t>(*p++);
+    cell = Cell();
+    if (tag == TYPE_NULL) {
+        cell.type = ValueType::NULL_VALUE;
+        text = NULL_TEXT;
+        return true;
+    }
+    if (tag == TYPE_INT64 || tag == TYPE_DOUBLE) {
+        if (end - p < 8) {
+            return false;
+        }
+        uint64_t bits = getU64(p);
+        p += 8;
+        if (tag == TYPE_INT64) {
+            cell.type = ValueType::INT64;
+            cell.integer = static_cast<int64_t>(bits);
+            text = std::to_string(cell.integer);
+        } else {
+            cell.type = ValueType::DOUBLE;
+            std::memcpy(&cell.real, &bits, sizeof(bits));
+            text = formatDouble(cell.real);
+        }
+        return true;
+    }
+    if (tag != TYPE_TEXT || end - p < 4) {
+        return false;
+    }
+    uint32_t length = getU32(p);
+    p += 4;
+    if (static_cast<size_t>(end - p) < length) {
+        return false;
+    }
+    text.assign(p, length);
+    p += length;
+    return true;
+}
+
+// Append a complete frame to out
+inline void appendFrame(std::string& out, uint8_t type, const std::string& payload) {
+    putU32(out, static_cast<uint32_t>(payload.size() + 1));
+    out += static_cast<char>(type);
+    out += payload;
+}
+
+// Start a frame whose payload is written directly into out; finish with endFrame
+inline size_t beginFrame(std::string& out, uint8_t type) {
+    size_t start = out.size();
+    putU32(out, 0);
+    out += static_cast<char>(type);
+    return start;
+}
+
+inline void endFrame(std::string& out, size_t start) {
+    uint32_t length = static_cast<uint32_t>(out.size() - start - 4);
+    out[start]     = static_cast<char>((length >> 24) & 0xFF);
+    out[start + 1] = static_cast<char>((length >> 16) & 0xFF);
+    out[start + 2] = static_cast<char>((length >> 8) & 0xFF);
+    out[start + 3] = static_cast<char>(length & 0xFF);
+}
+
+// Try to extract one frame from buffer starting at offset.
+// Returns false if the frame is not complete yet.
+inline bool readFrame(const std::string& buffer, size_t& offset, uint8_t& type, std::string& payload) {
+    if (buffer.size() - offset < HEADER_SIZE) {
+        return false;
+    }
+    uint32_t length = getU32(buffer.data() + offset);
+    if (length == 0 || buffer.size() - offset - 4 < length) {
+        return false;
+    }
+    type = static_cast<uint8_t>(buffer[offset + 4]);
+    payload.assign(buffer, offset + HEADER_SIZE, length - 1);
+    offset += 4 + length;
+    return true;
+}
+
+} // namespace Wire
+
+#endif // WIREPROTOCOL_H
@@ -1,53 +1,224 @@
 #include "Engine.h"
 #include "HttpServer.h"
+#include "BinaryServer.h"
+#include "RemoteClient.h"
+#include "Replication.h"
+#include "MemoryTracker.h"
+#include "AsyncIO.h"
 #include <iostream>
 #include <cstring>
 #include <cstdlib>
+#include <thread>
 
 void printUsage(const char* programName) {
     std::cout << "Usage:\n";
     std::cout << "  " << programName << "                    - Start interactive REPL mode\n";
     std::cout << "  " << programName << " <script.sql>       - Execute SQL from script file\n";
     std::cout << "  " << programName << " --web [port]       - Start web server (default port: 8080)\n";
+    std::cout << "  " << programName << " --binary [port]    - Start binary protocol server (default port: 9090)\n";
+    std::cout << "  " << programName << " --connect host:port [script.sql]\n";
+    std::cout << "      - REPL or pipelined script against a running binary protocol server\n";
+    std::cout << "\nOptions:\n";
+    std::cout << "  --memory-limit <size>   Per-query memory budget, e.g. 64M (results spill to disk beyond it)\n";
+    std::cout << "  --io-backend <name>     Storage I/O backend: uring, threads or auto (default)\n";
+    std::cout << "  --query-timeout <ms>    Default per-query deadline (0 = none)\n";
+    std::cout << "  --evict-after <s>       Unload tables idle this long to disk, reloaded on use (0 = never)\n";
+    std::cout << "  --max-queries <n>       Web server: statements run at once, the rest queue (default 4)\n";
+    std::cout << "  --heavy-cost <cost>     Web server: planner cost from which a query is heavy (default 100000)\n";
+    std::cout << "  --primary <socket>      Ship the WAL to replicas over a Unix socket\n";
+    std::cout << "  --replica-of <socket>   Run as a read-only, in-memory replica of that primary\n";
     std::cout << "\nExamples:\n";
     std::cout << "  " << programName << "\n";
     std::cout << "  " << programName << " script.sql\n";
     std::cout << "  " << programName << " --web\n";
     std::cout << "  " << programName << " --web 3000\n";
+    std::cout << "  " << programName << " --web 8080 --binary 9090\n";
+    std::cout << "  " << programName << " --web 8080 --primary /tmp/minisql.sock\n";
+    std::cout << "  " << programName << " --web 8081 --replica-of /tmp/minisql.sock\n";
+    std::cout << "  " << programName << " --connect localhost:9090 load.sql\n";
+}
+
+// Parse an optional port argument following a flag
+static bool parsePort(int argc, char* argv[], int& i, int& port) {
+    if (i + 1 < argc && argv[i + 1][0] != '-') {
+        port = std::atoi(argv[++i]);
+        if (port <= 0 || port > 65535) {
+            std::cerr << "Error: Invalid port number. Must be between 1 and 65535.\n";
+            return false;
+        }
+    }
+    return true;
 }
 
 int main(int argc, char* argv[]) {
-    Engine engine;
+    if (argc == 2 && (strcmp(argv[1], "--help") == 0 || strcmp(argv[1], "-h") == 0)) {
+        printUsage(argv[0]);
+        return 0;
+    }
     
-    if (argc == 1) {
-        // No arguments - start REPL
-        engine.repl();
-    } else if (argc == 2) {
-        if (strcmp(argv[1], "--help") == 0 || strcmp(argv[1], "-h") == 0) {
-            printUsage(argv[0]);
-            return 0;
-        } else if (strcmp(argv[1], "--web") == 0) {
-            // Start web server on default port
-            HttpServer server(&engine, 8080);
-            server.start();
+    bool web = false;
+    bool binary = false;
+    int webPort = 8080;
+    int binaryPort = 9090;
+    size_t memoryLimit = 0;
+    long queryTimeout = 0;
+    long maxQueries = 4;
+    long evictAfter = 0;
+    double heavyCost = 100000;
+    bool requireUring = false;
+    std::string script;
+    std::string primarySocket;
+    std::string replicaOf;
+    std::string connectHost;
+    int connectPort = 0;
+    
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--web") == 0) {
+            web = true;
+            if (!parsePort(argc, argv, i, webPort)) return 1;
+        } else if (strcmp(argv[i], "--binary") == 0) {
+            binary = true;
+            if (!parsePort(argc, argv, i, binaryPort)) return 1;
+        } else if (strcmp(argv[i], "--memory-limit") == 0) {
+            if (i + 1 >= argc || !parseByteSize(argv[++i], memoryLimit)) {
+                std::cerr << "Error: Invalid memory limit. Use bytes or a K/M/G suffix.\n";
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--query-timeout") == 0 || strcmp(argv[i], "--max-queries") == 0) {
+            bool timeout = argv[i][2] == 'q';
+            char* end = nullptr;
+            long value = i + 1 < argc ? std::strtol(argv[++i], &end, 10) : -1;
+            if (!end || *end != '\0' || value < (timeout ? 0 : 1) || value > (timeout ? 86400000 : 1024)) {
+                std::cerr << "Error: Invalid " << (timeout ? "query timeout" : "query limit") << ".\n";
+                return 1;
+            }
+            (timeout ? queryTimeout : maxQueries) = value;
+        } else if (strcmp(argv[i], "--evict-after") == 0) {
+            char* end = nullptr;
+            evictAfter = i + 1 < argc ? std::strtol(argv[++i], &end, 10) : -1;
+            if (!end || *end != '\0' || evictAfter < 0 || evictAfter > 31536000) {
+                std::cerr << "Error: Invalid eviction timeout.\n";
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--heavy-cost") == 0) {
+            char* end = nullptr;
+            heavyCost = i + 1 < argc ? std::strtod(argv[++i], &end) : -1;
+            if (!end || *end != '\0' || heavyCost < 0) {
+                std::cerr << "Error: Invalid heavy query cost.\n";
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--io-backend") == 0) {
+            std::string name = i + 1 < argc ? argv[++i] : "";
+            if (name == "uring") {
+                AsyncIO::configure(AsyncIO::Backend::IO_URING);
+                requireUring = true;
+            } else if (name == "threads") {
+                AsyncIO::configure(AsyncIO::Backend::THREADS);
+            } else if (name != "auto") {
+                std::cerr << "Error: Invalid I/O backend. Use uring, threads or auto.\n";
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--primary") == 0 || strcmp(argv[i], "--replica-of") == 0) {
+            if (i + 1 >= argc) {
+                std::cerr << "Error: " << argv[i] << " needs a socket path.\n";
+                return 1;
+            }
+            (argv[i][2] == 'p' ? primarySocket : replicaOf) = argv[i + 1];
+            ++i;
+        } else if (strcmp(argv[i], "--connect") == 0) {
+            std::string target = i + 1 < argc ? argv[++i] : "";
+            size_t colon = target.rfind(':');
+            connectPort = colon == std::string::npos ? 0 : std::atoi(target.c_str() + colon + 1);
+            if (colon == 0 || connectPort <= 0 || connectPort > 65535) {
+                std::cerr << "Error: --connect needs host:port.\n";
+                return 1;
+            }
+            connectHost = target.substr(0, colon);
+        } else if (argv[i][0] != '-' && script.empty()) {
+            script = argv[i];
         } else {
-            // Execute script file
-            engine.executeScript(argv[1]);
-        }
-    } else if (argc == 3 && strcmp(argv[1], "--web") == 0) {
-        // Start web server on custom port
-        int port = std::atoi(argv[2]);
-        if (port <= 0 || port > 65535) {
-            std::cerr << "Error: Invalid port number. Must be between 1 and 65535.\n";
+            std::cerr << "Error: Invalid arguments.\n\n";
+            printUsage(argv[0]);
             return 1;
         }
-        HttpServer server(&engine, port);
-        server.start();
-    } else {
+    }
+    
+    if ((!script.empty() && (web || binary)) || (!primarySocket.empty() && !replicaOf.empty())) {
         std::cerr << "Error: Invalid arguments.\n\n";
         printUsage(argv[0]);
         return 1;
     }
     
+    // A client opens no storage of its own
+    if (!connectHost.empty()) {
+        if (web || binary || !primarySocket.empty() || !replicaOf.empty()) {
+            std::cerr << "Error: --connect cannot be combined with server options.\n\n";
+            printUsage(argv[0]);
+            return 1;
+        }
+        RemoteClient client(connectHost, connectPort);
+        if (!client.connect()) {
+            std::cerr << "Error: " << client.getError() << "\n";
+            return 1;
+        }
+        if (script.empty()) {
+            client.repl();
+        } else if (!client.runScript(script)) {
+            std::cerr << "Error: " << client.getError() << "\n";
+            return 1;
+        }
+        return 0;
+    }
+    
+    // An explicit uring does not fall back to the thread pool like auto does
+    if (requireUring && strcmp(AsyncIO::instance().backendName(), "io_uring") != 0) {
+        std::cerr << "Error: io_uring is unavailable; use --io-backend auto or threads.\n";
+        return 1;
+    }
+    
+    // Replicas keep no files of their own; they bootstrap from the primary
+    Engine engine(replicaOf.empty() ? "data" : "");
+    engine.setMemoryLimit(memoryLimit);
+    engine.setQueryTimeout(static_cast<uint32_t>(queryTimeout));
+    engine.setEvictAfter(static_cast<uint32_t>(evictAfter));
+    
+    ReplicationServer replicationServer(&engine, primarySocket);
+    if (!primarySocket.empty()) {
+        std::thread([&replicationServer]() { replicationServer.start(); }).detach();
+    }
+    ReplicaClient replica(&engine, replicaOf);
+    if (!replicaOf.empty()) {
+        engine.setReadOnly(true);
+        replica.start();
+        if (!replica.waitForSnapshot(5000)) {
+            std::cerr << "Warning: No snapshot from the primary yet; serving an empty database until it arrives\n";
+        }
+    }
+    
+    if (web || binary) {
+        // The binary listener runs alongside the web server when both are requested
+        BinaryServer binaryServer(&engine, binaryPort);
+        std::thread binaryThread;
+        if (binary && web) {
+            binaryThread = std::thread([&binaryServer]() { binaryServer.start(); });
+            binaryThread.detach();
+        }
+        
+        if (web) {
+            HttpServer server(&engine, webPort);
+            server.setMaxQueries(static_cast<size_t>(maxQueries));
+            server.setHeavyCost(heavyCost);
+            server.start();
+        } else {
+            binaryServer.start();
+        }
+    } else if (!script.empty()) {
+        // Execute script file
+        engine.executeScript(script);
+    } else {
+        // No arguments - start REPL
+        engine.repl();
+    }
+    
     return 0;
 }
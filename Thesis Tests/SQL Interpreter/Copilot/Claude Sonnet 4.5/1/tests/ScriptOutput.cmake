@@ -0,0 +1,35 @@
+# Runs a script through minisql in a fresh data directory and checks that
+# every error is printed exactly once, on stderr, while results still reach
+# stdout.
+#
+#   cmake -DMINISQL=<binary> -DSCRIPT=<file.sql> -DWORK_DIR=<dir> -P ScriptOutput.cmake
+
+file(REMOVE_RECURSE "${WORK_DIR}")
+file(MAKE_DIRECTORY "${WORK_DIR}")
+
+execute_process(
+    COMMAND "${MINISQL}" "${SCRIPT}"
+    WORKING_DIRECTORY "${WORK_DIR}"
+    OUTPUT_VARIABLE out
+    ERROR_VARIABLE err
+    RESULT_VARIABLE status)
+
+if(NOT status EQUAL 0)
+    message(FATAL_ERROR "minisql exited with ${status}\n${err}")
+endif()
+
+function(expect_count text haystack expected where)
+    string(REGEX MATCHALL "${text}" matches "${haystack}")
+    list(LENGTH matches count)
+    if(NOT count EQUAL expected)
+        message(FATAL_ERROR "'${text}' printed ${count} time(s) on ${where}, expected ${expected}\n"
+                            "stdout:\n${out}\nstderr:\n${err}")
+    endif()
+endfunction()
+
+expect_count("Table 'missing_select' does not exist" "${err}" 1 stderr)
+expect_count("Table 'missing_insert' does not exist" "${err}" 1 stderr)
+expect_count("Parse error" "${err}" 1 stderr)
+expect_count("does not exist" "${out}" 0 stdout)
+expect_count("Parse error" "${out}" 0 stdout)
+expect_count("one" "${out}" 1 stdout)
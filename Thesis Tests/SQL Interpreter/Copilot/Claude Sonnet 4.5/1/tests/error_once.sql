@@ -0,0 +1,7 @@
+-- Each failing statement must be reported exactly once (on stderr)
+CREATE TABLE t (id, name);
+INSERT INTO t VALUES (1, 'one');
+SELECT * FROM missing_select;
+INSERT INTO missing_insert VALUES (1);
+SELEC 1;
+SELECT * FROM t;